@@ -7,6 +7,9 @@
 #include <tilck/common/assert.h>
 #include <tilck/common/fat32_base.h>
 #include <tilck/common/utils.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/lz4.h>
+#include <tilck/common/arch/generic_x86/x86_utils.h>
 
 #include "defs.h"
 #include "utils.h"
@@ -22,6 +25,11 @@ struct load_ramdisk_ctx {
    UINT32 rounded_tot_used_bytes;   /* Rounded up at PAGE_SIZE */
 
    void *fat_hdr;
+
+   bool lz4;                        /* The initrd is LZ4-compressed */
+   struct lz4_rd_hdr lz4_hdr;
+   u64 read_cycles;
+   u64 dec_cycles;
 };
 
 static EFI_STATUS
@@ -43,6 +51,18 @@ LoadRamdisk_GetTotFatSize(struct load_ramdisk_ctx *ctx)
    status = ReadAlignedBlock(ctx->blockio, initrd_off, PAGE_SIZE, fat_hdr);
    HANDLE_EFI_ERROR("ReadAlignedBlock");
 
+   if (lz4_rd_check_hdr(fat_hdr)) {
+
+      ctx->lz4 = true;
+      ctx->lz4_hdr = *(struct lz4_rd_hdr *)fat_hdr;
+      ctx->tot_used_bytes = ctx->lz4_hdr.orig_size;
+      ctx->rounded_tot_used_bytes = round_up_at(ctx->tot_used_bytes, PAGE_SIZE);
+
+      status = BS->FreePages(paddr, 1);
+      HANDLE_EFI_ERROR("FreePages");
+      goto end;
+   }
+
    fat_sec_sz = fat_get_sector_size(fat_hdr);
    ctx->total_fat_size = (fat_get_first_data_sector(fat_hdr) + 1) * fat_sec_sz;
    ctx->rounded_tot_fat_sz = round_up_at(ctx->total_fat_size, PAGE_SIZE);
@@ -92,6 +112,86 @@ end:
    return status;
 }
 
+/*
+ * Read the LZ4-compressed initrd (see <tilck/common/lz4.h>) chunk by chunk,
+ * decompressing each chunk directly in the final buffer, right after reading
+ * it. EFI_BLOCK_IO is synchronous, so the decompression is interleaved with
+ * the reads, but we read much less data and we never need to keep in memory
+ * the whole compressed image.
+ */
+static EFI_STATUS
+LoadRamdisk_ReadLz4(struct load_ramdisk_ctx *ctx)
+{
+   const struct lz4_rd_hdr *hdr = &ctx->lz4_hdr;
+   const UINTN initrd_off = INITRD_SECTOR * SECTOR_SIZE;
+   const UINTN chunk_sz = 256 * KB;
+   const UINTN tail_sz =
+      round_up_at(LZ4_RD_MAX_BLOCK_BYTES(hdr->block_size), PAGE_SIZE);
+   const UINTN tot_sz =
+      round_up_at(hdr->hdr_size + hdr->comp_size,
+                  ctx->blockio->Media->BlockSize);
+   const UINTN pages = (tail_sz + chunk_sz) / PAGE_SIZE;
+
+   EFI_PHYSICAL_ADDRESS paddr = 0;
+   EFI_STATUS status;
+   struct lz4_rd_stream s;
+   UINTN done, n;
+   u32 pending = 0, skip = hdr->hdr_size;
+   u8 *chunk, *data;
+   u64 start;
+   int rc;
+
+   status = BS->AllocatePages(AllocateAnyPages,
+                              EfiLoaderData,
+                              pages,
+                              &paddr);
+   HANDLE_EFI_ERROR("AllocatePages");
+
+   /* Layout: [ tail of the previous chunk ][ chunk buffer ] */
+   chunk = (u8 *)TO_PTR(paddr) + tail_sz;
+   lz4_rd_stream_init(&s, hdr, ctx->fat_hdr);
+
+   for (done = 0; done < tot_sz; done += n) {
+
+      n = MIN(chunk_sz, tot_sz - done);
+
+      start = RDTSC();
+      status = ReadAlignedBlock(ctx->blockio, initrd_off + done, n, chunk);
+      ctx->read_cycles += RDTSC() - start;
+      HANDLE_EFI_ERROR("ReadAlignedBlock");
+
+      /* The incomplete block at the end of the previous chunk comes first */
+      data = chunk - pending + skip;
+      pending += (u32)n - skip;
+      skip = 0;
+
+      start = RDTSC();
+      rc = lz4_rd_feed(&s, data, pending);
+      ctx->dec_cycles += RDTSC() - start;
+
+      if (rc < 0 || pending - (u32)rc > tail_sz)
+         break;
+
+      pending -= (u32)rc;
+      memmove(chunk - pending, data + rc, pending);
+      ShowProgress(ST->ConOut, LOADING_INITRD_STR_U, done + n, tot_sz);
+   }
+
+   if (!lz4_rd_done(&s) || !fat_check_header(ctx->fat_hdr)) {
+      Print(L"\nCorrupted LZ4 ramdisk\n");
+      status = EFI_VOLUME_CORRUPTED;
+      goto end;
+   }
+
+   ctx->tot_used_bytes = fat_calculate_used_bytes(ctx->fat_hdr);
+
+end:
+   if (paddr)
+      BS->FreePages(paddr, pages);
+
+   return status;
+}
+
 static EFI_STATUS
 LoadRamdisk_CompactClusters(struct load_ramdisk_ctx *ctx)
 {
@@ -249,19 +349,29 @@ LoadRamdisk(EFI_HANDLE image,
    status = LoadRamdisk_GetTotFatSize(&ctx);
    HANDLE_EFI_ERROR("LoadRamdisk_GetTotFatSize");
 
-   status = LoadRamdisk_GetTotUsedBytes(&ctx);
-   HANDLE_EFI_ERROR("LoadRamdisk_GetTotUsedBytes");
+   if (!ctx.lz4) {
+      status = LoadRamdisk_GetTotUsedBytes(&ctx);
+      HANDLE_EFI_ERROR("LoadRamdisk_GetTotUsedBytes");
+   }
 
    status = LoadRamdisk_AllocMem(&ctx);
    HANDLE_EFI_ERROR("LoadRamdisk_AllocMem");
 
-   status = ReadDiskWithProgress(ST->ConOut,
-                                 LOADING_INITRD_STR_U,
-                                 ctx.blockio,
-                                 initrd_off,
-                                 ctx.rounded_tot_used_bytes,
-                                 ctx.fat_hdr);
-   HANDLE_EFI_ERROR("ReadDiskWithProgress");
+   if (ctx.lz4) {
+
+      status = LoadRamdisk_ReadLz4(&ctx);
+      HANDLE_EFI_ERROR("LoadRamdisk_ReadLz4");
+
+   } else {
+
+      status = ReadDiskWithProgress(ST->ConOut,
+                                    LOADING_INITRD_STR_U,
+                                    ctx.blockio,
+                                    initrd_off,
+                                    ctx.rounded_tot_used_bytes,
+                                    ctx.fat_hdr);
+      HANDLE_EFI_ERROR("ReadDiskWithProgress");
+   }
 
    /* Now we're done with the BlockIoProtocol, close it. */
    BS->CloseProtocol(bioDeviceHandle, &BlockIoProtocol, image, NULL);
@@ -271,6 +381,12 @@ LoadRamdisk(EFI_HANDLE image,
    Print(LOADING_INITRD_STR_U);
    write_ok_msg();
 
+   if (ctx.lz4) {
+      Print(L"LZ4 ramdisk: %u -> %u KB, read: %u M, decompress: %u M cycles\n",
+            ctx.lz4_hdr.comp_size / KB, ctx.lz4_hdr.orig_size / KB,
+            (u32)(ctx.read_cycles >> 20), (u32)(ctx.dec_cycles >> 20));
+   }
+
    status = LoadRamdisk_CompactClusters(&ctx);
    HANDLE_EFI_ERROR("LoadRamdisk_CompactClusters");
 
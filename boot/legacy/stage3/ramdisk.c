@@ -6,6 +6,10 @@
 #include <tilck/common/fat32_base.h>
 #include <tilck/common/printk.h>
 #include <tilck/common/color_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+#include <tilck/common/lz4.h>
+#include <tilck/common/arch/generic_x86/x86_utils.h>
 
 #include <multiboot.h>
 
@@ -14,6 +18,8 @@
 #include "mm.h"
 #include "common.h"
 
+#define READ_CHUNK_SECTORS                      1024
+
 static void
 dump_progress(const char *prefix_str, u32 curr, u32 tot)
 {
@@ -35,7 +41,7 @@ static void
 read_sectors_with_progress(const char *prefix_str,
                            u32 paddr, u32 first_sector, u32 count)
 {
-   const u32 chunk_sectors = 1024;
+   const u32 chunk_sectors = READ_CHUNK_SECTORS;
    const u32 chunks_count = count / chunk_sectors;
    const u32 rem = count - chunks_count * chunk_sectors;
 
@@ -95,65 +101,98 @@ overlap_with_kernel_file(ulong pa, ulong sz)
    return IN_RANGE(pa, kbegin, kend) || IN_RANGE(pa + sz, kbegin, kend);
 }
 
+/*
+ * Load an LZ4-compressed ramdisk (see <tilck/common/lz4.h>), decompressing it
+ * chunk by chunk directly at its final location, while reading it. This way,
+ * we read from the disk much less data and we don't need to keep the whole
+ * compressed image in memory. Since int 13h is synchronous, the decompression
+ * of each chunk is interleaved with the reads, not concurrent with them.
+ *
+ * Memory layout: [ ramdisk ][ tail of the previous chunk ][ chunk buffer ]
+ */
 static bool
-check_fat_header(struct fat_hdr *hdr)
+load_lz4_ramdisk(const char *load_str,
+                 const struct lz4_rd_hdr *hdr,
+                 u32 first_sec,
+                 ulong min_paddr,
+                 ulong *ref_rd_paddr,
+                 u32 *ref_rd_size,
+                 bool alloc_extra_page)
 {
-   /*
-    * Minimum sanity checks for determining if we correctly read a real FAT
-    * header or some corrupted data.
-    */
+   const u32 chunk_sz = READ_CHUNK_SECTORS * SECTOR_SIZE;
+   const u32 tail_sz = round_up_at(LZ4_RD_MAX_BLOCK_BYTES(hdr->block_size),
+                                   SECTOR_SIZE);
+   const u32 tot_sectors =
+      (hdr->hdr_size + hdr->comp_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+   struct lz4_rd_stream s;
+   ulong rd_paddr, size_to_alloc;
+   u64 start, read_cycles = 0, dec_cycles = 0;
+   u32 sec, left, n, pending = 0, skip = hdr->hdr_size;
+   u8 *chunk, *data;
+   int rc;
 
-   if (hdr->BPB_BytsPerSec != SECTOR_SIZE)
+   size_to_alloc = round_up_at(hdr->orig_size, SECTOR_SIZE);
+
+   if (alloc_extra_page)
+      size_to_alloc += PAGE_SIZE;
+
+   size_to_alloc += tail_sz + chunk_sz;
+   rd_paddr = get_usable_mem(&g_meminfo, min_paddr, size_to_alloc);
+
+   if (!rd_paddr || overlap_with_kernel_file(rd_paddr, size_to_alloc)) {
+      printk("No free memory for loading the ramdisk\n");
       return false;
+   }
 
-   switch (fat_get_type(hdr)) {
-
-      case fat12_type:
-         /* We never use FAT12: something must be wrong */
-         return false;
-
-      case fat16_type:
-
-         {
-            struct fat16_header2 *h2 = (void *)(hdr + 1);
-
-            if (h2->BS_FilSysType[0] != 'F' ||
-                h2->BS_FilSysType[1] != 'A' ||
-                h2->BS_FilSysType[2] != 'T')
-            {
-               /*
-               * The FAT specification does not require BS_FilSysType to be set,
-               * but the Tilck tools and most of the FAT tools in general do set
-               * this field to a reasonable value like FAT16 or FAT32. If it
-               * does not start with "FAT", something is wrong.
-               */
-               return false;
-            }
-         }
-         break;
+   chunk = (u8 *)rd_paddr + size_to_alloc - chunk_sz;
+   lz4_rd_stream_init(&s, hdr, (void *)rd_paddr);
+
+   for (sec = first_sec, left = tot_sectors; left > 0; left -= n, sec += n) {
 
-      case fat32_type:
+      n = MIN(left, (u32)READ_CHUNK_SECTORS);
 
-         {
-            struct fat32_header2 *h2 = (void *)(hdr + 1);
+      start = RDTSC();
+      read_sectors((ulong)chunk, sec, n);
+      read_cycles += RDTSC() - start;
 
-            if (h2->BS_FilSysType[0] != 'F' ||
-                h2->BS_FilSysType[1] != 'A' ||
-                h2->BS_FilSysType[2] != 'T')
-            {
-               /* Same as for fat16_type */
-               return false;
-            }
-         }
+      /* The incomplete block at the end of the previous chunk comes first */
+      data = chunk - pending + skip;
+      pending += n * SECTOR_SIZE - skip;
+      skip = 0;
 
+      start = RDTSC();
+      rc = lz4_rd_feed(&s, data, pending);
+      dec_cycles += RDTSC() - start;
+
+      if (rc < 0)
          break;
 
-      default:
+      pending -= (u32)rc;
 
-         /* We couldn't determine the FAT type */
-         return false;
+      if (pending > tail_sz)
+         break;
+
+      memmove(chunk - pending, data + rc, pending);
+      dump_progress(load_str, tot_sectors - left + n, tot_sectors);
+   }
+
+   if (!lz4_rd_done(&s) || !fat_check_header((void *)rd_paddr)) {
+      printk("\n");
+      printk("Corrupted LZ4 ramdisk\n");
+      return false;
    }
 
+   bt_movecur(bt_get_curr_row(), 0);
+   printk("%s", load_str);
+   write_ok_msg();
+
+   printk("LZ4 ramdisk: %u -> %u KB, read: %u M, decompress: %u M cycles\n",
+          hdr->comp_size / KB, hdr->orig_size / KB,
+          (u32)(read_cycles >> 20), (u32)(dec_cycles >> 20));
+
+   *ref_rd_paddr = rd_paddr;
+   *ref_rd_size = fat_calculate_used_bytes((void *)rd_paddr);
    return true;
 }
 
@@ -181,8 +220,22 @@ load_fat_ramdisk(const char *load_str,
    // Read FAT's header
    read_sectors(free_mem, first_sec, 1 /* read just 1 sector */);
 
+   if (lz4_rd_check_hdr((void *)free_mem)) {
+
+      /* Copy the header: `free_mem` will be reused for the ramdisk */
+      struct lz4_rd_hdr hdr = *(struct lz4_rd_hdr *)free_mem;
+
+      if (!load_lz4_ramdisk(load_str, &hdr, first_sec, min_paddr,
+                            ref_rd_paddr, ref_rd_size, alloc_extra_page))
+      {
+         goto end;
+      }
+
+      return true;
+   }
+
    // Do some sanity checks against data corruption
-   if (!check_fat_header((void *)free_mem))
+   if (!fat_check_header((void *)free_mem))
       goto corrupted;
 
    // Determine FAT's metadata size
@@ -1,5 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#include <tilck_gen_headers/config_boot.h>
+
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/assert.h>
 #include <tilck/common/string_util.h>
@@ -269,7 +271,12 @@ fat_walk(struct fat_walk_static_params *p, u32 cluster)
           * In that case, fat_get_rootdir() returns 0 as cluster. In all the
           * other cases, we need only the cluster.
           */
-         dentries = fat_get_pointer_to_cluster_data(p->h, cluster);
+         dentries = p->clu_data_cb
+            ? p->clu_data_cb(p->clu_data_arg, cluster)
+            : fat_get_pointer_to_cluster_data(p->h, cluster);
+
+         if (!dentries)
+            return -5; /* EIO */
       }
 
       ASSERT(dentries != NULL);
@@ -869,6 +876,67 @@ fat_calculate_used_bytes(struct fat_hdr *hdr)
    return (ff_sector + 1) * hdr->BPB_BytsPerSec;
 }
 
+bool fat_check_header(struct fat_hdr *hdr)
+{
+   /*
+    * Minimum sanity checks for determining if we correctly read a real FAT
+    * header or some corrupted data.
+    */
+
+   if (hdr->BPB_BytsPerSec != SECTOR_SIZE)
+      return false;
+
+   switch (fat_get_type(hdr)) {
+
+      case fat12_type:
+         /* We never use FAT12: something must be wrong */
+         return false;
+
+      case fat16_type:
+
+         {
+            struct fat16_header2 *h2 = (void *)(hdr + 1);
+
+            if (h2->BS_FilSysType[0] != 'F' ||
+                h2->BS_FilSysType[1] != 'A' ||
+                h2->BS_FilSysType[2] != 'T')
+            {
+               /*
+               * The FAT specification does not require BS_FilSysType to be set,
+               * but the Tilck tools and most of the FAT tools in general do set
+               * this field to a reasonable value like FAT16 or FAT32. If it
+               * does not start with "FAT", something is wrong.
+               */
+               return false;
+            }
+         }
+         break;
+
+      case fat32_type:
+
+         {
+            struct fat32_header2 *h2 = (void *)(hdr + 1);
+
+            if (h2->BS_FilSysType[0] != 'F' ||
+                h2->BS_FilSysType[1] != 'A' ||
+                h2->BS_FilSysType[2] != 'T')
+            {
+               /* Same as for fat16_type */
+               return false;
+            }
+         }
+
+         break;
+
+      default:
+
+         /* We couldn't determine the FAT type */
+         return false;
+   }
+
+   return true;
+}
+
 bool fat_is_first_data_sector_aligned(struct fat_hdr *hdr, u32 page_size)
 {
    u32 fdc = fat_get_first_data_sector(hdr);
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/lz4.h>
+
+#define LZ4_MIN_MATCH                           4
+
+static bool
+lz4_read_len(const u8 **ip_ref, const u8 *iend, u32 *len)
+{
+   const u8 *ip = *ip_ref;
+   u8 b;
+
+   do {
+
+      if (ip == iend)
+         return false;
+
+      b = *ip++;
+      *len += b;
+
+   } while (b == 255);
+
+   *ip_ref = ip;
+   return true;
+}
+
+int
+lz4_decompress(const void *src, u32 src_sz, void *dst, u32 dst_cap)
+{
+   const u8 *ip = src;
+   const u8 *const iend = ip + src_sz;
+   u8 *op = dst;
+   u8 *const oend = op + dst_cap;
+   const u8 *match;
+   u32 len, off;
+   u8 token;
+
+   while (ip < iend) {
+
+      token = *ip++;
+      len = token >> 4;
+
+      /* Literals */
+      if (len == 15 && !lz4_read_len(&ip, iend, &len))
+         return -1;
+
+      if (len > (u32)(iend - ip) || len > (u32)(oend - op))
+         return -1;
+
+      memcpy(op, ip, len);
+      op += len;
+      ip += len;
+
+      if (ip == iend)
+         break;      /* The last sequence has only literals */
+
+      /* Match */
+      if (iend - ip < 2)
+         return -1;
+
+      off = (u32)ip[0] | ((u32)ip[1] << 8);
+      ip += 2;
+
+      if (!off || off > (u32)(op - (u8 *)dst))
+         return -1;
+
+      len = token & 15;
+
+      if (len == 15 && !lz4_read_len(&ip, iend, &len))
+         return -1;
+
+      len += LZ4_MIN_MATCH;
+
+      if (len > (u32)(oend - op))
+         return -1;
+
+      /* The match can overlap with the output: copy byte by byte */
+      for (match = op - off; len > 0; len--)
+         *op++ = *match++;
+   }
+
+   return (int)(op - (u8 *)dst);
+}
+
+bool
+lz4_rd_check_hdr(const void *buf)
+{
+   const struct lz4_rd_hdr *h = buf;
+
+   if (memcmp(h->magic, LZ4_RD_MAGIC, sizeof(h->magic)))
+      return false;
+
+   if (h->hdr_size != sizeof(*h) || !h->orig_size)
+      return false;
+
+   return IN_RANGE_INC(h->block_size, 1, LZ4_RD_MAX_BLOCK_SIZE);
+}
+
+void
+lz4_rd_stream_init(struct lz4_rd_stream *s, const void *hdr, void *dst)
+{
+   const struct lz4_rd_hdr *h = hdr;
+
+   *s = (struct lz4_rd_stream) {
+      .dst = dst,
+      .dst_size = h->orig_size,
+      .out = 0,
+      .block_size = h->block_size,
+   };
+}
+
+int
+lz4_rd_feed(struct lz4_rd_stream *s, const void *buf, u32 len)
+{
+   const u8 *p = buf;
+   u32 consumed = 0;
+   u32 bhdr, bsz, exp_out;
+   int rc;
+
+   while (!lz4_rd_done(s) && len - consumed >= sizeof(u32)) {
+
+      memcpy(&bhdr, p + consumed, sizeof(u32));
+      bsz = bhdr & ~LZ4_RD_STORED;
+      exp_out = MIN(s->block_size, s->dst_size - s->out);
+
+      if (bsz > s->block_size)
+         return -1;
+
+      if (len - consumed - sizeof(u32) < bsz)
+         break;      /* Incomplete block: wait for more data */
+
+      consumed += sizeof(u32);
+
+      if (bhdr & LZ4_RD_STORED) {
+
+         if (bsz != exp_out)
+            return -1;
+
+         memcpy(s->dst + s->out, p + consumed, bsz);
+         rc = (int)bsz;
+
+      } else {
+
+         rc = lz4_decompress(p + consumed, bsz, s->dst + s->out, exp_out);
+
+         if (rc != (int)exp_out)
+            return -1;
+      }
+
+      consumed += bsz;
+      s->out += (u32)rc;
+   }
+
+   return (int)consumed;
+}
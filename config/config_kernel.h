@@ -20,6 +20,10 @@
 #cmakedefine01 KERNEL_64BIT_OFFT
 #cmakedefine01 KRN_CLOCK_DRIFT_COMP
 #cmakedefine01 KRN32_LIN_VADDR
+#cmakedefine01 KRN_SYS_STATS
+#cmakedefine01 KRN_LOCKSTAT
+#cmakedefine01 KRN_SMP
+#cmakedefine01 KRN_LAPIC_TIMER
 
 /*
  * --------------------------------------------------------------------------
@@ -45,7 +49,17 @@
 #define MAX_MOUNTPOINTS                            16
 #define MAX_NESTED_INTERRUPTS                      32
 
+#define MAX_CPUS                                   16
+
+/* Physical page where the APs start: it must be in the reserved first 64 KB */
+#define AP_TRAMPOLINE_PADDR                    0x8000
+
+/* Max yields in kmutex_lock() waiting for a runnable owner, before sleeping */
+#define KMUTEX_SPIN_MAX_YIELDS                      8
+
 #define WTH_MAX_THREADS                            64
 #define WTH_MAX_PRIO_QUEUE_SIZE                    32
-#define WTH_KB_QUEUE_SIZE                          32
-#define WTH_SERIAL_QUEUE_SIZE                      32
+
+/* Threaded IRQ bottom halves: see irq_bh.h */
+#define IRQ_BH_MAX_PRIO                             7
+#define IRQ_BH_QUEUE_SIZE                          32
@@ -37,6 +37,7 @@
 #define HI_VMEM_SIZE             (128ul * MB)
 
 #define USER_VDSO_VADDR       (HI_VMEM_START)
+#define USER_VVAR_VADDR       (USER_VDSO_VADDR + 4 * KB)
 
 #define USERMODE_VADDR_END          (BASE_VA) /* biggest user vaddr + 1 */
 #define MAX_BRK                  (0x40000000) /* +1 GB (virtual memory) */
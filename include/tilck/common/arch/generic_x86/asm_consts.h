@@ -22,6 +22,19 @@
 
 #define EFLAGS_IOPL     0x3000
 
+/* Interrupt vectors used by the LAPIC */
+#define LAPIC_TIMER_VECTOR              0xf0
+#define LAPIC_SPURIOUS_VECTOR           0xff
+
+/*
+ * Vectors dynamically allocated to the interrupt sources delivered through
+ * the LAPIC (MSI, MSI-X and IOAPIC), right after the ones of the 8259 PIC.
+ */
+#define IRQ_DYN_VECTOR_BASE             0x30
+#define IRQ_DYN_VECTORS_COUNT           48
+
+#define MSR_IA32_APIC_BASE              0x01b
+
 #define MSR_IA32_SYSENTER_CS            0x174
 #define MSR_IA32_SYSENTER_ESP           0x175
 #define MSR_IA32_SYSENTER_EIP           0x176
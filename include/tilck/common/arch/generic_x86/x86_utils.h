@@ -184,6 +184,12 @@ static ALWAYS_INLINE void halt(void)
    asmVolatile("hlt");
 }
 
+/* Hint to the CPU that we're in a busy-wait loop */
+static ALWAYS_INLINE void cpu_relax(void)
+{
+   asmVolatile("pause" ::: "memory");
+}
+
 static ALWAYS_INLINE void wrmsr(u32 msr_id, u64 msr_value)
 {
    asmVolatile( "wrmsr" : : "c" (msr_id), "A" (msr_value) );
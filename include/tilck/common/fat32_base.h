@@ -122,6 +122,7 @@ static inline bool is_long_name_entry(struct fat_entry *e)
 // FAT INTERNALS ---------------------------------------------------------------
 
 enum fat_type fat_get_type(struct fat_hdr *hdr);
+bool fat_check_header(struct fat_hdr *hdr);
 
 struct fat_entry *
 fat_get_rootdir(struct fat_hdr *hdr,
@@ -252,6 +253,13 @@ typedef int (*fat_dentry_cb)(struct fat_hdr *,
                              const char *,         /* long name */
                              void *);              /* user data pointer */
 
+/*
+ * Returns a pointer to the data of the given cluster or NULL in case of error.
+ * Used when the clusters do not follow the header in memory (e.g. the FAT
+ * partition is on a block device and only its header and FATs are in memory).
+ */
+typedef void *(*fat_cluster_data_cb)(void *, u32);
+
 struct fat_walk_static_params {
 
    struct fat_walk_long_name_ctx *ctx;
@@ -259,11 +267,16 @@ struct fat_walk_static_params {
    enum fat_type ft;
    fat_dentry_cb cb;
    void *arg;
+
+   fat_cluster_data_cb clu_data_cb;    /* optional */
+   void *clu_data_arg;
 };
 
 /*
  * Walk the FAT directory having dir entries in the specified cluster.
  * For the root directory, just set cluster = 0.
+ *
+ * Returns 0 or -EIO (-5) when `clu_data_cb` failed.
  */
 int fat_walk(struct fat_walk_static_params *p, u32 cluster);
 
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+/*
+ * LZ4-compressed ramdisk, as produced by `fathack --compress`. The format is:
+ *
+ *    struct lz4_rd_hdr
+ *    block 0: u32 block_hdr, data
+ *    block 1: u32 block_hdr, data
+ *    ...
+ *
+ * Each block decompresses to exactly `block_size` bytes (except the last one)
+ * and it's an independent LZ4 block (no back-references in previous blocks).
+ * The low 31 bits of `block_hdr` contain the size of the block's data, while
+ * the high bit (LZ4_RD_STORED) marks the incompressible blocks, which are
+ * stored as they are. Therefore, a block's data is never bigger than
+ * `block_size` and the blocks can be decompressed in streaming fashion, while
+ * the compressed image is read from the disk, by keeping in memory only a
+ * chunk of it.
+ */
+
+#define LZ4_RD_MAGIC                         "TILCKLZ4"
+#define LZ4_RD_BLOCK_SIZE                    (64 * KB)
+#define LZ4_RD_MAX_BLOCK_SIZE                (1 * MB)
+#define LZ4_RD_STORED                        (1u << 31)
+#define LZ4_RD_MAX_BLOCK_BYTES(bs)           (sizeof(u32) + (bs))
+
+struct lz4_rd_hdr {
+
+   char magic[8];             /* LZ4_RD_MAGIC, without the NUL terminator */
+   u32 hdr_size;              /* sizeof(struct lz4_rd_hdr) */
+   u32 block_size;            /* decompressed size of each block */
+   u32 orig_size;             /* decompressed size of the whole ramdisk */
+   u32 comp_size;             /* size of the blocks following the header */
+};
+
+struct lz4_rd_stream {
+
+   u8 *dst;                   /* where to decompress the ramdisk */
+   u32 dst_size;              /* lz4_rd_hdr->orig_size */
+   u32 out;                   /* bytes decompressed so far */
+   u32 block_size;            /* lz4_rd_hdr->block_size */
+};
+
+/*
+ * Decompress a single LZ4 block (raw format, no frame). Returns the number of
+ * bytes written in `dst` or -1 if the data is corrupted or doesn't fit.
+ */
+int lz4_decompress(const void *src, u32 src_sz, void *dst, u32 dst_cap);
+
+bool lz4_rd_check_hdr(const void *buf);
+void lz4_rd_stream_init(struct lz4_rd_stream *s, const void *hdr, void *dst);
+
+/*
+ * Decompress all the *complete* blocks in `buf` and return the number of bytes
+ * consumed, or -1 in case of corrupted data. The caller is expected to pass
+ * again the unconsumed bytes in the next call, followed by the new data.
+ */
+int lz4_rd_feed(struct lz4_rd_stream *s, const void *buf, u32 len);
+
+static inline bool lz4_rd_done(struct lz4_rd_stream *s)
+{
+   return s->out == s->dst_size;
+}
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Tilck's userspace interface for the sampling profiler (/dev/prof).
+ *
+ * Once started, the kernel takes a sample every `period` timer ticks: the
+ * interrupted instruction pointer, the current pid/tid and, when the timer
+ * interrupted kernel code, the return addresses found by following the frame
+ * pointers on the kernel stack. The samples are queued in a ring buffer and
+ * consumed with read(), which returns only whole samples and returns 0 when
+ * no sample is available. When the ring is full, new samples are dropped.
+ *
+ * Only one process at a time can open the device.
+ */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+#define TILCK_IOCTL_PROF_START                   1   /* arg: period in ticks */
+#define TILCK_IOCTL_PROF_STOP                    2
+#define TILCK_IOCTL_PROF_GET_STATS               3   /* arg: tilck_prof_stats */
+#define TILCK_IOCTL_PROF_GET_SYM                 4   /* arg: tilck_prof_sym */
+
+#define TILCK_PROF_MAX_FRAMES                   12
+
+/* Sample flags */
+#define TILCK_PROF_FL_USER                      (1 << 0)
+
+struct tilck_prof_sample {
+
+   s32 pid;
+   s32 tid;
+   u32 flags;
+   u32 frames_count;                      /* Valid elements in frames[] */
+   ulong frames[TILCK_PROF_MAX_FRAMES];   /* frames[0]: interrupted IP */
+};
+
+/* Used with TILCK_IOCTL_PROF_GET_STATS */
+struct tilck_prof_stats {
+
+   u32 timer_hz;
+   u32 period;
+   u32 samples;
+   u32 dropped;
+};
+
+/* Used with TILCK_IOCTL_PROF_GET_SYM: resolves a kernel address */
+struct tilck_prof_sym {
+
+   ulong addr;
+   ulong off;                 /* Output: offset of `addr` in the symbol */
+   char name[56];             /* Output */
+};
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * Tilck's userspace interface for the binary trace ring (/dev/trace).
+ *
+ * The device is meant to be memory-mapped: the first page of the mapping
+ * contains a `struct tilck_trace_ring_hdr`, followed (at `data_off`) by an
+ * array of `rec_count` records of `rec_size` bytes each.
+ *
+ * The kernel is the only producer: it reserves the record at position `head`
+ * (records are at index `pos % rec_count`) with a lock-free atomic increment
+ * and publishes it by storing `pos + 1` in its `seq_plus_one` field, with
+ * release semantics. The consumer reads the record at position `tail` once
+ * its `seq_plus_one` is equal to `tail + 1` (acquire load) and then stores
+ * `tail + 1` in `tail` (release store), freeing the slot. When the ring is
+ * full, new records are dropped and `dropped` is incremented.
+ *
+ * Only one process at a time can open the device.
+ */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+#define TILCK_TRACE_RING_MAGIC          0x31637274   /* "trc1" */
+
+#define TILCK_IOCTL_TRACE_START                  1   /* enable tracing */
+#define TILCK_IOCTL_TRACE_STOP                   2   /* disable tracing */
+#define TILCK_IOCTL_TRACE_TID                    3   /* arg: tid (0 = self) */
+#define TILCK_IOCTL_TRACE_GET_SYS_NAME           4   /* arg: tilck_trace_sys */
+
+/* Record types */
+#define TILCK_TRACE_SYS_ENTER                    1
+#define TILCK_TRACE_SYS_EXIT                     2
+#define TILCK_TRACE_SIGNAL_DELIVERED             4
+#define TILCK_TRACE_KILLED                       5
+
+struct tilck_trace_ring_hdr {
+
+   u32 magic;
+   u32 rec_size;
+   u32 rec_count;             /* Always a power of 2 */
+   u32 data_off;              /* Offset of the records in the mapping */
+
+   u32 head;                  /* Written by the kernel */
+   u32 tail;                  /* Written by the consumer */
+   u32 dropped;               /* Written by the kernel */
+};
+
+struct tilck_trace_rec {
+
+   u32 seq_plus_one;          /* 0 or stale while the record is being written */
+   u16 type;
+   u16 sys;
+   s32 tid;
+   s32 signum;
+   u64 ts;                    /* Nanoseconds since boot */
+   s64 retval;
+   ulong args[6];
+
+} ALIGNED_AT(64);
+
+/* Used with TILCK_IOCTL_TRACE_GET_SYS_NAME */
+struct tilck_trace_sys {
+
+   u32 sys;
+   char name[32];
+};
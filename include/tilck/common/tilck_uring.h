@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+/*
+ * The subset of Linux's io_uring ABI (see <linux/io_uring.h>) supported by
+ * Tilck. The structures have exactly the same layout as on Linux, but they're
+ * defined here because the kernel headers of the toolchain might be too old to
+ * have them. Do NOT include this header together with <linux/io_uring.h>.
+ *
+ * How it works, in short: io_uring_setup() returns a file descriptor that has
+ * to be memory-mapped (MAP_SHARED) at IORING_OFF_SQ_RING, for the rings, and
+ * at IORING_OFF_SQES, for the submission queue entries (SQEs). Since Tilck
+ * advertises IORING_FEAT_SINGLE_MMAP, the SQ and the CQ rings share the same
+ * mapping. The user fills SQEs, stores their indexes in the SQ array and
+ * bumps the SQ tail (release store). Then it calls io_uring_enter() to submit
+ * any number of them with a single syscall and, optionally, to wait for
+ * `min_complete` completions. Completions (CQEs) are consumed by reading the
+ * entries between the CQ head and the CQ tail (acquire load) and then by
+ * storing the new CQ head (release store).
+ */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+#define IORING_OFF_SQ_RING                      0x0
+#define IORING_OFF_CQ_RING                0x8000000
+#define IORING_OFF_SQES                  0x10000000
+
+/* io_uring_setup() flags */
+#define IORING_SETUP_CQSIZE                (1u << 3)
+
+/* io_uring_params->features */
+#define IORING_FEAT_SINGLE_MMAP            (1u << 0)
+#define IORING_FEAT_NODROP                 (1u << 1)
+#define IORING_FEAT_SUBMIT_STABLE          (1u << 2)
+#define IORING_FEAT_RW_CUR_POS             (1u << 3)
+
+/* io_uring_enter() flags */
+#define IORING_ENTER_GETEVENTS             (1u << 0)
+
+/* io_uring_register() opcodes */
+#define IORING_REGISTER_FILES                     2
+#define IORING_UNREGISTER_FILES                   3
+
+/* Supported opcodes */
+#define IORING_OP_NOP                             0
+#define IORING_OP_POLL_ADD                        6
+#define IORING_OP_READ                           22
+#define IORING_OP_WRITE                          23
+
+/* io_uring_sqe->flags */
+#define IOSQE_FIXED_FILE                   (1u << 0)
+
+struct io_uring_sqe {
+
+   u8 opcode;
+   u8 flags;                  /* IOSQE_* flags */
+   u16 ioprio;
+   s32 fd;                    /* or index in the registered files */
+   u64 off;                   /* file offset, or -1 for the current one */
+   u64 addr;                  /* buffer address */
+   u32 len;                   /* buffer size */
+
+   union {
+      u32 rw_flags;
+      u16 poll_events;        /* IORING_OP_POLL_ADD */
+   };
+
+   u64 user_data;             /* copied as-is in the CQE */
+   u16 buf_index;
+   u16 personality;
+   s32 splice_fd_in;
+   u64 __pad2[2];
+};
+
+struct io_uring_cqe {
+
+   u64 user_data;
+   s32 res;                   /* like the return value of the syscall */
+   u32 flags;
+};
+
+struct io_sqring_offsets {
+
+   u32 head;
+   u32 tail;
+   u32 ring_mask;
+   u32 ring_entries;
+   u32 flags;
+   u32 dropped;
+   u32 array;
+   u32 resv1;
+   u64 resv2;
+};
+
+struct io_cqring_offsets {
+
+   u32 head;
+   u32 tail;
+   u32 ring_mask;
+   u32 ring_entries;
+   u32 overflow;
+   u32 cqes;
+   u32 flags;
+   u32 resv1;
+   u64 resv2;
+};
+
+struct io_uring_params {
+
+   u32 sq_entries;
+   u32 cq_entries;
+   u32 flags;
+   u32 sq_thread_cpu;
+   u32 sq_thread_idle;
+   u32 features;
+   u32 wq_fd;
+   u32 resv[3];
+   struct io_sqring_offsets sq_off;
+   struct io_cqring_offsets cq_off;
+};
+
+STATIC_ASSERT(sizeof(struct io_uring_sqe) == 64);
+STATIC_ASSERT(sizeof(struct io_uring_cqe) == 16);
+STATIC_ASSERT(sizeof(struct io_uring_params) == 120);
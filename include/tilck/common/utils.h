@@ -114,6 +114,13 @@ get_first_set_bit_index64(u64 num)
    return i;
 }
 
+CONSTEXPR static inline u32
+get_last_set_bit_index32(u32 num)
+{
+   ASSERT(num != 0);
+   return 31 - (u32)__builtin_clz(num);
+}
+
 CONSTEXPR static inline u32
 get_first_zero_bit_index_l(ulong num)
 {
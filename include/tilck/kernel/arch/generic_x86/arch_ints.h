@@ -21,7 +21,8 @@ static ALWAYS_INLINE bool is_irq(int int_num)
 
 static ALWAYS_INLINE bool is_timer_irq(int int_num)
 {
-   return int_to_irq(int_num) == X86_PC_TIMER_IRQ;
+   return int_to_irq(int_num) == X86_PC_TIMER_IRQ ||
+          int_num == LAPIC_TIMER_VECTOR;
 }
 
 static ALWAYS_INLINE bool is_fault(int int_num)
@@ -266,8 +266,98 @@ fpu_cpy_single_128_sse(void *dest, const void *src)
                : "memory");
 }
 
+/*
+ * -----------------------------------------------
+ *
+ * Glyph expansion kernels
+ *
+ * -----------------------------------------------
+ *
+ * Expand a 8-pixel scanline of a 1-bit font into 8 32-bpp pixels, selecting
+ * for each pixel the fg or the bg color. Bit 7 is the leftmost pixel. The
+ * masks and the colors are loaded once in the SIMD registers by the
+ * *load_colors* funcs and then used by all the following *expand* calls,
+ * which therefore have to happen in the same FPU context, without any other
+ * SIMD code in between. The kernel code is compiled with -mgeneral-regs-only,
+ * so the compiler won't touch those registers.
+ */
+
+struct fpu_glyph_colors {
+
+   u32 masks[8];        /* masks[i] = 1 << (7 - i) */
+   u32 fg[8];           /* fg color, replicated */
+   u32 bg[8];           /* bg color, replicated */
+
+} ALIGNED_AT(32);
+
+EXTERN ALWAYS_INLINE FASTCALL void
+fpu_glyph_load_colors_avx2(const struct fpu_glyph_colors *c)
+{
+   asmVolatile("vmovdqa   (%0), %%ymm0\n\t"
+               "vmovdqa 32(%0), %%ymm1\n\t"
+               "vmovdqa 64(%0), %%ymm2\n\t"
+               : /* no output */
+               : "r" (c)
+               : "memory");
+}
+
+EXTERN ALWAYS_INLINE FASTCALL void
+fpu_glyph_expand_8px_nt_avx2(void *dest, u32 bits)
+{
+   asmVolatile("vmovd        %0, %%xmm3\n\t"
+               "vpbroadcastd %%xmm3, %%ymm3\n\t"
+               "vpand        %%ymm0, %%ymm3, %%ymm3\n\t"
+               "vpcmpeqd     %%ymm0, %%ymm3, %%ymm3\n\t"
+               "vpblendvb    %%ymm3, %%ymm1, %%ymm2, %%ymm3\n\t"
+               "vmovntdq     %%ymm3, (%1)\n\t"
+               : /* no output */
+               : "r" (bits), "r" (dest)
+               : "memory");
+}
+
+/*
+ * SSE2 has no blend instruction: keep (fg ^ bg) in xmm2 and compute each
+ * pixel as: bg ^ ((fg ^ bg) & mask).
+ */
+EXTERN ALWAYS_INLINE FASTCALL void
+fpu_glyph_load_colors_sse2(const struct fpu_glyph_colors *c)
+{
+   asmVolatile("movdqa   (%0), %%xmm0\n\t"
+               "movdqa 16(%0), %%xmm1\n\t"
+               "movdqa 32(%0), %%xmm2\n\t"
+               "movdqa 64(%0), %%xmm3\n\t"
+               "pxor   %%xmm3, %%xmm2\n\t"
+               : /* no output */
+               : "r" (c)
+               : "memory");
+}
+
+EXTERN ALWAYS_INLINE FASTCALL void
+fpu_glyph_expand_8px_nt_sse2(void *dest, u32 bits)
+{
+   asmVolatile("movd     %0, %%xmm4\n\t"
+               "pshufd   $0, %%xmm4, %%xmm4\n\t"
+               "movdqa   %%xmm4, %%xmm5\n\t"
+               "pand     %%xmm0, %%xmm4\n\t"
+               "pand     %%xmm1, %%xmm5\n\t"
+               "pcmpeqd  %%xmm0, %%xmm4\n\t"
+               "pcmpeqd  %%xmm1, %%xmm5\n\t"
+               "pand     %%xmm2, %%xmm4\n\t"
+               "pand     %%xmm2, %%xmm5\n\t"
+               "pxor     %%xmm3, %%xmm4\n\t"
+               "pxor     %%xmm3, %%xmm5\n\t"
+               "movntdq  %%xmm4,   (%1)\n\t"
+               "movntdq  %%xmm5, 16(%1)\n\t"
+               : /* no output */
+               : "r" (bits), "r" (dest)
+               : "memory");
+}
+
 void memcpy256_failsafe(void *dest, const void *src, u32 n);
 FASTCALL void memcpy_single_256_failsafe(void *dest, const void *src);
+FASTCALL void
+fpu_glyph_load_colors_failsafe(const struct fpu_glyph_colors *c);
+FASTCALL void fpu_glyph_expand_8px_failsafe(void *dest, u32 bits);
 
 /* Non-temporal hint for the destination */
 /* 'n' is the number of 32-byte (256-bit) data packets to copy */
@@ -324,6 +414,8 @@ EXTERN inline void fpu_memset256(void *dest, u32 val32, u32 n)
 
 void FASTCALL __asm_fpu_cpy_single_256_nt(void *dest, const void *src);
 void FASTCALL __asm_fpu_cpy_single_256_nt_read(void *dest, const void *src);
+void FASTCALL __asm_fpu_glyph_load_colors(const struct fpu_glyph_colors *c);
+void FASTCALL __asm_fpu_glyph_expand_8px_nt(void *dest, u32 bits);
 
 EXTERN ALWAYS_INLINE FASTCALL void
 fpu_cpy_single_256_nt(void *dest, const void *src)
@@ -337,5 +429,23 @@ fpu_cpy_single_256_nt_read(void *dest, const void *src)
    __asm_fpu_cpy_single_256_nt_read(dest, src);
 }
 
+EXTERN ALWAYS_INLINE FASTCALL void
+fpu_glyph_load_colors(const struct fpu_glyph_colors *c)
+{
+   __asm_fpu_glyph_load_colors(c);
+}
+
+EXTERN ALWAYS_INLINE FASTCALL void
+fpu_glyph_expand_8px_nt(void *dest, u32 bits)
+{
+   __asm_fpu_glyph_expand_8px_nt(dest, bits);
+}
+
+/*
+ * Name of the SIMD variant of the glyph kernels selected at boot, or NULL if
+ * fpu_glyph_* are just the (slow) failsafe funcs and should not be used.
+ */
+extern const char *fpu_glyph_kernels;
+
 
 void init_fpu_memcpy(void);
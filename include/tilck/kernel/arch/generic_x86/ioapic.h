@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+#define IOAPIC_MAX_COUNT                                      8
+
+/* IOAPIC registers, accessed indirectly through IOREGSEL and IOWIN */
+#define IOAPIC_IOREGSEL                                    0x00
+#define IOAPIC_IOWIN                                       0x10
+
+#define IOAPIC_REG_ID                                      0x00
+#define IOAPIC_REG_VER                                     0x01
+#define IOAPIC_REG_REDTBL                                  0x10
+
+/* Fields of a redirection table entry (low 32 bits) */
+#define IOAPIC_RED_ACTIVE_LOW                         (1 << 13)
+#define IOAPIC_RED_LEVEL                              (1 << 15)
+#define IOAPIC_RED_MASKED                             (1 << 16)
+
+/* Flags for ioapic_route_gsi(), matching the ones of the MADT table */
+#define IOAPIC_FL_ACTIVE_LOW                           (1 << 0)
+#define IOAPIC_FL_LEVEL                                (1 << 1)
+
+/*
+ * Called by the ACPI module while parsing the MADT table, before
+ * init_ioapics(): register an IOAPIC and the overrides for the ISA IRQs, which
+ * otherwise are identity-mapped to the first GSIs (global system interrupts).
+ */
+void ioapic_add(u8 id, ulong paddr, u32 gsi_base);
+void ioapic_add_isa_override(u8 isa_irq, u32 gsi, u32 flags);
+
+void init_ioapics(void);
+u32 ioapic_isa_irq_to_gsi(u8 isa_irq, u32 *flags);
+int ioapic_route_gsi(u32 gsi, int vector, u32 flags);
+int ioapic_mask_gsi(u32 gsi);
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/arch/generic_x86/asm_consts.h>
+
+/* Default physical address of the LAPIC registers (overridden by ACPI) */
+#define LAPIC_DEFAULT_PADDR                         0xfee00000
+
+/* Flags of the IA32_APIC_BASE MSR */
+#define APIC_BASE_BSP                                  (1 << 8)
+#define APIC_BASE_ENABLE                              (1 << 11)
+#define APIC_BASE_ADDR_MASK                          0xfffff000
+
+/* LAPIC registers (offsets in the MMIO page) */
+#define LAPIC_ID                                          0x020
+#define LAPIC_VERSION                                     0x030
+#define LAPIC_TPR                                         0x080
+#define LAPIC_EOI                                         0x0b0
+#define LAPIC_SVR                                         0x0f0
+#define LAPIC_ESR                                         0x280
+#define LAPIC_ICR_LOW                                     0x300
+#define LAPIC_ICR_HIGH                                    0x310
+#define LAPIC_LVT_TIMER                                   0x320
+#define LAPIC_LVT_LINT0                                   0x350
+#define LAPIC_LVT_LINT1                                   0x360
+#define LAPIC_LVT_ERROR                                   0x370
+#define LAPIC_TIMER_INIT_CNT                              0x380
+#define LAPIC_TIMER_CURR_CNT                              0x390
+#define LAPIC_TIMER_DIV                                   0x3e0
+
+/* Flags of the SVR register */
+#define LAPIC_SVR_ENABLE                               (1 << 8)
+
+/* Flags of the LVT registers */
+#define LAPIC_LVT_NMI                                  (4 << 8)
+#define LAPIC_LVT_EXTINT                               (7 << 8)
+#define LAPIC_LVT_MASKED                              (1 << 16)
+#define LAPIC_LVT_TIMER_ONESHOT                        (0 << 17)
+
+/* Values of the timer's divide configuration register */
+#define LAPIC_TIMER_DIV_16                                  0x3
+
+/* Fields of the ICR register (low 32 bits) */
+#define LAPIC_ICR_FIXED                                (0 << 8)
+#define LAPIC_ICR_NMI                                  (4 << 8)
+#define LAPIC_ICR_INIT                                 (5 << 8)
+#define LAPIC_ICR_STARTUP                              (6 << 8)
+#define LAPIC_ICR_PENDING                             (1 << 12)
+#define LAPIC_ICR_ASSERT                              (1 << 14)
+#define LAPIC_ICR_LEVEL                               (1 << 15)
+#define LAPIC_ICR_DEST_SELF                           (1 << 18)
+#define LAPIC_ICR_DEST_ALL                            (2 << 18)
+#define LAPIC_ICR_DEST_ALL_BUT_SELF                   (3 << 18)
+
+extern volatile u32 *lapic_regs;
+
+static ALWAYS_INLINE bool lapic_is_available(void)
+{
+   return lapic_regs != NULL;
+}
+
+static ALWAYS_INLINE u32 lapic_read(u32 reg)
+{
+   return lapic_regs[reg / sizeof(u32)];
+}
+
+static ALWAYS_INLINE void lapic_write(u32 reg, u32 val)
+{
+   lapic_regs[reg / sizeof(u32)] = val;
+}
+
+static ALWAYS_INLINE u32 lapic_get_id(void)
+{
+   return lapic_read(LAPIC_ID) >> 24;
+}
+
+static ALWAYS_INLINE void lapic_send_eoi(void)
+{
+   lapic_write(LAPIC_EOI, 0);
+}
+
+void lapic_set_paddr(ulong paddr);
+void init_lapic(void);
+void lapic_enable(void);
+void lapic_enable_ap(void);
+int lapic_send_ipi(u32 apic_id, u32 icr_flags);
+void init_lapic_timer(void);
+void lapic_timer_irq_handler(void);
@@ -53,6 +53,11 @@ static ALWAYS_INLINE void set_return_register(regs_t *r, ulong value)
    r->eax = value;
 }
 
+static ALWAYS_INLINE void regs_set_user_stack_ptr(regs_t *r, ulong value)
+{
+   r->useresp = value;
+}
+
 static ALWAYS_INLINE ulong get_rem_stack(void)
 {
    return (get_stack_ptr() & ((ulong)KERNEL_STACK_SIZE - 1));
@@ -72,3 +77,8 @@ static ALWAYS_INLINE void *regs_get_ip(regs_t *r)
 {
    return TO_PTR(r->eip);
 }
+
+static ALWAYS_INLINE bool regs_is_user_mode(regs_t *r)
+{
+   return (r->cs & 3) == 3;
+}
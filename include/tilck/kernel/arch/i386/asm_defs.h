@@ -17,6 +17,17 @@
 #define TI_F_RESUME_RS_OFF     20 /* offset of: fault_resume_regs */
 #define TI_FAULTS_MASK_OFF     24 /* offset of: faults_resume_mask */
 
+/* Offsets in struct vdso_time_data, used by the vdso */
+#define VVAR_SEQ_OFF            0
+#define VVAR_TSC_OK_OFF         4
+#define VVAR_TSC_BASE_OFF       8
+#define VVAR_NS_BASE_OFF       16
+#define VVAR_TSC_MULT_OFF      24
+#define VVAR_TSC_SHIFT_OFF     28
+#define VVAR_MAX_DNS_OFF       32
+#define VVAR_MAX_DTSC_OFF      36
+#define VVAR_BOOT_TS_OFF       40
+
 #define SIZEOF_REGS            84
 #define REGS_EIP_OFF           64
 #define REGS_USERESP_OFF       76
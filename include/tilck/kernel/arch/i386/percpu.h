@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck_gen_headers/config_kernel.h>
+#include <tilck/common/basic_defs.h>
+
+/*
+ * Each CPU has its own TSS and, therefore, its own TSS descriptor in the GDT:
+ * CPU `n` uses the entry X86_CPU_TSS_GDT_BASE + n. That allows us to get the
+ * index of the current CPU with a single `str` instruction.
+ */
+#define X86_CPU_TSS_GDT_BASE                          5
+
+/* Set by init_segmentation(), once the BSP has loaded its TSS */
+extern bool x86_cpu_tss_loaded;
+
+/*
+ * Index of the current CPU in cpus[]. Before init_segmentation(), only the BSP
+ * is running and the TR register might contain anything: that's CPU 0.
+ */
+static ALWAYS_INLINE u32 arch_get_cpu_idx(void)
+{
+   u16 sel;
+   u32 idx;
+
+   if (UNLIKELY(!x86_cpu_tss_loaded))
+      return 0;
+
+   asmVolatile("str %0" : "=r" (sel));
+   idx = (u32)(sel >> 3) - X86_CPU_TSS_GDT_BASE;
+
+   /* In the double fault handler, we're using a different TSS */
+   return idx < MAX_CPUS ? idx : 0;
+}
+
+static ALWAYS_INLINE ulong arch_percpu_irq_save(void)
+{
+   ulong flags;
+
+   asmVolatile("pushf\n\t"
+               "pop %0\n\t"
+               "cli"
+               : "=r" (flags)
+               : /* no input */
+               : "memory");
+
+   return flags;
+}
+
+static ALWAYS_INLINE void arch_percpu_irq_restore(ulong flags)
+{
+   asmVolatile("push %0\n\t"
+               "popf"
+               : /* no output */
+               : "r" (flags)
+               : "memory", "cc");
+}
@@ -38,6 +38,11 @@ static ALWAYS_INLINE void set_return_register(regs_t *r, ulong value)
    NOT_IMPLEMENTED();
 }
 
+static ALWAYS_INLINE void regs_set_user_stack_ptr(regs_t *r, ulong value)
+{
+   NOT_IMPLEMENTED();
+}
+
 NORETURN static ALWAYS_INLINE void context_switch(regs_t *r)
 {
    NOT_IMPLEMENTED();
@@ -62,3 +67,9 @@ static ALWAYS_INLINE void *regs_get_ip(regs_t *r)
 {
    return TO_PTR(r->rip);
 }
+
+static ALWAYS_INLINE bool regs_is_user_mode(regs_t *r)
+{
+   NOT_IMPLEMENTED();
+   return false;
+}
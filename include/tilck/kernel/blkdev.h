@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/page_size.h>
+
+#include <tilck/kernel/list.h>
+#include <tilck/kernel/sync.h>
+
+#define BLK_SECTOR_SIZE                           512u
+#define BLK_SECTOR_SHIFT                             9
+#define BLK_SECTORS_PER_PAGE       (PAGE_SIZE / BLK_SECTOR_SIZE)
+
+#define BLK_MAX_DEVS                                32
+#define BLK_MAX_REQ_BIOS                            32   /* per request */
+#define BLK_READAHEAD_PAGES                          8
+
+struct blkdev;
+
+/*
+ * A single I/O operation on a contiguous range of sectors, submitted by the
+ * page cache (or by any other user of the block layer) with blkdev_submit().
+ * Adjacent bios are merged by the block layer into the same request.
+ */
+struct blk_bio {
+
+   struct list_node node;     /* node in blk_req->bios */
+   u64 sector;                /* first sector, relative to the device */
+   u32 count;                 /* number of sectors */
+   void *buf;                 /* count * BLK_SECTOR_SIZE bytes */
+   bool write;
+
+   volatile bool done;
+   int rc;
+};
+
+/*
+ * A request for the driver: a run of sectors [sector, sector + count) made
+ * by one or more bios, ordered by sector, all in the same direction.
+ */
+struct blk_req {
+
+   struct list_node node;     /* node in blkdev->q_reqs */
+   struct list bios;
+   u64 sector;
+   u32 count;
+   u32 nr_bios;
+   bool write;
+};
+
+struct blkdev_ops {
+
+   /*
+    * Transfer synchronously all the bios of `req`, in order. Writes must have
+    * reached the media on return. It's called in task context, without any
+    * lock held: it can sleep. Returns 0 or -errno.
+    */
+   int (*xfer)(struct blkdev *dev, struct blk_req *req);
+};
+
+struct blkdev_stats {
+
+   u64 bios;                  /* bios submitted */
+   u64 reqs;                  /* requests sent to the driver */
+   u64 merges;                /* bios merged into an existing request */
+   u64 pc_hits;               /* page cache hits */
+   u64 pc_misses;             /* page cache misses */
+   u64 pc_evictions;          /* pages evicted from the page cache */
+};
+
+struct blkdev {
+
+   struct list_node node;     /* node in the global list of block devices */
+   char name[16];
+   u16 minor;
+
+   u64 nr_sectors;
+   u32 max_sectors;           /* max sectors per request (driver's limit) */
+   const struct blkdev_ops *ops;
+   void *priv;                /* driver's private data */
+
+   /*
+    * Partitions don't have a queue: their bios get shifted by `start_sector`
+    * and submitted to the queue of the `parent` device.
+    */
+   struct blkdev *parent;
+   u64 start_sector;
+
+   /* Request queue */
+   struct kmutex q_lock;
+   struct kcond q_cond;       /* signalled when bios complete */
+   struct list q_reqs;        /* pending requests, FIFO order */
+   bool q_busy;               /* a task is running the queue */
+
+   /* Page cache */
+   struct kmutex pc_lock;
+   void *pc_root;             /* bintree of struct blk_page, by index */
+   struct list pc_lru;        /* head: most recently used */
+   u32 pc_pages;
+   u32 pc_max_pages;
+
+   struct blkdev_stats stats;
+};
+
+void blkdev_init(struct blkdev *dev);
+void blkdev_destroy(struct blkdev *dev);
+int register_blkdev(struct blkdev *dev);
+int blkdev_scan_partitions(struct blkdev *dev);
+struct blkdev *blkdev_get(u16 minor);
+int blkdev_lookup(const char *path, struct blkdev **out);
+
+/* Request queue interface */
+void blkdev_submit(struct blkdev *dev, struct blk_bio *bios, u32 n);
+int blkdev_wait(struct blkdev *dev, struct blk_bio *bio);
+int blkdev_rw_sectors(struct blkdev *dev,
+                      u64 sector,
+                      u32 count,
+                      void *buf,
+                      bool write);
+
+/* Page cache interface: `off` and `len` don't need to be sector-aligned */
+ssize_t blkdev_read(struct blkdev *dev, u64 off, void *buf, size_t len);
+ssize_t blkdev_write(struct blkdev *dev, u64 off, const void *buf, size_t len);
+void blkdev_drop_cache(struct blkdev *dev);
+
+static ALWAYS_INLINE u64 blkdev_get_size(struct blkdev *dev)
+{
+   return dev->nr_sectors << BLK_SECTOR_SHIFT;
+}
@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+
+/*
+ * Boot timeline: a fixed-size log of the boot stages, from the beginning of
+ * kmain() to the launch of init, with the RDTSC() timestamps of their begin and
+ * end. The modules initialized in parallel show up here with the TID of the
+ * kernel thread that ran them. The report is exposed in /syst/stats/boot.
+ *
+ * The log is append-only and it has no locks: a slot is reserved with an atomic
+ * increment, then it's owned by the caller of boot_tl_begin(), until it calls
+ * boot_tl_end(). When the log is full, the new stages are silently ignored.
+ */
+
+#define BOOT_TL_MAX_EVENTS                   96
+
+struct boot_tl_event {
+
+   const char *name;          /* must be a static string */
+   u64 start;                 /* RDTSC() at the beginning of the stage */
+   u64 end;                   /* RDTSC() at the end, 0 if still running */
+   int tid;                   /* task running the stage (0 = early kmain()) */
+};
+
+void boot_tl_init(void);
+int boot_tl_begin(const char *name);
+void boot_tl_end(int idx);
+void boot_tl_mark(const char *name);
+int boot_tl_snapshot(struct boot_tl_event *arr, int max_count, u64 *base);
+
+/* Run `call` as a boot stage named after it, e.g. BOOT_STAGE(init_paging()) */
+#define BOOT_STAGE(call)                                    \
+   do {                                                     \
+      int __stage_idx = boot_tl_begin(#call);               \
+      call;                                                 \
+      boot_tl_end(__stage_idx);                             \
+   } while (0)
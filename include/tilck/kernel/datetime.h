@@ -36,6 +36,8 @@ bool clock_in_full_resync(void);
 struct k_timeval k_ts64_to_k_timeval(struct k_timespec64 ts);
 void ticks_to_timespec(u64 ticks, struct k_timespec64 *tp);
 u64 timespec_to_ticks(const struct k_timespec64 *tp);
+u64 timespec_to_ns(const struct k_timespec64 *tp);
+void ns_to_timespec(u64 ns, struct k_timespec64 *tp);
 void real_time_get_timespec(struct k_timespec64 *tp);
 void monotonic_time_get_timespec(struct k_timespec64 *tp);
 void clock_get_resync_stats(struct clock_resync_stats *s);
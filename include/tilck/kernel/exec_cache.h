@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/atomics.h>
+#include <tilck/common/elf_types.h>
+
+#include <tilck/kernel/elf_loader.h>
+#include <tilck/kernel/fs/vfs_base.h>
+#include <tilck/kernel/sys_types.h>
+
+#define EXEC_CACHE_MAX_ENTRIES      8
+
+/*
+ * A run of physically contiguous pages belonging to a read-only segment of a
+ * cached ELF image, as mapped by the file system's mmap() function.
+ */
+struct exec_page_run {
+
+   ulong vaddr;
+   ulong paddr;
+   size_t page_count;
+};
+
+/*
+ * A cached ELF image. The key is the tuple (fs, inode, mtime, size): in
+ * addition to that, the cache is explicitly invalidated by the VFS layer every
+ * time a file might get modified. See exec_cache_invalidate().
+ *
+ * The cached data is what load_elf_program() would otherwise have to re-read
+ * and re-validate on every execve(): the raw ELF header, the program headers
+ * and the physical pages backing the read-only segments. The writable
+ * segments are still loaded every time, as they're private to each process.
+ */
+struct exec_cache_entry {
+
+   REF_COUNTED_OBJECT;
+
+   /* key */
+   struct mnt_fs *fs;
+   vfs_inode_ptr_t inode;
+   s64 mtime_sec;
+   s64 mtime_nsec;
+   s64 fsize;
+
+   /* cached data */
+   char hdr_buf[ELF_RAW_HEADER_SIZE];
+   Elf_Phdr *phdrs;
+   size_t phdrs_size;
+   struct exec_page_run *runs;
+   size_t runs_count;
+
+   u64 last_used;
+};
+
+struct exec_cache_stats {
+
+   ulong hits;
+   ulong misses;
+   ulong invalidations;
+   ulong evictions;
+   ulong entries;
+};
+
+extern struct exec_cache_stats exec_cache_stats;
+
+/*
+ * Look for a valid cache entry for the given (fs, inode) pair. On success, the
+ * entry is retained and must be released with exec_cache_release(). Stale
+ * entries (mtime or size changed) are dropped.
+ */
+struct exec_cache_entry *
+exec_cache_lookup(struct mnt_fs *fs,
+                  vfs_inode_ptr_t inode,
+                  const struct k_stat64 *st);
+
+void exec_cache_release(struct exec_cache_entry *e);
+
+/*
+ * Allocate a new entry, copying `phdrs`. The `runs` array is allocated but
+ * left for the caller to fill. Returns NULL on OOM. The returned object is
+ * owned by the caller until passed to exec_cache_insert().
+ */
+struct exec_cache_entry *
+exec_cache_new_entry(struct mnt_fs *fs,
+                     vfs_inode_ptr_t inode,
+                     const struct k_stat64 *st,
+                     const char *hdr_buf,
+                     const Elf_Phdr *phdrs,
+                     size_t phdrs_size,
+                     size_t runs_count);
+
+/* Insert an entry in the cache. Takes the ownership of `e`. */
+void exec_cache_insert(struct exec_cache_entry *e);
+
+/* Drop the entry for `inode` or all the entries of `fs` if inode is NULL */
+void __exec_cache_invalidate(struct mnt_fs *fs, vfs_inode_ptr_t inode);
+
+static ALWAYS_INLINE void
+exec_cache_invalidate(struct mnt_fs *fs, vfs_inode_ptr_t inode)
+{
+   if (exec_cache_stats.entries)
+      __exec_cache_invalidate(fs, inode);
+}
@@ -9,9 +9,16 @@
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/fs/vfs_base.h>
 
+struct blkdev;
+
 struct fat_fs_device_data {
 
-   struct fat_hdr *hdr; /* vaddr of the beginning of the FAT partition */
+   /*
+    * For ramdisks, the vaddr of the beginning of the FAT partition. For block
+    * devices, a buffer containing just its first sectors, up to the beginning
+    * of the data region: the boot sector, the FATs and the FAT16 root dir.
+    */
+   struct fat_hdr *hdr;
    enum fat_type type;
    u32 cluster_size;
    u32 root_cluster;
@@ -28,6 +35,12 @@ struct fat_fs_device_data {
     * regular fat_entry.
     */
    struct fat_entry *root_dir_entries;
+
+   /* Fields used only when the FAT partition is on a block device */
+   struct blkdev *bdev;
+   size_t hdr_size;
+   struct kmutex clu_cache_lock;
+   void *clu_cache_root;      /* bintree of the cached directory clusters */
 };
 
 struct fatfs_handle {
@@ -44,6 +57,8 @@ STATIC_ASSERT(sizeof(struct fatfs_handle) <= MAX_FS_HANDLE_SIZE);
 
 struct mnt_fs *fat_mount_ramdisk(void *vaddr, size_t rd_size, u32 flags);
 void fat_umount_ramdisk(struct mnt_fs *fs);
+int fat_mount_blkdev(struct blkdev *dev, u32 flags, struct mnt_fs **out);
+void fat_umount_blkdev(struct mnt_fs *fs);
 
 struct datetime
 fat_datetime_to_regular_datetime(u16 date, u16 time, u8 timetenth);
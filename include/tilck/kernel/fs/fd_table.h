@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+
+#include <tilck_gen_headers/config_userlim.h>
+
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/fs/vfs_base.h>
+
+/*
+ * Number of fds that a table can hold without any additional allocation. It is
+ * also the granularity used for growing tables, since each word of the bitmaps
+ * covers exactly NBITS fds.
+ */
+#define FDT_INLINE_FDS                   NBITS
+
+struct process;
+
+/*
+ * The file descriptor table of a process.
+ *
+ * Tables grow on demand up to MAX_HANDLES fds and are never shared: fork()
+ * gives the child a copy of the table, with all the handles duplicated. See
+ * fdt_fork(). All the functions here must be called while holding the
+ * `fslock` of the process.
+ */
+struct fd_table {
+
+   int size;               /* Number of slots (always a multiple of NBITS) */
+   int next_fd;            /* Hint: all the fds below `next_fd` are in use */
+
+   fs_handle *handles;
+   ulong *open_fds;        /* Bitmap of the fds in use */
+   ulong *cloexec_fds;     /* Bitmap of the fds having FD_CLOEXEC set */
+
+   /* Inline storage used while size == FDT_INLINE_FDS */
+   fs_handle inline_handles[FDT_INLINE_FDS];
+   ulong inline_open_fds[1];
+   ulong inline_cloexec_fds[1];
+};
+
+static ALWAYS_INLINE fs_handle
+fdt_get(struct fd_table *fdt, int fd)
+{
+   if (!fdt || !IN_RANGE(fd, 0, fdt->size))
+      return NULL;
+
+   return fdt->handles[fd];
+}
+
+static ALWAYS_INLINE int
+fdt_size(struct fd_table *fdt)
+{
+   return fdt ? fdt->size : 0;
+}
+
+static ALWAYS_INLINE bool
+fdt_is_cloexec(struct fd_table *fdt, int fd)
+{
+   ASSERT(IN_RANGE(fd, 0, fdt->size));
+   return !!(fdt->cloexec_fds[fd / NBITS] & (1UL << (fd % NBITS)));
+}
+
+void fdt_release(struct fd_table *fdt);
+int fdt_fork(struct process *pi);
+int fdt_get_free_fd(struct process *pi, int ge);
+int fdt_reserve_fd(struct process *pi, int fd);
+void fdt_install(struct process *pi, int fd, fs_handle h);
+fs_handle fdt_remove(struct process *pi, int fd);
+void fdt_set_cloexec(struct process *pi, int fd, bool val);
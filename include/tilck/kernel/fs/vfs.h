@@ -74,6 +74,7 @@ typedef ssize_t        (*func_read)         (fs_handle, char *, size_t, offt *);
 typedef ssize_t        (*func_write)        (fs_handle, char *, size_t, offt *);
 typedef offt           (*func_seek)         (fs_handle, offt, int);
 typedef int            (*func_ioctl)        (fs_handle, ulong, void *);
+typedef int            (*func_fcntl)        (fs_handle, int, int);
 
 typedef int            (*func_mmap)         (struct user_mapping *,
                                              pdir_t *,
@@ -159,6 +160,7 @@ struct file_ops {
    func_read read;                     /* if NULL -> -EBADF  */
    func_write write;                   /* if NULL -> -EBADF  */
    func_ioctl ioctl;                   /* if NULL -> -ENOTTY */
+   func_fcntl fcntl;                   /* if NULL -> -EINVAL */
    func_seek seek;                     /* if NULL -> -ESPIPE */
    func_mmap mmap;                     /* if NULL -> -ENODEV */
    func_munmap munmap;                 /* if NULL -> -ENODEV */
@@ -203,6 +205,7 @@ int vfs_utimens(const char *path, const struct k_timespec64 times[2]);
 
 int vfs_ftruncate(fs_handle h, offt length);
 int vfs_ioctl(fs_handle h, ulong request, void *argp);
+int vfs_fcntl(fs_handle h, int cmd, int arg);
 int vfs_fstat64(fs_handle h, struct k_stat64 *statbuf);
 int vfs_getdents64(fs_handle h, struct linux_dirent64 *dirp, u32 bs);
 int vfs_fchmod(fs_handle h, mode_t mode);
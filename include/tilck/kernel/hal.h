@@ -171,6 +171,8 @@ void on_first_pdir_update(void);
 extern void (*hw_read_clock)(struct datetime *out);
 void hw_read_clock_cmos(struct datetime *out);
 u32 hw_timer_setup(u32 hz);
+void hw_hrtimer_calib_begin(void);
+void hw_hrtimer_calib_end(u32 ticks);
 
 bool allocate_fpu_regs(arch_task_members_t *arch_fields);
 void copy_main_tss_on_regs(regs_t *ctx);
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/list.h>
+
+/*
+ * High-resolution timers.
+ *
+ * The expire times are absolute and use the same clock as get_sys_time(), in
+ * nanoseconds. The callbacks are always called in IRQ context, with the
+ * interrupts disabled: they must be very short and must not sleep.
+ *
+ * When the arch code provides a one-shot timer backend (e.g. the LAPIC timer
+ * on x86), the timers fire at the requested time. Otherwise, the expired
+ * timers are checked at every tick of the periodic timer.
+ */
+
+struct hrtimer;
+typedef void (*hrtimer_func)(struct hrtimer *);
+
+struct hrtimer {
+
+   struct list_node node;
+   u64 expires;
+   hrtimer_func func;
+};
+
+struct hrtimer_backend {
+
+   const char *name;
+
+   /* Fire an IRQ calling hrtimer_run_expired() in (about) `delta` ns */
+   void (*program)(u64 delta);
+
+   /* Stop the timer: there are no more hrtimers */
+   void (*stop)(void);
+};
+
+void hrtimer_init(struct hrtimer *t, hrtimer_func func);
+void hrtimer_start(struct hrtimer *t, u64 expires);
+u64 hrtimer_cancel(struct hrtimer *t);
+void hrtimer_run_expired(void);
+void hrtimer_set_backend(const struct hrtimer_backend *b);
+const char *hrtimer_get_backend_name(void);
+
+static ALWAYS_INLINE bool hrtimer_is_pending(struct hrtimer *t)
+{
+   return list_is_node_in_list(&t->node);
+}
@@ -6,15 +6,29 @@
 #include <tilck/common/atomics.h>
 #include <tilck/kernel/list.h>
 #include <tilck/kernel/hal_types.h>
+#include <tilck/kernel/smp.h>
 
 void set_fault_handler(int fault, void *ptr);
 
+#if KRN_SMP
+
+static ALWAYS_INLINE bool in_irq(void)
+{
+   int count;
+   DO_ON_THIS_CPU(c, count = c->in_irq_count);
+   return count > 0;
+}
+
+#else
+
 static ALWAYS_INLINE bool in_irq(void)
 {
    extern ATOMIC(int) __in_irq_count;
    return atomic_load_explicit(&__in_irq_count, mo_relaxed) > 0;
 }
 
+#endif
+
 #if KRN_TRACK_NESTED_INTERR
    void check_not_in_irq_handler(void);
    void check_in_irq_handler(void);
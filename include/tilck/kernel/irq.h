@@ -26,6 +26,13 @@ void init_irq_handling();
 void irq_install_handler(u8 irq, struct irq_handler_node *n);
 void irq_uninstall_handler(u8 irq, struct irq_handler_node *n);
 
+/*
+ * Dedicated vectors, delivered through the LAPIC to a single handler (e.g. for
+ * MSI interrupts). Return the allocated vector or a negative errno value.
+ */
+int irq_alloc_vector(struct irq_handler_node *n);
+void irq_free_vector(int vector);
+
 void irq_set_mask(int irq);
 void irq_clear_mask(int irq);
 bool irq_is_masked(int irq);
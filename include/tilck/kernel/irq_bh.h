@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/list.h>
+
+/*
+ * Threaded IRQ bottom halves (BH).
+ *
+ * A BH is deferred work scheduled by an IRQ handler (the top half) and run
+ * later, with interrupts and preemption enabled, by a dedicated worker thread.
+ * There's one worker thread per BH priority, shared by all the BHs having that
+ * priority (0 is the highest).
+ *
+ * Scheduling a BH already pending is a no-op, other than counting it as
+ * coalesced: N interrupts arriving before the BH runs, schedule it just once.
+ * Therefore, the BH function must process *all* the work available when it
+ * runs. The pending bit is cleared right before calling it, so an interrupt
+ * arriving while the BH runs will schedule it again.
+ *
+ * For each BH we account the latency from the top half scheduling it to the
+ * beginning of its run (in TSC cycles) and the times it could not be queued
+ * because its worker thread's queue was full (overflows). In that case, the
+ * next interrupt will try again. The stats are shown by the debug panel.
+ */
+
+struct irq_bh_stats {
+
+   u32 scheduled;             /* calls to irq_bh_schedule() */
+   u32 coalesced;             /* scheduled while already pending */
+   u32 runs;
+   u32 overflows;             /* not queued because the queue was full */
+   u64 lat_tot;               /* top half -> BH latency, in TSC cycles */
+   u64 lat_max;
+};
+
+struct irq_bh {
+
+   struct list_node node;     /* node in the global list of BHs */
+   const char *name;          /* must be a static string */
+   int irq;                   /* IRQ of the top half, just for the stats */
+   int priority;
+   void (*func)(void *ctx);
+   void *ctx;
+
+   /* Internal fields, accessed with the interrupts disabled */
+   struct worker_thread *wth;
+   bool pending;
+   u64 sched_tsc;             /* RDTSC() when it became pending */
+   struct irq_bh_stats stats;
+};
+
+/* Info about a BH, as returned by irq_bh_snapshot() */
+struct irq_bh_info {
+
+   const char *name;
+   int irq;
+   int priority;
+   bool pending;
+   struct irq_bh_stats stats;
+};
+
+int irq_bh_init(struct irq_bh *bh,
+                const char *name,
+                int irq,
+                int priority,
+                void (*func)(void *),
+                void *ctx);
+
+bool irq_bh_schedule(struct irq_bh *bh);
+void irq_bh_run_now(struct irq_bh *bh);
+int irq_bh_get_count(void);
+int irq_bh_snapshot(struct irq_bh_info *arr, int max_count);
+void irq_bh_reset_stats(void);
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/atomics.h>
+
+/*
+ * The kernel log: a ring of fixed-size, sequence-numbered records, one for each
+ * printk() call. Records are appended in a lock-free way, from any context
+ * (IRQ handlers included): a writer reserves its sequence number with an atomic
+ * fetch-add, fills its slot and then publishes it by setting the slot's `seq`.
+ * When the ring is full, the oldest records get overwritten.
+ *
+ * Readers (the console and /dev/kmsg) keep their own position in the log and
+ * detect overwritten records by checking the slot's `seq` again after copying
+ * its contents, like with a seqlock.
+ */
+
+#if TINY_KERNEL
+   #define KMSG_RECORDS                  16
+#else
+   #define KMSG_RECORDS                 128
+#endif
+
+#define KMSG_TEXT_SZ                    224
+
+/* Record flags */
+#define KMSG_FL_PREFIX              (1 << 0)   /* it starts a new line */
+#define KMSG_FL_LOWSS               (1 << 1)   /* printed with low stack */
+
+struct kmsg_hdr {
+
+   u32 seq;
+   u16 len;                /* length of the text */
+   u8 flags;
+   u8 unused0;
+   u64 ts;                 /* get_sys_time() at the moment of the printk */
+};
+
+struct kmsg_record {
+
+   ATOMIC(u32) seq_plus_one;     /* 0 if the slot is being written */
+   struct kmsg_hdr hdr;
+   char text[KMSG_TEXT_SZ];
+};
+
+/* Append a record to the log, returning its sequence number */
+u32 kmsg_append(const char *buf, u32 len, u8 flags, u64 ts);
+
+/*
+ * Copy in `buf` up to `size` bytes of the text of the record `seq`, starting at
+ * `off`. On success, returns the number of bytes copied and fills `hdr`.
+ * Returns -EAGAIN if the record has not been published yet and -EPIPE if it
+ * has already been overwritten.
+ */
+int kmsg_read(u32 seq, u32 off, char *buf, u32 size, struct kmsg_hdr *hdr);
+
+/* Sequence number that the next record will have */
+u32 kmsg_get_next_seq(void);
+
+/* Sequence number of the oldest record that might still be in the log */
+u32 kmsg_get_first_seq(void);
+
+void init_kmsg_device(void);
+void init_printk_worker(void);
+
+/*
+ * Wake up the /dev/kmsg readers. It must be called in task context, with
+ * preemption enabled.
+ */
+void kmsg_wakeup_readers(void);
+
+/* Number of open /dev/kmsg handles */
+extern ATOMIC(int) kmsg_readers;
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck_gen_headers/config_kernel.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/list.h>
+
+/*
+ * Lock contention statistics (lockstat), compiled-in only when KRN_LOCKSTAT
+ * is enabled. Only the lock instances explicitly registered with a name
+ * using one of the lockstat_register_*() functions are tracked.
+ *
+ * For each lock we count the acquisitions, how many of them had to wait
+ * (contentions) and the total and the max wait time, in TSC cycles. For kcond
+ * objects, every kcond_wait() counts as a contended acquisition.
+ */
+
+enum lockstat_type {
+   LOCKSTAT_KMUTEX,
+   LOCKSTAT_RWLOCK,
+   LOCKSTAT_KCOND,
+};
+
+struct lockstat {
+
+   struct list_node node;     /* node in the global list of tracked locks */
+   const char *name;          /* must be a static string */
+   long id;                   /* instance id (e.g. the pid), or -1 */
+   enum lockstat_type type;
+
+   int holder_tid;            /* exclusive holder (0 if the lock is free) */
+   u32 acquisitions;
+   u32 contentions;
+   u64 wait_tot;
+   u64 wait_max;
+};
+
+#if KRN_LOCKSTAT
+   #define lockstat_ref(obj)                     (&(obj)->ls)
+   #define lockstat_of(obj)                      ((obj)->ls)
+#else
+   #define lockstat_ref(obj)                     ((struct lockstat **)NULL)
+   #define lockstat_of(obj)                      ((struct lockstat *)NULL)
+#endif
+
+void lockstat_register(struct lockstat **ls_ref,
+                       enum lockstat_type type,
+                       const char *name,
+                       long id);
+
+void lockstat_unregister(struct lockstat **ls_ref);
+void lockstat_reset(void);
+int lockstat_get_count(void);
+int lockstat_snapshot(struct lockstat *arr, int max_count);
+
+u64 __lockstat_wait_begin(void);
+void __lockstat_acquired(struct lockstat *ls, u64 wait_start, bool ex);
+void __lockstat_released(struct lockstat *ls);
+
+#define lockstat_register_kmutex(m, name, id)                           \
+   lockstat_register(lockstat_ref(m), LOCKSTAT_KMUTEX, (name), (id))
+
+#define lockstat_register_rwlock(rw, name, id)                          \
+   lockstat_register(lockstat_ref(rw), LOCKSTAT_RWLOCK, (name), (id))
+
+#define lockstat_register_kcond(c, name, id)                            \
+   lockstat_register(lockstat_ref(c), LOCKSTAT_KCOND, (name), (id))
+
+/* Returns the timestamp to pass to lockstat_acquired() after the wait */
+static ALWAYS_INLINE u64
+lockstat_wait_begin(struct lockstat *ls)
+{
+   return (KRN_LOCKSTAT && ls) ? __lockstat_wait_begin() : 0;
+}
+
+/* `wait_start` is 0 when the lock has been acquired without waiting */
+static ALWAYS_INLINE void
+lockstat_acquired(struct lockstat *ls, u64 wait_start)
+{
+   if (KRN_LOCKSTAT && ls)
+      __lockstat_acquired(ls, wait_start, true);
+}
+
+static ALWAYS_INLINE void
+lockstat_shacquired(struct lockstat *ls, u64 wait_start)
+{
+   if (KRN_LOCKSTAT && ls)
+      __lockstat_acquired(ls, wait_start, false);
+}
+
+static ALWAYS_INLINE void
+lockstat_released(struct lockstat *ls)
+{
+   if (KRN_LOCKSTAT && ls)
+      __lockstat_released(ls);
+}
+
+static inline const char *
+lockstat_type_str(enum lockstat_type t)
+{
+   switch (t) {
+      case LOCKSTAT_KMUTEX: return "kmutex";
+      case LOCKSTAT_RWLOCK: return "rwlock";
+      case LOCKSTAT_KCOND:  return "kcond";
+      default:              return "?";
+   }
+}
@@ -5,15 +5,37 @@
 #include <tilck/common/basic_defs.h>
 #include <tilck/kernel/list.h>
 
+/*
+ * Modules are initialized in order of priority. A module can declare the
+ * modules it depends on in `deps`: they must have a lower priority value (be
+ * initialized before it). The hard dependencies must be listed also in the
+ * module's `module_deps` file, which is checked at build time; the deps not
+ * built-in are just ignored here.
+ *
+ * Modules not needed by init (e.g. device discovery) can be marked as `async`:
+ * each of them is initialized in a dedicated kernel thread, in parallel with
+ * the remaining modules and with init itself, as soon as all its deps have
+ * been initialized. Anything depending on an async module must call
+ * wait_for_all_modules() first.
+ */
+
 struct module {
 
    const char *name;
    int priority;
    void (*init)(void);
+   const char *const *deps;         /* NULL-terminated list of names */
+   bool async;
+
+   /* Set by init_modules() */
+   bool initialized;
 };
 
+#define MOD_DEPS(...)      ((const char *const []){ __VA_ARGS__, NULL })
+
 void init_modules(void);
 void register_module(struct module *m);
+void wait_for_all_modules(void);
 
 #define REGISTER_MODULE(m)                             \
    __attribute__((constructor))                        \
@@ -30,9 +52,11 @@ void register_module(struct module *m);
 #define MOD_acpi_prio                         30
 #define MOD_kb_prio                           50
 #define MOD_tracing_prio                     100
+#define MOD_profiler_prio                    110
 #define MOD_tty_prio                         200
 #define MOD_fbdev_prio                       300
 #define MOD_serial_prio                      400
 #define MOD_sb16_prio                        410
+#define MOD_ata_prio                         420
 #define MOD_systests_prio                    990
 #define MOD_dp_prio                         1000 /* last */
@@ -104,6 +104,9 @@ pdir_t *pdir_deep_clone(pdir_t *pdir);
 void pdir_destroy(pdir_t *pdir);
 void invalidate_page(ulong vaddr);
 void set_page_rw(pdir_t *pdir, void *vaddr, bool rw);
+void set_page_cow(pdir_t *pdir, void *vaddr);
+void *share_user_page_cow(pdir_t *pdir, void *vaddr);
+void release_shared_page(void *page);
 void retain_pageframes_mapped_at(pdir_t *pdir, void *vaddr, size_t len);
 void release_pageframes_mapped_at(pdir_t *pdir, void *vaddr, size_t len);
 
@@ -1,11 +1,39 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #pragma once
-#define PIPE_BUF_SIZE   4096
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/fs/vfs_base.h>
+
+/*
+ * Pipes store their data in a list of pages, allocated on demand. The capacity
+ * of a pipe can be changed with fcntl(F_SETPIPE_SZ), up to PIPE_MAX_BUFS pages.
+ */
+#define PIPE_DEF_BUFS             16        /* 64 KB, like on Linux */
+#define PIPE_MAX_BUFS            256        /* 1 MB */
+
+#ifndef F_SETPIPE_SZ
+   #define F_SETPIPE_SZ         1031
+   #define F_GETPIPE_SZ         1032
+#endif
+
+#ifndef SPLICE_F_MOVE
+   #define SPLICE_F_MOVE           1
+   #define SPLICE_F_NONBLOCK       2
+   #define SPLICE_F_MORE           4
+   #define SPLICE_F_GIFT           8
+#endif
+
+#define SPLICE_F_ALL   \
+   (SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT)
 
 struct pipe;
+struct iovec;
 
 struct pipe *create_pipe(void);
 void destroy_pipe(struct pipe *p);
 fs_handle pipe_create_read_handle(struct pipe *p);
 fs_handle pipe_create_write_handle(struct pipe *p);
+bool is_pipe_handle(fs_handle h);
+
+ssize_t
+pipe_vmsplice(fs_handle h, const struct iovec *iov, int iovcnt, u32 flags);
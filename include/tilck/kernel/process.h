@@ -19,6 +19,8 @@
 #include <tilck/kernel/fs/flock.h>
 #include <tilck/kernel/sys_types.h>
 
+struct fd_table;
+
 struct kernel_alloc {
 
    struct bintree_node node;
@@ -58,14 +60,14 @@ struct process {
 
    int *set_child_tid;                    /* NOTE: this is an user pointer */
 
-   struct kmutex fslock;                  /* protects `handles` and `cwd` */
+   struct kmutex fslock;                  /* protects `fdt` and `cwd` */
    mode_t umask;
 
    struct vfs_path cwd;                   /* CWD as a struct vfs_path */
    char *debug_cmdline;                   /* debug field used by debugpanel */
 
    struct locked_file *elf;
-   fs_handle handles[MAX_HANDLES];        /* just a small fixed-size array */
+   struct fd_table *fdt;                  /* NULL means no open fds */
 
    /*
     * The purpose of having this opaque `arch_fields` member here is to avoid
@@ -117,7 +119,7 @@ task_is_parent(struct task *parent, struct task *child)
    return child->pi->parent_pid == parent->pi->pid;
 }
 
-int do_fork(bool vfork);
+int do_fork(bool vfork, void *user_stack);
 void handle_vforked_child_move_on(struct process *pi);
 int first_execve(const char *abs_path, const char *const *argv);
 
@@ -51,6 +51,10 @@ struct rwlock_wp {
    bool w;    /* writer waiting */
    bool rec;  /* is exlock operation recursive */
    u16 rc;    /* recursive locking count */
+
+#if KRN_LOCKSTAT
+   struct lockstat *ls;
+#endif
 };
 
 void rwlock_wp_init(struct rwlock_wp *rw, bool recursive);
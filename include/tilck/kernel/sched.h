@@ -10,6 +10,8 @@
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/signal.h>
+#include <tilck/kernel/hrtimer.h>
+#include <tilck/kernel/smp.h>
 
 #include <tilck_gen_headers/config_sched.h>
 
@@ -78,7 +80,6 @@ struct task {
 
    struct bintree_node tree_by_tid_node;
    struct list_node runnable_node;
-   struct list_node wakeup_timer_node;
    struct list_node siblings_node;    /* nodes in parent's pi's children list */
 
    struct list tasks_waiting_list;    /* tasks waiting this task to end */
@@ -95,7 +96,7 @@ struct task {
    };
 
    struct wait_obj wobj;
-   u32 ticks_before_wake_up;
+   struct hrtimer wakeup_timer;
 
    /* List of callbacks to call on exit */
    struct list on_exit;
@@ -133,17 +134,47 @@ struct task {
    /* Old blocked signals mask, saved by sys_rt_sigsuspend() */
    ulong sa_old_mask[K_SIGACTION_MASK_WORDS];
 
+#if KRN_SMP
+   /* CPU whose runqueue contains the task, or the CPU running it */
+   u32 cpu;
+#endif
+
    /* See the comment above struct process' pi_arch */
    char ti_arch[ARCH_TASK_MEMBERS_SIZE] ALIGNED_AT(ARCH_TASK_MEMBERS_ALIGN);
 };
 
 extern struct task *kernel_process;
 extern struct process *kernel_process_pi;
-extern struct task *idle_task;
+extern struct task *idle_task;             /* the BSP's idle task */
 
+#if !KRN_SMP
 extern struct list runnable_tasks_list;
+#endif
 extern const char *const task_state_str[5];
 
+#if KRN_SMP
+
+static ALWAYS_INLINE bool is_idle_task(struct task *ti)
+{
+   /* The idle tasks never migrate: ti->cpu is always their CPU */
+   return ti == cpus[ti->cpu].idle_task;
+}
+
+void sched_kick_task(struct task *ti);
+struct task *sched_create_cpu_idle_task(u32 cpu);
+void sched_drop_cpu_idle_task(u32 cpu);
+
+#else
+
+static ALWAYS_INLINE bool is_idle_task(struct task *ti)
+{
+   return ti == idle_task;
+}
+
+static inline void sched_kick_task(struct task *ti) { }
+
+#endif
+
 #define KTH_ALLOC_BUFS                       (1 << 0)
 #define KTH_WORKER_THREAD                    (1 << 1)
 
@@ -159,6 +190,52 @@ void task_change_state(struct task *ti, enum task_state new_state);
 void task_change_state_idempotent(struct task *ti, enum task_state new_state);
 bool save_regs_and_schedule(bool skip_disable_preempt);
 
+#if KRN_SMP
+
+static ALWAYS_INLINE void sched_set_need_resched(void)
+{
+   DO_ON_THIS_CPU(c, atomic_store_explicit(&c->need_resched, 1, mo_relaxed));
+}
+
+static ALWAYS_INLINE void sched_clear_need_resched(void)
+{
+   DO_ON_THIS_CPU(c, atomic_store_explicit(&c->need_resched, 0, mo_relaxed));
+}
+
+static ALWAYS_INLINE bool need_reschedule(void)
+{
+   int val;
+   DO_ON_THIS_CPU(c, val = atomic_load_explicit(&c->need_resched, mo_relaxed));
+   return (bool)val;
+}
+
+static ALWAYS_INLINE void disable_preemption(void)
+{
+   DO_ON_THIS_CPU(c, c->disable_preempt++);
+}
+
+static ALWAYS_INLINE void enable_preemption_nosched(void)
+{
+   DO_ON_THIS_CPU(c, c->disable_preempt--);
+}
+
+void enable_preemption(void);
+
+/* WARNING: see the comment in the !KRN_SMP case below */
+static ALWAYS_INLINE void force_enable_preemption(void)
+{
+   DO_ON_THIS_CPU(c, c->disable_preempt = 0);
+}
+
+static ALWAYS_INLINE int get_preempt_disable_count(void)
+{
+   int val;
+   DO_ON_THIS_CPU(c, val = c->disable_preempt);
+   return val;
+}
+
+#else
+
 static ALWAYS_INLINE void sched_set_need_resched(void)
 {
    extern ATOMIC(int) __need_resched; /* see docs/atomics.md */
@@ -207,6 +284,8 @@ static ALWAYS_INLINE int get_preempt_disable_count(void)
    return atomic_load_explicit(&__disable_preempt, mo_relaxed);
 }
 
+#endif
+
 static ALWAYS_INLINE bool is_preemption_enabled(void)
 {
    return !get_preempt_disable_count();
@@ -279,6 +358,17 @@ static ALWAYS_INLINE bool schedule_preempt_disabled(void)
 }
 
 
+#if KRN_SMP
+
+static ALWAYS_INLINE struct task *get_curr_task(void)
+{
+   struct task *curr;
+   DO_ON_THIS_CPU(c, curr = c->current);
+   return curr;
+}
+
+#else
+
 static ALWAYS_INLINE struct task *get_curr_task(void)
 {
    extern struct task *__current;
@@ -302,13 +392,15 @@ static ALWAYS_INLINE struct task *get_curr_task(void)
    return __current;
 }
 
+#endif
+
 /* Hack: it works only if the C file includes process.h, but that's fine. */
 #define get_curr_proc() (get_curr_task()->pi)
 
 static ALWAYS_INLINE enum task_state
-get_curr_task_state(void)
+get_task_state(struct task *ti)
 {
-   STATIC_ASSERT(sizeof(get_curr_task()->state) == 4);
+   STATIC_ASSERT(sizeof(ti->state) == 4);
 
    /*
     * Casting `state` to u32 and back to `enum task_state` to avoid compiler
@@ -316,11 +408,17 @@ get_curr_task_state(void)
     */
 
    return (enum task_state) atomic_load_explicit(
-      (ATOMIC(u32)*)&get_curr_task()->state,
+      (ATOMIC(u32)*)&ti->state,
       mo_relaxed
    );
 }
 
+static ALWAYS_INLINE enum task_state
+get_curr_task_state(void)
+{
+   return get_task_state(get_curr_task());
+}
+
 #if DEBUG_CHECKS
 
    #define ASSERT_CURR_TASK_STATE(exp)                            \
@@ -399,9 +497,11 @@ void kthread_exit(void);
 int kthread_join(int tid, bool ignore_signals);
 int kthread_join_all(const int *tids, size_t n, bool ignore_signals);
 
+void init_task_wakeup_timer(struct task *ti);
 void task_set_wakeup_timer(struct task *task, u32 ticks);
+void task_set_wakeup_timer_ns(struct task *ti, u64 ns);
 void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks);
-u32 task_cancel_wakeup_timer(struct task *ti);
+u64 task_cancel_wakeup_timer(struct task *ti);
 
 typedef void (*kthread_func_ptr)();
 
@@ -0,0 +1,118 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck_gen_headers/config_kernel.h>
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/atomics.h>
+#include <tilck/kernel/list.h>
+
+/*
+ * SMP support. Without KRN_SMP, only the enumeration of the CPUs is done.
+ *
+ * With KRN_SMP, the application processors (APs) are started and take part in
+ * the scheduling: each CPU has its own current task, idle task, runqueue,
+ * preemption counter and IRQ nesting counter, all in its `struct cpu_info`.
+ * Idle CPUs steal runnable tasks from the other runqueues and the CPUs notify
+ * each other with IPIs (reschedule, timer tick, cross-CPU calls).
+ *
+ * The kernel itself is still serialized by a big kernel lock (BKL): a CPU
+ * holds it whenever it runs kernel code and releases it only when it returns
+ * to user space or it halts in its idle task. Therefore, all the kernel code
+ * written for a single CPU keeps working unchanged, while the user code runs
+ * in parallel on all the CPUs. Note: the device IRQs are still delivered only
+ * to the BSP, therefore the kernel must never busy-wait for an IRQ.
+ */
+
+struct task;
+
+struct cpu_info {
+
+   u32 hw_id;                 /* LAPIC ID, on x86 */
+   bool bsp;
+   volatile bool online;
+   void *kernel_stack;        /* APs only: the stack used during the startup */
+
+#if KRN_SMP
+
+   /* Per-CPU state: see the accessors in sched.h and interrupts.h */
+   struct task *current;
+   struct task *idle_task;
+   int disable_preempt;
+   int in_irq_count;
+   ATOMIC(int) need_resched;  /* might be set by other CPUs */
+
+   struct list runnable_list;
+   int runnable_count;
+
+   /* Release the BKL after the context switch in progress */
+   bool bkl_drop_on_switch;
+
+#endif
+};
+
+extern struct cpu_info cpus[MAX_CPUS];
+extern u32 cpus_count;
+
+void smp_add_cpu(u32 hw_id);
+u32 get_online_cpus_count(void);
+void init_smp(void);
+
+#if KRN_SMP
+
+#include <tilck/kernel/arch/i386/percpu.h>
+
+static ALWAYS_INLINE u32 get_this_cpu_idx(void)
+{
+   return arch_get_cpu_idx();
+}
+
+static ALWAYS_INLINE struct cpu_info *get_this_cpu(void)
+{
+   return &cpus[arch_get_cpu_idx()];
+}
+
+/*
+ * Run `stmt` with `c` pointing to the `struct cpu_info` of the current CPU.
+ * The interrupts are disabled meanwhile: otherwise, the task might be preempted
+ * and migrated to another CPU between reading the CPU index and using `c`.
+ */
+#define DO_ON_THIS_CPU(c, stmt)                                      \
+   do {                                                              \
+      ulong __percpu_fl = arch_percpu_irq_save();                    \
+      {                                                              \
+         struct cpu_info *c = get_this_cpu();                        \
+         stmt;                                                       \
+      }                                                              \
+      arch_percpu_irq_restore(__percpu_fl);                          \
+   } while (0)
+
+bool bkl_lock(void);
+void bkl_unlock(void);
+bool bkl_is_owned(void);
+
+bool smp_handle_call_ipi(int int_num);
+void smp_call_on_others(void (*func)(void *), void *arg);
+void smp_send_resched(u32 cpu);
+void smp_broadcast_tick(void);
+void smp_idle_halt(void);
+void smp_on_context_switch(void);
+void smp_tlb_shootdown(ulong vaddr);
+void smp_flush_tlb_others(void);
+void smp_release_pdir(void *pdir);
+void smp_reload_gdt_on_others(void);
+void smp_stop_other_cpus(void);
+
+#else
+
+static ALWAYS_INLINE u32 get_this_cpu_idx(void) { return 0; }
+static inline bool bkl_lock(void) { return false; }
+static inline void bkl_unlock(void) { }
+static inline bool smp_handle_call_ipi(int int_num) { return false; }
+static inline void smp_broadcast_tick(void) { }
+static inline void smp_tlb_shootdown(ulong vaddr) { }
+static inline void smp_flush_tlb_others(void) { }
+static inline void smp_release_pdir(void *pdir) { }
+static inline void smp_reload_gdt_on_others(void) { }
+static inline void smp_stop_other_cpus(void) { }
+
+#endif
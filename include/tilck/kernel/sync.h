@@ -1,12 +1,14 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #pragma once
+#include <tilck_gen_headers/config_kernel.h>
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/atomics.h>
 #include <tilck/kernel/list.h>
 
 struct task;
+struct lockstat;
 
 enum wo_type {
 
@@ -150,6 +152,11 @@ struct kmutex {
 #if KMUTEX_STATS_ENABLED
    u32 num_waiters;
    u32 max_num_waiters;
+   u32 num_spin_acquired;
+#endif
+
+#if KRN_LOCKSTAT
+   struct lockstat *ls;
 #endif
 };
 
@@ -163,6 +170,13 @@ struct kmutex {
 
 #define KMUTEX_FL_RECURSIVE                                (1 << 0)
 
+/*
+ * Never yield waiting for the owner to release the mutex in kmutex_lock(), go
+ * to sleep immediately instead. Useful for mutexes typically held for a long
+ * time (e.g. while doing I/O) and for comparing the two behaviors in tests.
+ */
+#define KMUTEX_FL_NO_SPIN                                  (1 << 2)
+
 #if KERNEL_SELFTESTS
 
    /*
@@ -190,6 +204,10 @@ bool kmutex_is_curr_task_holding_lock(struct kmutex *m);
 struct kcond {
 
    struct list wait_list;
+
+#if KRN_LOCKSTAT
+   struct lockstat *ls;
+#endif
 };
 
 #define STATIC_KCOND_INIT(s)                     \
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck_gen_headers/config_kernel.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sys_types.h>
+
+/*
+ * Always-on syscall statistics: per-syscall call counters and log2 histograms
+ * of the latency (in TSC cycles) of each call, measured from the entry to the
+ * exit of the syscall, blocking time included.
+ *
+ * The counters are updated in the common syscall path with preemption
+ * disabled, so they don't need any atomic operations: the overhead is just
+ * two RDTSC instructions and a few increments per call.
+ */
+
+#define SYS_STATS_HIST_BUCKETS             32
+
+struct sys_stats {
+
+   u32 count;
+   u32 hist[SYS_STATS_HIST_BUCKETS];   /* hist[i]: calls taking ~2^i cycles */
+   u64 tot_cycles;
+   u64 max_cycles;
+};
+
+/* Array of MAX_SYSCALLS elements, NULL if KRN_SYS_STATS is disabled */
+extern struct sys_stats *sys_stats;
+
+/* When > 0, only the syscalls of the process with this PID are accounted */
+extern long sys_stats_pid_filter;
+
+void init_sys_stats(void);
+void sys_stats_reset(void);
+const char *sys_stats_get_name(u32 sn);
+void __sys_stats_account(u32 sn, u64 cycles);
+
+static ALWAYS_INLINE u64
+sys_stats_begin(void)
+{
+   return KRN_SYS_STATS ? RDTSC() : 0;
+}
+
+/* Must be called with preemption disabled */
+static ALWAYS_INLINE void
+sys_stats_end(u32 sn, u64 start)
+{
+   if (KRN_SYS_STATS && LIKELY(sys_stats != NULL))
+      __sys_stats_account(sn, RDTSC() - start);
+}
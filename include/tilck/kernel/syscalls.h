@@ -32,6 +32,8 @@
 
 #endif
 
+struct io_uring_params;
+
 CREATE_STUB_SYSCALL_IMPL(sys_restart_syscall);
 
 int sys_exit(int code);
@@ -192,7 +194,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_ipc)
 int sys_fsync(int fd);
 CREATE_STUB_SYSCALL_IMPL(sys_sigreturn);
 
-CREATE_STUB_SYSCALL_IMPL(sys_clone)
+int sys_clone(ulong flags, void *newsp, int *ptid, ulong tls, int *ctid);
 CREATE_STUB_SYSCALL_IMPL(sys_setdomainname)
 
 int sys_newuname(struct utsname *buf);
@@ -442,7 +444,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_get_robust_list)
 CREATE_STUB_SYSCALL_IMPL(sys_splice)
 CREATE_STUB_SYSCALL_IMPL(sys_ia32_sync_file_range)
 CREATE_STUB_SYSCALL_IMPL(sys_tee)
-CREATE_STUB_SYSCALL_IMPL(sys_vmsplice)
+int sys_vmsplice(int fd, const struct iovec *iov, ulong nr_segs, u32 flags);
 CREATE_STUB_SYSCALL_IMPL(sys_move_pages)
 CREATE_STUB_SYSCALL_IMPL(sys_getcpu)
 CREATE_STUB_SYSCALL_IMPL(sys_epoll_pwait)
@@ -557,9 +559,14 @@ CREATE_STUB_SYSCALL_IMPL(sys_rt_sigtimedwait)
 CREATE_STUB_SYSCALL_IMPL(sys_futex)
 CREATE_STUB_SYSCALL_IMPL(sys_sched_rr_get_interval)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_send_signal)
-CREATE_STUB_SYSCALL_IMPL(sys_io_uring_setup)
-CREATE_STUB_SYSCALL_IMPL(sys_io_uring_enter)
-CREATE_STUB_SYSCALL_IMPL(sys_io_uring_register)
+int sys_io_uring_setup(u32 entries, struct io_uring_params *u_params);
+int sys_io_uring_enter(int fd,
+                       u32 to_submit,
+                       u32 min_complete,
+                       u32 flags,
+                       const void *sig,
+                       size_t sigsz);
+int sys_io_uring_register(int fd, u32 opcode, void *arg, u32 nr_args);
 CREATE_STUB_SYSCALL_IMPL(sys_open_tree)
 CREATE_STUB_SYSCALL_IMPL(sys_move_mount)
 CREATE_STUB_SYSCALL_IMPL(sys_fsopen)
@@ -568,7 +575,7 @@ CREATE_STUB_SYSCALL_IMPL(sys_fsmount)
 CREATE_STUB_SYSCALL_IMPL(sys_fspick)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_open)
 CREATE_STUB_SYSCALL_IMPL(sys_clone3)
-CREATE_STUB_SYSCALL_IMPL(sys_close_range)
+int sys_close_range(u32 first, u32 last, u32 flags);
 CREATE_STUB_SYSCALL_IMPL(sys_openat2)
 CREATE_STUB_SYSCALL_IMPL(sys_pidfd_getfd)
 CREATE_STUB_SYSCALL_IMPL(sys_faccessat2)
@@ -0,0 +1,6 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck/kernel/fs/fd_table.h>
+
+STATIC struct fd_table *fdt_dup(struct fd_table *fdt, struct process *pi);
@@ -1,6 +0,0 @@
-/* SPDX-License-Identifier: BSD-2-Clause */
-
-#pragma once
-#include <tilck/kernel/process.h>
-
-STATIC int fork_dup_all_handles(struct process *pi);
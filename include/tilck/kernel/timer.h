@@ -6,6 +6,7 @@
 
 void kernel_sleep(u64 ticks);  /* sleep for `ticks` timer ticks (jiffies) */
 void kernel_sleep_ms(u64 ms);  /* sleep for `ms` milliseconds */
+void kernel_sleep_ns(u64 ns);  /* sleep for `ns` nanoseconds */
 void delay_us(u32 us);         /* busy-wait for `us` microseconds */
 
 static ALWAYS_INLINE u64
@@ -15,4 +16,8 @@ ms_to_ticks(u64 ms)
 }
 
 u64 get_ticks(void);
+u32 get_ns_since_last_tick(void);
+bool has_tsc_clocksource(void);
+u64 tsc_to_ns(u64 cycles);
+void timer_tick_adj_changed(void);
 void init_timer(void);
@@ -2,9 +2,57 @@
 
 #pragma once
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/page_size.h>
 
 extern const ulong vdso_begin;
 extern const ulong vdso_end;
 extern const ulong sysexit_user_code_user_vaddr;
 extern const ulong post_sig_handler_user_vaddr;
 extern const ulong pause_trampoline_user_vaddr;
+
+/*
+ * Time data shared with the userspace through the "vvar" page, mapped
+ * read-only at USER_VVAR_VADDR, right after the vdso page. The vdso functions
+ * (__vdso_clock_gettime() etc.) compute the current time as:
+ *
+ *    ns_base + MIN((MIN(rdtsc() - tsc_base, max_delta_tsc) * tsc_mult)
+ *                     >> tsc_shift, max_delta_ns)
+ *
+ * which is exactly what get_sys_time() does in the kernel. The page is updated
+ * by the timer IRQ handler, using `seq` as a seqlock: the readers retry while
+ * it's odd or when it changed during the read.
+ *
+ * NOTE: the field offsets are hard-coded in the vdso's asm code too, see the
+ * VVAR_* constants in asm_defs.h.
+ */
+struct vdso_time_data {
+
+   volatile u32 seq;
+   u32 tsc_ok;                /* 0 = no TSC clocksource: use the syscalls */
+   u64 tsc_base;              /* TSC value at the last tick */
+   u64 ns_base;               /* __time_ns at the last tick */
+   u32 tsc_mult;
+   u32 tsc_shift;             /* always <= 31 */
+   u32 max_delta_ns;          /* duration of the current tick - 1 */
+   u32 max_delta_tsc;         /* TSC cycles per tick */
+   s64 boot_ts;               /* UNIX timestamp at boot */
+};
+
+union vvar_page {
+   struct vdso_time_data time;
+   char raw[PAGE_SIZE];
+};
+
+extern union vvar_page vvar_page;
+
+static ALWAYS_INLINE void vdso_time_write_begin(void)
+{
+   vvar_page.time.seq++;
+   asmVolatile("" ::: "memory");
+}
+
+static ALWAYS_INLINE void vdso_time_write_end(void)
+{
+   asmVolatile("" ::: "memory");
+   vvar_page.time.seq++;
+}
@@ -29,6 +29,22 @@
 
 #define PCI_SUBCLASS_PCI_BRIDGE          0x04
 
+#define PCI_CAP_ID_MSI                   0x05
+#define PCI_CAP_ID_MSIX                  0x11
+
+#define PCI_COMMAND_OFF                  0x04
+#define PCI_COMMAND_MEM_SPACE        (1 << 1)
+#define PCI_COMMAND_BUS_MASTER       (1 << 2)
+#define PCI_COMMAND_INTX_DISABLE    (1 << 10)
+
+#define PCI_BAR0_OFF                     0x10
+#define PCI_BAR_IO                   (1 << 0)
+#define PCI_BAR_TYPE_MASK            (3 << 1)
+#define PCI_BAR_TYPE_64BIT           (2 << 1)
+#define PCI_BAR_MEM_ADDR_MASK           0xfffffff0
+
+struct irq_handler_node;
+
 
 struct pci_vendor {
    u16 vendor_id;
@@ -107,6 +123,11 @@ struct pci_device {
    struct pci_device_loc loc;
    struct pci_device_basic_info nfo;
    void *ext_config;
+
+   u8 msi_cap;                   /* offset of the MSI capability, or 0 */
+   u8 msix_cap;                  /* offset of the MSI-X capability, or 0 */
+   int msi_vector;               /* set by pci_enable_msi(), or 0 */
+   volatile u32 *msix_entry;     /* mapped entry #0 of the MSI-X table */
 };
 
 static ALWAYS_INLINE struct pci_device_loc
@@ -142,3 +163,18 @@ pci_config_write(struct pci_device_loc loc, u32 off, u32 width, u32 val)
 
 struct pci_device *
 pci_get_object(struct pci_device_loc loc);
+
+struct pci_device *
+pci_find_device(u16 vendor_id, u16 device_id);
+
+int
+pci_get_mem_bar(struct pci_device_loc loc, u32 bar, u64 *paddr);
+
+u8
+pci_find_cap(struct pci_device_loc loc, u8 cap_id);
+
+int
+pci_enable_msi(struct pci_device *dev, struct irq_handler_node *n);
+
+void
+pci_disable_msi(struct pci_device *dev);
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#pragma once
+#include <tilck_gen_headers/mod_profiler.h>
+#include <tilck/common/basic_defs.h>
+#include <tilck/kernel/hal.h>
+
+extern bool __prof_running;
+
+void prof_take_sample(regs_t *r);
+
+/*
+ * Called by the arch IRQ code on every timer IRQ, before re-enabling the
+ * interrupts. `r` is the interrupted context.
+ */
+static ALWAYS_INLINE void
+prof_timer_irq(regs_t *r)
+{
+   if (MOD_profiler && UNLIKELY(__prof_running))
+      prof_take_sample(r);
+}
@@ -4,15 +4,30 @@
 #include <tilck_gen_headers/mod_serial.h>
 #include <tilck/common/basic_defs.h>
 
+/* Size of the RX and TX FIFOs of the 16550 UART */
+#define SERIAL_RX_FIFO_SIZE                  16
+#define SERIAL_TX_FIFO_SIZE                  16
+
 void init_serial_port(u16 port);
 
 bool serial_read_ready(u16 port);
 void serial_wait_for_read(u16 port);
 char serial_read(u16 port);
+size_t serial_read_fifo(u16 port, char *buf, size_t len, bool *overrun);
 
 bool serial_write_ready(u16 port);
 void serial_wait_for_write(u16 port);
 void serial_write(u16 port, char c);
+void serial_write_fifo(u16 port, const char *buf, size_t len);
+void serial_set_tx_intr(u16 port, bool enabled);
+
+/*
+ * Buffered write: the data is copied in the TX ring of the serial device and
+ * then sent by the IRQ handler, in bursts of SERIAL_TX_FIFO_SIZE bytes. Blocks
+ * only when the ring is full. Falls back to polling when sleeping is not
+ * possible (panic, early boot etc.).
+ */
+void serial_write_buf(u16 port, const char *buf, size_t len);
 
 #if MOD_serial
    void early_init_serial_ports(void);
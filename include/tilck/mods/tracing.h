@@ -192,6 +192,18 @@ trace_signal_delivered_int(int target_tid, int signum);
 void
 trace_task_killed_int(int signum);
 
+void
+init_trace_ring(void);
+
+void
+trace_ring_sys_event(enum trace_event_type type,
+                     u32 sys,
+                     long retval,
+                     const ulong args[6]);
+
+void
+trace_ring_signal_event(enum trace_event_type type, int tid, int signum);
+
 const char *
 tracing_get_syscall_name(u32 n);
 
@@ -279,6 +291,18 @@ tracing_is_enabled(void)
    return __tracing_on;
 }
 
+/*
+ * True while a consumer has /dev/trace open. In that case, syscall and signal
+ * events are written only to the binary trace ring, skipping the expensive
+ * saving of the syscall parameters done for the text trace buffer.
+ */
+static ALWAYS_INLINE bool
+trace_ring_is_active(void)
+{
+   extern bool __trace_ring_on;
+   return __trace_ring_on;
+}
+
 static ALWAYS_INLINE bool
 trace_printk_is_enabled(void)
 {
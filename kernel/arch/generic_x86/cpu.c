@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <tilck_gen_headers/config_mm.h>
+#include <tilck_gen_headers/config_kernel.h>
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/printk.h>
@@ -114,7 +115,7 @@ static bool enable_avx(void)
    return true;
 }
 
-void init_pat(void)
+static void set_pat_entries(void)
 {
    u64 pat = rdmsr(MSR_IA32_PAT);
    u8 *entries = (u8 *)&pat;
@@ -122,6 +123,11 @@ void init_pat(void)
    entries[7] = MEM_TYPE_WC;
 
    wrmsr(MSR_IA32_PAT, pat);
+}
+
+void init_pat(void)
+{
+   set_pat_entries();
    printk("CPU: PAT initialized\n");
 }
 
@@ -180,6 +186,31 @@ out:
    printk("CPU: Physical addr bits: %u\n", x86_cpu_features.phys_addr_bits);
 }
 
+#if KRN_SMP
+
+/*
+ * Enable on the current AP the features enabled on the BSP by
+ * enable_cpu_features(), assuming that all the CPUs are the same. Faults are
+ * not expected here: the same steps already succeeded on the BSP.
+ */
+void enable_cpu_features_on_ap(void)
+{
+   if (x86_cpu_features.can_use_sse)
+      asm_enable_sse();
+
+   if (x86_cpu_features.can_use_avx) {
+      asm_enable_osxsave();
+      asm_enable_avx();
+   }
+
+   hw_fpu_disable();
+
+   if (x86_cpu_features.edx1.pat)
+      set_pat_entries();
+}
+
+#endif
+
 static char fpu_kernel_regs[CPU_XSAVE_AREA_SIZE] ALIGNED_AT(64);
 
 void save_current_fpu_regs(bool in_kernel)
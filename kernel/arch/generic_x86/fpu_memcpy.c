@@ -40,6 +40,25 @@ memcpy_single_256_failsafe(void *dest, const void *src)
    memcpy32(dest, src, 8);
 }
 
+const char *fpu_glyph_kernels;
+static const struct fpu_glyph_colors *failsafe_glyph_colors;
+
+FASTCALL void
+fpu_glyph_load_colors_failsafe(const struct fpu_glyph_colors *c)
+{
+   failsafe_glyph_colors = c;
+}
+
+FASTCALL void
+fpu_glyph_expand_8px_failsafe(void *dest, u32 bits)
+{
+   const struct fpu_glyph_colors *c = failsafe_glyph_colors;
+   u32 *pixels = dest;
+
+   for (u32 i = 0; i < 8; i++)
+      pixels[i] = (bits & c->masks[i]) ? c->fg[i] : c->bg[i];
+}
+
 /* 'n' is the number of 32-byte (256-bit) data packets to copy */
 void fpu_memcpy256_nt_avx2(void *dest, const void *src, u32 n)
 {
@@ -196,6 +215,34 @@ static void *get_fpu_cpy_single_256_nt_read_func(void)
    return IS_RELEASE_BUILD ? &memcpy_single_256_failsafe : NULL;
 }
 
+/*
+ * The glyph kernels keep their state in the SIMD registers between calls,
+ * therefore the load_colors and expand funcs must always belong to the same
+ * variant: select both of them at once.
+ */
+static bool get_fpu_glyph_funcs(void **load_colors, void **expand)
+{
+   if (kopt_no_fpu_memcpy)
+      return false;
+
+   if (x86_cpu_features.can_use_avx2) {
+      *load_colors = &fpu_glyph_load_colors_avx2;
+      *expand = &fpu_glyph_expand_8px_nt_avx2;
+      fpu_glyph_kernels = "avx2";
+      return true;
+   }
+
+   if (x86_cpu_features.can_use_sse2) {
+      *load_colors = &fpu_glyph_load_colors_sse2;
+      *expand = &fpu_glyph_expand_8px_nt_sse2;
+      fpu_glyph_kernels = "sse2";
+      return true;
+   }
+
+   /* No integer SIMD before SSE2: keep the failsafe funcs */
+   return false;
+}
+
 static void
 simple_hot_patch(void *dest, void *func, size_t max_size)
 {
@@ -217,7 +264,7 @@ simple_hot_patch(void *dest, void *func, size_t max_size)
 
 void init_fpu_memcpy(void)
 {
-   void *func;
+   void *func, *func2;
 
    if (kopt_no_fpu_memcpy) {
 
@@ -260,4 +307,9 @@ void init_fpu_memcpy(void)
    if ((func = get_fpu_cpy_single_256_nt_read_func())) {
       simple_hot_patch(&__asm_fpu_cpy_single_256_nt_read, func, 128);
    }
+
+   if (get_fpu_glyph_funcs(&func, &func2)) {
+      simple_hot_patch(&__asm_fpu_glyph_load_colors, func, 128);
+      simple_hot_patch(&__asm_fpu_glyph_expand_8px_nt, func2, 128);
+   }
 }
@@ -0,0 +1,184 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+#include <tilck/kernel/arch/generic_x86/ioapic.h>
+
+/*
+ * IOAPIC support.
+ *
+ * Tilck keeps receiving the legacy ISA IRQs through the 8259 PIC, so here we
+ * don't touch any redirection entry we haven't been asked to route: the
+ * firmware leaves them masked, unless it uses one of them for the virtual wire
+ * mode. Drivers knowing the GSI of their device can route it to a dedicated
+ * vector (see irq_alloc_vector()) with ioapic_route_gsi().
+ */
+
+struct ioapic {
+
+   ulong paddr;
+   volatile u32 *regs;
+   u32 gsi_base;
+   u32 gsi_count;
+   u8 id;
+};
+
+struct isa_irq_override {
+   u32 gsi;
+   u32 flags;
+};
+
+static struct ioapic ioapics[IOAPIC_MAX_COUNT];
+static int ioapics_count;
+static struct isa_irq_override isa_overrides[16];
+static bool isa_overrides_init;
+
+static void init_isa_overrides_if_necessary(void)
+{
+   if (isa_overrides_init)
+      return;
+
+   for (u32 i = 0; i < ARRAY_SIZE(isa_overrides); i++)
+      isa_overrides[i] = (struct isa_irq_override) { .gsi = i, .flags = 0 };
+
+   isa_overrides_init = true;
+}
+
+void ioapic_add(u8 id, ulong paddr, u32 gsi_base)
+{
+   if (ioapics_count == IOAPIC_MAX_COUNT) {
+      printk("IOAPIC: ignoring IOAPIC %u: too many IOAPICs\n", id);
+      return;
+   }
+
+   ioapics[ioapics_count++] = (struct ioapic) {
+      .paddr = paddr,
+      .gsi_base = gsi_base,
+      .id = id,
+   };
+}
+
+void ioapic_add_isa_override(u8 isa_irq, u32 gsi, u32 flags)
+{
+   init_isa_overrides_if_necessary();
+
+   if (isa_irq < ARRAY_SIZE(isa_overrides))
+      isa_overrides[isa_irq] = (struct isa_irq_override) { gsi, flags };
+}
+
+u32 ioapic_isa_irq_to_gsi(u8 isa_irq, u32 *flags)
+{
+   ASSERT(isa_irq < ARRAY_SIZE(isa_overrides));
+   init_isa_overrides_if_necessary();
+
+   *flags = isa_overrides[isa_irq].flags;
+   return isa_overrides[isa_irq].gsi;
+}
+
+static u32 ioapic_read(struct ioapic *io, u32 reg)
+{
+   io->regs[IOAPIC_IOREGSEL / sizeof(u32)] = reg;
+   return io->regs[IOAPIC_IOWIN / sizeof(u32)];
+}
+
+static void ioapic_write(struct ioapic *io, u32 reg, u32 val)
+{
+   io->regs[IOAPIC_IOREGSEL / sizeof(u32)] = reg;
+   io->regs[IOAPIC_IOWIN / sizeof(u32)] = val;
+}
+
+static struct ioapic *ioapic_get_by_gsi(u32 gsi)
+{
+   for (int i = 0; i < ioapics_count; i++) {
+
+      struct ioapic *io = &ioapics[i];
+
+      if (io->regs && IN_RANGE(gsi, io->gsi_base, io->gsi_base+io->gsi_count))
+         return io;
+   }
+
+   return NULL;
+}
+
+/* Map the registers of the IOAPICs found by the ACPI module in the MADT */
+void init_ioapics(void)
+{
+   void *va;
+
+   for (int i = 0; i < ioapics_count; i++) {
+
+      struct ioapic *io = &ioapics[i];
+
+      if (!(va = hi_vmem_reserve(PAGE_SIZE)))
+         panic("IOAPIC: unable to reserve hi vmem");
+
+      if (map_kernel_page(va, io->paddr, PAGING_FL_RW | PAGING_FL_SHARED))
+         panic("IOAPIC: unable to map the registers");
+
+      io->regs = va;
+      io->gsi_count = ((ioapic_read(io, IOAPIC_REG_VER) >> 16) & 0xff) + 1;
+
+      printk("IOAPIC: id: %u, paddr: %p, GSIs: %u-%u\n",
+             io->id,
+             TO_PTR(io->paddr),
+             io->gsi_base,
+             io->gsi_base + io->gsi_count - 1);
+   }
+}
+
+/*
+ * Route the given GSI to `vector` on the LAPIC of the current CPU (the BSP)
+ * and unmask it.
+ */
+int ioapic_route_gsi(u32 gsi, int vector, u32 flags)
+{
+   struct ioapic *io = ioapic_get_by_gsi(gsi);
+   u32 reg, lo = (u32)vector;
+   ulong var;
+
+   if (!io || !lapic_is_available())
+      return -ENODEV;
+
+   if (flags & IOAPIC_FL_ACTIVE_LOW)
+      lo |= IOAPIC_RED_ACTIVE_LOW;
+
+   if (flags & IOAPIC_FL_LEVEL)
+      lo |= IOAPIC_RED_LEVEL;
+
+   reg = IOAPIC_REG_REDTBL + 2 * (gsi - io->gsi_base);
+   lapic_enable();
+
+   disable_interrupts(&var);
+   {
+      /* Physical destination mode, fixed delivery mode */
+      ioapic_write(io, reg, IOAPIC_RED_MASKED);
+      ioapic_write(io, reg + 1, lapic_get_id() << 24);
+      ioapic_write(io, reg, lo);
+   }
+   enable_interrupts(&var);
+   return 0;
+}
+
+int ioapic_mask_gsi(u32 gsi)
+{
+   struct ioapic *io = ioapic_get_by_gsi(gsi);
+   u32 reg;
+   ulong var;
+
+   if (!io)
+      return -ENODEV;
+
+   reg = IOAPIC_REG_REDTBL + 2 * (gsi - io->gsi_base);
+
+   disable_interrupts(&var);
+   {
+      ioapic_write(io, reg, ioapic_read(io, reg) | IOAPIC_RED_MASKED);
+   }
+   enable_interrupts(&var);
+   return 0;
+}
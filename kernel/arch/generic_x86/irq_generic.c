@@ -7,10 +7,14 @@
 
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/irq.h>
+#include <tilck/kernel/errno.h>
 #include <tilck/kernel/term.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+
+#include <tilck/mods/profiler.h>
 
 #include "pic.h"
 
@@ -33,6 +37,9 @@ struct list irq_handlers_lists[16] = {
    STATIC_LIST_INIT(irq_handlers_lists[15]),
 };
 
+/* Handlers of the dynamic vectors (IRQ_DYN_VECTOR_BASE + index) */
+static struct irq_handler_node *dyn_vectors[IRQ_DYN_VECTORS_COUNT];
+
 u32 unhandled_irq_count[256];
 u32 spur_irq_count;
 
@@ -64,6 +71,74 @@ void irq_uninstall_handler(u8 irq, struct irq_handler_node *n)
    enable_interrupts(&var);
 }
 
+int irq_alloc_vector(struct irq_handler_node *n)
+{
+   int vec = -ENOSPC;
+   ulong var;
+
+   if (!lapic_is_available())
+      return -ENODEV;
+
+   lapic_enable();
+   disable_interrupts(&var);
+   {
+      for (int i = 0; i < IRQ_DYN_VECTORS_COUNT; i++) {
+
+         if (!dyn_vectors[i]) {
+            dyn_vectors[i] = n;
+            vec = IRQ_DYN_VECTOR_BASE + i;
+            break;
+         }
+      }
+   }
+   enable_interrupts(&var);
+   return vec;
+}
+
+void irq_free_vector(int vector)
+{
+   const int i = vector - IRQ_DYN_VECTOR_BASE;
+   ulong var;
+
+   ASSERT(IN_RANGE(i, 0, IRQ_DYN_VECTORS_COUNT));
+   disable_interrupts(&var);
+   {
+      dyn_vectors[i] = NULL;
+   }
+   enable_interrupts(&var);
+}
+
+static ALWAYS_INLINE bool is_dyn_vector(int int_num)
+{
+   return IN_RANGE(int_num,
+                   IRQ_DYN_VECTOR_BASE,
+                   IRQ_DYN_VECTOR_BASE + IRQ_DYN_VECTORS_COUNT);
+}
+
+/*
+ * A dynamic vector has a single handler: no list to walk. There's no need to
+ * mask anything either: until the EOI, the LAPIC blocks all the vectors in the
+ * same (or a lower) priority class, while the higher ones can nest.
+ */
+static void handle_dyn_vector(regs_t *r)
+{
+   struct irq_handler_node *n = dyn_vectors[r->int_num - IRQ_DYN_VECTOR_BASE];
+   enum irq_action hret = IRQ_NOT_HANDLED;
+
+   push_nested_interrupt(r->int_num);
+   enable_interrupts_forced();
+   {
+      if (n)
+         hret = n->handler(n->context);
+
+      if (hret == IRQ_NOT_HANDLED)
+         unhandled_irq_count[int_to_irq(r->int_num)]++;
+   }
+   disable_interrupts_forced();
+   lapic_send_eoi();
+   pop_nested_interrupt();
+}
+
 static inline void handle_irq_set_mask_and_eoi(int irq)
 {
    if (KRN_TRACK_NESTED_INTERR) {
@@ -105,11 +180,28 @@ void arch_irq_handling(regs_t *r)
    ASSERT(!are_interrupts_enabled());
    ASSERT(!is_preemption_enabled());
 
+   if (r->int_num == LAPIC_TIMER_VECTOR) {
+
+      /* Not a PIC IRQ: handle it with interrupts disabled, no handler lists */
+      push_nested_interrupt(r->int_num);
+      lapic_timer_irq_handler();
+      pop_nested_interrupt();
+      return;
+   }
+
+   if (is_dyn_vector(r->int_num)) {
+      handle_dyn_vector(r);
+      return;
+   }
+
    if (pic_is_spur_irq(irq)) {
       spur_irq_count++;
       return;
    }
 
+   if (irq == X86_PC_TIMER_IRQ)
+      prof_timer_irq(r);
+
    push_nested_interrupt(r->int_num);
    handle_irq_set_mask_and_eoi(irq);
    enable_interrupts_forced();
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/arch/generic_x86/cpu_features.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+
+/* Max number of polling iterations waiting for an IPI to be delivered */
+#define LAPIC_IPI_MAX_POLLS                          (1000 * 1000)
+
+volatile u32 *lapic_regs;
+static ulong lapic_paddr;
+static bool lapic_enabled;
+
+/*
+ * Called by the ACPI module when parsing the MADT table, which contains the
+ * actual physical address of the LAPIC registers.
+ */
+void lapic_set_paddr(ulong paddr)
+{
+   lapic_paddr = paddr;
+}
+
+/*
+ * Map the registers of the LAPIC. Note: we don't software-enable the LAPIC nor
+ * touch its LVT entries here: Tilck still receives the legacy interrupts
+ * through the 8259 PIC. Sending IPIs works anyway. The LAPIC gets enabled only
+ * when its timer or a dynamic vector is used, see lapic_enable().
+ *
+ * The MMIO page is not mapped with the CD bit set: the firmware always covers
+ * the LAPIC range with an uncacheable MTRR.
+ */
+void init_lapic(void)
+{
+   u64 apic_base;
+   void *va;
+
+   if (!x86_cpu_features.edx1.apic || !x86_cpu_features.edx1.msr) {
+      printk("LAPIC: not available\n");
+      return;
+   }
+
+   apic_base = rdmsr(MSR_IA32_APIC_BASE);
+
+   if (!(apic_base & APIC_BASE_ENABLE)) {
+      printk("LAPIC: disabled by the firmware\n");
+      return;
+   }
+
+   if (!lapic_paddr)
+      lapic_paddr = (ulong)(apic_base & APIC_BASE_ADDR_MASK);
+
+   if (!(va = hi_vmem_reserve(PAGE_SIZE)))
+      panic("LAPIC: unable to reserve hi vmem");
+
+   if (map_kernel_page(va, lapic_paddr, PAGING_FL_RW | PAGING_FL_SHARED))
+      panic("LAPIC: unable to map the registers");
+
+   lapic_regs = va;
+   printk("LAPIC: paddr: %p, id: %u, version: %#x\n",
+          TO_PTR(lapic_paddr),
+          lapic_get_id(),
+          lapic_read(LAPIC_VERSION) & 0xff);
+}
+
+/*
+ * Software-enable the LAPIC in the "virtual wire" mode: the legacy 8259 PIC
+ * keeps delivering the external interrupts through LINT0, as ExtINT. Calling
+ * this function more than once is harmless.
+ */
+void lapic_enable(void)
+{
+   ulong var;
+   ASSERT(lapic_is_available());
+
+   disable_interrupts(&var);
+   {
+      if (!lapic_enabled) {
+         lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+         lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_EXTINT);
+         lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_NMI);
+         lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+         lapic_write(LAPIC_TPR, 0);
+         lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+         lapic_enabled = true;
+      }
+   }
+   enable_interrupts(&var);
+}
+
+/*
+ * Software-enable the LAPIC of an AP. Unlike the BSP, the APs don't receive
+ * the external interrupts through LINT0: the PIC is connected only to the BSP.
+ * Therefore, they get only the IPIs and the MSIs.
+ */
+void lapic_enable_ap(void)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+   lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+   lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+   lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+   lapic_write(LAPIC_TPR, 0);
+   lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+}
+
+/*
+ * Send an IPI to the LAPIC with the given ID and wait for it to be accepted.
+ * The `icr_flags` contain the delivery mode, the vector and the other flags
+ * of the low 32 bits of the ICR register.
+ */
+int lapic_send_ipi(u32 apic_id, u32 icr_flags)
+{
+   ulong var;
+   int rc = -ETIMEDOUT;
+
+   ASSERT(lapic_is_available());
+   disable_interrupts(&var);
+   {
+      lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+      lapic_write(LAPIC_ICR_LOW, icr_flags);
+
+      for (int i = 0; i < LAPIC_IPI_MAX_POLLS; i++) {
+
+         if (!(lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)) {
+            rc = 0;
+            break;
+         }
+
+         cpu_relax();
+      }
+   }
+   enable_interrupts(&var);
+   return rc;
+}
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_kernel.h>
+#include <tilck_gen_headers/config_sched.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/hrtimer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+
+/*
+ * One-shot hrtimer backend based on the LAPIC timer.
+ *
+ * The timer is calibrated against the PIT, during the same window used by
+ * timer.c to measure the bogoMips and calibrate the TSC. Only after that, it
+ * gets registered as hrtimer backend. The PIT keeps running anyway: it still
+ * drives the scheduler ticks and the system time.
+ */
+
+extern u32 __tick_duration;
+
+/* Max delta programmed at once: longer timers just cause an extra IRQ */
+#define LAPIC_TIMER_MAX_DELTA                        (TS_SCALE / 10)
+
+static bool lapic_timer_enabled;
+static u32 lapic_timer_cnt_per_tick;
+
+static void lapic_timer_program(u64 delta)
+{
+   u64 cnt;
+
+   delta = MIN(delta, (u64)LAPIC_TIMER_MAX_DELTA);
+   cnt = delta * lapic_timer_cnt_per_tick / __tick_duration;
+
+   lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR | LAPIC_LVT_TIMER_ONESHOT);
+   lapic_write(LAPIC_TIMER_INIT_CNT, (u32)CLAMP(cnt, 1u, UINT32_MAX));
+}
+
+static void lapic_timer_stop(void)
+{
+   lapic_write(LAPIC_TIMER_INIT_CNT, 0);
+}
+
+static const struct hrtimer_backend lapic_hrtimer_backend = {
+   .name = "lapic",
+   .program = &lapic_timer_program,
+   .stop = &lapic_timer_stop,
+};
+
+void init_lapic_timer(void)
+{
+   if (!KRN_LAPIC_TIMER || !lapic_is_available())
+      return;
+
+   lapic_enable();
+   lapic_timer_enabled = true;
+}
+
+void lapic_timer_irq_handler(void)
+{
+   lapic_send_eoi();
+   hrtimer_run_expired();
+}
+
+/*
+ * Called by timer.c on the first tick of the calibration window: let the LAPIC
+ * timer count down from its max value, with its interrupt masked.
+ */
+void hw_hrtimer_calib_begin(void)
+{
+   if (!lapic_timer_enabled)
+      return;
+
+   lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+   lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR);
+   lapic_write(LAPIC_TIMER_INIT_CNT, UINT32_MAX);
+}
+
+/*
+ * Called by timer.c with the interrupts disabled, `ticks` ticks after
+ * hw_hrtimer_calib_begin().
+ */
+void hw_hrtimer_calib_end(u32 ticks)
+{
+   u32 elapsed;
+
+   if (!lapic_timer_enabled)
+      return;
+
+   elapsed = UINT32_MAX - lapic_read(LAPIC_TIMER_CURR_CNT);
+   lapic_write(LAPIC_TIMER_INIT_CNT, 0);
+   lapic_timer_cnt_per_tick = elapsed / ticks;
+
+   if (lapic_timer_cnt_per_tick < 1000) {
+      printk("LAPIC timer: calibration failed (cnt/tick: %u)\n",
+             lapic_timer_cnt_per_tick);
+      return;
+   }
+
+   printk("LAPIC timer: %u KHz\n",
+          (u32)((u64)lapic_timer_cnt_per_tick * TIMER_HZ / 1000));
+
+   hrtimer_set_backend(&lapic_hrtimer_backend);
+}
@@ -60,12 +60,14 @@ void release_pageframes_mapped_at(pdir_t *pdir, void *vaddrp, size_t len)
 void invalidate_page(ulong vaddr)
 {
    invalidate_page_hw(vaddr);
+   smp_tlb_shootdown(vaddr);
 }
 
 void init_paging(void)
 {
    int rc;
    void *user_vdso_vaddr;
+   void *user_vvar_vaddr;
    size_t pagesframes_refcount_bufsize;
 
    phys_mem_lim = (ulong)MIN(get_phys_mem_size(),
@@ -114,6 +116,23 @@ void init_paging(void)
 
    if (rc < 0)
       panic("Unable to map the vdso-like page");
+
+   /*
+    * Map the vvar page, right after the vdso, read-only for the userspace. It
+    * contains the data used by the vdso functions like __vdso_clock_gettime().
+    */
+   user_vvar_vaddr = hi_vmem_reserve(PAGE_SIZE);
+
+   if (user_vvar_vaddr != (void *)USER_VVAR_VADDR)
+      panic("user_vvar_vaddr != USER_VVAR_VADDR");
+
+   rc = map_page(get_kernel_pdir(),
+                 user_vvar_vaddr,
+                 KERNEL_VA_TO_PA(&vvar_page),
+                 PAGING_FL_US);
+
+   if (rc < 0)
+      panic("Unable to map the vvar page");
 }
 
 void *
@@ -180,6 +180,7 @@ NORETURN void panic(const char *fmt, ...)
 
    __in_panic = true;
    first_in_panic_double_fault = __in_double_fault;
+   smp_stop_other_cpus();
 
    va_start(args, fmt);
 
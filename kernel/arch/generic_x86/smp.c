@@ -0,0 +1,552 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_kernel.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+#include <tilck/common/atomics.h>
+
+#include <tilck/kernel/smp.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/paging_hw.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/irq.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+
+#if KRN_SMP
+
+/* Max time to wait for an AP to come online after the STARTUP IPIs */
+#define AP_STARTUP_TIMEOUT_MS                   100
+
+struct ap_tramp_data {
+
+   u32 cr3;
+   u32 stack;
+   u32 entry;
+   u32 cpu_idx;
+};
+
+struct desc_table_ptr {
+
+   u16 size_minus_one;
+   u32 addr;
+
+} PACKED;
+
+extern char ap_trampoline[];
+extern char ap_trampoline_end[];
+extern struct ap_tramp_data ap_tramp_data;
+
+void gdt_init_on_ap(u32 cpu);
+void enable_cpu_features_on_ap(void);
+void init_sysenter_on_this_cpu(void);
+
+/* The BSP boots with the preemption disabled, like without KRN_SMP */
+struct cpu_info cpus[MAX_CPUS] = {
+   [0] = { .disable_preempt = 1 },
+};
+
+#else
+
+struct cpu_info cpus[MAX_CPUS];
+
+#endif
+
+u32 cpus_count;
+
+void smp_add_cpu(u32 hw_id)
+{
+   if (cpus_count == MAX_CPUS) {
+      printk("SMP: ignoring CPU with id %u: MAX_CPUS reached\n", hw_id);
+      return;
+   }
+
+   cpus[cpus_count++].hw_id = hw_id;
+}
+
+u32 get_online_cpus_count(void)
+{
+   u32 count = 0;
+
+   for (u32 i = 0; i < cpus_count; i++)
+      if (cpus[i].online)
+         count++;
+
+   return count;
+}
+
+#if KRN_SMP
+
+/*
+ * The big kernel lock: index of the CPU owning it or -1. It's not a counter,
+ * just an owner: see bkl_lock(). The BSP owns it since the boot.
+ */
+static ATOMIC(int) bkl_owner;
+
+/*
+ * Cross-CPU calls: a single slot is enough, because only the owner of the BKL
+ * can make such calls. `call_pending` is the mask of the CPUs which still have
+ * to run `call_func`.
+ */
+static void (*volatile call_func)(void *);
+static void *volatile call_arg;
+static ATOMIC(u32) call_pending;
+static volatile bool stop_requested;
+
+static int call_vector = -1;
+static int resched_vector = -1;
+static int tick_vector = -1;
+
+static struct desc_table_ptr bsp_idtr;
+
+static void smp_run_pending_call(void)
+{
+   const u32 bit = 1u << get_this_cpu_idx();
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (UNLIKELY(stop_requested)) {
+      while (true)
+         halt();
+   }
+
+   if (atomic_load_explicit(&call_pending, mo_acquire) & bit) {
+      call_func(call_arg);
+      atomic_fetch_and_explicit(&call_pending, ~bit, mo_release);
+   }
+}
+
+/*
+ * Acquire the BKL, unless the current CPU already owns it. In that case,
+ * return false: the caller must NOT release it. Interrupts must be disabled.
+ *
+ * While spinning, run the cross-CPU calls: the owner of the BKL might be
+ * waiting for us to do that, with the interrupts disabled.
+ */
+bool bkl_lock(void)
+{
+   const int me = (int)get_this_cpu_idx();
+   int exp;
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (atomic_load_explicit(&bkl_owner, mo_relaxed) == me)
+      return false;
+
+   while (true) {
+
+      exp = -1;
+
+      if (atomic_cas_weak(&bkl_owner, &exp, me, mo_acquire, mo_relaxed))
+         break;
+
+      smp_run_pending_call();
+      cpu_relax();
+   }
+
+   return true;
+}
+
+void bkl_unlock(void)
+{
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(bkl_is_owned());
+   ASSERT(get_this_cpu()->in_irq_count == 0);
+
+   atomic_store_explicit(&bkl_owner, -1, mo_release);
+}
+
+bool bkl_is_owned(void)
+{
+   const int me = (int)get_this_cpu_idx();
+   return atomic_load_explicit(&bkl_owner, mo_relaxed) == me;
+}
+
+/*
+ * Called by context_switch() once on the stack of the new task: release the
+ * BKL if the task is going back to user space. Doing that earlier would allow
+ * other CPUs to resume the previous task while we're still on its stack.
+ */
+void smp_on_context_switch(void)
+{
+   struct cpu_info *c = get_this_cpu();
+
+   if (c->bkl_drop_on_switch) {
+      c->bkl_drop_on_switch = false;
+      bkl_unlock();
+   }
+}
+
+/* Halt in the idle task, without holding the BKL meanwhile */
+void smp_idle_halt(void)
+{
+   disable_interrupts_forced();
+   bkl_unlock();
+
+   /* The interrupts get enabled after `sti`'s next instruction: no races */
+   asmVolatile("sti\n\t"
+               "hlt\n\t"
+               : /* no output */
+               : /* no input */
+               : "memory");
+
+   disable_interrupts_forced();
+   bkl_lock();
+   enable_interrupts_forced();
+}
+
+static void smp_send_ipi(u32 cpu, int vector)
+{
+   if (lapic_send_ipi(cpus[cpu].hw_id, LAPIC_ICR_FIXED | (u32)vector))
+      printk("SMP: IPI %d to CPU %u not accepted\n", vector, cpus[cpu].hw_id);
+}
+
+bool smp_handle_call_ipi(int int_num)
+{
+   if (int_num != call_vector)
+      return false;
+
+   /* Note: the call might have been already run while in bkl_lock() */
+   smp_run_pending_call();
+   lapic_send_eoi();
+   return true;
+}
+
+/*
+ * Run `func(arg)` on all the other online CPUs and wait for them. The caller
+ * must own the BKL. The other CPUs run `func` with interrupts disabled, either
+ * in the IPI handler, or while spinning in bkl_lock().
+ */
+void smp_call_on_others(void (*func)(void *), void *arg)
+{
+   u32 mask = 0;
+   u32 me;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      ASSERT(bkl_is_owned());
+      me = get_this_cpu_idx();
+
+      for (u32 i = 0; i < cpus_count; i++)
+         if (i != me && cpus[i].online)
+            mask |= 1u << i;
+
+      if (mask) {
+
+         call_func = func;
+         call_arg = arg;
+         atomic_store_explicit(&call_pending, mask, mo_release);
+
+         for (u32 i = 0; i < cpus_count; i++)
+            if (mask & (1u << i))
+               smp_send_ipi(i, call_vector);
+
+         while (atomic_load_explicit(&call_pending, mo_acquire))
+            cpu_relax();
+      }
+   }
+   enable_interrupts(&var);
+}
+
+/* Make the given CPU call the scheduler, at the end of the IPI handler */
+void smp_send_resched(u32 cpu)
+{
+   ASSERT(cpu != get_this_cpu_idx());
+   atomic_store_explicit(&cpus[cpu].need_resched, 1, mo_relaxed);
+   smp_send_ipi(cpu, resched_vector);
+}
+
+/*
+ * Only the BSP receives the timer IRQ: forward the tick to the other CPUs, in
+ * order to account their time and, when idle, let them steal work.
+ */
+void smp_broadcast_tick(void)
+{
+   const u32 me = get_this_cpu_idx();
+
+   if (tick_vector < 0)
+      return;
+
+   for (u32 i = 0; i < cpus_count; i++)
+      if (i != me && cpus[i].online)
+         smp_send_ipi(i, tick_vector);
+}
+
+static void smp_invlpg_func(void *arg)
+{
+   invalidate_page_hw((ulong)arg);
+}
+
+static void smp_flush_tlb_func(void *arg)
+{
+   __set_curr_pdir(__get_curr_pdir());
+}
+
+static void smp_release_pdir_func(void *arg)
+{
+   if (get_curr_pdir() == arg)
+      set_curr_pdir(get_kernel_pdir());
+}
+
+static bool smp_have_other_cpus(void)
+{
+   return get_online_cpus_count() > 1;
+}
+
+void smp_tlb_shootdown(ulong vaddr)
+{
+   if (smp_have_other_cpus())
+      smp_call_on_others(&smp_invlpg_func, TO_PTR(vaddr));
+}
+
+void smp_flush_tlb_others(void)
+{
+   if (smp_have_other_cpus())
+      smp_call_on_others(&smp_flush_tlb_func, NULL);
+}
+
+void smp_release_pdir(void *pdir)
+{
+   if (smp_have_other_cpus())
+      smp_call_on_others(&smp_release_pdir_func, pdir);
+}
+
+/* Called by panic(): halt the other CPUs, without waiting for them */
+void smp_stop_other_cpus(void)
+{
+   const u32 me = get_this_cpu_idx();
+
+   if (call_vector < 0)
+      return;
+
+   stop_requested = true;
+
+   for (u32 i = 0; i < cpus_count; i++)
+      if (i != me && cpus[i].online)
+         lapic_send_ipi(cpus[i].hw_id, LAPIC_ICR_FIXED | (u32)call_vector);
+}
+
+static enum irq_action smp_nop_ipi_handler(void *ctx)
+{
+   /* The reschedule IPI: need_resched is already set. See irq_entry() */
+   return IRQ_HANDLED;
+}
+
+static enum irq_action smp_tick_ipi_handler(void *ctx)
+{
+   sched_account_ticks();
+   return IRQ_HANDLED;
+}
+
+DEFINE_IRQ_HANDLER_NODE(call_ipi_node, smp_nop_ipi_handler, NULL);
+DEFINE_IRQ_HANDLER_NODE(resched_ipi_node, smp_nop_ipi_handler, NULL);
+DEFINE_IRQ_HANDLER_NODE(tick_ipi_node, smp_tick_ipi_handler, NULL);
+
+static bool smp_alloc_ipi_vectors(void)
+{
+   call_vector = irq_alloc_vector(&call_ipi_node);
+   resched_vector = irq_alloc_vector(&resched_ipi_node);
+   tick_vector = irq_alloc_vector(&tick_ipi_node);
+
+   if (call_vector < 0 || resched_vector < 0 || tick_vector < 0) {
+
+      printk("SMP: unable to allocate the IPI vectors\n");
+
+      if (call_vector >= 0)
+         irq_free_vector(call_vector);
+
+      if (resched_vector >= 0)
+         irq_free_vector(resched_vector);
+
+      if (tick_vector >= 0)
+         irq_free_vector(tick_vector);
+
+      call_vector = resched_vector = tick_vector = -1;
+      return false;
+   }
+
+   return true;
+}
+
+/*
+ * C entry point of the APs, called by the trampoline code with paging enabled,
+ * the stack allocated by the BSP and the AP's index in cpus[]. Everything done
+ * before setting `online` is per-CPU and runs while the BSP waits for us. Then,
+ * the AP joins the scheduling by running its idle task, like any other CPU.
+ */
+static NORETURN void smp_ap_entry(u32 idx)
+{
+   struct cpu_info *cpu = &cpus[idx];
+
+   asmVolatile("lidt (%0)" : : "r" (&bsp_idtr) : "memory");
+   gdt_init_on_ap(idx);
+   lapic_enable_ap();
+   enable_cpu_features_on_ap();
+   init_sysenter_on_this_cpu();
+
+   cpu->online = true;
+
+   bkl_lock();
+   switch_to_task(cpu->idle_task);
+}
+
+static bool smp_wait_for_ap(struct cpu_info *cpu, u32 timeout_ms)
+{
+   const u64 end = get_ticks() + MAX(1u, ms_to_ticks(timeout_ms));
+
+   while (!cpu->online && get_ticks() < end)
+      kernel_sleep(1);
+
+   return cpu->online;
+}
+
+static void smp_start_ap(u32 idx, struct ap_tramp_data *data)
+{
+   struct cpu_info *cpu = &cpus[idx];
+   const u32 init = LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL;
+   const u32 sipi = LAPIC_ICR_STARTUP | (AP_TRAMPOLINE_PADDR >> PAGE_SHIFT);
+
+   if (!(cpu->kernel_stack = kzmalloc(KERNEL_STACK_SIZE))) {
+      printk("SMP: no memory for the stack of CPU %u\n", cpu->hw_id);
+      return;
+   }
+
+   if (!sched_create_cpu_idle_task(idx)) {
+      printk("SMP: unable to create the idle task of CPU %u\n", cpu->hw_id);
+      kfree2(cpu->kernel_stack, KERNEL_STACK_SIZE);
+      cpu->kernel_stack = NULL;
+      return;
+   }
+
+   cpu->current = cpu->idle_task;
+   cpu->disable_preempt = 1;
+
+   /*
+    * Everything the AP reads must be in place before the first STARTUP IPI.
+    * The previous AP doesn't use the trampoline's data anymore: it either
+    * came online or got reset by us.
+    */
+   data->cr3 = (u32)LIN_VA_TO_PA(get_kernel_pdir());
+   data->stack = (u32)(ulong)cpu->kernel_stack + KERNEL_STACK_SIZE - 16;
+   data->entry = (u32)(ulong)&smp_ap_entry;
+   data->cpu_idx = idx;
+
+   /* The INIT-SIPI-SIPI sequence, as described in the Intel MP spec */
+   if (lapic_send_ipi(cpu->hw_id, init))
+      goto fail;
+
+   kernel_sleep_ms(10);
+
+   if (lapic_send_ipi(cpu->hw_id, sipi))
+      goto fail;
+
+   if (smp_wait_for_ap(cpu, 1))
+      return;
+
+   if (lapic_send_ipi(cpu->hw_id, sipi))
+      goto fail;
+
+   if (smp_wait_for_ap(cpu, AP_STARTUP_TIMEOUT_MS))
+      return;
+
+fail:
+   /*
+    * Put the AP back in the wait-for-SIPI state, so that it cannot come online
+    * later, using the resources we're going to free or the trampoline.
+    */
+   lapic_send_ipi(cpu->hw_id, init);
+   sched_drop_cpu_idle_task(idx);
+   kfree2(cpu->kernel_stack, KERNEL_STACK_SIZE);
+   cpu->kernel_stack = NULL;
+   printk("SMP: failed to start CPU %u\n", cpu->hw_id);
+}
+
+static void smp_start_all_aps(void)
+{
+   void *tramp = TO_PTR(AP_TRAMPOLINE_PADDR);
+   const size_t tramp_sz = (size_t)(ap_trampoline_end - ap_trampoline);
+   struct ap_tramp_data *data;
+
+   STATIC_ASSERT(AP_TRAMPOLINE_PADDR < 64 * KB);
+   STATIC_ASSERT((AP_TRAMPOLINE_PADDR & (PAGE_SIZE - 1)) == 0);
+   VERIFY(tramp_sz <= PAGE_SIZE);
+
+   if (!smp_alloc_ipi_vectors())
+      return;
+
+   /*
+    * Temporarily identity-map the trampoline's page in the kernel's page
+    * directory: the APs need that while they enable the paging.
+    */
+   if (is_mapped(get_kernel_pdir(), tramp)) {
+      printk("SMP: unable to map the trampoline: vaddr in use\n");
+      return;
+   }
+
+   if (map_kernel_page(tramp,
+                       AP_TRAMPOLINE_PADDR,
+                       PAGING_FL_RW | PAGING_FL_SHARED))
+   {
+      printk("SMP: unable to map the trampoline\n");
+      return;
+   }
+
+   memcpy(tramp, ap_trampoline, tramp_sz);
+   data = tramp + ((char *)&ap_tramp_data - ap_trampoline);
+
+   asmVolatile("sidt (%0)" : : "r" (&bsp_idtr) : "memory");
+
+   for (u32 i = 1; i < cpus_count; i++)
+      smp_start_ap(i, data);
+
+   /* Every AP is online or has been reset: nobody is using the trampoline */
+   unmap_kernel_page(tramp, false);
+}
+
+#endif // KRN_SMP
+
+void init_smp(void)
+{
+   u32 bsp_id;
+   bool bsp_found = false;
+
+   if (!lapic_is_available())
+      return;
+
+   bsp_id = lapic_get_id();
+
+   /* No MADT table: assume we're on a single-core machine */
+   if (!cpus_count)
+      smp_add_cpu(bsp_id);
+
+   /* The BSP is always cpus[0]: the per-CPU state of the boot is there */
+   for (u32 i = 0; i < cpus_count; i++) {
+      if (cpus[i].hw_id == bsp_id) {
+         cpus[i].hw_id = cpus[0].hw_id;
+         cpus[0].hw_id = bsp_id;
+         bsp_found = true;
+         break;
+      }
+   }
+
+   if (!bsp_found) {
+      printk("SMP: the BSP (id: %u) is not in the MADT. Ignore the APs\n",
+             bsp_id);
+      cpus[0].hw_id = bsp_id;
+      cpus_count = 1;
+   }
+
+   cpus[0].bsp = cpus[0].online = true;
+
+#if KRN_SMP
+   if (cpus_count > 1)
+      smp_start_all_aps();
+#endif
+
+   printk("SMP: CPUs: %u, online: %u\n", cpus_count, get_online_cpus_count());
+}
@@ -15,6 +15,7 @@
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/signal.h>
+#include <tilck/kernel/sys_stats.h>
 #include <tilck/mods/tracing.h>
 
 #include "idt_int.h"
@@ -545,6 +546,7 @@ static void do_special_syscall(regs_t *r)
    const bool signals = ~fl & SYSFL_NO_SIG;
    const bool preemptable = ~fl & SYSFL_NO_PREEMPT;
    const bool traceable = ~fl & SYSFL_NO_TRACE;
+   const u64 start = sys_stats_begin();
 
    if (signals)
       process_signals(curr, sig_pre_syscall, r);
@@ -563,6 +565,8 @@ static void do_special_syscall(regs_t *r)
    if (preemptable)
       disable_preemption();
 
+   sys_stats_end(sn, start);
+
    if (signals)
       process_signals(curr, sig_in_syscall, r);
 }
@@ -572,6 +576,7 @@ static void do_syscall(regs_t *r)
    struct task *curr = get_curr_task();
    const u32 sn = r->eax;
    const syscall_type fptr = syscalls[sn].fptr;
+   const u64 start = sys_stats_begin();
 
    process_signals(curr, sig_pre_syscall, r);
    enable_preemption();
@@ -581,6 +586,7 @@ static void do_syscall(regs_t *r)
       trace_sys_exit(sn,r->eax,r->ebx,r->ecx,r->edx,r->esi,r->edi,r->ebp);
    }
    disable_preemption();
+   sys_stats_end(sn, start);
    process_signals(curr, sig_in_syscall, r);
 }
 
@@ -614,6 +620,13 @@ void handle_syscall(regs_t *r)
    set_current_task_in_user_mode();
 }
 
+/* Setup the sysenter interface: the MSRs are per-CPU */
+void init_sysenter_on_this_cpu(void)
+{
+   wrmsr(MSR_IA32_SYSENTER_CS, X86_KERNEL_CODE_SEL);
+   wrmsr(MSR_IA32_SYSENTER_EIP, (ulong) &sysenter_entry);
+}
+
 void init_syscall_interfaces(void)
 {
    /* Set the entry for the int 0x80 syscall interface */
@@ -622,8 +635,6 @@ void init_syscall_interfaces(void)
                  X86_KERNEL_CODE_SEL,
                  IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE | IDT_FLAG_DPL3);
 
-   /* Setup the sysenter interface */
-   wrmsr(MSR_IA32_SYSENTER_CS, X86_KERNEL_CODE_SEL);
-   wrmsr(MSR_IA32_SYSENTER_EIP, (ulong) &sysenter_entry);
+   init_sysenter_on_this_cpu();
 }
 
@@ -14,7 +14,13 @@
 #include "gdt_int.h"
 #include "double_fault.h"
 
+#if KRN_SMP
+/* Make room for a TSS entry per CPU, see X86_CPU_TSS_GDT_BASE */
+static struct gdt_entry initial_gdt_in_bss[X86_CPU_TSS_GDT_BASE + MAX_CPUS + 3];
+#else
 static struct gdt_entry initial_gdt_in_bss[8];
+#endif
+
 static s32 initial_gdt_refcount_in_bss[ARRAY_SIZE(initial_gdt_in_bss)];
 
 static u32 gdt_size = ARRAY_SIZE(initial_gdt_in_bss);
@@ -44,6 +50,32 @@ static s32 *gdt_refcount = initial_gdt_refcount_in_bss;
 
 struct tss_entry tss_array[2] ALIGNED_AT(PAGE_SIZE);
 
+#if KRN_SMP
+
+/*
+ * With KRN_SMP, each AP needs its own TSS too, for its `esp0` and because the
+ * TSS descriptor gets marked as busy by `ltr`. The BSP uses tss_array[TSS_MAIN]
+ * instead. Note: all of them fit in a single page.
+ */
+static struct tss_entry ap_tss_array[MAX_CPUS - 1] ALIGNED_AT(PAGE_SIZE);
+STATIC_ASSERT(sizeof(ap_tss_array) <= PAGE_SIZE);
+
+bool x86_cpu_tss_loaded;
+
+static ALWAYS_INLINE struct tss_entry *get_cpu_tss(u32 cpu)
+{
+   return cpu ? &ap_tss_array[cpu - 1] : &tss_array[TSS_MAIN];
+}
+
+#else
+
+static ALWAYS_INLINE struct tss_entry *get_cpu_tss(u32 cpu)
+{
+   return &tss_array[TSS_MAIN];
+}
+
+#endif
+
 static void load_gdt(struct gdt_entry *gdt, u32 entries_count);
 
 
@@ -179,6 +211,9 @@ static NODISCARD int gdt_expand(void)
          load_gdt(new_gdt, new_size);
       }
       enable_interrupts_forced();
+
+      /* The other CPUs must stop using the old GDT before we free it */
+      smp_reload_gdt_on_others();
    }
    enable_preemption();
 
@@ -229,9 +264,11 @@ void set_kernel_stack(ulong stack)
    ulong var;
    disable_interrupts(&var);
    {
+      struct tss_entry *tss = get_cpu_tss(get_this_cpu_idx());
+
       /* Kernel stack segment = data seg */
-      tss_array[TSS_MAIN].ss0 = X86_KERNEL_DATA_SEL;
-      tss_array[TSS_MAIN].esp0 = stack;
+      tss->ss0 = X86_KERNEL_DATA_SEL;
+      tss->esp0 = stack;
       wrmsr(MSR_IA32_SYSENTER_ESP, stack);
    }
    enable_interrupts(&var);
@@ -311,6 +348,19 @@ void init_segmentation(void)
                   GDT_ACC_REG | GDT_ACCESS_PL3 | GDT_ACCESS_RW,
                   GDT_GRAN_4KB | GDT_32BIT);
 
+#if KRN_SMP
+
+   /* GDT entries for the TSS of each CPU: the BSP uses the first one */
+   for (u32 i = 0; i < MAX_CPUS; i++) {
+      set_entry_num2(X86_CPU_TSS_GDT_BASE + i,
+                     (ulong)get_cpu_tss(i),       /* TSS addr */
+                     sizeof(struct tss_entry),    /* limit: struct TSS size */
+                     GDT_DESC_TYPE_TSS | GDT_ACCESS_PL0,
+                     GDT_GRAN_BYTE | GDT_32BIT);
+   }
+
+#else
+
    /* GDT entry for our TSS */
    set_entry_num2(5,
                   (ulong)&tss_array[TSS_MAIN],  /* TSS addr */
@@ -318,6 +368,8 @@ void init_segmentation(void)
                   GDT_DESC_TYPE_TSS | GDT_ACCESS_PL0,
                   GDT_GRAN_BYTE | GDT_32BIT);
 
+#endif
+
    /* Register other special GDT entires */
    register_double_fault_tss_entry();
 
@@ -326,8 +378,39 @@ void init_segmentation(void)
 
    /* Load the TSS */
    load_tss(5 /* TSS index in GDT */, 0 /* priv. level */);
+
+#if KRN_SMP
+   x86_cpu_tss_loaded = true;
+#endif
 }
 
+#if KRN_SMP
+
+/*
+ * Called by each AP during its startup, while the BSP waits for it: load the
+ * shared GDT and the TSS of the AP. After that, get_this_cpu_idx() works.
+ */
+void gdt_init_on_ap(u32 cpu)
+{
+   ASSERT(!are_interrupts_enabled());
+   ASSERT(0 < cpu && cpu < MAX_CPUS);
+
+   load_gdt(gdt, gdt_size);
+   load_tss(X86_CPU_TSS_GDT_BASE + cpu, 0);
+}
+
+static void gdt_reload_on_this_cpu(void *unused)
+{
+   load_gdt(gdt, gdt_size);
+}
+
+void smp_reload_gdt_on_others(void)
+{
+   smp_call_on_others(&gdt_reload_on_this_cpu, NULL);
+}
+
+#endif
+
 static void DEBUG_set_thread_area(struct user_desc *d)
 {
    printk(NO_PREFIX "set_thread_area(e: %i,\n"
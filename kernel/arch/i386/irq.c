@@ -7,10 +7,16 @@
 
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/irq.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+#include <tilck/kernel/arch/generic_x86/ioapic.h>
 
 #include "idt_int.h"
 #include "../generic_x86/pic.h"
 
+void lapic_timer_entry(void);
+void lapic_spur_entry(void);
+extern void (*dyn_irq_entry_points[IRQ_DYN_VECTORS_COUNT])(void);
+
 
 /*
  * We first remap the interrupt controllers, and then we install
@@ -32,4 +38,26 @@ void init_irq_handling(void)
 
       irq_set_mask(i);
    }
+
+   for (int i = 0; i < IRQ_DYN_VECTORS_COUNT; i++) {
+
+      idt_set_entry(IRQ_DYN_VECTOR_BASE + (u8)i,
+                    dyn_irq_entry_points[i],
+                    X86_KERNEL_CODE_SEL,
+                    IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE | IDT_FLAG_DPL0);
+   }
+
+   idt_set_entry(LAPIC_TIMER_VECTOR,
+                 lapic_timer_entry,
+                 X86_KERNEL_CODE_SEL,
+                 IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE | IDT_FLAG_DPL0);
+
+   idt_set_entry(LAPIC_SPURIOUS_VECTOR,
+                 lapic_spur_entry,
+                 X86_KERNEL_CODE_SEL,
+                 IDT_FLAG_PRESENT | IDT_FLAG_INT_GATE | IDT_FLAG_DPL0);
+
+   init_lapic();
+   init_ioapics();
+   init_lapic_timer();
 }
@@ -74,7 +74,7 @@ bool handle_potential_cow(void *context)
 
       pt->pages[pt_index].rw = true;
       pt->pages[pt_index].avail = 0;
-      invalidate_page_hw(vaddr);
+      invalidate_page(vaddr);
       return true;
    }
 
@@ -124,7 +124,7 @@ bool handle_potential_cow(void *context)
    pt->pages[pt_index].rw = true;
    pt->pages[pt_index].avail = 0;
 
-   invalidate_page_hw(vaddr);
+   invalidate_page(vaddr);
    return true;
 }
 
@@ -252,7 +252,89 @@ void set_page_rw(pdir_t *pdir, void *vaddrp, bool rw)
    pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
    ASSERT(LIN_VA_TO_PA(pt) != 0);
    pt->pages[pt_index].rw = rw;
-   invalidate_page_hw(vaddr);
+   invalidate_page(vaddr);
+}
+
+/*
+ * Turn an already mapped page into a private copy-on-write one, no matter if it
+ * was shared or not. The pageframe is NOT copied here: that will happen in
+ * handle_potential_cow() on the first write attempt, as long as somebody else
+ * (e.g. a ramfs block or the FAT ramdisk) still holds a reference to it.
+ */
+void set_page_cow(pdir_t *pdir, void *vaddrp)
+{
+   page_table_t *pt;
+   const ulong vaddr = (ulong) vaddrp;
+   const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
+   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
+
+   pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
+   ASSERT(LIN_VA_TO_PA(pt) != 0);
+   ASSERT(pt->pages[pt_index].present);
+
+   pt->pages[pt_index].rw = false;
+   pt->pages[pt_index].avail = PAGE_COW_ORIG_RW;
+   invalidate_page(vaddr);
+}
+
+/*
+ * Take a reference to the private, writable, user page mapped at `vaddr` and
+ * turn it into a copy-on-write page. That allows the kernel to hold the page's
+ * content without copying it: if the user space writes to the page while the
+ * kernel still holds the reference, it will get its own copy.
+ *
+ * Returns the linear address of the page or NULL if the page cannot be shared
+ * (not mapped, read-only, shared or referenced by somebody else). CoW pages
+ * are fine, as long as nobody else references them. The reference must be
+ * dropped with release_shared_page().
+ */
+void *share_user_page_cow(pdir_t *pdir, void *vaddrp)
+{
+   page_table_t *pt;
+   page_t *p;
+   ulong paddr;
+   const ulong vaddr = (ulong) vaddrp;
+   const u32 pt_index = (vaddr >> PAGE_SHIFT) & 1023;
+   const u32 pd_index = (vaddr >> BIG_PAGE_SHIFT);
+
+   ASSERT(IS_PAGE_ALIGNED(vaddr));
+
+   if (vaddr >= BASE_VA)
+      return NULL;
+
+   pt = PA_TO_LIN_VA(pdir->entries[pd_index].ptaddr << PAGE_SHIFT);
+
+   if (LIN_VA_TO_PA(pt) == 0)
+      return NULL;
+
+   p = &pt->pages[pt_index];
+
+   if (!p->present || !p->us || (p->avail & PAGE_SHARED))
+      return NULL;
+
+   if (!p->rw && !(p->avail & PAGE_COW_ORIG_RW))
+      return NULL;
+
+   paddr = (ulong)p->pageAddr << PAGE_SHIFT;
+
+   if (paddr >= phys_mem_lim || paddr == KERNEL_VA_TO_PA(zero_page))
+      return NULL;
+
+   if (pf_ref_count_get(paddr) != 1)
+      return NULL;
+
+   pf_ref_count_inc(paddr);
+   set_page_cow(pdir, vaddrp);
+   return PA_TO_LIN_VA(paddr);
+}
+
+/* Drop a reference taken with share_user_page_cow() */
+void release_shared_page(void *page)
+{
+   const ulong paddr = LIN_VA_TO_PA(page);
+
+   if (!pf_ref_count_dec(paddr))
+      kfree2(page, PAGE_SIZE);
 }
 
 static inline int
@@ -282,7 +364,7 @@ __unmap_page(pdir_t *pdir, void *vaddrp, bool free_pageframe, bool permissive)
       pt->pages[pt_index].pageAddr << PAGE_SHIFT;
 
    pt->pages[pt_index].raw = 0;
-   invalidate_page_hw(vaddr);
+   invalidate_page(vaddr);
 
    if (!pf_ref_count_dec(paddr) && free_pageframe) {
       ASSERT(paddr != KERNEL_VA_TO_PA(zero_page));
@@ -442,7 +524,7 @@ map_page_int(pdir_t *pdir, void *vaddrp, ulong paddr, u32 hw_flags)
 
    pt->pages[pt_index].raw = PG_PRESENT_BIT | hw_flags | paddr;
    pf_ref_count_inc(paddr);
-   invalidate_page_hw(vaddr);
+   invalidate_page(vaddr);
    return 0;
 }
 
@@ -767,6 +849,9 @@ void pdir_destroy(pdir_t *pdir)
    // Kernel's pdir cannot be destroyed!
    ASSERT(pdir != __kernel_pdir);
 
+   // No other CPU must keep using it, not even lazily (e.g. in a kthread)
+   smp_release_pdir(pdir);
+
    for (u32 i = 0; i < BASE_VADDR_PD_IDX; i++) {
 
       if (!pdir->entries[i].present)
@@ -834,7 +919,7 @@ static void set_big_4mb_page_pat_wc(pdir_t *pdir, void *vaddrp)
    e->big_4mb_page.cd = 1;
    e->big_4mb_page.wt = 1;
 
-   invalidate_page_hw(vaddr);
+   invalidate_page(vaddr);
 }
 
 static void set_4kb_page_pat_wc(pdir_t *pdir, void *vaddrp)
@@ -855,7 +940,7 @@ static void set_4kb_page_pat_wc(pdir_t *pdir, void *vaddrp)
    pt->pages[pt_index].cd = 1;
    pt->pages[pt_index].wt = 1;
 
-   invalidate_page_hw(vaddr);
+   invalidate_page(vaddr);
 }
 
 void set_pages_pat_wc(pdir_t *pdir, void *vaddr, size_t size)
@@ -5,6 +5,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/utils.h>
+#include <tilck/common/elf_types.h>
 
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/process.h>
@@ -40,6 +41,19 @@ STATIC_ASSERT(
 
 STATIC_ASSERT(TOT_PROC_AND_TASK_SIZE <= 1024);
 
+/* The vdso's asm code depends on those offsets */
+#define VVAR_OFF(f) OFFSET_OF(struct vdso_time_data, f)
+STATIC_ASSERT(VVAR_OFF(seq) == VVAR_SEQ_OFF);
+STATIC_ASSERT(VVAR_OFF(tsc_ok) == VVAR_TSC_OK_OFF);
+STATIC_ASSERT(VVAR_OFF(tsc_base) == VVAR_TSC_BASE_OFF);
+STATIC_ASSERT(VVAR_OFF(ns_base) == VVAR_NS_BASE_OFF);
+STATIC_ASSERT(VVAR_OFF(tsc_mult) == VVAR_TSC_MULT_OFF);
+STATIC_ASSERT(VVAR_OFF(tsc_shift) == VVAR_TSC_SHIFT_OFF);
+STATIC_ASSERT(VVAR_OFF(max_delta_ns) == VVAR_MAX_DNS_OFF);
+STATIC_ASSERT(VVAR_OFF(max_delta_tsc) == VVAR_MAX_DTSC_OFF);
+STATIC_ASSERT(VVAR_OFF(boot_ts) == VVAR_BOOT_TS_OFF);
+#undef VVAR_OFF
+
 void task_info_reset_kernel_stack(struct task *ti)
 {
    ulong bottom = (ulong)ti->kernel_stack + KERNEL_STACK_SIZE - 1;
@@ -112,15 +126,18 @@ push_args_on_user_stack(regs_t *r,
 
    // push the env array (in reverse order)
 
-   push_on_user_stack(r, 0); /*
-                              * 2nd mandatory NULL pointer: after the 'env'
-                              * pointers there could additional aux information
-                              * that some libc implementations check for.
-                              * Therefore, it is essential to add another NULL
-                              * after the env pointers to inform the libc impl
-                              * that no such information exist. For more info,
-                              * check __init_libc() in libmusl.
-                              */
+   /*
+    * Push the auxiliary vector (in reverse order): after the 'env' pointers,
+    * the libc implementations expect a list of (type, value) pairs terminated
+    * by AT_NULL. For more info, check __init_libc() in libmusl. AT_SYSINFO_EHDR
+    * points to the vdso page, which is an ELF image exporting __vdso_* funcs.
+    */
+   push_on_user_stack(r, 0);                  /* AT_NULL */
+   push_on_user_stack(r, 0);
+   push_on_user_stack(r, PAGE_SIZE);
+   push_on_user_stack(r, AT_PAGESZ);
+   push_on_user_stack(r, USER_VDSO_VADDR);
+   push_on_user_stack(r, AT_SYSINFO_EHDR);
 
    push_on_user_stack(r, 0); // mandatory final NULL pointer (end of 'env' ptrs)
 
@@ -695,6 +712,12 @@ switch_to_task(struct task *ti)
    /* From here until the end, we have to be as fast as possible */
    disable_interrupts_forced();
    switch_to_task_pop_nested_interrupts();
+
+#if KRN_SMP
+   /* Going back to user space: release the BKL, once off the current stack */
+   get_this_cpu()->bkl_drop_on_switch = !ti->running_in_kernel;
+#endif
+
    enable_preemption_nosched();
    ASSERT(is_preemption_enabled());
 
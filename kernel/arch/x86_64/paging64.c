@@ -72,6 +72,21 @@ void set_page_rw(pdir_t *pdir, void *vaddrp, bool rw)
    NOT_IMPLEMENTED();
 }
 
+void set_page_cow(pdir_t *pdir, void *vaddrp)
+{
+   NOT_IMPLEMENTED();
+}
+
+void *share_user_page_cow(pdir_t *pdir, void *vaddrp)
+{
+   NOT_IMPLEMENTED();
+}
+
+void release_shared_page(void *page)
+{
+   NOT_IMPLEMENTED();
+}
+
 NODISCARD int
 map_page(pdir_t *pdir, void *vaddrp, ulong paddr, u32 pg_flags)
 {
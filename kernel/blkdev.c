@@ -0,0 +1,880 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/blkdev.h>
+#include <tilck/kernel/bintree.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/system_mmap.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/devfs.h>
+#include <tilck/kernel/modules.h>
+
+#include <linux/major.h> // system header
+#include <linux/fs.h>    // system header
+
+/*
+ * The block layer
+ * -----------------
+ *
+ * Users of the block layer submit bios (contiguous runs of sectors) with
+ * blkdev_submit() and wait for them with blkdev_wait(). Bios submitted in
+ * batch get merged into the same request when they're adjacent, so that the
+ * driver can transfer them with a single command. There's no I/O thread: the
+ * first task waiting for a bio while nobody else is running the queue becomes
+ * the dispatcher and runs it until it's empty, while the other tasks just
+ * sleep on `q_cond`.
+ *
+ * On top of that, each block device has its own LRU page cache, used by
+ * blkdev_read() and blkdev_write(). Misses cause a read-ahead of up to
+ * BLK_READAHEAD_PAGES pages, in a single request. Writes go through the
+ * cache: blkdev_write() returns only after the data reached the device.
+ *
+ * NOTE: a partition and its whole disk have separate page caches, which are
+ * NOT coherent with each other. Don't write through both at the same time.
+ */
+
+struct blk_page {
+
+   struct bintree_node node;
+   struct list_node lru_node;    /* not in the LRU list while I/O is pending */
+   ulong index;                  /* offset in the device / PAGE_SIZE */
+   void *data;
+};
+
+static struct blkdev *blkdevs[BLK_MAX_DEVS];
+static u16 blkdevs_count;
+static int blk_major = -1;
+
+void blkdev_init(struct blkdev *dev)
+{
+   list_node_init(&dev->node);
+   kmutex_init(&dev->q_lock, 0);
+   kcond_init(&dev->q_cond);
+   list_init(&dev->q_reqs);
+
+   kmutex_init(&dev->pc_lock, 0);
+   list_init(&dev->pc_lru);
+   dev->pc_root = NULL;
+   dev->pc_pages = 0;
+
+   if (!dev->pc_max_pages) {
+      dev->pc_max_pages =
+         MAX(16u, (u32)(get_phys_mem_size() / PAGE_SIZE / 32));
+   }
+
+   if (!dev->max_sectors)
+      dev->max_sectors = BLK_READAHEAD_PAGES * BLK_SECTORS_PER_PAGE;
+}
+
+void blkdev_destroy(struct blkdev *dev)
+{
+   ASSERT(list_is_empty(&dev->q_reqs));
+   blkdev_drop_cache(dev);
+   kcond_destory(&dev->q_cond);
+   kmutex_destroy(&dev->q_lock);
+   kmutex_destroy(&dev->pc_lock);
+}
+
+/* ------------------------------ Request queue ----------------------------- */
+
+static void blk_complete_bio(struct blk_bio *bio, int rc)
+{
+   bio->rc = rc;
+   bio->done = true;
+}
+
+/*
+ * Try to merge `bio` with the last request in the queue, the only one we can
+ * extend without changing the order of overlapping reads and writes.
+ */
+static bool blk_try_merge(struct blkdev *dev, struct blk_bio *bio)
+{
+   struct blk_req *req;
+
+   if (list_is_empty(&dev->q_reqs))
+      return false;
+
+   req = list_last_obj(&dev->q_reqs, struct blk_req, node);
+
+   if (req->write != bio->write || req->nr_bios == BLK_MAX_REQ_BIOS)
+      return false;
+
+   if (req->count + bio->count > dev->max_sectors)
+      return false;
+
+   if (req->sector + req->count == bio->sector) {
+
+      list_add_tail(&req->bios, &bio->node);
+
+   } else if (bio->sector + bio->count == req->sector) {
+
+      list_add_head(&req->bios, &bio->node);
+      req->sector = bio->sector;
+
+   } else {
+
+      return false;
+   }
+
+   req->count += bio->count;
+   req->nr_bios++;
+   dev->stats.merges++;
+   return true;
+}
+
+static void blk_queue_bio(struct blkdev *dev, struct blk_bio *bio)
+{
+   struct blk_req *req;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&dev->q_lock));
+   dev->stats.bios++;
+
+   if (blk_try_merge(dev, bio))
+      return;
+
+   if (!(req = kalloc_obj(struct blk_req))) {
+      blk_complete_bio(bio, -ENOMEM);
+      return;
+   }
+
+   list_node_init(&req->node);
+   list_init(&req->bios);
+   list_add_tail(&req->bios, &bio->node);
+   req->sector = bio->sector;
+   req->count = bio->count;
+   req->nr_bios = 1;
+   req->write = bio->write;
+   list_add_tail(&dev->q_reqs, &req->node);
+}
+
+/*
+ * Submit `n` bios at once, giving the block layer the chance to merge them.
+ * For partitions, the bios' sectors are shifted and the bios are queued on
+ * the parent device: from now on, they're relative to the whole disk.
+ */
+void blkdev_submit(struct blkdev *dev, struct blk_bio *bios, u32 n)
+{
+   struct blkdev *qdev = dev->parent ? dev->parent : dev;
+
+   kmutex_lock(&qdev->q_lock);
+
+   for (u32 i = 0; i < n; i++) {
+
+      struct blk_bio *bio = &bios[i];
+
+      list_node_init(&bio->node);
+      bio->done = false;
+      bio->rc = 0;
+
+      if (!bio->count ||
+          bio->count > qdev->max_sectors ||
+          bio->sector + bio->count > dev->nr_sectors)
+      {
+         blk_complete_bio(bio, -EINVAL);
+         continue;
+      }
+
+      bio->sector += dev->start_sector;
+      blk_queue_bio(qdev, bio);
+   }
+
+   kmutex_unlock(&qdev->q_lock);
+}
+
+/* Called with `q_lock` held: run the queue until it gets empty */
+static void blk_run_queue(struct blkdev *dev)
+{
+   struct blk_req *req;
+   struct blk_bio *bio, *tmp;
+   int rc;
+
+   ASSERT(!dev->q_busy);
+   dev->q_busy = true;
+
+   while (!list_is_empty(&dev->q_reqs)) {
+
+      req = list_first_obj(&dev->q_reqs, struct blk_req, node);
+      list_remove(&req->node);
+      dev->stats.reqs++;
+
+      kmutex_unlock(&dev->q_lock);
+      {
+         rc = dev->ops->xfer(dev, req);
+      }
+      kmutex_lock(&dev->q_lock);
+
+      list_for_each(bio, tmp, &req->bios, node) {
+         list_remove(&bio->node);
+         blk_complete_bio(bio, rc);
+      }
+
+      kfree_obj(req, struct blk_req);
+      kcond_signal_all(&dev->q_cond);
+   }
+
+   dev->q_busy = false;
+}
+
+int blkdev_wait(struct blkdev *dev, struct blk_bio *bio)
+{
+   struct blkdev *qdev = dev->parent ? dev->parent : dev;
+   int rc;
+
+   kmutex_lock(&qdev->q_lock);
+   {
+      while (!bio->done) {
+
+         if (!qdev->q_busy)
+            blk_run_queue(qdev);
+         else
+            kcond_wait(&qdev->q_cond, &qdev->q_lock, KCOND_WAIT_FOREVER);
+      }
+
+      rc = bio->rc;
+   }
+   kmutex_unlock(&qdev->q_lock);
+   return rc;
+}
+
+static int blk_wait_all(struct blkdev *dev, struct blk_bio *bios, u32 n)
+{
+   int rc = 0;
+
+   for (u32 i = 0; i < n; i++) {
+
+      int bio_rc = blkdev_wait(dev, &bios[i]);
+
+      if (bio_rc && !rc)
+         rc = bio_rc;
+   }
+
+   return rc;
+}
+
+/* Synchronous, uncached, I/O */
+int
+blkdev_rw_sectors(struct blkdev *dev, u64 sector, u32 count, void *buf, bool wr)
+{
+   struct blkdev *qdev = dev->parent ? dev->parent : dev;
+   struct blk_bio bio;
+   int rc;
+
+   while (count > 0) {
+
+      bio = (struct blk_bio) {
+         .sector = sector,
+         .count = MIN(count, qdev->max_sectors),
+         .buf = buf,
+         .write = wr,
+      };
+
+      blkdev_submit(dev, &bio, 1);
+
+      if ((rc = blkdev_wait(dev, &bio)))
+         return rc;
+
+      sector += bio.count;
+      count -= bio.count;
+      buf += bio.count * BLK_SECTOR_SIZE;
+   }
+
+   return 0;
+}
+
+/* ------------------------------- Page cache ------------------------------- */
+
+static inline ulong blk_nr_pages(struct blkdev *dev)
+{
+   return (ulong)((dev->nr_sectors + BLK_SECTORS_PER_PAGE - 1)
+                     / BLK_SECTORS_PER_PAGE);
+}
+
+static void blk_free_page(struct blk_page *pg)
+{
+   kfree2(pg->data, PAGE_SIZE);
+   kfree_obj(pg, struct blk_page);
+}
+
+static void blk_pc_remove(struct blkdev *dev, struct blk_page *pg)
+{
+   bintree_remove_ptr(&dev->pc_root, pg, struct blk_page, node, index);
+
+   if (list_is_node_in_list(&pg->lru_node))
+      list_remove(&pg->lru_node);
+
+   dev->pc_pages--;
+}
+
+/*
+ * Get a page for `index`, not yet in the cache: allocate a new one or, when
+ * the cache is full, evict the least recently used page. Pages with pending
+ * I/O are not in the LRU list, so they're never evicted.
+ */
+static struct blk_page *blk_pc_alloc(struct blkdev *dev, ulong index)
+{
+   struct blk_page *pg = NULL;
+
+   if (dev->pc_pages >= dev->pc_max_pages && !list_is_empty(&dev->pc_lru)) {
+      pg = list_last_obj(&dev->pc_lru, struct blk_page, lru_node);
+      blk_pc_remove(dev, pg);
+      dev->stats.pc_evictions++;
+   }
+
+   if (!pg) {
+
+      if (!(pg = kalloc_obj(struct blk_page)))
+         return NULL;
+
+      if (!(pg->data = kmalloc(PAGE_SIZE))) {
+         kfree_obj(pg, struct blk_page);
+         return NULL;
+      }
+   }
+
+   bintree_node_init(&pg->node);
+   list_node_init(&pg->lru_node);
+   pg->index = index;
+
+   DEBUG_ONLY_UNSAFE(bool success =)
+      bintree_insert_ptr(&dev->pc_root, pg, struct blk_page, node, index);
+
+   ASSERT(success);
+   dev->pc_pages++;
+   return pg;
+}
+
+static inline struct blk_page *blk_pc_find(struct blkdev *dev, ulong index)
+{
+   return bintree_find_ptr(dev->pc_root, index, struct blk_page, node, index);
+}
+
+static inline void blk_pc_touch(struct blkdev *dev, struct blk_page *pg)
+{
+   if (list_is_node_in_list(&pg->lru_node))
+      list_remove(&pg->lru_node);
+
+   list_add_head(&dev->pc_lru, &pg->lru_node);
+}
+
+/* Init a bio for the sectors [first, last] of the page `pg` */
+static void
+blk_page_bio(struct blkdev *dev,
+             struct blk_page *pg,
+             struct blk_bio *bio,
+             u32 first,
+             u32 last,
+             bool write)
+{
+   const u64 sector = (u64)pg->index * BLK_SECTORS_PER_PAGE + first;
+
+   ASSERT(sector < dev->nr_sectors);
+   last = (u32)MIN((u64)last, dev->nr_sectors - 1 - (sector - first));
+
+   *bio = (struct blk_bio) {
+      .sector = sector,
+      .count = last - first + 1,
+      .buf = pg->data + first * BLK_SECTOR_SIZE,
+      .write = write,
+   };
+}
+
+/*
+ * Read into the cache the page `index` plus, as read-ahead, the following
+ * pages until the first one already cached (at most BLK_READAHEAD_PAGES in
+ * total). All the bios are submitted at once and get merged in one request.
+ */
+static struct blk_page *
+blk_pc_fill(struct blkdev *dev, ulong index, bool readahead, int *rc)
+{
+   struct blk_page *pages[BLK_READAHEAD_PAGES];
+   struct blk_bio bios[BLK_READAHEAD_PAGES];
+   const ulong nr_pages = blk_nr_pages(dev);
+   u32 n = 1;
+
+   if (readahead) {
+
+      const u32 max = MIN((u32)BLK_READAHEAD_PAGES, dev->pc_max_pages);
+
+      while (n < max && index + n < nr_pages && !blk_pc_find(dev, index + n))
+         n++;
+   }
+
+   for (u32 i = 0; i < n; i++) {
+
+      if (!(pages[i] = blk_pc_alloc(dev, index + i))) {
+
+         if (!i) {
+            *rc = -ENOMEM;
+            return NULL;
+         }
+
+         n = i; /* just skip the rest of the read-ahead */
+         break;
+      }
+
+      /* The device might end in the middle of its last page */
+      if (index + i == nr_pages - 1)
+         bzero(pages[i]->data, PAGE_SIZE);
+
+      blk_page_bio(dev, pages[i], &bios[i], 0, BLK_SECTORS_PER_PAGE - 1, 0);
+   }
+
+   blkdev_submit(dev, bios, n);
+   *rc = blk_wait_all(dev, bios, n);
+
+   for (u32 i = n; i > 0; i--) {
+
+      if (*rc) {
+         blk_pc_remove(dev, pages[i - 1]);
+         blk_free_page(pages[i - 1]);
+         continue;
+      }
+
+      /* In reverse order: the requested page will be the most recent one */
+      blk_pc_touch(dev, pages[i - 1]);
+   }
+
+   return *rc ? NULL : pages[0];
+}
+
+static struct blk_page *
+blk_pc_get(struct blkdev *dev, ulong index, int *rc)
+{
+   struct blk_page *pg;
+
+   if ((pg = blk_pc_find(dev, index))) {
+      dev->stats.pc_hits++;
+      blk_pc_touch(dev, pg);
+      return pg;
+   }
+
+   dev->stats.pc_misses++;
+   return blk_pc_fill(dev, index, true, rc);
+}
+
+ssize_t blkdev_read(struct blkdev *dev, u64 off, void *buf, size_t len)
+{
+   const u64 dev_size = blkdev_get_size(dev);
+   struct blk_page *pg;
+   size_t done = 0;
+   int rc = 0;
+
+   if (off >= dev_size)
+      return 0;
+
+   len = (size_t)MIN((u64)len, dev_size - off);
+   kmutex_lock(&dev->pc_lock);
+
+   while (done < len) {
+
+      const ulong index = (ulong)((off + done) >> PAGE_SHIFT);
+      const size_t pg_off = (size_t)((off + done) & (PAGE_SIZE - 1));
+      const size_t n = MIN(PAGE_SIZE - pg_off, len - done);
+
+      if (!(pg = blk_pc_get(dev, index, &rc)))
+         break;
+
+      memcpy(buf + done, pg->data + pg_off, n);
+      done += n;
+   }
+
+   kmutex_unlock(&dev->pc_lock);
+   return done ? (ssize_t)done : rc;
+}
+
+/* Write-back the pending pages and put them back in the LRU list */
+static int
+blk_pc_write_pending(struct blkdev *dev,
+                     struct blk_page **pages,
+                     struct blk_bio *bios,
+                     u32 n)
+{
+   int rc;
+
+   blkdev_submit(dev, bios, n);
+   rc = blk_wait_all(dev, bios, n);
+
+   for (u32 i = 0; i < n; i++) {
+
+      if (rc) {
+         /* The content of the cached pages is unknown now: drop them */
+         blk_pc_remove(dev, pages[i]);
+         blk_free_page(pages[i]);
+         continue;
+      }
+
+      blk_pc_touch(dev, pages[i]);
+   }
+
+   return rc;
+}
+
+ssize_t blkdev_write(struct blkdev *dev, u64 off, const void *buf, size_t len)
+{
+   const u64 dev_size = blkdev_get_size(dev);
+   struct blk_page *pages[BLK_READAHEAD_PAGES];
+   struct blk_bio bios[BLK_READAHEAD_PAGES];
+   struct blk_page *pg;
+   size_t done = 0, pending = 0;
+   u32 n = 0;
+   int rc = 0;
+
+   if (off >= dev_size)
+      return -ENOSPC;
+
+   len = (size_t)MIN((u64)len, dev_size - off);
+   kmutex_lock(&dev->pc_lock);
+
+   while (done + pending < len) {
+
+      const u64 pos = off + done + pending;
+      const ulong index = (ulong)(pos >> PAGE_SHIFT);
+      const u32 pg_off = (u32)(pos & (PAGE_SIZE - 1));
+      const u32 cnt = (u32)MIN(PAGE_SIZE - pg_off, len - done - pending);
+
+      if ((pg = blk_pc_find(dev, index))) {
+
+         dev->stats.pc_hits++;
+
+      } else {
+
+         dev->stats.pc_misses++;
+
+         if (pg_off == 0 && cnt == PAGE_SIZE)
+            pg = blk_pc_alloc(dev, index);   /* full page: no need to read */
+         else
+            pg = blk_pc_fill(dev, index, false, &rc);
+
+         if (!pg) {
+            rc = rc ? rc : -ENOMEM;
+            break;
+         }
+      }
+
+      /* Take the page out of the LRU list while its I/O is pending */
+      if (list_is_node_in_list(&pg->lru_node))
+         list_remove(&pg->lru_node);
+
+      memcpy(pg->data + pg_off, buf + done + pending, cnt);
+
+      blk_page_bio(dev,
+                   pg,
+                   &bios[n],
+                   pg_off / BLK_SECTOR_SIZE,
+                   (pg_off + cnt - 1) / BLK_SECTOR_SIZE,
+                   true);
+
+      pages[n++] = pg;
+      pending += cnt;
+
+      if (n == ARRAY_SIZE(bios)) {
+
+         if ((rc = blk_pc_write_pending(dev, pages, bios, n)))
+            break;
+
+         done += pending;
+         pending = 0;
+         n = 0;
+      }
+   }
+
+   if (n > 0 && !(rc = blk_pc_write_pending(dev, pages, bios, n)))
+      done += pending;
+
+   kmutex_unlock(&dev->pc_lock);
+   return done ? (ssize_t)done : rc;
+}
+
+void blkdev_drop_cache(struct blkdev *dev)
+{
+   struct blk_page *pg, *tmp;
+
+   kmutex_lock(&dev->pc_lock);
+   {
+      list_for_each(pg, tmp, &dev->pc_lru, lru_node) {
+         blk_pc_remove(dev, pg);
+         blk_free_page(pg);
+      }
+
+      ASSERT(dev->pc_pages == 0);
+      ASSERT(dev->pc_root == NULL);
+   }
+   kmutex_unlock(&dev->pc_lock);
+}
+
+/* ---------------------------- Device files ------------------------------- */
+
+static inline struct blkdev *blk_handle_to_dev(fs_handle h)
+{
+   return blkdev_get(((struct devfs_handle *)h)->file->dev_minor);
+}
+
+static ssize_t blk_dev_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   ssize_t rc;
+
+   if (*pos < 0)
+      return -EINVAL;
+
+   if ((rc = blkdev_read(blk_handle_to_dev(h), (u64)*pos, buf, size)) > 0)
+      *pos += rc;
+
+   return rc;
+}
+
+static ssize_t blk_dev_write(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   ssize_t rc;
+
+   if (*pos < 0)
+      return -EINVAL;
+
+   if ((rc = blkdev_write(blk_handle_to_dev(h), (u64)*pos, buf, size)) > 0)
+      *pos += rc;
+
+   return rc;
+}
+
+static offt blk_dev_seek(fs_handle h, offt off, int whence)
+{
+   struct devfs_handle *dh = h;
+   const offt size = (offt)blkdev_get_size(blk_handle_to_dev(h));
+   offt new_pos;
+
+   switch (whence) {
+
+      case SEEK_SET:
+         new_pos = off;
+         break;
+
+      case SEEK_CUR:
+         new_pos = dh->h_fpos + off;
+         break;
+
+      case SEEK_END:
+         new_pos = size + off;
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   if (new_pos < 0 || new_pos > size)
+      return -EINVAL;
+
+   dh->h_fpos = new_pos;
+   return dh->h_fpos;
+}
+
+static int blk_dev_ioctl(fs_handle h, ulong request, void *argp)
+{
+   struct blkdev *dev = blk_handle_to_dev(h);
+   int rc = 0;
+
+   switch (request) {
+
+      case BLKGETSIZE64: {
+         u64 val = blkdev_get_size(dev);
+         rc = copy_to_user(argp, &val, sizeof(val));
+         break;
+      }
+
+      case BLKGETSIZE: {
+         ulong val = (ulong)dev->nr_sectors;
+         rc = copy_to_user(argp, &val, sizeof(val));
+         break;
+      }
+
+      case BLKSSZGET: {
+         int val = BLK_SECTOR_SIZE;
+         rc = copy_to_user(argp, &val, sizeof(val));
+         break;
+      }
+
+      case BLKFLSBUF:
+         blkdev_drop_cache(dev);
+         return 0;
+
+      default:
+         return -EINVAL;
+   }
+
+   return rc ? -EFAULT : 0;
+}
+
+static int
+create_blk_device(int minor,
+                  enum vfs_entry_type *type,
+                  struct devfs_file_info *nfo)
+{
+   static const struct file_ops static_ops_blk = {
+      .read = blk_dev_read,
+      .write = blk_dev_write,
+      .seek = blk_dev_seek,
+      .ioctl = blk_dev_ioctl,
+   };
+
+   *type = VFS_BLOCK_DEV;
+   nfo->fops = &static_ops_blk;
+   return 0;
+}
+
+static void blk_register_driver(void)
+{
+   struct driver_info *di;
+
+   if (!(di = kzalloc_obj(struct driver_info)))
+      panic("blkdev: out of memory");
+
+   di->name = "blk";
+   di->create_dev_file = create_blk_device;
+   blk_major = register_driver(di, BLOCK_EXT_MAJOR);
+}
+
+struct blkdev *blkdev_get(u16 minor)
+{
+   return minor < blkdevs_count ? blkdevs[minor] : NULL;
+}
+
+/*
+ * Initialize `dev` and create its device file in /dev. The driver must have
+ * already set at least `name`, `nr_sectors` and `ops`.
+ */
+int register_blkdev(struct blkdev *dev)
+{
+   int rc;
+
+   ASSERT(dev->ops || dev->parent);
+
+   if (blkdevs_count == ARRAY_SIZE(blkdevs))
+      return -ENOSPC;
+
+   if (blk_major < 0)
+      blk_register_driver();
+
+   blkdev_init(dev);
+   dev->minor = blkdevs_count;
+
+   if ((rc = create_dev_file(dev->name, (u16)blk_major, dev->minor, NULL)))
+      return rc;
+
+   blkdevs[blkdevs_count++] = dev;
+   printk("blkdev: %s, %llu sectors (%llu MB)\n",
+          dev->name, dev->nr_sectors, blkdev_get_size(dev) / MB);
+   return 0;
+}
+
+int blkdev_lookup(const char *path, struct blkdev **out)
+{
+   struct k_stat64 st;
+   struct blkdev *dev;
+   int rc;
+
+   /* The drives are probed by async modules (e.g. ata): wait for them */
+   wait_for_all_modules();
+
+   if ((rc = vfs_stat64(path, &st, true)))
+      return rc;
+
+   if (!S_ISBLK(st.st_mode))
+      return -ENOTBLK;
+
+   if ((int)(st.st_rdev >> 8) != blk_major)
+      return -ENXIO;
+
+   if (!(dev = blkdev_get(st.st_rdev & 0xff)))
+      return -ENXIO;
+
+   *out = dev;
+   return 0;
+}
+
+/* ------------------------------ Partitions -------------------------------- */
+
+struct mbr_part_entry {
+
+   u8 status;
+   u8 chs_first[3];
+   u8 type;
+   u8 chs_last[3];
+   u32 lba_start;
+   u32 sectors;
+
+} PACKED;
+
+#define MBR_PART_TABLE_OFF                         446
+#define MBR_SIGNATURE_OFF                          510
+
+static bool mbr_skip_part_type(u8 type)
+{
+   return type == 0x00 ||     /* unused */
+          type == 0x05 ||     /* extended (CHS) */
+          type == 0x0f ||     /* extended (LBA) */
+          type == 0xee;       /* GPT protective MBR */
+}
+
+static void
+blkdev_add_partition(struct blkdev *dev, u32 num, struct mbr_part_entry *e)
+{
+   struct blkdev *part;
+   int rc;
+
+   if (!e->sectors || (u64)e->lba_start + e->sectors > dev->nr_sectors) {
+      printk("blkdev: %s: ignoring invalid partition %u\n", dev->name, num);
+      return;
+   }
+
+   if (!(part = kzalloc_obj(struct blkdev))) {
+      printk("blkdev: no memory for partition %s%u\n", dev->name, num);
+      return;
+   }
+
+   snprintk(part->name, sizeof(part->name), "%s%u", dev->name, num);
+   part->parent = dev;
+   part->start_sector = e->lba_start;
+   part->nr_sectors = e->sectors;
+   part->max_sectors = dev->max_sectors;
+
+   if ((rc = register_blkdev(part))) {
+      printk("blkdev: failed to register %s: %d\n", part->name, rc);
+      kfree_obj(part, struct blkdev);
+   }
+}
+
+/*
+ * Read the MBR of `dev` and register a block device for each of its primary
+ * partitions, named like the device followed by the partition number.
+ */
+int blkdev_scan_partitions(struct blkdev *dev)
+{
+   struct mbr_part_entry *parts;
+   u8 *mbr;
+   int rc;
+
+   ASSERT(!dev->parent);
+
+   if (!(mbr = kmalloc(BLK_SECTOR_SIZE)))
+      return -ENOMEM;
+
+   if ((rc = blkdev_rw_sectors(dev, 0, 1, mbr, false)))
+      goto out;
+
+   if (mbr[MBR_SIGNATURE_OFF] != 0x55 || mbr[MBR_SIGNATURE_OFF + 1] != 0xaa)
+      goto out; /* no partition table */
+
+   parts = (void *)(mbr + MBR_PART_TABLE_OFF);
+
+   for (u32 i = 0; i < 4; i++) {
+      if (!mbr_skip_part_type(parts[i].type))
+         blkdev_add_partition(dev, i + 1, &parts[i]);
+   }
+
+out:
+   kfree2(mbr, BLK_SECTOR_SIZE);
+   return rc;
+}
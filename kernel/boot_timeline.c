@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/atomics.h>
+
+#include <tilck/kernel/boot_timeline.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+
+static struct boot_tl_event boot_tl_events[BOOT_TL_MAX_EVENTS];
+static ATOMIC(int) boot_tl_count;
+static u64 boot_tl_base;
+
+void boot_tl_init(void)
+{
+   boot_tl_base = RDTSC();
+}
+
+int boot_tl_begin(const char *name)
+{
+   struct boot_tl_event *e;
+   int idx = atomic_fetch_add_explicit(&boot_tl_count, 1, mo_relaxed);
+
+   if (idx >= BOOT_TL_MAX_EVENTS)
+      return -1;
+
+   e = &boot_tl_events[idx];
+   e->name = name;
+   e->tid = get_curr_tid();
+   e->start = RDTSC();
+   return idx;
+}
+
+void boot_tl_end(int idx)
+{
+   if (idx >= 0)
+      boot_tl_events[idx].end = RDTSC();
+}
+
+void boot_tl_mark(const char *name)
+{
+   boot_tl_end(boot_tl_begin(name));
+}
+
+int boot_tl_snapshot(struct boot_tl_event *arr, int max_count, u64 *base)
+{
+   int count = atomic_load_explicit(&boot_tl_count, mo_relaxed);
+   count = MIN(count, BOOT_TL_MAX_EVENTS);
+   count = MIN(count, max_count);
+
+   disable_preemption();
+   {
+      for (int i = 0; i < count; i++)
+         arr[i] = boot_tl_events[i];
+   }
+   enable_preemption();
+
+   *base = boot_tl_base;
+   return count;
+}
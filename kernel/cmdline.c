@@ -144,6 +144,7 @@ ALL_KOPTS_BEGIN
    DEFINE_KOPT(sched_alive_thread, sat , bool, false)
    DEFINE_KOPT(sercon            ,     , bool, !MOD_console)
    DEFINE_KOPT(noacpi            ,     , bool, false)
+   DEFINE_KOPT(sync_mods         , sm  , bool, false)
    DEFINE_KOPT(fb_no_opt         ,     , bool, false)
    DEFINE_KOPT(fb_no_wc          ,     , bool, false)
    DEFINE_KOPT(no_fpu_memcpy     ,     , bool, false)
@@ -11,6 +11,7 @@
 #include <tilck/kernel/syscalls.h>
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/vdso.h>
 
 #define FULL_RESYNC_MAX_ATTEMPTS       10
 
@@ -210,6 +211,7 @@ retry:
          abs_drift = (int)(hw_time_ns - __time_ns);
          __tick_adj_val = (TS_SCALE / TIMER_HZ) / 10;
          __tick_adj_ticks_rem = abs_drift / __tick_adj_val;
+         timer_tick_adj_changed();
       }
    }
    enable_interrupts_forced();
@@ -266,6 +268,7 @@ static void clock_multi_second_resync(int drift)
    {
       __tick_adj_val = adj_val;
       __tick_adj_ticks_rem = adj_ticks;
+      timer_tick_adj_changed();
    }
    enable_interrupts_forced();
    clock_rstats.multi_second_resync_count++;
@@ -395,6 +398,7 @@ int clock_get_second_drift(void)
 void init_system_time(void)
 {
    struct datetime d;
+   ulong var;
 
 #if KRN_CLOCK_DRIFT_COMP
       if (kthread_create(&clock_drift_adj, 0, NULL) < 0)
@@ -407,16 +411,36 @@ void init_system_time(void)
    if (boot_timestamp < 0)
       panic("Invalid boot-time UNIX timestamp: %d\n", boot_timestamp);
 
-   __time_ns = 0;
+   disable_interrupts(&var);
+   {
+      __time_ns = 0;
+
+      vdso_time_write_begin();
+      {
+         vvar_page.time.boot_ts = boot_timestamp;
+         vvar_page.time.ns_base = 0;
+      }
+      vdso_time_write_end();
+   }
+   enable_interrupts(&var);
 }
 
 u64 get_sys_time(void)
 {
+   static u64 last_ts;
    u64 ts;
    ulong var;
    disable_interrupts(&var);
    {
-      ts = __time_ns;
+      ts = __time_ns + get_ns_since_last_tick();
+
+      /*
+       * The TSC interpolation might get slightly ahead of the next tick, in
+       * particular when the drift compensation makes the ticks shorter: never
+       * let the system time go backwards.
+       */
+      ts = MAX(ts, last_ts);
+      last_ts = ts;
    }
    enable_interrupts(&var);
    return ts;
@@ -472,6 +496,18 @@ u64 timespec_to_ticks(const struct k_timespec64 *tp)
    return ticks;
 }
 
+u64 timespec_to_ns(const struct k_timespec64 *tp)
+{
+   const u64 max_sec = (UINT64_MAX - BILLION) / BILLION;
+   return MIN((u64)tp->tv_sec, max_sec) * BILLION + (u64)tp->tv_nsec;
+}
+
+void ns_to_timespec(u64 ns, struct k_timespec64 *tp)
+{
+   tp->tv_sec = (s64)(ns / BILLION);
+   tp->tv_nsec = (long)(ns % BILLION);
+}
+
 void real_time_get_timespec(struct k_timespec64 *tp)
 {
    const u64 t = get_sys_time();
@@ -565,10 +601,24 @@ do_clock_getres(clockid_t clk_id, struct k_timespec64 *res)
    switch (clk_id) {
 
       case CLOCK_REALTIME:
-      case CLOCK_REALTIME_COARSE:
       case CLOCK_MONOTONIC:
-      case CLOCK_MONOTONIC_COARSE:
       case CLOCK_MONOTONIC_RAW:
+
+         /* With the TSC clocksource, get_sys_time() has a ns resolution */
+         if (has_tsc_clocksource()) {
+
+            *res = (struct k_timespec64) {
+               .tv_sec = 0,
+               .tv_nsec = 1,
+            };
+
+            break;
+         }
+
+         /* fall-through */
+
+      case CLOCK_REALTIME_COARSE:
+      case CLOCK_MONOTONIC_COARSE:
       case CLOCK_PROCESS_CPUTIME_ID:
       case CLOCK_THREAD_CPUTIME_ID:
 
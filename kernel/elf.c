@@ -7,6 +7,7 @@
 #include <tilck/common/utils.h>
 
 #include <tilck/kernel/elf_loader.h>
+#include <tilck/kernel/exec_cache.h>
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
@@ -160,18 +161,160 @@ static inline int check_segment_alignment(Elf_Phdr *phdr)
    return 0;
 }
 
+static int
+load_rw_tail_page(fs_handle *elf_h,
+                  pdir_t *pdir,
+                  Elf_Phdr *phdr,
+                  ulong page_va)
+{
+   /*
+    * The page containing the end of the file-backed part of a writable segment
+    * cannot be mapped directly from the file: its tail (if any) belongs to the
+    * .bss section and must be zero, while in the file there's something else
+    * after `p_filesz`. Therefore, this is the only page we have to copy.
+    */
+
+   const ulong file_end_va = phdr->p_vaddr + phdr->p_filesz;
+   const ulong copy_va = MAX(phdr->p_vaddr, page_va);
+   const size_t to_read = file_end_va - copy_va;
+   const offt off = (offt)(phdr->p_offset + (copy_va - phdr->p_vaddr));
+   char *p;
+   offt rc;
+
+   ASSERT(IS_PAGE_ALIGNED(page_va));
+   ASSERT(copy_va < file_end_va);
+   ASSERT(to_read <= PAGE_SIZE);
+
+   if (!(p = kzmalloc(PAGE_SIZE)))
+      return -ENOMEM;
+
+   rc = map_page(pdir, (void *)page_va, LIN_VA_TO_PA(p), PAGING_FL_RWUS);
+
+   if (rc) {
+      kfree2(p, PAGE_SIZE);
+      return (int)rc;
+   }
+
+   /* From now on, `p` is owned by `pdir`: no need to free it on failure */
+   rc = vfs_seek(elf_h, off, SEEK_SET);
+
+   if (rc < 0)
+      return (int)rc;           /* I/O error during seek */
+
+   if (rc != off)
+      return -ENOEXEC;
+
+   rc = vfs_read(elf_h, p + (copy_va & OFFSET_IN_PAGE_MASK), to_read);
+
+   if (rc < 0)
+      return (int)rc;           /* I/O error during read */
+
+   if (rc < (offt)to_read)
+      return -ENOEXEC;          /* The ELF file is corrupted */
+
+   return 0;
+}
+
+/*
+ * Load a writable segment (.data + .bss) without copying it. The pages fully
+ * covered by file data are mapped directly from the file system (ramfs blocks
+ * or the FAT ramdisk) as *private* CoW pages, while the rest of the .bss is
+ * mapped to the zero page, also in CoW mode. Therefore, the pageframes are
+ * actually allocated and copied only on the first write attempt, in
+ * handle_potential_cow(). Only the page containing the end of the file data
+ * needs to be copied eagerly. See load_rw_tail_page().
+ */
+static int
+load_rw_segment_by_mmap(fs_handle *elf_h,
+                        pdir_t *pdir,
+                        Elf_Phdr *phdr,
+                        ulong *end_vaddr_ref)
+{
+   const ulong va_begin = phdr->p_vaddr & PAGE_MASK;
+   const ulong file_end_va = phdr->p_vaddr + phdr->p_filesz;
+   const ulong file_pages_end_va = file_end_va & PAGE_MASK;
+   const ulong va_end =
+      round_up_at(phdr->p_vaddr + phdr->p_memsz, PAGE_SIZE);
+
+   ulong va = va_begin;
+   size_t page_count, count;
+   int rc;
+
+   if (MMAP_NO_COW || is_mapped(pdir, (void *)va_begin)) {
+
+      /*
+       * Either we've been configured to not use CoW at all or the first page
+       * of this segment overlaps with the last one of the previous segment.
+       * In both cases, just fall back to the simple copy-based approach.
+       */
+      return load_segment_by_copy(elf_h, pdir, phdr, end_vaddr_ref);
+   }
+
+   *end_vaddr_ref = va_end;
+
+   if (file_pages_end_va > va_begin) {
+
+      struct user_mapping um = {0};
+      um.pi = NULL;
+      um.h = elf_h;
+      um.off = phdr->p_offset & PAGE_MASK;
+      um.vaddr = va_begin;
+      um.len = file_pages_end_va - va_begin;
+      um.prot = PROT_READ;
+
+      if ((rc = vfs_mmap(&um, pdir, VFS_MM_DONT_REGISTER)))
+         return rc;
+
+      for (; va < file_pages_end_va; va += PAGE_SIZE) {
+
+         if (is_mapped(pdir, (void *)va)) {
+            set_page_cow(pdir, (void *)va);
+            continue;
+         }
+
+         /* A hole in a sparse file: it's all zeros */
+         if ((rc = map_zero_page(pdir, (void *)va, PAGING_FL_RWUS)))
+            return rc;
+      }
+   }
+
+   /*
+    * NOTE: a pure-bss segment (p_filesz == 0) with an unaligned p_vaddr has
+    * file_end_va > file_pages_end_va too, but there's nothing to copy: its
+    * first page is handled below like the rest of the .bss.
+    */
+   if (phdr->p_filesz > 0 && file_end_va > file_pages_end_va) {
+
+      if ((rc = load_rw_tail_page(elf_h, pdir, phdr, va)))
+         return rc;
+
+      va += PAGE_SIZE;
+   }
+
+   if (va < va_end) {
+
+      page_count = (va_end - va) >> PAGE_SHIFT;
+      count = map_zero_pages(pdir, (void *)va, page_count, PAGING_FL_RWUS);
+
+      if (count != page_count)
+         return -ENOMEM;
+   }
+
+   return 0;
+}
+
 static int
 load_segment_by_mmap(fs_handle *elf_h,
                      pdir_t *pdir,
                      Elf_Phdr *phdr,
                      ulong *end_vaddr_ref)
 {
-   if (phdr->p_flags & PF_W)
-      return load_segment_by_copy(elf_h, pdir, phdr, end_vaddr_ref);
-
    if (UNLIKELY(phdr->p_memsz == 0))
       return 0; /* very weird (because the phdr has type LOAD) */
 
+   if (phdr->p_flags & PF_W)
+      return load_rw_segment_by_mmap(elf_h, pdir, phdr, end_vaddr_ref);
+
    /*
     * Logic behind the calculation of `um.len`.
     *
@@ -308,31 +451,32 @@ alloc_and_map_stack_page(pdir_t *pdir, void *stack_top, u32 i)
 }
 
 static int
-open_elf_file(const char *filepath, fs_handle *elf_file_ref)
+open_elf_file(const char *filepath,
+              fs_handle *elf_file_ref,
+              struct k_stat64 *statbuf)
 {
-   struct k_stat64 statbuf;
    fs_handle h;
    int rc;
 
    if ((rc = vfs_open(filepath, &h, O_RDONLY, 0)))
       return rc;           /* The file does not exist (typical case) */
 
-   if ((rc = vfs_fstat64(h, &statbuf))) {
+   if ((rc = vfs_fstat64(h, statbuf))) {
       vfs_close(h);
       return rc;           /* Cannot stat() the file */
    }
 
-   if ((statbuf.st_mode & S_IFREG) != S_IFREG) {
+   if ((statbuf->st_mode & S_IFREG) != S_IFREG) {
 
       vfs_close(h);
 
-      if ((statbuf.st_mode & S_IFDIR) == S_IFDIR)
+      if ((statbuf->st_mode & S_IFDIR) == S_IFDIR)
          return -EISDIR;   /* Cannot execute a directory! */
 
       return -EACCES;      /* Not a regular file */
    }
 
-   if ((statbuf.st_mode & S_IXUSR) != S_IXUSR) {
+   if ((statbuf->st_mode & S_IXUSR) != S_IXUSR) {
       vfs_close(h);
       return -EACCES;      /* Doesn't have exec permission */
    }
@@ -357,12 +501,143 @@ is_dyn_exec(struct elf_headers *eh)
    return false;
 }
 
+static inline vfs_inode_ptr_t
+get_elf_inode(fs_handle elf_h)
+{
+   return get_fs(elf_h)->fsops->get_inode(elf_h);
+}
+
+static inline bool
+is_ro_load_segment(Elf_Phdr *phdr)
+{
+   return phdr->p_type == PT_LOAD &&
+          phdr->p_memsz > 0 &&
+          !(phdr->p_flags & PF_W);
+}
+
+/*
+ * Walk the pages of the read-only segments, as they've been mapped in `pdir`
+ * by load_segment_by_mmap(), and collect them in runs of physically contiguous
+ * pages. When `runs` is NULL, just count them.
+ */
+static size_t
+collect_ro_page_runs(struct elf_headers *eh,
+                     pdir_t *pdir,
+                     struct exec_page_run *runs)
+{
+   struct exec_page_run tmp = {0};
+   struct exec_page_run *last = NULL;
+   size_t count = 0;
+   ulong pa;
+
+   for (int i = 0; i < eh->header->e_phnum; i++) {
+
+      Elf_Phdr *phdr = eh->phdrs + i;
+
+      if (!is_ro_load_segment(phdr))
+         continue;
+
+      const ulong va_begin = phdr->p_vaddr & PAGE_MASK;
+      const ulong va_end =
+         round_up_at(phdr->p_vaddr + phdr->p_memsz, PAGE_SIZE);
+
+      for (ulong va = va_begin; va < va_end; va += PAGE_SIZE) {
+
+         if (get_mapping2(pdir, (void *)va, &pa))
+            continue;   /* Past the end of the file: not mapped */
+
+         if (last &&
+             last->vaddr + (last->page_count << PAGE_SHIFT) == va &&
+             last->paddr + (last->page_count << PAGE_SHIFT) == pa)
+         {
+            last->page_count++;
+            continue;
+         }
+
+         /* In counting-only mode, just use `tmp` to track the last run */
+         last = runs ? &runs[count] : &tmp;
+         *last = (struct exec_page_run) {
+            .vaddr = va,
+            .paddr = pa,
+            .page_count = 1,
+         };
+
+         count++;
+      }
+   }
+
+   return count;
+}
+
+/*
+ * After successfully loading a program with load_segment_by_mmap(), save in
+ * the exec cache everything we need to skip, next time, both the parsing of
+ * the headers and the mapping of the read-only segments. Failing to do that
+ * (e.g. because we're out of memory) is not fatal at all.
+ */
+static void
+exec_cache_add_program(fs_handle elf_h,
+                       const struct k_stat64 *statbuf,
+                       char *header_buf,
+                       struct elf_headers *eh,
+                       pdir_t *pdir)
+{
+   struct exec_cache_entry *ce;
+   size_t runs_count;
+
+   if (!eh->total_phdrs_size)
+      return;
+
+   if (!(runs_count = collect_ro_page_runs(eh, pdir, NULL)))
+      return;
+
+   ce = exec_cache_new_entry(get_fs(elf_h),
+                             get_elf_inode(elf_h),
+                             statbuf,
+                             header_buf,
+                             eh->phdrs,
+                             eh->total_phdrs_size,
+                             runs_count);
+
+   if (!ce)
+      return;
+
+   collect_ro_page_runs(eh, pdir, ce->runs);
+   exec_cache_insert(ce);
+}
+
+/*
+ * Map the read-only segments of a program, by using the physical pages saved
+ * in the exec cache. That's what load_segment_by_mmap() would have done, but
+ * without walking through the file system.
+ */
+static int
+map_cached_ro_segments(struct exec_cache_entry *ce, pdir_t *pdir)
+{
+   for (size_t i = 0; i < ce->runs_count; i++) {
+
+      struct exec_page_run *r = &ce->runs[i];
+      size_t count = map_pages(pdir,
+                               (void *)r->vaddr,
+                               r->paddr,
+                               r->page_count,
+                               PAGING_FL_US | PAGING_FL_SHARED);
+
+      if (count != r->page_count)
+         return -ENOMEM;
+   }
+
+   return 0;
+}
+
 int
 load_elf_program(const char *filepath,
                  char *header_buf,
                  struct elf_program_info *pinfo)
 {
    load_segment_func load_seg = NULL;
+   struct exec_cache_entry *ce = NULL;
+   struct k_stat64 statbuf;
    fs_handle elf_h = NULL;
    struct elf_headers eh;
    ulong brk = 0;
@@ -372,7 +647,7 @@ load_elf_program(const char *filepath,
    pinfo->wrong_arch = false;
    pinfo->dyn_exec = false;
 
-   if ((rc = open_elf_file(filepath, &elf_h)))
+   if ((rc = open_elf_file(filepath, &elf_h, &statbuf)))
       return rc;
 
    if ((rc = acquire_subsys_flock_h(elf_h, SUBSYS_PROCMGNT, &pinfo->lf))) {
@@ -380,9 +655,32 @@ load_elf_program(const char *filepath,
       return rc == -EBADF ? -ENOEXEC : rc;
    }
 
-   if ((rc = load_elf_headers(elf_h, header_buf, &eh, &pinfo->wrong_arch))) {
-      vfs_close(elf_h);
-      return rc;
+   if (is_mmap_supported(elf_h))
+      ce = exec_cache_lookup(get_fs(elf_h), get_elf_inode(elf_h), &statbuf);
+
+   if (ce) {
+
+      /*
+       * Cache hit: the headers have already been read and validated by a
+       * previous execve() of the same file. Note: total_phdrs_size = 0 means
+       * that `phdrs` is not owned by `eh`.
+       */
+      memcpy(header_buf, ce->hdr_buf, ELF_RAW_HEADER_SIZE);
+      eh = (struct elf_headers) {
+         .header_buf = header_buf,
+         .header = (void *)header_buf,
+         .phdrs = ce->phdrs,
+         .total_phdrs_size = 0,
+      };
+
+   } else {
+
+      rc = load_elf_headers(elf_h, header_buf, &eh, &pinfo->wrong_arch);
+
+      if (rc) {
+         vfs_close(elf_h);
+         return rc;
+      }
    }
 
    if (is_dyn_exec(&eh)) {
@@ -402,6 +700,9 @@ load_elf_program(const char *filepath,
       goto out;
    }
 
+   if (ce && (rc = map_cached_ro_segments(ce, pinfo->pdir)))
+      goto out;
+
    for (int i = 0; i < eh.header->e_phnum; i++) {
 
       ulong end_vaddr = 0;
@@ -410,20 +711,31 @@ load_elf_program(const char *filepath,
       if (phdr->p_type != PT_LOAD)
          continue;
 
-      rc = check_segment_alignment(phdr);
+      if (ce && is_ro_load_segment(phdr)) {
 
-      if (rc < 0)
-         goto out;
+         /* Already mapped by map_cached_ro_segments() */
+         end_vaddr = round_up_at(phdr->p_vaddr + phdr->p_memsz, PAGE_SIZE);
 
-      rc = load_seg(elf_h, pinfo->pdir, phdr, &end_vaddr);
+      } else {
 
-      if (rc < 0)
-         goto out;
+         rc = check_segment_alignment(phdr);
+
+         if (rc < 0)
+            goto out;
+
+         rc = load_seg(elf_h, pinfo->pdir, phdr, &end_vaddr);
+
+         if (rc < 0)
+            goto out;
+      }
 
       if (end_vaddr > brk)
          brk = end_vaddr;
    }
 
+   if (!ce && load_seg == &load_segment_by_mmap)
+      exec_cache_add_program(elf_h, &statbuf, header_buf, &eh, pinfo->pdir);
+
    /*
     * Mapping the user stack.
     *
@@ -466,6 +778,9 @@ out:
    vfs_close(elf_h);
    free_elf_headers(&eh);
 
+   if (ce)
+      exec_cache_release(ce);
+
    if (UNLIKELY(rc != 0)) {
 
       if (pinfo->pdir) {
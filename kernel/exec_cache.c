@@ -0,0 +1,216 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/exec_cache.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/sched.h>
+
+struct exec_cache_stats exec_cache_stats;
+
+static struct exec_cache_entry *entries[EXEC_CACHE_MAX_ENTRIES];
+static u64 use_counter;
+
+static void exec_cache_free_entry(struct exec_cache_entry *e)
+{
+   ASSERT(get_ref_count(e) == 0);
+   kfree_array_obj(e->runs, struct exec_page_run, e->runs_count);
+   kfree2(e->phdrs, e->phdrs_size);
+   kfree_obj(e, struct exec_cache_entry);
+}
+
+void exec_cache_release(struct exec_cache_entry *e)
+{
+   if (!release_obj(e))
+      exec_cache_free_entry(e);
+}
+
+static bool
+is_entry_valid(struct exec_cache_entry *e, const struct k_stat64 *st)
+{
+   return e->mtime_sec == (s64)st->st_mtim.tv_sec &&
+          e->mtime_nsec == (s64)st->st_mtim.tv_nsec &&
+          e->fsize == (s64)st->st_size;
+}
+
+/*
+ * Remove the entry at slot `i` from the table, returning it. Since the table
+ * holds a reference of each entry, the caller is supposed to call
+ * exec_cache_release() on the returned object, after enabling the preemption.
+ */
+static struct exec_cache_entry *remove_entry_at(int i)
+{
+   struct exec_cache_entry *e = entries[i];
+
+   ASSERT(!is_preemption_enabled());
+   ASSERT(e != NULL);
+
+   entries[i] = NULL;
+   exec_cache_stats.entries--;
+   return e;
+}
+
+struct exec_cache_entry *
+exec_cache_lookup(struct mnt_fs *fs,
+                  vfs_inode_ptr_t inode,
+                  const struct k_stat64 *st)
+{
+   struct exec_cache_entry *e = NULL;
+   struct exec_cache_entry *stale = NULL;
+
+   disable_preemption();
+   {
+      for (int i = 0; i < EXEC_CACHE_MAX_ENTRIES; i++) {
+
+         if (!entries[i])
+            continue;
+
+         if (entries[i]->fs != fs || entries[i]->inode != inode)
+            continue;
+
+         if (!is_entry_valid(entries[i], st)) {
+            stale = remove_entry_at(i);
+            exec_cache_stats.invalidations++;
+            break;
+         }
+
+         e = entries[i];
+         e->last_used = ++use_counter;
+         retain_obj(e);
+         break;
+      }
+
+      if (e)
+         exec_cache_stats.hits++;
+      else
+         exec_cache_stats.misses++;
+   }
+   enable_preemption();
+
+   if (stale)
+      exec_cache_release(stale);
+
+   return e;
+}
+
+struct exec_cache_entry *
+exec_cache_new_entry(struct mnt_fs *fs,
+                     vfs_inode_ptr_t inode,
+                     const struct k_stat64 *st,
+                     const char *hdr_buf,
+                     const Elf_Phdr *phdrs,
+                     size_t phdrs_size,
+                     size_t runs_count)
+{
+   struct exec_cache_entry *e;
+
+   ASSERT(phdrs_size > 0);
+   ASSERT(runs_count > 0);
+
+   if (!(e = kzalloc_obj(struct exec_cache_entry)))
+      return NULL;
+
+   if (!(e->phdrs = kmalloc(phdrs_size))) {
+      kfree_obj(e, struct exec_cache_entry);
+      return NULL;
+   }
+
+   if (!(e->runs = kalloc_array_obj(struct exec_page_run, runs_count))) {
+      kfree2(e->phdrs, phdrs_size);
+      kfree_obj(e, struct exec_cache_entry);
+      return NULL;
+   }
+
+   e->fs = fs;
+   e->inode = inode;
+   e->mtime_sec = (s64)st->st_mtim.tv_sec;
+   e->mtime_nsec = (s64)st->st_mtim.tv_nsec;
+   e->fsize = (s64)st->st_size;
+   e->phdrs_size = phdrs_size;
+   e->runs_count = runs_count;
+
+   memcpy(e->hdr_buf, hdr_buf, ELF_RAW_HEADER_SIZE);
+   memcpy(e->phdrs, phdrs, phdrs_size);
+   return e;
+}
+
+void exec_cache_insert(struct exec_cache_entry *e)
+{
+   struct exec_cache_entry *victim = NULL;
+   int free_slot = -1;
+   int lru_slot = -1;
+
+   ASSERT(get_ref_count(e) == 0);
+   retain_obj(e);          /* the table's reference */
+
+   disable_preemption();
+   {
+      for (int i = 0; i < EXEC_CACHE_MAX_ENTRIES; i++) {
+
+         if (!entries[i]) {
+
+            if (free_slot < 0)
+               free_slot = i;
+
+            continue;
+         }
+
+         if (entries[i]->fs == e->fs && entries[i]->inode == e->inode) {
+
+            /*
+             * Another task, racing with us, already inserted an entry for
+             * this very file. Just replace it.
+             */
+            victim = remove_entry_at(i);
+            free_slot = i;
+            break;
+         }
+
+         if (lru_slot < 0 ||
+             entries[i]->last_used < entries[lru_slot]->last_used)
+         {
+            lru_slot = i;
+         }
+      }
+
+      if (free_slot < 0) {
+         victim = remove_entry_at(lru_slot);
+         exec_cache_stats.evictions++;
+         free_slot = lru_slot;
+      }
+
+      e->last_used = ++use_counter;
+      entries[free_slot] = e;
+      exec_cache_stats.entries++;
+   }
+   enable_preemption();
+
+   if (victim)
+      exec_cache_release(victim);
+}
+
+void __exec_cache_invalidate(struct mnt_fs *fs, vfs_inode_ptr_t inode)
+{
+   struct exec_cache_entry *victims[EXEC_CACHE_MAX_ENTRIES];
+   int count = 0;
+
+   disable_preemption();
+   {
+      for (int i = 0; i < EXEC_CACHE_MAX_ENTRIES; i++) {
+
+         if (!entries[i] || entries[i]->fs != fs)
+            continue;
+
+         if (inode && entries[i]->inode != inode)
+            continue;
+
+         victims[count++] = remove_entry_at(i);
+         exec_cache_stats.invalidations++;
+      }
+   }
+   enable_preemption();
+
+   for (int i = 0; i < count; i++)
+      exec_cache_release(victims[i]);
+}
@@ -13,6 +13,7 @@
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/fs/fd_table.h>
 
 #include <tilck/mods/tracing.h>
 
@@ -100,14 +101,17 @@ static void
 close_all_handles(void)
 {
    struct process *pi = get_curr_proc();
+   struct fd_table *fdt;
    ASSERT(is_preemption_enabled());
 
-   for (int i = 0; i < MAX_HANDLES; i++) {
-      if (pi->handles[i]) {
-         vfs_close(pi->handles[i]);
-         pi->handles[i] = NULL;
-      }
+   kmutex_lock(&pi->fslock);
+   {
+      fdt = pi->fdt;
+      pi->fdt = NULL;
    }
+   kmutex_unlock(&pi->fslock);
+
+   fdt_release(fdt);
 }
 
 struct on_task_exit_cb {
@@ -9,55 +9,13 @@
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/paging_hw.h>
 #include <tilck/kernel/process_mm.h>
-#include <tilck/kernel/test/fork.h>
+#include <tilck/kernel/fs/fd_table.h>
 
-STATIC int fork_dup_all_handles(struct process *pi)
-{
-   ASSERT(!is_preemption_enabled());
-
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
-
-      int rc;
-      fs_handle dup_h = NULL;
-      fs_handle h = pi->handles[i];
-      struct user_mapping *um;
-
-      if (!h)
-         continue;
-
-      rc = vfs_dup(h, &dup_h);
-
-      if (rc < 0 || !dup_h) {
-
-         enable_preemption();
-         {
-            for (u32 j = 0; j < i; j++)
-               vfs_close(pi->handles[j]);
-         }
-         disable_preemption();
-         return -ENOMEM;
-      }
-
-      /* Update file handle's process pointer to the new process */
-      ((struct fs_handle_base *)dup_h)->pi = pi;
-
-      /* Replace the older (parent's) handle with the new one */
-      pi->handles[i] = dup_h;
-
-      if (!pi->mi)
-         continue;
-
-      list_for_each_ro(um, &pi->mi->mappings, pi_node) {
-         if (um->h == h)
-            um->h = dup_h;
-      }
-   }
-
-   return 0;
-}
-
-// Returns child's pid
-int do_fork(bool vfork)
+/*
+ * Returns child's pid. When `user_stack` is not NULL, the child will start
+ * running in user space with that stack pointer (see sys_clone()).
+ */
+int do_fork(bool vfork, void *user_stack)
 {
    int pid;
    int rc = -EAGAIN;
@@ -105,10 +63,13 @@ int do_fork(bool vfork)
    *child->state_regs = *curr->state_regs; // copy parent's regs_t
    set_return_register(child->state_regs, 0);
 
+   if (user_stack)
+      regs_set_user_stack_ptr(child->state_regs, (ulong)user_stack);
+
    // Make the parent to get child's pid as return value.
    set_return_register(curr->state_regs, (ulong) child->tid);
 
-   if (fork_dup_all_handles(child->pi) < 0)
+   if (fdt_fork(child->pi) < 0)
       goto oom_case;
 
    add_task(child);
@@ -128,6 +89,9 @@ int do_fork(bool vfork)
        */
 
       set_curr_pdir(curr_pi->pdir);
+
+      /* Same for the other threads of the parent, on the other CPUs */
+      smp_flush_tlb_others();
    }
 
    enable_preemption();
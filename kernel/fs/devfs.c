@@ -14,6 +14,7 @@
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/rwlock.h>
+#include <tilck/kernel/lockstat.h>
 #include <tilck/kernel/paging.h>
 
 #include <dirent.h> // system header
@@ -52,6 +53,9 @@ register_driver(struct driver_info *info, int arg_major)
 {
    u16 major;
 
+   /* Modules can register drivers concurrently: see init_modules() */
+   disable_preemption();
+
    /* Be sure there's always enough space. */
    VERIFY(drivers_count < ARRAY_SIZE(drivers) - 1);
 
@@ -74,6 +78,7 @@ register_driver(struct driver_info *info, int arg_major)
 
    info->major = major;
    drivers[drivers_count++] = info;
+   enable_preemption();
    return major;
 }
 
@@ -121,7 +126,12 @@ create_dev_file(const char *filename, u16 major, u16 minor, void **devfile)
 
    d = fs->device_data;
 
-   f->inode = devfs_get_next_inode(d);
+   rwlock_wp_exlock(&d->rwlock);
+   {
+      f->inode = devfs_get_next_inode(d);
+   }
+   rwlock_wp_exunlock(&d->rwlock);
+
    f->name = filename;
    f->dev_major = major;
    f->dev_minor = minor;
@@ -143,7 +153,11 @@ create_dev_file(const char *filename, u16 major, u16 minor, void **devfile)
       return -EINVAL;
    }
 
-   list_add_tail(&d->root_dir.files_list, &f->dir_node);
+   rwlock_wp_exlock(&d->rwlock);
+   {
+      list_add_tail(&d->root_dir.files_list, &f->dir_node);
+   }
+   rwlock_wp_exunlock(&d->rwlock);
 
    if (devfile)
       *devfile = f;
@@ -220,6 +234,11 @@ devfs_stat(struct mnt_fs *fs, vfs_inode_ptr_t i, struct k_stat64 *statbuf)
          statbuf->st_ino = df->inode;
          break;
 
+      case VFS_BLOCK_DEV:
+         statbuf->st_mode = 0660 | S_IFBLK;
+         statbuf->st_ino = df->inode;
+         break;
+
       default:
          panic("devfs: Invalid dentry type: %d", df->type);
    }
@@ -228,7 +247,7 @@ devfs_stat(struct mnt_fs *fs, vfs_inode_ptr_t i, struct k_stat64 *statbuf)
    statbuf->st_uid = 0; /* root */
    statbuf->st_gid = 0; /* root */
 
-   if (df->type == VFS_CHAR_DEV)
+   if (df->type == VFS_CHAR_DEV || df->type == VFS_BLOCK_DEV)
       statbuf->st_rdev = (dev_t)(df->dev_major << 8 | df->dev_minor);
 
    statbuf->st_size = 0;
@@ -275,8 +294,10 @@ devfs_open_file(struct mnt_fs *fs, struct devfs_file *pos, fs_handle *out)
       return -ENOMEM;
 
    if (pos->nfo.create_extra) {
-      if ((rc = pos->nfo.create_extra(pos->dev_minor, h->extra)))
+      if ((rc = pos->nfo.create_extra(pos->dev_minor, h->extra))) {
+         vfs_free_handle(h);
          return rc;
+      }
    }
 
    h->file       = pos;
@@ -450,6 +471,7 @@ devfs_get_inode(fs_handle h)
          return &ddata->root_dir;
 
       case VFS_CHAR_DEV:
+      case VFS_BLOCK_DEV:
          return dh->file;
 
       default:
@@ -522,6 +544,7 @@ create_devfs(void)
    d->root_dir.inode = devfs_get_next_inode(d);
    list_init(&d->root_dir.files_list);
    rwlock_wp_init(&d->rwlock, false);
+   lockstat_register_rwlock(&d->rwlock, "devfs", -1);
    d->wrt_time = (time_t)get_timestamp();
 
    return fs;
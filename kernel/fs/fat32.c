@@ -9,6 +9,8 @@
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/user.h>
+#include <tilck/kernel/blkdev.h>
+#include <tilck/kernel/bintree.h>
 
 #include <dirent.h> // system header
 
@@ -16,6 +18,80 @@ int fat_mmap(struct user_mapping *um, pdir_t *pdir, int flags);
 int fat_munmap(struct user_mapping *um, void *vaddrp, size_t len);
 int fat_ramdisk_prepare_for_mmap(struct fat_fs_device_data *d, size_t rd_size);
 
+/*
+ * When the FAT partition is on a block device, the clusters containing dir
+ * entries are read once and kept in memory until umount, because the rest of
+ * the code uses pointers to struct fat_entry as inodes. The clusters of the
+ * regular files are read instead through the page cache of the block device.
+ */
+struct fat_cached_cluster {
+
+   struct bintree_node node;
+   ulong clu;
+   void *data;
+};
+
+static inline u64
+fat_bdev_cluster_off(struct fat_fs_device_data *d, u32 clu)
+{
+   const u64 sector = fat_get_sector_for_cluster(d->hdr, clu);
+   return sector * fat_get_sector_size(d->hdr);
+}
+
+static void *fat_bdev_get_cluster(void *arg, u32 clu)
+{
+   struct fat_fs_device_data *d = arg;
+   struct fat_cached_cluster *c;
+   ssize_t rc;
+
+   if (clu < 2 || clu >= fat_get_cluster_count(d->hdr) + 2)
+      return NULL; /* corrupted file system */
+
+   kmutex_lock(&d->clu_cache_lock);
+
+   c = bintree_find_ptr(d->clu_cache_root,
+                        clu,
+                        struct fat_cached_cluster,
+                        node,
+                        clu);
+
+   if (c)
+      goto out;
+
+   if (!(c = kalloc_obj(struct fat_cached_cluster)))
+      goto out;
+
+   if (!(c->data = kmalloc(d->cluster_size))) {
+      kfree_obj(c, struct fat_cached_cluster);
+      c = NULL;
+      goto out;
+   }
+
+   rc = blkdev_read(d->bdev,
+                    fat_bdev_cluster_off(d, clu),
+                    c->data,
+                    d->cluster_size);
+
+   if (rc != (ssize_t)d->cluster_size) {
+      kfree2(c->data, d->cluster_size);
+      kfree_obj(c, struct fat_cached_cluster);
+      c = NULL;
+      goto out;
+   }
+
+   bintree_node_init(&c->node);
+   c->clu = clu;
+   bintree_insert_ptr(&d->clu_cache_root,
+                      c,
+                      struct fat_cached_cluster,
+                      node,
+                      clu);
+
+out:
+   kmutex_unlock(&d->clu_cache_lock);
+   return c ? c->data : NULL;
+}
+
 /*
  * Special fat_walk() wrapper handling the special case where `e` is NOT a dir
  * entry but a pointer to the entries in the root directory.
@@ -26,6 +102,11 @@ fat_fs_walk_generic(struct fat_fs_device_data *d,
                     struct fat_walk_static_params *static_walk_params,
                     struct fat_entry *e)
 {
+   if (d->bdev) {
+      static_walk_params->clu_data_cb = &fat_bdev_get_cluster;
+      static_walk_params->clu_data_arg = d;
+   }
+
    return fat_walk(static_walk_params,
                    e == d->root_dir_entries
                      ? d->root_cluster
@@ -63,8 +144,6 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
 
    do {
 
-      char *data = fat_get_pointer_to_cluster_data(d->hdr, h->curr_cluster);
-
       const offt file_rem       = fsize - *pos;
       const offt buf_rem        = (offt)bufsize - written_to_buf;
       const offt cluster_off    = *pos % (offt)d->cluster_size;
@@ -73,7 +152,27 @@ fat_read(fs_handle handle, char *buf, size_t bufsize, offt *pos)
 
       ASSERT(to_read >= 0);
 
-      memcpy(buf + written_to_buf, data + cluster_off, (size_t)to_read);
+      if (d->bdev) {
+
+         const u64 off =
+            fat_bdev_cluster_off(d, h->curr_cluster) + (u64)cluster_off;
+
+         ssize_t rc = blkdev_read(d->bdev,
+                                  off,
+                                  buf + written_to_buf,
+                                  (size_t)to_read);
+
+         if (rc != (ssize_t)to_read)
+            return written_to_buf ? (ssize_t)written_to_buf : -EIO;
+
+      } else {
+
+         char *data =
+            fat_get_pointer_to_cluster_data(d->hdr, h->curr_cluster);
+
+         memcpy(buf + written_to_buf, data + cluster_off, (size_t)to_read);
+      }
+
       written_to_buf += to_read;
       *pos += to_read;
 
@@ -656,3 +755,148 @@ void fat_umount_ramdisk(struct mnt_fs *fs)
    kfree_obj(fs->device_data, struct fat_fs_device_data);
    destory_fs_obj(fs);
 }
+
+static int fat_bdev_check_hdr(struct fat_hdr *hdr, u8 *sector0)
+{
+   const u32 bps = hdr->BPB_BytsPerSec;
+
+   if (sector0[510] != 0x55 || sector0[511] != 0xaa)
+      return -EINVAL;
+
+   if (bps < 512 || bps > 4096 || (bps & (bps - 1)))
+      return -EINVAL;
+
+   if (!hdr->BPB_SecPerClus || (hdr->BPB_SecPerClus & (hdr->BPB_SecPerClus-1)))
+      return -EINVAL;
+
+   if (!hdr->BPB_NumFATs || !hdr->BPB_RsvdSecCnt || !fat_get_FATSz(hdr))
+      return -EINVAL;
+
+   if (fat_get_TotSec(hdr) <= fat_get_first_data_sector(hdr))
+      return -EINVAL;
+
+   if (fat_get_type(hdr) == fat12_type)
+      return -EINVAL; /* FAT12 is not supported */
+
+   return 0;
+}
+
+static void fat_bdev_free_clu_cache(struct fat_fs_device_data *d)
+{
+   struct fat_cached_cluster *c;
+
+   while ((c = bintree_get_first_obj(d->clu_cache_root,
+                                     struct fat_cached_cluster,
+                                     node)))
+   {
+      bintree_remove_ptr(&d->clu_cache_root,
+                         c,
+                         struct fat_cached_cluster,
+                         node,
+                         clu);
+
+      kfree2(c->data, d->cluster_size);
+      kfree_obj(c, struct fat_cached_cluster);
+   }
+}
+
+static void fat_bdev_free_device_data(struct fat_fs_device_data *d)
+{
+   fat_bdev_free_clu_cache(d);
+   kmutex_destroy(&d->clu_cache_lock);
+
+   if (d->hdr)
+      kfree2(d->hdr, d->hdr_size);
+
+   kfree_obj(d, struct fat_fs_device_data);
+}
+
+/*
+ * Mount a FAT16 or FAT32 partition on a block device, read-only. Only the
+ * boot sector, the FATs and the FAT16 root dir are kept in memory.
+ */
+int fat_mount_blkdev(struct blkdev *dev, u32 flags, struct mnt_fs **out)
+{
+   struct fat_fs_device_data *d;
+   struct mnt_fs *fs;
+   u8 *sector0;
+   int rc;
+
+   if (flags & VFS_FS_RW)
+      return -EROFS;
+
+   if (!(sector0 = kmalloc(BLK_SECTOR_SIZE)))
+      return -ENOMEM;
+
+   if (blkdev_read(dev, 0, sector0, BLK_SECTOR_SIZE) != BLK_SECTOR_SIZE) {
+      kfree2(sector0, BLK_SECTOR_SIZE);
+      return -EIO;
+   }
+
+   if ((rc = fat_bdev_check_hdr((void *)sector0, sector0))) {
+      kfree2(sector0, BLK_SECTOR_SIZE);
+      return rc;
+   }
+
+   if (!(d = kzalloc_obj(struct fat_fs_device_data))) {
+      kfree2(sector0, BLK_SECTOR_SIZE);
+      return -ENOMEM;
+   }
+
+   kmutex_init(&d->clu_cache_lock, 0);
+   d->bdev = dev;
+   d->hdr_size = fat_get_first_data_sector((void *)sector0)
+                    * fat_get_sector_size((void *)sector0);
+
+   kfree2(sector0, BLK_SECTOR_SIZE);
+
+   if (!(d->hdr = kmalloc(d->hdr_size))) {
+      rc = -ENOMEM;
+      goto err;
+   }
+
+   if (blkdev_read(dev, 0, d->hdr, d->hdr_size) != (ssize_t)d->hdr_size) {
+      rc = -EIO;
+      goto err;
+   }
+
+   d->type = fat_get_type(d->hdr);
+   d->cluster_size = fat_get_cluster_size(d->hdr);
+
+   if (d->type == fat16_type) {
+
+      d->root_dir_entries =
+         fat_get_rootdir(d->hdr, d->type, &d->root_cluster);
+
+   } else {
+
+      struct fat32_header2 *h2 = (void *)(d->hdr + 1);
+      d->root_cluster = h2->BPB_RootClus;
+      d->root_dir_entries = fat_bdev_get_cluster(d, d->root_cluster);
+
+      if (!d->root_dir_entries) {
+         rc = -EIO;
+         goto err;
+      }
+   }
+
+   fs = create_fs_obj("fat", &static_fsops_fat, d, flags | VFS_FS_RQ_DE_SKIP);
+
+   if (!fs) {
+      rc = -ENOMEM;
+      goto err;
+   }
+
+   *out = fs;
+   return 0;
+
+err:
+   fat_bdev_free_device_data(d);
+   return rc;
+}
+
+void fat_umount_blkdev(struct mnt_fs *fs)
+{
+   fat_bdev_free_device_data(fs->device_data);
+   destory_fs_obj(fs);
+}
@@ -0,0 +1,355 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_userlim.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/fs/fd_table.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/test/fd_table.h>
+
+#include <fcntl.h>      // system header
+
+#define FDT_MAX_SIZE     ((int)round_up_at(MAX_HANDLES, NBITS))
+
+static ALWAYS_INLINE size_t fdt_bitmap_words(int size)
+{
+   return (size_t)size / NBITS;
+}
+
+/*
+ * Size of the external storage used by tables larger than FDT_INLINE_FDS:
+ * it's a single chunk containing, in order: the array of handles, the bitmap
+ * of the open fds and the bitmap of the cloexec fds.
+ */
+static ALWAYS_INLINE size_t fdt_ext_storage_size(int size)
+{
+   return (size_t)size * sizeof(fs_handle) +
+          fdt_bitmap_words(size) * sizeof(ulong) * 2;
+}
+
+static ALWAYS_INLINE void
+set_bit_l(ulong *bitmap, int n, bool val)
+{
+   if (val)
+      bitmap[n / NBITS] |= (1UL << (n % NBITS));
+   else
+      bitmap[n / NBITS] &= ~(1UL << (n % NBITS));
+}
+
+static void fdt_use_inline_storage(struct fd_table *fdt)
+{
+   fdt->size = FDT_INLINE_FDS;
+   fdt->handles = fdt->inline_handles;
+   fdt->open_fds = fdt->inline_open_fds;
+   fdt->cloexec_fds = fdt->inline_cloexec_fds;
+}
+
+static struct fd_table *fdt_alloc(void)
+{
+   struct fd_table *fdt;
+
+   if (!(fdt = kzalloc_obj(struct fd_table)))
+      return NULL;
+
+   fdt_use_inline_storage(fdt);
+   return fdt;
+}
+
+static void fdt_free(struct fd_table *fdt)
+{
+   if (fdt->handles != fdt->inline_handles)
+      kfree2(fdt->handles, fdt_ext_storage_size(fdt->size));
+
+   kfree_obj(fdt, struct fd_table);
+}
+
+/* Grow `fdt` in order to have at least `min_size` slots */
+static int fdt_expand(struct fd_table *fdt, int min_size)
+{
+   const int old_size = fdt->size;
+   const size_t old_words = fdt_bitmap_words(old_size);
+   int new_size = MAX(old_size * 2, (int)round_up_at(min_size, NBITS));
+   size_t new_words;
+   void *storage;
+
+   ASSERT(min_size <= FDT_MAX_SIZE);
+
+   if (min_size <= old_size)
+      return 0;
+
+   new_size = MIN(new_size, FDT_MAX_SIZE);
+   new_words = fdt_bitmap_words(new_size);
+
+   if (!(storage = kzmalloc(fdt_ext_storage_size(new_size))))
+      return -ENOMEM;
+
+   {
+      fs_handle *handles = storage;
+      ulong *open_fds = (ulong *)(handles + new_size);
+      ulong *cloexec_fds = open_fds + new_words;
+
+      memcpy(handles, fdt->handles, sizeof(fs_handle) * (size_t)old_size);
+      memcpy(open_fds, fdt->open_fds, sizeof(ulong) * old_words);
+      memcpy(cloexec_fds, fdt->cloexec_fds, sizeof(ulong) * old_words);
+
+      if (fdt->handles != fdt->inline_handles)
+         kfree2(fdt->handles, fdt_ext_storage_size(old_size));
+
+      fdt->handles = handles;
+      fdt->open_fds = open_fds;
+      fdt->cloexec_fds = cloexec_fds;
+      fdt->size = new_size;
+   }
+
+   return 0;
+}
+
+/*
+ * Create a copy of `fdt` for the process `pi`, by duplicating all of its
+ * handles. Returns NULL in case of OOM. Called with preemption disabled.
+ */
+STATIC struct fd_table *fdt_dup(struct fd_table *fdt, struct process *pi)
+{
+   struct fd_table *new_fdt;
+   int i = 0;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (!(new_fdt = fdt_alloc()))
+      return NULL;
+
+   if (fdt_expand(new_fdt, fdt->size))
+      goto oom_case;
+
+   for (; i < fdt->size; i++) {
+
+      struct fs_handle_base *dup_h = NULL;
+      fs_handle h = fdt->handles[i];
+
+      if (!h)
+         continue;
+
+      if (vfs_dup(h, (fs_handle *)&dup_h) < 0 || !dup_h)
+         goto oom_case;
+
+      /* Update file handle's process pointer to the new process */
+      dup_h->pi = pi;
+
+      /* vfs_dup() drops the fd flags, but here we're copying the fd table */
+      if (fdt_is_cloexec(fdt, i))
+         dup_h->fd_flags |= FD_CLOEXEC;
+
+      new_fdt->handles[i] = dup_h;
+   }
+
+   memcpy(new_fdt->open_fds,
+          fdt->open_fds,
+          sizeof(ulong) * fdt_bitmap_words(fdt->size));
+
+   memcpy(new_fdt->cloexec_fds,
+          fdt->cloexec_fds,
+          sizeof(ulong) * fdt_bitmap_words(fdt->size));
+
+   new_fdt->next_fd = fdt->next_fd;
+   return new_fdt;
+
+oom_case:
+
+   enable_preemption();
+   {
+      for (int j = 0; j < i; j++) {
+         if (new_fdt->handles[j])
+            vfs_close(new_fdt->handles[j]);
+      }
+   }
+   disable_preemption();
+
+   fdt_free(new_fdt);
+   return NULL;
+}
+
+void fdt_release(struct fd_table *fdt)
+{
+   if (!fdt)
+      return;
+
+   for (int i = 0; i < fdt->size; i++) {
+      if (fdt->handles[i])
+         vfs_close(fdt->handles[i]);
+   }
+
+   fdt_free(fdt);
+}
+
+/*
+ * Called by fork() on the child process `pi`, which still points to the fd
+ * table of its parent: replace it with a copy, where all the handles have been
+ * duplicated. Therefore, just like before the introduction of fd tables, the
+ * file offsets of the child are independent from the parent's ones since the
+ * beginning.
+ */
+int fdt_fork(struct process *pi)
+{
+   struct fd_table *parent_fdt = pi->fdt;
+   struct fd_table *new_fdt;
+   struct user_mapping *um;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (!parent_fdt)
+      return 0;
+
+   if (!(new_fdt = fdt_dup(parent_fdt, pi))) {
+      pi->fdt = NULL;
+      return -ENOMEM;
+   }
+
+   /*
+    * The child's file mappings reference the parent's handles: make them
+    * reference the child's copies. Exception: a vforked process shares its
+    * mappings with its parent, which continues to own the original handles.
+    */
+   if (pi->mi && !pi->vforked) {
+
+      list_for_each_ro(um, &pi->mi->mappings, pi_node) {
+
+         for (int i = 0; i < parent_fdt->size; i++) {
+            if (parent_fdt->handles[i] && um->h == parent_fdt->handles[i]) {
+               um->h = new_fdt->handles[i];
+               break;
+            }
+         }
+      }
+   }
+
+   pi->fdt = new_fdt;
+   return 0;
+}
+
+/* The fd table is allocated lazily, on the first open fd */
+static int fdt_alloc_if_needed(struct process *pi)
+{
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+
+   if (pi->fdt)
+      return 0;
+
+   if (!(pi->fdt = fdt_alloc()))
+      return -ENOMEM;
+
+   return 0;
+}
+
+int fdt_reserve_fd(struct process *pi, int fd)
+{
+   int rc;
+   ASSERT(IN_RANGE(fd, 0, MAX_HANDLES));
+
+   if ((rc = fdt_alloc_if_needed(pi)))
+      return rc;
+
+   return fdt_expand(pi->fdt, fd + 1);
+}
+
+int fdt_get_free_fd(struct process *pi, int ge)
+{
+   struct fd_table *fdt;
+   int fd, rc;
+
+   if (!IN_RANGE(ge, 0, MAX_HANDLES))
+      return -EMFILE;
+
+   if ((rc = fdt_alloc_if_needed(pi)))
+      return rc;
+
+   fdt = pi->fdt;
+   fd = MAX(ge, fdt->next_fd);
+
+   for (int w = fd / NBITS; w < (int)fdt_bitmap_words(fdt->size); w++) {
+
+      /* Ignore the bits below `fd` in the first word */
+      ulong word = fdt->open_fds[w];
+
+      if (w == fd / NBITS && (fd % NBITS))
+         word |= make_bitmask((ulong)(fd % NBITS));
+
+      if (word != ~0UL) {
+         fd = w * NBITS + (int)get_first_zero_bit_index_l(word);
+         goto found;
+      }
+   }
+
+   fd = MAX(fd, fdt->size);
+
+found:
+
+   if (fd >= MAX_HANDLES)
+      return -EMFILE;
+
+   if ((rc = fdt_expand(fdt, fd + 1)))
+      return rc;
+
+   return fd;
+}
+
+void fdt_install(struct process *pi, int fd, fs_handle h)
+{
+   struct fd_table *fdt = pi->fdt;
+   struct fs_handle_base *hb = h;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+   ASSERT(fdt != NULL);
+   ASSERT(IN_RANGE(fd, 0, fdt->size));
+   ASSERT(!fdt->handles[fd]);
+
+   fdt->handles[fd] = h;
+   set_bit_l(fdt->open_fds, fd, true);
+   set_bit_l(fdt->cloexec_fds, fd, !!(hb->fd_flags & FD_CLOEXEC));
+
+   if (fd == fdt->next_fd)
+      fdt->next_fd++;
+}
+
+fs_handle fdt_remove(struct process *pi, int fd)
+{
+   struct fd_table *fdt = pi->fdt;
+   fs_handle h;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+   ASSERT(fdt != NULL);
+
+   if (!(h = fdt_get(fdt, fd)))
+      return NULL;
+
+   fdt->handles[fd] = NULL;
+   set_bit_l(fdt->open_fds, fd, false);
+   set_bit_l(fdt->cloexec_fds, fd, false);
+
+   if (fd < fdt->next_fd)
+      fdt->next_fd = fd;
+
+   return h;
+}
+
+void fdt_set_cloexec(struct process *pi, int fd, bool val)
+{
+   struct fd_table *fdt = pi->fdt;
+   struct fs_handle_base *hb = fdt_get(fdt, fd);
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+   ASSERT(hb != NULL);
+
+   set_bit_l(fdt->cloexec_fds, fd, val);
+
+   if (val)
+      hb->fd_flags |= FD_CLOEXEC;
+   else
+      hb->fd_flags &= ~FD_CLOEXEC;
+}
@@ -1,11 +1,13 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/fs/kernelfs.h>
+#include <tilck/kernel/fs/fd_table.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/fault_resumable.h>
@@ -14,25 +16,17 @@
 
 #include <fcntl.h>      // system header
 
-static inline bool is_fd_in_valid_range(int fd)
-{
-   return IN_RANGE(fd, 0, MAX_HANDLES);
-}
+#ifndef CLOSE_RANGE_UNSHARE
+   #define CLOSE_RANGE_UNSHARE      (1U << 1)
+#endif
 
-static int get_free_handle_num_ge(struct process *pi, int ge)
-{
-   ASSERT(kmutex_is_curr_task_holding_lock(&pi->fslock));
+#ifndef CLOSE_RANGE_CLOEXEC
+   #define CLOSE_RANGE_CLOEXEC      (1U << 2)
+#endif
 
-   for (int free_fd = ge; free_fd < MAX_HANDLES; free_fd++)
-      if (!pi->handles[free_fd])
-         return free_fd;
-
-   return -1;
-}
-
-static int get_free_handle_num(struct process *pi)
+static inline bool is_fd_in_valid_range(int fd)
 {
-   return get_free_handle_num_ge(pi, 0);
+   return IN_RANGE(fd, 0, MAX_HANDLES);
 }
 
 /*
@@ -49,10 +43,9 @@ fs_handle get_fs_handle(int fd)
    fs_handle handle = NULL;
 
    kmutex_lock(&curr->pi->fslock);
-
-   if (is_fd_in_valid_range(fd) && curr->pi->handles[fd])
-      handle = curr->pi->handles[fd];
-
+   {
+      handle = fdt_get(curr->pi->fdt, fd);
+   }
    kmutex_unlock(&curr->pi->fslock);
    return handle;
 }
@@ -87,24 +80,22 @@ int sys_open(const char *u_path, int flags, mode_t mode)
 
    kmutex_lock(&curr->pi->fslock);
 
-   if ((free_fd = get_free_handle_num(curr->pi)) < 0)
-      goto no_fds;
+   if ((free_fd = fdt_get_free_fd(curr->pi, 0)) < 0) {
+      ret = free_fd;
+      goto end;
+   }
 
    if ((ret = vfs_open(path, &h, flags, mode)) < 0)
       goto end;
 
    ASSERT(h != NULL);
 
-   curr->pi->handles[free_fd] = h;
+   fdt_install(curr->pi, free_fd, h);
    ret = free_fd;
 
 end:
    kmutex_unlock(&curr->pi->fslock);
    return ret;
-
-no_fds:
-   ret = -EMFILE;
-   goto end;
 }
 
 int sys_creat(const char *u_path, mode_t mode)
@@ -140,20 +131,25 @@ int sys_rmdir(const char *u_path)
 
 int sys_close(int fd)
 {
-   struct task *curr = get_curr_task();
+   struct process *pi = get_curr_proc();
    fs_handle handle;
-   int ret = 0;
+   int rc;
 
-   if (!(handle = get_fs_handle(fd)))
-      return -EBADF;
+   kmutex_lock(&pi->fslock);
 
-   kmutex_lock(&curr->pi->fslock);
-   {
-      vfs_close(handle);
-      curr->pi->handles[fd] = NULL;
+   if (!fdt_get(pi->fdt, fd)) {
+      rc = -EBADF;
+      goto out;
    }
-   kmutex_unlock(&curr->pi->fslock);
-   return ret;
+
+   handle = fdt_remove(pi, fd);
+   ASSERT(handle != NULL);
+   vfs_close(handle);
+   rc = 0;
+
+out:
+   kmutex_unlock(&pi->fslock);
+   return rc;
 }
 
 int sys_mkdir(const char *u_path, mode_t mode)
@@ -359,6 +355,36 @@ int sys_writev(int fd, const struct iovec *u_iov, int u_iovcnt)
    return (int)vfs_writev(handle, iov, u_iovcnt);
 }
 
+int sys_vmsplice(int fd, const struct iovec *u_iov, ulong nr_segs, u32 flags)
+{
+   struct task *curr = get_curr_task();
+   struct iovec *iov = (void *)curr->args_copybuf;
+   struct fs_handle_base *hb;
+
+   if (flags & ~SPLICE_F_ALL)
+      return -EINVAL;
+
+   if (!nr_segs)
+      return 0;
+
+   if (nr_segs > ARGS_COPYBUF_SIZE / sizeof(struct iovec))
+      return -EINVAL;
+
+   if (copy_from_user(iov, u_iov, sizeof(struct iovec) * nr_segs))
+      return -EFAULT;
+
+   if (iov_len_overflow(iov, (int)nr_segs))
+      return -EINVAL;
+
+   if (!(hb = get_fs_handle(fd)))
+      return -EBADF;
+
+   if (!is_pipe_handle(hb))
+      return -EBADF;
+
+   return (int)pipe_vmsplice(hb, iov, (int)nr_segs, flags);
+}
+
 int sys_readv(int fd, const struct iovec *u_iov, int u_iovcnt)
 {
    struct task *curr = get_curr_task();
@@ -606,12 +632,21 @@ int sys_dup2(int oldfd, int newfd)
 
    kmutex_lock(&curr->pi->fslock);
 
-   if (!(old_h = get_fs_handle(oldfd))) {
+   if (!get_fs_handle(oldfd)) {
       rc = -EBADF;
       goto out;
    }
 
-   new_h = get_fs_handle(newfd);
+   /*
+    * Make sure our fd table is private and large enough for `newfd`. Note:
+    * get `old_h` only after that, since unsharing the table replaces all the
+    * handles with their copies.
+    */
+   if ((rc = fdt_reserve_fd(curr->pi, newfd)))
+      goto out;
+
+   old_h = get_fs_handle(oldfd);
+   new_h = fdt_remove(curr->pi, newfd);
 
    if (new_h) {
 
@@ -647,7 +682,7 @@ int sys_dup2(int oldfd, int newfd)
       goto out;
    }
 
-   curr->pi->handles[newfd] = new_h;
+   fdt_install(curr->pi, newfd, new_h);
    rc = newfd;
 
 out:
@@ -657,15 +692,13 @@ out:
 
 int sys_dup(int oldfd)
 {
-   int rc = -EMFILE, free_fd;
    struct process *pi = get_curr_proc();
+   int rc;
 
    kmutex_lock(&pi->fslock);
    {
-      free_fd = get_free_handle_num(pi);
-
-      if (is_fd_in_valid_range(free_fd))
-         rc = sys_dup2(oldfd, free_fd);
+      if ((rc = fdt_get_free_fd(pi, 0)) >= 0)
+         rc = sys_dup2(oldfd, rc);
    }
    kmutex_unlock(&pi->fslock);
    return rc;
@@ -710,23 +743,103 @@ static void debug_print_fcntl_command(int cmd)
    }
 }
 
+static bool fdt_has_cloexec_fds(struct fd_table *fdt)
+{
+   for (int w = 0; w < fdt_size(fdt) / NBITS; w++)
+      if (fdt->cloexec_fds[w])
+         return true;
+
+   return false;
+}
+
+static void close_fds_in_range(struct process *pi, int first, int last)
+{
+   const int size = fdt_size(pi->fdt);
+   fs_handle h;
+
+   for (int fd = first; fd <= last && fd < size; fd++) {
+      if ((h = fdt_remove(pi, fd)))
+         vfs_close(h);
+   }
+}
+
 void close_cloexec_handles(struct process *pi)
 {
+   struct fd_table *fdt;
+   int w;
+
    kmutex_lock(&pi->fslock);
 
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
+   /*
+    * Most of the times, there are no FD_CLOEXEC fds at all: in that case, we
+    * don't even need to scan the bitmap.
+    */
+   if (!fdt_has_cloexec_fds(pi->fdt))
+      goto out;
+
+   fdt = pi->fdt;
 
-      struct fs_handle_base *h = pi->handles[i];
+   for (w = 0; w < fdt_size(fdt) / NBITS; w++) {
 
-      if (h && (h->fd_flags & FD_CLOEXEC)) {
-         vfs_close(h);
-         pi->handles[i] = NULL;
+      ulong bits = fdt->cloexec_fds[w];
+
+      while (bits) {
+
+         const int bit = (int)get_first_set_bit_index_l(bits);
+         const int fd = w * NBITS + bit;
+
+         bits &= ~(1UL << bit);
+         vfs_close(fdt_remove(pi, fd));
       }
    }
 
+out:
    kmutex_unlock(&pi->fslock);
 }
 
+int sys_close_range(u32 first, u32 last, u32 flags)
+{
+   struct process *pi = get_curr_proc();
+   int rc = 0;
+
+   if (first > last)
+      return -EINVAL;
+
+   if (flags & ~(CLOSE_RANGE_UNSHARE | CLOSE_RANGE_CLOEXEC))
+      return -EINVAL;
+
+   if (first >= MAX_HANDLES)
+      return 0;
+
+   last = MIN(last, (u32)MAX_HANDLES - 1);
+   kmutex_lock(&pi->fslock);
+
+   /*
+    * CLOSE_RANGE_UNSHARE is about tables shared between threads: on Tilck,
+    * where processes have a single thread, fd tables are never shared.
+    * Therefore, the flag can be just ignored.
+    */
+
+   if (first >= (u32)fdt_size(pi->fdt))
+      goto out;
+
+   if (flags & CLOSE_RANGE_CLOEXEC) {
+
+      for (int fd = (int)first; fd <= (int)last; fd++) {
+         if (fdt_get(pi->fdt, fd))
+            fdt_set_cloexec(pi, fd, true);
+      }
+
+   } else {
+
+      close_fds_in_range(pi, (int)first, (int)last);
+   }
+
+out:
+   kmutex_unlock(&pi->fslock);
+   return rc;
+}
+
 int sys_fcntl64(int fd, int cmd, int arg)
 {
    int rc = 0;
@@ -741,8 +854,10 @@ int sys_fcntl64(int fd, int cmd, int arg)
       case F_DUPFD:
          {
             kmutex_lock(&curr->pi->fslock);
-            int new_fd = get_free_handle_num_ge(curr->pi, arg);
-            rc = sys_dup2(fd, new_fd);
+
+            if ((rc = fdt_get_free_fd(curr->pi, arg)) >= 0)
+               rc = sys_dup2(fd, rc);
+
             kmutex_unlock(&curr->pi->fslock);
             return rc;
          }
@@ -750,19 +865,23 @@ int sys_fcntl64(int fd, int cmd, int arg)
       case F_DUPFD_CLOEXEC:
          {
             kmutex_lock(&curr->pi->fslock);
-            int new_fd = get_free_handle_num_ge(curr->pi, arg);
-            if (!(rc = sys_dup2(fd, new_fd))) {
-               /* dup2 succeeded */
-               struct fs_handle_base *h2 = get_fs_handle(new_fd);
-               ASSERT(h2 != NULL);
-               h2->fd_flags |= FD_CLOEXEC;
-            }
+
+            if ((rc = fdt_get_free_fd(curr->pi, arg)) >= 0)
+               rc = sys_dup2(fd, rc);
+
+            if (rc >= 0)
+               fdt_set_cloexec(curr->pi, rc, true); /* dup2 succeeded */
+
             kmutex_unlock(&curr->pi->fslock);
             return rc;
          }
 
       case F_SETFD:
-         hb->fd_flags = arg & 0xffff;
+         kmutex_lock(&curr->pi->fslock);
+         {
+            fdt_set_cloexec(curr->pi, fd, !!(arg & FD_CLOEXEC));
+         }
+         kmutex_unlock(&curr->pi->fslock);
          break;
 
       case F_GETFD:
@@ -792,6 +911,10 @@ int sys_fcntl64(int fd, int cmd, int arg)
       case F_GETFL:
          return hb->fl_flags;
 
+      case F_SETPIPE_SZ:
+      case F_GETPIPE_SZ:
+         return vfs_fcntl(hb, cmd, arg);
+
       default:
          printk("fcntl64: Ignored unknown cmd %d\n", cmd);
    }
@@ -989,30 +1112,31 @@ int sys_pipe2(int u_pipefd[2], int flags)
       goto no_mem;
    }
 
-   if ((fds[0] = get_free_handle_num(curr->pi)) < 0)
+   if ((fds[0] = fdt_get_free_fd(curr->pi, 0)) < 0)
       goto no_fds;
 
    if (!(read_h = pipe_create_read_handle(p)))
       goto fault;
 
-   curr->pi->handles[fds[0]] = read_h;
+   if (flags & O_CLOEXEC)
+      read_h->fd_flags |= FD_CLOEXEC;
+
+   fdt_install(curr->pi, fds[0], read_h);
 
-   if ((fds[1] = get_free_handle_num(curr->pi)) < 0)
+   if ((fds[1] = fdt_get_free_fd(curr->pi, 0)) < 0)
       goto no_fds;
 
    if (!(write_h = pipe_create_write_handle(p)))
       goto fault;
 
-   curr->pi->handles[fds[1]] = write_h;
+   if (flags & O_CLOEXEC)
+      write_h->fd_flags |= FD_CLOEXEC;
+
+   fdt_install(curr->pi, fds[1], write_h);
 
    if (copy_to_user(u_pipefd, fds, sizeof(fds)))
       goto fault;
 
-   if (flags & O_CLOEXEC) {
-      read_h->fd_flags |= FD_CLOEXEC;
-      write_h->fd_flags |= FD_CLOEXEC;
-   }
-
 end:
    kmutex_unlock(&curr->pi->fslock);
    return ret;
@@ -1020,12 +1144,12 @@ end:
 err_end:
 
    if (read_h) {
-      curr->pi->handles[fds[0]] = NULL;
+      fdt_remove(curr->pi, fds[0]);
       kfs_destroy_handle((void *)read_h);
    }
 
    if (write_h) {
-      curr->pi->handles[fds[1]] = NULL;
+      fdt_remove(curr->pi, fds[1]);
       kfs_destroy_handle((void *)write_h);
    }
 
@@ -1044,6 +1168,6 @@ no_mem:
    goto err_end;
 
 no_fds:
-   ret = -EMFILE;
+   ret = fds[0] < 0 ? fds[0] : fds[1]; /* -EMFILE or -ENOMEM */
    goto err_end;
 }
@@ -1,10 +1,37 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
+#include <tilck/common/string_util.h>
+
 #include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/fat32.h>
 #include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/blkdev.h>
+#include <tilck/kernel/user.h>
+
+#include <sys/mount.h>  // system header
 
 #include "fs_int.h"
 
+static int
+mount_copy_str(char *dest, const char *user_src, size_t max_size)
+{
+   int rc = copy_str_from_user(dest, user_src, max_size, NULL);
+
+   if (rc < 0)
+      return -EFAULT;
+
+   if (rc > 0)
+      return -ENAMETOOLONG;
+
+   return 0;
+}
+
+/*
+ * Only FAT file systems on block devices are supported, in read-only mode.
+ * Mounting without MS_RDONLY fails with -EROFS, like on Linux for read-only
+ * devices: tools like busybox's mount retry with MS_RDONLY automatically.
+ */
 int
 sys_mount(const char *user_source,
           const char *user_target,
@@ -12,7 +39,46 @@ sys_mount(const char *user_source,
           unsigned long mountflags,
           const void *user_data)
 {
-   return -ENOSYS;
+   struct task *curr = get_curr_task();
+   char *source = curr->args_copybuf + (ARGS_COPYBUF_SIZE / 4) * 0;
+   char *target = curr->args_copybuf + (ARGS_COPYBUF_SIZE / 4) * 1;
+   char *fstype = curr->args_copybuf + (ARGS_COPYBUF_SIZE / 4) * 2;
+   struct blkdev *dev;
+   struct mnt_fs *fs;
+   int rc;
+
+   STATIC_ASSERT(ARGS_COPYBUF_SIZE / 4 >= MAX_PATH);
+
+   if (!user_source || !user_target || !user_fstype)
+      return -EINVAL;
+
+   if ((rc = mount_copy_str(source, user_source, MAX_PATH)))
+      return rc;
+
+   if ((rc = mount_copy_str(target, user_target, MAX_PATH)))
+      return rc;
+
+   if ((rc = mount_copy_str(fstype, user_fstype, 32)))
+      return rc;
+
+   if (strcmp(fstype, "vfat") && strcmp(fstype, "msdos"))
+      return -ENODEV;
+
+   if (!(mountflags & MS_RDONLY))
+      return -EROFS;
+
+   if ((rc = blkdev_lookup(source, &dev)))
+      return rc;
+
+   if ((rc = fat_mount_blkdev(dev, 0, &fs)))
+      return rc;
+
+   if ((rc = mp_add(fs, target))) {
+      fat_umount_blkdev(fs);
+      return rc;
+   }
+
+   return 0;
 }
 
 int sys_umount(const char *target, int flags)
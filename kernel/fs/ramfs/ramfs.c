@@ -7,6 +7,7 @@
 
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/fs/flock.h>
+#include <tilck/kernel/lockstat.h>
 #include <tilck/kernel/test/vfs.h>
 
 #include <sys/mman.h>      // system header
@@ -355,6 +356,7 @@ struct mnt_fs *ramfs_create(void)
    }
 
    rwlock_wp_init(&d->rwlock, false);
+   lockstat_register_rwlock(&d->rwlock, "ramfs", -1);
    d->next_inode_num = 1;
    d->root = ramfs_create_inode_dir(d, 0777, NULL);
 
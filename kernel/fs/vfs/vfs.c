@@ -11,6 +11,7 @@
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/exec_cache.h>
 
 #include <dirent.h> // system header
 
@@ -200,15 +201,32 @@ int vfs_ioctl(fs_handle h, ulong request, void *argp)
    return hb->fops->ioctl(h, request, argp);
 }
 
+/* Handle the fcntl() commands specific to a given type of file */
+int vfs_fcntl(fs_handle h, int cmd, int arg)
+{
+   NO_TEST_ASSERT(is_preemption_enabled());
+   ASSERT(h != NULL);
+
+   struct fs_handle_base *hb = (struct fs_handle_base *) h;
+
+   if (!hb->fops->fcntl)
+      return -EINVAL;
+
+   return hb->fops->fcntl(h, cmd, arg);
+}
+
 int vfs_ftruncate(fs_handle h, offt length)
 {
    struct fs_handle_base *hb = (struct fs_handle_base *) h;
    const struct fs_ops *fsops = hb->fs->fsops;
+   vfs_inode_ptr_t inode;
 
    if (!fsops->truncate)
       return -EROFS;
 
-   return fsops->truncate(hb->fs, fsops->get_inode(h), length);
+   inode = fsops->get_inode(h);
+   exec_cache_invalidate(hb->fs, inode);
+   return fsops->truncate(hb->fs, inode, length);
 }
 
 int vfs_fstat64(fs_handle h, struct k_stat64 *statbuf)
@@ -324,6 +342,14 @@ vfs_open_impl(struct mnt_fs *fs, struct vfs_path *p,
                ASSERT(hb->lf != NULL);
          }
       }
+
+      /*
+       * A file cannot be modified without opening it for writing first, which
+       * is mutually exclusive with executing it (see flock.c): therefore,
+       * this is the right place where to invalidate its exec cache entry.
+       */
+      if (flags & (O_WRONLY | O_RDWR | O_TRUNC))
+         exec_cache_invalidate(fs, fs->fsops->get_inode(*out));
    }
 
    /* file handles retain their struct mnt_fs */
@@ -443,6 +469,7 @@ vfs_unlink_impl(struct mnt_fs *fs,
    if (!p->fs_path.inode)
       return -ENOENT;
 
+   exec_cache_invalidate(fs, p->fs_path.inode);
    return fs->fsops->unlink(p);
 }
 
@@ -483,6 +510,7 @@ vfs_truncate_impl(struct mnt_fs *fs,
       return rc; /* We couldn't acquire the lock */
 
    /* Got the lock, great. Now do truncate the file */
+   exec_cache_invalidate(fs, p->fs_path.inode);
    rc = fs->fsops->truncate(fs, p->fs_path.inode, len);
 
    /* Release the lock */
@@ -718,6 +746,10 @@ vfs_rename_or_link(const char *oldpath,
    /* Finally, we can call struct mnt_fs's func (if any) */
    func = get_func_ptr(fs);
 
+   /* The file at `newpath`, if any, is going to be replaced */
+   if (func && newp.fs_path.inode)
+      exec_cache_invalidate(fs, newp.fs_path.inode);
+
    rc = func
       ? fs->flags & VFS_FS_RW
          ? func(fs, &oldp, &newp)
@@ -927,6 +959,7 @@ create_fs_obj(const char *type,
 void destory_fs_obj(struct mnt_fs *fs)
 {
    ASSERT(!fs->pss_lock_root);
+   exec_cache_invalidate(fs, NULL);
    kfree_obj(fs, struct mnt_fs);
 }
 
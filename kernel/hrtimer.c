@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+
+#include <tilck/kernel/hrtimer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/hal.h>
+
+/*
+ * The list of the pending hrtimers, sorted by expire time. A plain sorted list
+ * is good enough for Tilck, where there are typically just a few active timers
+ * at the same time. Both the list and the backend are protected by disabling
+ * the interrupts, because the timers expire in IRQ context.
+ */
+static struct list hrtimers_list = STATIC_LIST_INIT(hrtimers_list);
+static const struct hrtimer_backend *backend;
+
+static void hrtimer_program_backend(u64 now)
+{
+   struct hrtimer *first;
+   ASSERT(!are_interrupts_enabled());
+
+   if (!backend)
+      return;
+
+   if (list_is_empty(&hrtimers_list)) {
+      backend->stop();
+      return;
+   }
+
+   first = list_first_obj(&hrtimers_list, struct hrtimer, node);
+   backend->program(first->expires > now ? first->expires - now : 0);
+}
+
+static void hrtimer_remove(struct hrtimer *t)
+{
+   list_remove(&t->node);
+   list_node_init(&t->node);
+}
+
+void hrtimer_init(struct hrtimer *t, hrtimer_func func)
+{
+   list_node_init(&t->node);
+   t->expires = 0;
+   t->func = func;
+}
+
+void hrtimer_start(struct hrtimer *t, u64 expires)
+{
+   struct hrtimer *pos;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      if (hrtimer_is_pending(t))
+         hrtimer_remove(t);
+
+      t->expires = expires;
+
+      list_for_each_ro(pos, &hrtimers_list, node) {
+         if (pos->expires > expires)
+            break;
+      }
+
+      /* Insert before `pos`, which might be the list head itself */
+      list_add_before(&pos->node, &t->node);
+
+      if (hrtimers_list.first == &t->node)
+         hrtimer_program_backend(get_sys_time());
+   }
+   enable_interrupts(&var);
+}
+
+/*
+ * Cancel the timer, if pending. Returns the nanoseconds left before its expire
+ * time (at least 1, if the timer was pending) or 0 if it was not pending.
+ */
+u64 hrtimer_cancel(struct hrtimer *t)
+{
+   u64 rem = 0;
+   u64 now;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      if (hrtimer_is_pending(t)) {
+
+         now = get_sys_time();
+         rem = t->expires > now ? t->expires - now : 1;
+
+         /*
+          * Don't re-program the backend even if this was the first timer:
+          * the worst case is just a spurious IRQ.
+          */
+         hrtimer_remove(t);
+      }
+   }
+   enable_interrupts(&var);
+   return rem;
+}
+
+/*
+ * Called in IRQ context by the backend and by the periodic timer. Runs the
+ * callbacks of all the expired timers and programs the backend for the next
+ * one, if any.
+ */
+void hrtimer_run_expired(void)
+{
+   struct hrtimer *t;
+   u64 now;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      now = get_sys_time();
+
+      while (!list_is_empty(&hrtimers_list)) {
+
+         t = list_first_obj(&hrtimers_list, struct hrtimer, node);
+
+         if (t->expires > now)
+            break;
+
+         hrtimer_remove(t);
+         t->func(t);
+      }
+
+      /* Note: re-read the time, because the callbacks took some time too */
+      hrtimer_program_backend(get_sys_time());
+   }
+   enable_interrupts(&var);
+}
+
+void hrtimer_set_backend(const struct hrtimer_backend *b)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      backend = b;
+      hrtimer_program_backend(get_sys_time());
+   }
+   enable_interrupts(&var);
+}
+
+const char *hrtimer_get_backend_name(void)
+{
+   return backend ? backend->name : "tick";
+}
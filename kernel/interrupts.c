@@ -23,6 +23,24 @@ void arch_irq_handling(regs_t *r);
  * to do with `KRN_TRACK_NESTED_INTERR` which is a debug util that tracks all
  * the interrupt types, including: syscalls, faults and IRQs.
  */
+
+#if KRN_SMP
+
+/* Per-CPU counter, see cpu_info.in_irq_count. Interrupts are disabled here */
+
+static ALWAYS_INLINE void inc_irq_count(void)
+{
+   get_this_cpu()->in_irq_count++;
+}
+
+static ALWAYS_INLINE void dec_irq_count(void)
+{
+   DEBUG_ONLY_UNSAFE(int oldval =) get_this_cpu()->in_irq_count--;
+   ASSERT(oldval > 0);
+}
+
+#else
+
 ATOMIC(int) __in_irq_count;
 
 static ALWAYS_INLINE void inc_irq_count(void)
@@ -38,8 +56,14 @@ static ALWAYS_INLINE void dec_irq_count(void)
    ASSERT(oldval > 0);
 }
 
+#endif
+
 #if KRN_TRACK_NESTED_INTERR
 
+/*
+ * NOTE: with KRN_SMP, this tracking is still global, not per-CPU: it's
+ * serialized by the BKL and it's always empty when a CPU releases the BKL.
+ */
 static int nested_interrupts_count;
 static int nested_interrupts[MAX_NESTED_INTERRUPTS] =
 {
@@ -193,6 +217,13 @@ static void irq_resched(regs_t *r)
 
 void irq_entry(regs_t *r)
 {
+   bool bkl;
+
+   /* Cross-CPU calls are handled without the BKL: the sender holds it */
+   if (smp_handle_call_ipi(regs_intnum(r)))
+      return;
+
+   bkl = bkl_lock();
    ASSERT(get_curr_task() != NULL);
    DEBUG_check_not_same_interrupt_nested(regs_intnum(r));
 
@@ -226,6 +257,9 @@ void irq_entry(regs_t *r)
     * re-enable the preemption and return.
     */
    enable_preemption_nosched();
+
+   if (bkl)
+      bkl_unlock();
 }
 
 void syscall_entry(regs_t *r)
@@ -235,6 +269,7 @@ void syscall_entry(regs_t *r)
     * the nested interrupts (debug feature). The preemption must always be
     * enabled here.
     */
+   const bool bkl = bkl_lock();
    ASSERT(!are_interrupts_enabled());
    ASSERT(is_preemption_enabled());
 
@@ -249,6 +284,9 @@ void syscall_entry(regs_t *r)
    pop_nested_interrupt();
 
    ASSERT(is_preemption_enabled());
+
+   if (bkl)
+      bkl_unlock();
 }
 
 void fault_entry(regs_t *r)
@@ -258,6 +296,7 @@ void fault_entry(regs_t *r)
     * but it's totally possible for example a page fault to occur in the kernel
     * while preemption is disabled.
     */
+   const bool bkl = bkl_lock();
    ASSERT(!are_interrupts_enabled());
 
    push_nested_interrupt(regs_intnum(r));
@@ -275,5 +314,8 @@ void fault_entry(regs_t *r)
 
    enable_preemption();
    disable_interrupts_forced();
+
+   if (bkl)
+      bkl_unlock();
 }
 
@@ -0,0 +1,1080 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_userlim.h>
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/atomics.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+#include <tilck/common/tilck_uring.h>
+
+#include <tilck/kernel/syscalls.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/pipe.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/kernelfs.h>
+#include <tilck/kernel/fs/fd_table.h>
+
+#include <fcntl.h>      // system header
+
+/*
+ * io_uring-style asynchronous I/O (see <tilck/common/tilck_uring.h>).
+ *
+ * SQEs are consumed in the context of the submitting task, in io_uring_enter().
+ * Requests that cannot block are just executed inline: that's the case of the
+ * files having no "ready" conditions at all (ramfs, fat, block devices) and of
+ * the ones already ready (e.g. a pipe with some data in it). All the other
+ * requests are punted to the `io_uring` worker thread, along with a private
+ * non-blocking duplicate of their file handle. The worker waits for all of
+ * them at once, on their files' ready conditions, like poll() does. Then:
+ *
+ *    - reads from pipes are done directly by the worker, in a kernel buffer.
+ *      That's the only kind of I/O that can be safely done outside of the
+ *      submitter's context (e.g. writing on a broken pipe sends SIGPIPE and
+ *      ttys check the process group of the reader).
+ *
+ *    - for everything else (POLL_ADD, ttys, the write end of pipes, etc.) the
+ *      worker just waits for the file to become ready.
+ *
+ * Completed async requests are moved on the ring's `done` list and get posted
+ * on the CQ ring by the submitter itself, during the next io_uring_enter(),
+ * which also finishes there the part of the work requiring its context (e.g.
+ * copying the data to the user buffer), like Linux's task_work does.
+ *
+ * Space in the CQ ring is reserved at submission time for all the requests in
+ * flight: therefore, completions are never dropped (IORING_FEAT_NODROP).
+ */
+
+#define IOU_MAX_ENTRIES                       1024
+#define IOU_MAX_FILES                          256
+#define IOU_POLLER_TIMEOUT_MS                  100
+
+/* Header of the rings' memory area, shared with user space */
+struct iou_rings {
+
+   u32 sq_head;               /* written by the kernel */
+   u32 sq_tail;               /* written by the user */
+   u32 sq_ring_mask;
+   u32 sq_ring_entries;
+   u32 sq_flags;
+   u32 sq_dropped;            /* invalid SQ array entries, skipped */
+
+   u32 cq_head;               /* written by the user */
+   u32 cq_tail;               /* written by the kernel */
+   u32 cq_ring_mask;
+   u32 cq_ring_entries;
+   u32 cq_overflow;           /* always 0: see IORING_FEAT_NODROP */
+   u32 cq_flags;
+};
+
+#define IOU_SQ_ARRAY_OFF       pow2_round_up_at(sizeof(struct iou_rings), 64)
+
+struct io_ring {
+
+   KOBJ_BASE_FIELDS
+
+   struct kmutex lock;        /* serializes enter() and register() */
+   struct kcond cq_cond;      /* signalled when async requests complete */
+   struct list done;          /* completed async requests, not posted yet */
+   u32 inflight;              /* async requests, not posted yet */
+   ATOMIC(int) handles;
+   bool dead;                 /* no more handles: cancel all the requests */
+
+   struct iou_rings *rings;   /* shared: header, SQ array and CQEs */
+   struct io_uring_sqe *sqes; /* shared */
+   u32 *sq_array;
+   struct io_uring_cqe *cqes;
+   size_t rings_size;
+   size_t sqes_size;
+   u32 sq_entries;
+   u32 cq_entries;
+   u32 sq_head;               /* private copy of rings->sq_head */
+   u32 cq_tail;               /* private copy of rings->cq_tail */
+
+   fs_handle *files;          /* registered files (private duplicates) */
+   u32 nr_files;
+};
+
+/* An async request */
+struct iou_req {
+
+   struct list_node node;     /* in iou_incoming, iou_polled or ring->done */
+   struct io_ring *ring;      /* retained while the worker owns the req */
+   fs_handle h;               /* private, non-blocking, duplicate handle */
+   struct kcond *conds[3];    /* the file's r/w/e ready conditions */
+   u64 user_data;
+   void *buf;                 /* user buffer */
+   void *kbuf;                /* kernel buffer, for reads in the worker */
+   s64 off;
+   u32 len;
+   u16 events;                /* POLLIN, POLLOUT or the POLL_ADD events */
+   u8 opcode;
+   bool in_worker;            /* the I/O is done by the worker thread */
+   int res;
+};
+
+static const struct file_ops static_ops_io_uring;
+
+static struct worker_thread *iou_wth;
+static struct kcond iou_wake_cond = STATIC_KCOND_INIT(iou_wake_cond);
+static struct list iou_incoming = STATIC_LIST_INIT(iou_incoming);
+static struct list iou_polled = STATIC_LIST_INIT(iou_polled);
+static bool iou_poller_active;
+
+static ALWAYS_INLINE ATOMIC(u32) *
+atomic_u32(u32 *ptr)
+{
+   return (ATOMIC(u32) *)ptr;
+}
+
+static void destroy_io_ring(struct io_ring *ring);
+
+static void iou_put_ring(struct io_ring *ring)
+{
+   if (release_obj(ring) == 0)
+      destroy_io_ring(ring);
+}
+
+static void iou_free_req(struct iou_req *r)
+{
+   if (r->kbuf)
+      kfree2(r->kbuf, r->len);
+
+   vfs_close(r->h);
+   kfree_obj(r, struct iou_req);
+}
+
+/* Number of CQEs not consumed yet by the user */
+static u32 iou_cq_used(struct io_ring *ring)
+{
+   u32 head = atomic_load_explicit(atomic_u32(&ring->rings->cq_head),
+                                   mo_acquire);
+
+   /* Never trust user space: a garbage head means a full ring */
+   return MIN(ring->cq_tail - head, ring->cq_entries);
+}
+
+static bool iou_post_cqe(struct io_ring *ring, u64 user_data, int res)
+{
+   struct io_uring_cqe *cqe;
+
+   if (iou_cq_used(ring) == ring->cq_entries)
+      return false;
+
+   cqe = &ring->cqes[ring->cq_tail & (ring->cq_entries - 1)];
+   cqe->user_data = user_data;
+   cqe->res = res;
+   cqe->flags = 0;
+
+   ring->cq_tail++;
+   atomic_store_explicit(atomic_u32(&ring->rings->cq_tail),
+                         ring->cq_tail, mo_release);
+   return true;
+}
+
+/*
+ * Read or write using the user buffer `buf`, like sys_read(), sys_pread64()
+ * and their write counterparts do. Called in the submitter's context.
+ */
+static int
+iou_do_rw(fs_handle h, u8 opcode, void *buf, u32 len, s64 off)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *hb = h;
+   const bool write = opcode == IORING_OP_WRITE;
+   void *kbuf = buf;
+   int rc;
+
+   if (off < -1 || off > OFFT_MAX)
+      return -EINVAL;
+
+   len = MIN(len, (u32)INT32_MAX);
+
+   if (!(hb->spec_flags & VFS_SPFL_NO_USER_COPY)) {
+
+      kbuf = curr->io_copybuf;
+      len = MIN(len, IO_COPYBUF_SIZE);
+
+      if (write && copy_from_user(kbuf, buf, len))
+         return -EFAULT;
+   }
+
+   if (write) {
+
+      rc = off < 0
+         ? (int)vfs_write(h, kbuf, len)
+         : (int)vfs_pwrite(h, kbuf, len, (offt)off);
+
+   } else {
+
+      rc = off < 0
+         ? (int)vfs_read(h, kbuf, len)
+         : (int)vfs_pread(h, kbuf, len, (offt)off);
+
+      if (rc > 0 && kbuf != buf && copy_to_user(buf, kbuf, (size_t)rc))
+         rc = -EFAULT;
+   }
+
+   return rc;
+}
+
+static u16 iou_ready_events(fs_handle h, u16 events)
+{
+   u16 ready = 0;
+   int rc;
+
+   if ((events & POLLIN) && vfs_read_ready(h))
+      ready |= POLLIN;
+
+   if ((events & POLLOUT) && vfs_write_ready(h))
+      ready |= POLLOUT;
+
+   if ((rc = vfs_except_ready(h)))
+      ready |= rc > 0 ? (u16)rc : POLLERR;
+
+   return ready;
+}
+
+/*
+ * Called by the worker thread: returns true when the request is done. Note:
+ * requests not in_worker are "done" as soon as their file is ready.
+ */
+static bool iou_req_poll(struct iou_req *r)
+{
+   u16 ready;
+   int rc;
+
+   if (r->ring->dead) {
+      r->res = -ECANCELED;
+      return true;
+   }
+
+   if (r->in_worker) {
+
+      rc = (int)vfs_read(r->h, r->kbuf, r->len);
+
+      if (rc == -EAGAIN)
+         return false;
+
+      r->res = rc;
+      return true;
+   }
+
+   if (!(ready = iou_ready_events(r->h, r->events)))
+      return false;
+
+   r->res = ready;
+   return true;
+}
+
+static void iou_req_done(struct iou_req *r)
+{
+   struct io_ring *ring = r->ring;
+   bool dead;
+
+   kmutex_lock(&ring->lock);
+   {
+      if (!(dead = ring->dead)) {
+         list_add_tail(&ring->done, &r->node);
+         kcond_signal_all(&ring->cq_cond);
+      }
+   }
+   kmutex_unlock(&ring->lock);
+
+   if (dead)
+      iou_free_req(r);
+
+   iou_put_ring(ring);
+}
+
+static int iou_poller_count_conds(void)
+{
+   struct iou_req *r;
+   int cnt = 1; /* iou_wake_cond */
+
+   list_for_each_ro(r, &iou_polled, node) {
+      for (int i = 0; i < 3; i++)
+         cnt += !!r->conds[i];
+   }
+
+   return cnt;
+}
+
+static void iou_poller_set_conds(struct multi_obj_waiter *w)
+{
+   struct iou_req *r;
+   int idx = 0;
+
+   mobj_waiter_set(w, idx++, WOBJ_KCOND,
+                   &iou_wake_cond, &iou_wake_cond.wait_list);
+
+   list_for_each_ro(r, &iou_polled, node) {
+      for (int i = 0; i < 3; i++) {
+
+         struct kcond *c = r->conds[i];
+
+         if (c)
+            mobj_waiter_set(w, idx++, WOBJ_KCOND, c, &c->wait_list);
+      }
+   }
+
+   ASSERT(idx == w->count);
+}
+
+/*
+ * The job run by the io_uring worker thread: it keeps waiting for all the
+ * async requests at once, until there are no more of them.
+ *
+ * NOTE: like in poll(), a wake-up happening between the readiness checks and
+ * the sleep would be lost. The wake-up timer makes the poller always re-check
+ * the requests after at most IOU_POLLER_TIMEOUT_MS.
+ */
+static void iou_poller(void *unused)
+{
+   struct task *curr = get_curr_task();
+   struct multi_obj_waiter *w;
+   struct iou_req *r, *tmp;
+
+   while (true) {
+
+      disable_preemption();
+      {
+         list_for_each(r, tmp, &iou_incoming, node) {
+            list_remove(&r->node);
+            list_add_tail(&iou_polled, &r->node);
+         }
+      }
+      enable_preemption();
+
+      list_for_each(r, tmp, &iou_polled, node) {
+         if (iou_req_poll(r)) {
+            list_remove(&r->node);
+            iou_req_done(r);
+         }
+      }
+
+      if (list_is_empty(&iou_polled)) {
+
+         disable_preemption();
+
+         if (list_is_empty(&iou_incoming)) {
+            iou_poller_active = false;
+            enable_preemption();
+            return;
+         }
+
+         enable_preemption();
+         continue;
+      }
+
+      if (!(w = allocate_mobj_waiter(iou_poller_count_conds()))) {
+         kernel_sleep_ms(IOU_POLLER_TIMEOUT_MS);
+         continue;
+      }
+
+      iou_poller_set_conds(w);
+      task_set_wakeup_timer(curr, ms_to_ticks(IOU_POLLER_TIMEOUT_MS));
+      disable_preemption();
+
+      if (list_is_empty(&iou_incoming)) {
+
+         prepare_to_wait_on_multi_obj(w);
+         enter_sleep_wait_state();
+
+      } else {
+
+         enable_preemption();
+      }
+
+      if (curr->wobj.type)
+         wait_obj_reset(&curr->wobj);
+
+      task_cancel_wakeup_timer(curr);
+      free_mobj_waiter(w);
+   }
+}
+
+static void iou_queue_async(struct iou_req *r)
+{
+   bool start;
+
+   retain_obj(r->ring);
+   disable_preemption();
+   {
+      list_add_tail(&iou_incoming, &r->node);
+
+      if ((start = !iou_poller_active))
+         iou_poller_active = true;
+      else
+         kcond_signal_all(&iou_wake_cond);
+   }
+   enable_preemption();
+
+   if (start) {
+
+      /*
+       * The job never runs concurrently with another instance of itself and
+       * the worker is dedicated to io_uring: the queue can never be full.
+       */
+      if (!wth_enqueue_on(iou_wth, &iou_poller, NULL))
+         panic("io_uring: unable to enqueue the poller job");
+   }
+}
+
+static int iou_punt(struct io_ring *ring,
+                    fs_handle h,
+                    const struct io_uring_sqe *sqe)
+{
+   struct fs_handle_base *dup_hb;
+   struct iou_req *r;
+   fs_handle dup_h;
+   int rc;
+
+   if (!(r = kzalloc_obj(struct iou_req)))
+      return -ENOMEM;
+
+   if ((rc = vfs_dup(h, &dup_h))) {
+      kfree_obj(r, struct iou_req);
+      return rc;
+   }
+
+   dup_hb = dup_h;
+   dup_hb->fl_flags |= O_NONBLOCK;
+
+   *r = (struct iou_req) {
+      .ring = ring,
+      .h = dup_h,
+      .user_data = sqe->user_data,
+      .buf = TO_PTR(sqe->addr),
+      .off = (s64)sqe->off,
+      .len = sqe->len,
+      .opcode = sqe->opcode,
+   };
+
+   list_node_init(&r->node);
+
+   switch (sqe->opcode) {
+
+      case IORING_OP_READ:
+         r->events = POLLIN;
+         r->in_worker = is_pipe_handle(h) && r->off == -1;
+         break;
+
+      case IORING_OP_WRITE:
+         r->events = POLLOUT;
+         break;
+
+      default:
+         r->events = sqe->poll_events & (u16)(POLLIN | POLLOUT);
+         break;
+   }
+
+   if (r->in_worker) {
+
+      r->len = MIN(r->len, IO_COPYBUF_SIZE);
+
+      if (!(r->kbuf = kmalloc(r->len))) {
+         iou_free_req(r);
+         return -ENOMEM;
+      }
+   }
+
+   /* Get the conditions here, as they might depend on the current process */
+   if (r->events & POLLIN)
+      r->conds[0] = vfs_get_rready_cond(h);
+
+   if (r->events & POLLOUT)
+      r->conds[1] = vfs_get_wready_cond(h);
+
+   r->conds[2] = vfs_get_except_cond(h);
+
+   ring->inflight++;
+   iou_queue_async(r);
+   return 0;
+}
+
+/*
+ * Returns true when an I/O operation on `h` might block, because the file has
+ * a ready condition and it's not ready now.
+ */
+static bool iou_might_block(fs_handle h, bool write)
+{
+   if (write)
+      return vfs_get_wready_cond(h) && !vfs_write_ready(h);
+
+   return vfs_get_rready_cond(h) && !vfs_read_ready(h);
+}
+
+/*
+ * Issue a single SQE. Returns false if the request has been punted to the
+ * worker thread, true if it's complete and its result is in `*res`.
+ */
+static bool
+iou_issue(struct io_ring *ring, const struct io_uring_sqe *sqe, int *res)
+{
+   const bool write = sqe->opcode == IORING_OP_WRITE;
+   fs_handle h;
+   int rc;
+
+   if (sqe->opcode == IORING_OP_NOP) {
+      *res = 0;
+      return true;
+   }
+
+   if (sqe->flags & ~IOSQE_FIXED_FILE) {
+      *res = -EINVAL;
+      return true;
+   }
+
+   if (sqe->flags & IOSQE_FIXED_FILE) {
+
+      h = (u32)sqe->fd < ring->nr_files ? ring->files[sqe->fd] : NULL;
+
+   } else {
+
+      h = get_fs_handle(sqe->fd);
+   }
+
+   if (!h) {
+      *res = -EBADF;
+      return true;
+   }
+
+   switch (sqe->opcode) {
+
+      case IORING_OP_READ:
+      case IORING_OP_WRITE:
+
+         if (iou_might_block(h, write))
+            break;
+
+         *res = iou_do_rw(h, sqe->opcode, TO_PTR(sqe->addr),
+                          sqe->len, (s64)sqe->off);
+         return true;
+
+      case IORING_OP_POLL_ADD:
+
+         if ((*res = iou_ready_events(h, sqe->poll_events)))
+            return true;
+
+         break;
+
+      default:
+         *res = -EINVAL;
+         return true;
+   }
+
+   rc = iou_punt(ring, h, sqe);
+   *res = rc;
+   return rc != 0;
+}
+
+static u32 iou_submit(struct io_ring *ring, u32 to_submit)
+{
+   struct io_uring_sqe sqe;
+   u32 tail, idx, n, avail;
+   int res;
+
+   tail = atomic_load_explicit(atomic_u32(&ring->rings->sq_tail), mo_acquire);
+   avail = MIN(tail - ring->sq_head, ring->sq_entries);
+   to_submit = MIN(to_submit, avail);
+
+   for (n = 0; n < to_submit; n++) {
+
+      /* Reserve a CQE for every request, also for the async ones */
+      if (iou_cq_used(ring) + ring->inflight >= ring->cq_entries)
+         break;
+
+      idx = ring->sq_array[ring->sq_head & (ring->sq_entries - 1)];
+      ring->sq_head++;
+
+      if (idx >= ring->sq_entries) {
+         ring->rings->sq_dropped++;
+         continue;
+      }
+
+      /* Copy the SQE, because the user can change it at any time */
+      memcpy(&sqe, &ring->sqes[idx], sizeof(sqe));
+
+      if (iou_issue(ring, &sqe, &res))
+         iou_post_cqe(ring, sqe.user_data, res);
+   }
+
+   atomic_store_explicit(atomic_u32(&ring->rings->sq_head),
+                         ring->sq_head, mo_release);
+   return n;
+}
+
+/* Post the completed async requests, finishing them in our context */
+static void iou_reap(struct io_ring *ring)
+{
+   struct iou_req *r, *tmp;
+   int res;
+
+   ASSERT(kmutex_is_curr_task_holding_lock(&ring->lock));
+
+   list_for_each(r, tmp, &ring->done, node) {
+
+      if (iou_cq_used(ring) == ring->cq_entries)
+         break;
+
+      list_remove(&r->node);
+      res = r->res;
+
+      if (r->opcode == IORING_OP_READ && r->in_worker) {
+
+         if (res > 0 && copy_to_user(r->buf, r->kbuf, (size_t)res))
+            res = -EFAULT;
+
+      } else if (r->opcode != IORING_OP_POLL_ADD) {
+
+         res = iou_do_rw(r->h, r->opcode, r->buf, r->len, r->off);
+
+         if (res == -EAGAIN) {
+            /* Somebody else got the data or the space first: wait again */
+            iou_queue_async(r);
+            continue;
+         }
+      }
+
+      iou_post_cqe(ring, r->user_data, res);
+      ring->inflight--;
+      iou_free_req(r);
+   }
+}
+
+static struct io_ring *iou_get_ring(int fd)
+{
+   struct fs_handle_base *hb = get_fs_handle(fd);
+
+   if (!hb || hb->fops != &static_ops_io_uring)
+      return NULL;
+
+   return (void *)((struct kfs_handle *)hb)->kobj;
+}
+
+int sys_io_uring_enter(int fd,
+                       u32 to_submit,
+                       u32 min_complete,
+                       u32 flags,
+                       const void *sig,
+                       size_t sigsz)
+{
+   struct io_ring *ring;
+   u32 submitted;
+   int rc = 0;
+
+   if (!(ring = iou_get_ring(fd)))
+      return get_fs_handle(fd) ? -EOPNOTSUPP : -EBADF;
+
+   if (flags & ~IORING_ENTER_GETEVENTS)
+      return -EINVAL;
+
+   if (sig)
+      return -EINVAL; /* Not supported */
+
+   kmutex_lock(&ring->lock);
+   {
+      submitted = iou_submit(ring, to_submit);
+      iou_reap(ring);
+
+      if (flags & IORING_ENTER_GETEVENTS) {
+
+         min_complete = MIN(min_complete, ring->cq_entries);
+
+         while (iou_cq_used(ring) < min_complete && ring->inflight) {
+
+            kcond_wait(&ring->cq_cond, &ring->lock, KCOND_WAIT_FOREVER);
+
+            if (pending_signals()) {
+               rc = -EINTR;
+               break;
+            }
+
+            iou_reap(ring);
+         }
+      }
+   }
+   kmutex_unlock(&ring->lock);
+   return submitted ? (int)submitted : rc;
+}
+
+static void iou_unregister_files(struct io_ring *ring)
+{
+   if (!ring->files)
+      return;
+
+   for (u32 i = 0; i < ring->nr_files; i++) {
+      if (ring->files[i])
+         vfs_close(ring->files[i]);
+   }
+
+   kfree_array_obj(ring->files, fs_handle, ring->nr_files);
+   ring->files = NULL;
+   ring->nr_files = 0;
+}
+
+static int iou_register_files(struct io_ring *ring, const int *u_fds, u32 n)
+{
+   int fd, rc = 0;
+   fs_handle h;
+
+   if (ring->files)
+      return -EBUSY;
+
+   if (!n || n > IOU_MAX_FILES)
+      return -EINVAL;
+
+   if (!(ring->files = kzalloc_array_obj(fs_handle, n)))
+      return -ENOMEM;
+
+   ring->nr_files = n;
+
+   for (u32 i = 0; i < n; i++) {
+
+      if (copy_from_user(&fd, &u_fds[i], sizeof(fd))) {
+         rc = -EFAULT;
+         break;
+      }
+
+      if (fd == -1)
+         continue;   /* sparse entry */
+
+      h = get_fs_handle(fd);
+
+      if (!h || ((struct fs_handle_base *)h)->fops == &static_ops_io_uring) {
+         rc = -EBADF;
+         break;
+      }
+
+      if ((rc = vfs_dup(h, &ring->files[i])))
+         break;
+   }
+
+   if (rc)
+      iou_unregister_files(ring);
+
+   return rc;
+}
+
+int sys_io_uring_register(int fd, u32 opcode, void *arg, u32 nr_args)
+{
+   struct io_ring *ring;
+   int rc;
+
+   if (!(ring = iou_get_ring(fd)))
+      return get_fs_handle(fd) ? -EOPNOTSUPP : -EBADF;
+
+   kmutex_lock(&ring->lock);
+   {
+      switch (opcode) {
+
+         case IORING_REGISTER_FILES:
+            rc = iou_register_files(ring, arg, nr_args);
+            break;
+
+         case IORING_UNREGISTER_FILES:
+            rc = ring->files ? 0 : -ENXIO;
+            iou_unregister_files(ring);
+            break;
+
+         default:
+            rc = -EINVAL;
+      }
+   }
+   kmutex_unlock(&ring->lock);
+   return rc;
+}
+
+static int
+io_ring_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
+{
+   struct kfs_handle *kh = um->h;
+   struct io_ring *ring = (void *)kh->kobj;
+   const size_t pg_count = um->len >> PAGE_SHIFT;
+   size_t mapped_cnt;
+   void *area;
+
+   ASSERT(IS_PAGE_ALIGNED(um->len));
+
+   if (flags & VFS_MM_DONT_MMAP)
+      return 0;
+
+   switch (um->off) {
+
+      case IORING_OFF_SQ_RING:
+      case IORING_OFF_CQ_RING:
+
+         if (um->len > ring->rings_size)
+            return -EINVAL;
+
+         area = ring->rings;
+         break;
+
+      case IORING_OFF_SQES:
+
+         if (um->len > ring->sqes_size)
+            return -EINVAL;
+
+         area = ring->sqes;
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   mapped_cnt = map_pages(pdir,
+                          um->vaddrp,
+                          LIN_VA_TO_PA(area),
+                          pg_count,
+                          PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED);
+
+   if (mapped_cnt != pg_count) {
+      unmap_pages_permissive(pdir, um->vaddrp, mapped_cnt, false);
+      return -ENOMEM;
+   }
+
+   return 0;
+}
+
+static const struct file_ops static_ops_io_uring =
+{
+   .mmap = io_ring_mmap,
+   .munmap = generic_fs_munmap,
+};
+
+static void io_ring_on_handle_close(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct io_ring *ring = (void *)kh->kobj;
+
+   if (atomic_fetch_sub_explicit(&ring->handles, 1, mo_relaxed) > 1)
+      return;
+
+   /* The last handle: cancel all the async requests */
+   kmutex_lock(&ring->lock);
+   {
+      ring->dead = true;
+   }
+   kmutex_unlock(&ring->lock);
+   kcond_signal_all(&iou_wake_cond);
+}
+
+static void io_ring_on_handle_dup(fs_handle h)
+{
+   struct kfs_handle *kh = h;
+   struct io_ring *ring = (void *)kh->kobj;
+
+   atomic_fetch_add_explicit(&ring->handles, 1, mo_relaxed);
+}
+
+static void destroy_io_ring(struct io_ring *ring)
+{
+   struct iou_req *r, *tmp;
+
+   list_for_each(r, tmp, &ring->done, node) {
+      list_remove(&r->node);
+      iou_free_req(r);
+   }
+
+   iou_unregister_files(ring);
+
+   if (ring->rings)
+      aligned_kfree2(ring->rings, ring->rings_size);
+
+   if (ring->sqes)
+      aligned_kfree2(ring->sqes, ring->sqes_size);
+
+   kcond_destory(&ring->cq_cond);
+   kmutex_destroy(&ring->lock);
+   kfree_obj(ring, struct io_ring);
+}
+
+static struct io_ring *create_io_ring(u32 sq_entries, u32 cq_entries)
+{
+   struct io_ring *ring;
+   size_t cqes_off;
+
+   if (!(ring = kzalloc_obj(struct io_ring)))
+      return NULL;
+
+   ring->on_handle_close = &io_ring_on_handle_close;
+   ring->on_handle_dup = &io_ring_on_handle_dup;
+   ring->destory_obj = (void *)&destroy_io_ring;
+   kmutex_init(&ring->lock, 0);
+   kcond_init(&ring->cq_cond);
+   list_init(&ring->done);
+
+   cqes_off = pow2_round_up_at(IOU_SQ_ARRAY_OFF + sq_entries * sizeof(u32),
+                               sizeof(struct io_uring_cqe));
+
+   ring->sq_entries = sq_entries;
+   ring->cq_entries = cq_entries;
+   ring->rings_size = pow2_round_up_at(
+      cqes_off + cq_entries * sizeof(struct io_uring_cqe), PAGE_SIZE
+   );
+   ring->sqes_size = pow2_round_up_at(
+      sq_entries * sizeof(struct io_uring_sqe), PAGE_SIZE
+   );
+
+   ring->rings = aligned_kmalloc(ring->rings_size, PAGE_SIZE);
+   ring->sqes = aligned_kmalloc(ring->sqes_size, PAGE_SIZE);
+
+   if (!ring->rings || !ring->sqes) {
+      destroy_io_ring(ring);
+      return NULL;
+   }
+
+   bzero(ring->rings, ring->rings_size);
+   bzero(ring->sqes, ring->sqes_size);
+
+   ring->sq_array = (void *)((char *)ring->rings + IOU_SQ_ARRAY_OFF);
+   ring->cqes = (void *)((char *)ring->rings + cqes_off);
+
+   ring->rings->sq_ring_mask = sq_entries - 1;
+   ring->rings->sq_ring_entries = sq_entries;
+   ring->rings->cq_ring_mask = cq_entries - 1;
+   ring->rings->cq_ring_entries = cq_entries;
+   return ring;
+}
+
+static void iou_fill_offsets(struct io_ring *ring, struct io_uring_params *p)
+{
+   p->sq_entries = ring->sq_entries;
+   p->cq_entries = ring->cq_entries;
+   p->features = IORING_FEAT_SINGLE_MMAP |
+                 IORING_FEAT_NODROP |
+                 IORING_FEAT_SUBMIT_STABLE |
+                 IORING_FEAT_RW_CUR_POS;
+
+   p->sq_off = (struct io_sqring_offsets) {
+      .head = offsetof(struct iou_rings, sq_head),
+      .tail = offsetof(struct iou_rings, sq_tail),
+      .ring_mask = offsetof(struct iou_rings, sq_ring_mask),
+      .ring_entries = offsetof(struct iou_rings, sq_ring_entries),
+      .flags = offsetof(struct iou_rings, sq_flags),
+      .dropped = offsetof(struct iou_rings, sq_dropped),
+      .array = IOU_SQ_ARRAY_OFF,
+   };
+
+   p->cq_off = (struct io_cqring_offsets) {
+      .head = offsetof(struct iou_rings, cq_head),
+      .tail = offsetof(struct iou_rings, cq_tail),
+      .ring_mask = offsetof(struct iou_rings, cq_ring_mask),
+      .ring_entries = offsetof(struct iou_rings, cq_ring_entries),
+      .overflow = offsetof(struct iou_rings, cq_overflow),
+      .cqes = (u32)((char *)ring->cqes - (char *)ring->rings),
+      .flags = offsetof(struct iou_rings, cq_flags),
+   };
+}
+
+static u32 iou_round_up_entries(u32 n)
+{
+   u32 res = 1;
+
+   while (res < n)
+      res <<= 1;
+
+   return res;
+}
+
+static int iou_create_worker(void)
+{
+   int rc = 0;
+
+   disable_preemption();
+   {
+      if (!iou_wth) {
+
+         iou_wth = wth_create_thread("io_uring", 10 /* priority */, 4);
+
+         if (!iou_wth)
+            rc = -ENOMEM;
+      }
+   }
+   enable_preemption();
+   return rc;
+}
+
+int sys_io_uring_setup(u32 entries, struct io_uring_params *u_params)
+{
+   struct task *curr = get_curr_task();
+   struct fs_handle_base *h = NULL;
+   struct io_ring *ring = NULL;
+   struct io_uring_params p;
+   u32 sq_entries, cq_entries;
+   int fd, rc;
+
+   if (copy_from_user(&p, u_params, sizeof(p)))
+      return -EFAULT;
+
+   for (u32 i = 0; i < ARRAY_SIZE(p.resv); i++)
+      if (p.resv[i])
+         return -EINVAL;
+
+   if (p.flags & ~IORING_SETUP_CQSIZE)
+      return -EINVAL;
+
+   if (!entries || entries > IOU_MAX_ENTRIES)
+      return -EINVAL;
+
+   sq_entries = iou_round_up_entries(entries);
+   cq_entries = 2 * sq_entries;
+
+   if (p.flags & IORING_SETUP_CQSIZE) {
+
+      if (p.cq_entries < sq_entries || p.cq_entries > 2 * IOU_MAX_ENTRIES)
+         return -EINVAL;
+
+      cq_entries = iou_round_up_entries(p.cq_entries);
+   }
+
+   if ((rc = iou_create_worker()))
+      return rc;
+
+   if (!(ring = create_io_ring(sq_entries, cq_entries)))
+      return -ENOMEM;
+
+   iou_fill_offsets(ring, &p);
+
+   if (copy_to_user(u_params, &p, sizeof(p))) {
+      destroy_io_ring(ring);
+      return -EFAULT;
+   }
+
+   kmutex_lock(&curr->pi->fslock);
+
+   if ((fd = fdt_get_free_fd(curr->pi, 0)) < 0) {
+      rc = fd;
+      goto out;
+   }
+
+   if (!(h = (void *)kfs_create_new_handle(&static_ops_io_uring,
+                                           (void *)ring, O_RDWR)))
+   {
+      rc = -ENOMEM;
+      goto out;
+   }
+
+   ring->handles = 1;
+   h->spec_flags = VFS_SPFL_MMAP_SUPPORTED;
+   h->fd_flags |= FD_CLOEXEC;
+   fdt_install(curr->pi, fd, h);
+   rc = fd;
+
+out:
+   kmutex_unlock(&curr->pi->fslock);
+
+   if (rc < 0)
+      destroy_io_ring(ring);
+
+   return rc;
+}
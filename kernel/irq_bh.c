@@ -0,0 +1,191 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_kernel.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/irq_bh.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/interrupts.h>
+#include <tilck/kernel/debug_utils.h>
+
+static struct list irq_bh_list = STATIC_LIST_INIT(irq_bh_list);
+static int irq_bh_count;
+
+/* One worker thread per BH priority, created on demand */
+static struct worker_thread *bh_threads[IRQ_BH_MAX_PRIO + 1];
+
+static struct worker_thread *get_bh_thread(int priority)
+{
+   struct worker_thread *wth;
+   ASSERT(!is_preemption_enabled());
+
+   if (!(wth = bh_threads[priority])) {
+      wth = wth_create_thread("irq_bh", priority, IRQ_BH_QUEUE_SIZE);
+      bh_threads[priority] = wth;
+   }
+
+   return wth;
+}
+
+int irq_bh_init(struct irq_bh *bh,
+                const char *name,
+                int irq,
+                int priority,
+                void (*func)(void *),
+                void *ctx)
+{
+   struct worker_thread *wth;
+   DEBUG_ONLY(check_not_in_irq_handler());
+
+   if (!IN_RANGE_INC(priority, 0, IRQ_BH_MAX_PRIO))
+      return -EINVAL;
+
+   *bh = (struct irq_bh) {
+      .name = name,
+      .irq = irq,
+      .priority = priority,
+      .func = func,
+      .ctx = ctx,
+   };
+
+   list_node_init(&bh->node);
+
+   disable_preemption();
+   {
+      if ((wth = get_bh_thread(priority))) {
+         bh->wth = wth;
+         list_add_tail(&irq_bh_list, &bh->node);
+         irq_bh_count++;
+      }
+   }
+   enable_preemption();
+   return wth ? 0 : -ENOMEM;
+}
+
+/* Mark the BH as not pending and account the latency: interrupts disabled */
+static void irq_bh_begin_run(struct irq_bh *bh)
+{
+   const u64 lat = RDTSC() - bh->sched_tsc;
+   ASSERT(!are_interrupts_enabled());
+
+   bh->pending = false;
+   bh->stats.runs++;
+   bh->stats.lat_tot += lat;
+   bh->stats.lat_max = MAX(bh->stats.lat_max, lat);
+}
+
+static void irq_bh_run(void *arg)
+{
+   struct irq_bh *bh = arg;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      irq_bh_begin_run(bh);
+   }
+   enable_interrupts(&var);
+
+   bh->func(bh->ctx);
+}
+
+/*
+ * Schedule the BH to run on its worker thread, unless it's already pending.
+ * Typically called by the top half. Returns false only in case of overflow.
+ */
+bool irq_bh_schedule(struct irq_bh *bh)
+{
+   bool ok = true;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      bh->stats.scheduled++;
+
+      if (bh->pending) {
+
+         bh->stats.coalesced++;
+
+      } else {
+
+         bh->pending = true;
+         bh->sched_tsc = RDTSC();
+
+         if (!wth_enqueue_on(bh->wth, &irq_bh_run, bh)) {
+
+            /* The work stays there: the next interrupt will retry */
+            bh->pending = false;
+            bh->stats.overflows++;
+            ok = false;
+         }
+      }
+   }
+   enable_interrupts(&var);
+   return ok;
+}
+
+/*
+ * Run the BH synchronously, in the current context. Useful only in special
+ * cases, like in panic, when the worker threads cannot run anymore.
+ */
+void irq_bh_run_now(struct irq_bh *bh)
+{
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      bh->sched_tsc = RDTSC();
+      irq_bh_begin_run(bh);
+   }
+   enable_interrupts(&var);
+
+   bh->func(bh->ctx);
+}
+
+int irq_bh_get_count(void)
+{
+   return irq_bh_count;
+}
+
+int irq_bh_snapshot(struct irq_bh_info *arr, int max_count)
+{
+   struct irq_bh *pos;
+   int count = 0;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      list_for_each_ro(pos, &irq_bh_list, node) {
+
+         if (count == max_count)
+            break;
+
+         arr[count++] = (struct irq_bh_info) {
+            .name = pos->name,
+            .irq = pos->irq,
+            .priority = pos->priority,
+            .pending = pos->pending,
+            .stats = pos->stats,
+         };
+      }
+   }
+   enable_interrupts(&var);
+   return count;
+}
+
+void irq_bh_reset_stats(void)
+{
+   struct irq_bh *pos;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      list_for_each_ro(pos, &irq_bh_list, node)
+         bzero(&pos->stats, sizeof(pos->stats));
+   }
+   enable_interrupts(&var);
+}
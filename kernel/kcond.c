@@ -6,11 +6,16 @@
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/interrupts.h>
+#include <tilck/kernel/lockstat.h>
 
 void kcond_init(struct kcond *c)
 {
    DEBUG_ONLY(check_not_in_irq_handler());
    list_init(&c->wait_list);
+
+#if KRN_LOCKSTAT
+   c->ls = NULL;
+#endif
 }
 
 bool kcond_is_anyone_waiting(struct kcond *c)
@@ -29,11 +34,13 @@ bool kcond_wait(struct kcond *c, struct kmutex *m, u32 timeout_ticks)
    DEBUG_ONLY(check_not_in_irq_handler());
    ASSERT(!m || kmutex_is_curr_task_holding_lock(m));
    struct task *curr = get_curr_task();
+   u64 wait_start;
    bool ret;
 
 panic_retry_hack:
 
    disable_preemption();
+   wait_start = lockstat_wait_begin(lockstat_of(c));
    prepare_to_wait_on(WOBJ_KCOND, c, NO_EXTRA, &c->wait_list);
 
    if (timeout_ticks != KCOND_WAIT_FOREVER)
@@ -73,6 +80,7 @@ panic_retry_hack:
     */
 
    ret = !wait_obj_reset(&curr->wobj);
+   lockstat_shacquired(lockstat_of(c), wait_start);
 
    if (m) {
       kmutex_lock(m); // Re-acquire the lock [if any]
@@ -180,5 +188,6 @@ void kcond_signal_all(struct kcond *c)
 
 void kcond_destory(struct kcond *c)
 {
+   lockstat_unregister(lockstat_ref(c));
    bzero(c, sizeof(struct kcond));
 }
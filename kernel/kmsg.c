@@ -0,0 +1,315 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/kmsg.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/fs/devfs.h>
+
+#include <linux/major.h> // system header
+#include <fcntl.h>       // system header
+
+#define KMSG_MINOR                       11     /* Like on Linux */
+#define KMSG_DEFAULT_LEVEL                6     /* LOG_INFO */
+
+static struct kmsg_record kmsg_records[KMSG_RECORDS];
+static ATOMIC(u32) kmsg_next_seq;
+
+ATOMIC(int) kmsg_readers;
+static struct kmutex kmsg_lock = STATIC_KMUTEX_INIT(kmsg_lock, 0);
+static struct kcond kmsg_cond = STATIC_KCOND_INIT(kmsg_cond);
+
+/* Per-handle data, stored in devfs_handle's `extra` field */
+struct kmsg_reader {
+   u32 seq;                   /* next record to read */
+};
+
+STATIC_ASSERT(sizeof(struct kmsg_reader) <= DEVFS_EXTRA_SIZE);
+
+u32 kmsg_get_next_seq(void)
+{
+   return atomic_load_explicit(&kmsg_next_seq, mo_relaxed);
+}
+
+u32 kmsg_get_first_seq(void)
+{
+   const u32 next = kmsg_get_next_seq();
+   return next - MIN(next, (u32)KMSG_RECORDS);
+}
+
+static bool kmsg_is_overwritten(u32 seq)
+{
+   return (s32)(kmsg_get_next_seq() - seq) > KMSG_RECORDS;
+}
+
+u32 kmsg_append(const char *buf, u32 len, u8 flags, u64 ts)
+{
+   const u32 seq = atomic_fetch_add_explicit(&kmsg_next_seq, 1, mo_relaxed);
+   struct kmsg_record *r = &kmsg_records[seq % KMSG_RECORDS];
+
+   len = MIN(len, (u32)KMSG_TEXT_SZ);
+
+   /* Make the readers to not trust the slot's contents while we write it */
+   atomic_store_explicit(&r->seq_plus_one, 0, mo_relaxed);
+   atomic_thread_fence(mo_release);
+
+   r->hdr = (struct kmsg_hdr) {
+      .seq = seq,
+      .len = (u16)len,
+      .flags = flags,
+      .ts = ts,
+   };
+
+   memcpy(r->text, buf, len);
+
+   /* Publish the record */
+   atomic_store_explicit(&r->seq_plus_one, seq + 1, mo_release);
+   return seq;
+}
+
+int kmsg_read(u32 seq, u32 off, char *buf, u32 size, struct kmsg_hdr *hdr)
+{
+   struct kmsg_record *r = &kmsg_records[seq % KMSG_RECORDS];
+   u32 n = 0;
+
+   if (atomic_load_explicit(&r->seq_plus_one, mo_acquire) != seq + 1)
+      return kmsg_is_overwritten(seq) ? -EPIPE : -EAGAIN;
+
+   *hdr = r->hdr;
+
+   if (off < hdr->len)
+      n = MIN(size, hdr->len - off);
+
+   if (n)
+      memcpy(buf, r->text + off, n);
+
+   /* Check that a writer didn't overwrite the record while we copied it */
+   atomic_thread_fence(mo_acquire);
+
+   if (atomic_load_explicit(&r->seq_plus_one, mo_relaxed) != seq + 1)
+      return -EPIPE;
+
+   return (int)n;
+}
+
+void kmsg_wakeup_readers(void)
+{
+   if (!atomic_load_explicit(&kmsg_readers, mo_relaxed))
+      return;
+
+   kmutex_lock(&kmsg_lock);
+   {
+      kcond_signal_all(&kmsg_cond);
+   }
+   kmutex_unlock(&kmsg_lock);
+}
+
+/*
+ * Format a record like Linux's /dev/kmsg does:
+ *
+ *    <level>,<seq>,<timestamp in us>,<flags>;<text>\n
+ *
+ * where flags is '-' for a record starting a new line and 'c' for the
+ * continuation of the previous one. Non-printable chars in the text (and the
+ * trailing newline) are escaped with \xNN. Returns -EINVAL if `size` is not
+ * enough to contain the whole record, exactly like Linux.
+ */
+static ssize_t
+kmsg_format_record(char *buf, size_t size, struct kmsg_hdr *h, const char *text)
+{
+   static const char hex_digits[] = "0123456789abcdef";
+   u32 len = h->len;
+   size_t w;
+
+   if (len > 0 && text[len - 1] == '\n')
+      len--;
+
+   w = (size_t)snprintk(buf, size, "%d,%u,%" PRIu64 ",%c;",
+                        KMSG_DEFAULT_LEVEL,
+                        h->seq,
+                        h->ts / (TS_SCALE / 1000000),
+                        (h->flags & KMSG_FL_PREFIX) ? '-' : 'c');
+
+   if (w >= size)
+      return -EINVAL;
+
+   for (u32 i = 0; i < len; i++) {
+
+      const u8 c = (u8)text[i];
+
+      if (IN_RANGE_INC(c, ' ', '~') && c != '\\') {
+
+         if (w + 1 >= size)
+            return -EINVAL;
+
+         buf[w++] = (char)c;
+
+      } else {
+
+         if (w + 4 >= size)
+            return -EINVAL;
+
+         buf[w++] = '\\';
+         buf[w++] = 'x';
+         buf[w++] = hex_digits[c >> 4];
+         buf[w++] = hex_digits[c & 0xf];
+      }
+   }
+
+   buf[w++] = '\n';
+   return (ssize_t)w;
+}
+
+static ssize_t kmsg_dev_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   struct devfs_handle *dh = h;
+   struct kmsg_reader *r = (void *)dh->extra;
+   char text[KMSG_TEXT_SZ];
+   struct kmsg_hdr hdr;
+   ssize_t rc;
+
+   kmutex_lock(&kmsg_lock);
+
+   while (true) {
+
+      rc = kmsg_read(r->seq, 0, text, sizeof(text), &hdr);
+
+      if (rc != -EAGAIN)
+         break;
+
+      if (dh->fl_flags & O_NONBLOCK)
+         break;
+
+      kcond_wait(&kmsg_cond, &kmsg_lock, KCOND_WAIT_FOREVER);
+
+      if (pending_signals()) {
+         rc = -EINTR;
+         break;
+      }
+   }
+
+   kmutex_unlock(&kmsg_lock);
+
+   if (rc == -EPIPE) {
+
+      /* We missed some records: like Linux, report it once and skip them */
+      r->seq = kmsg_get_first_seq();
+      return rc;
+   }
+
+   if (rc < 0)
+      return rc;
+
+   if ((rc = kmsg_format_record(buf, size, &hdr, text)) > 0)
+      r->seq++;
+
+   return rc;
+}
+
+static offt kmsg_dev_seek(fs_handle h, offt off, int whence)
+{
+   struct devfs_handle *dh = h;
+   struct kmsg_reader *r = (void *)dh->extra;
+
+   if (off != 0)
+      return -EINVAL;
+
+   switch (whence) {
+
+      case SEEK_SET:
+         r->seq = kmsg_get_first_seq();
+         break;
+
+      case SEEK_END:
+         r->seq = kmsg_get_next_seq();
+         break;
+
+      default:
+         return -EINVAL;
+   }
+
+   return 0;
+}
+
+static int kmsg_dev_read_ready(fs_handle h)
+{
+   struct devfs_handle *dh = h;
+   struct kmsg_reader *r = (void *)dh->extra;
+   struct kmsg_hdr hdr;
+
+   /* Note: an overwritten record is "ready", since read() will fail */
+   return kmsg_read(r->seq, 0, NULL, 0, &hdr) != -EAGAIN;
+}
+
+static struct kcond *kmsg_dev_get_rready_cond(fs_handle h)
+{
+   return &kmsg_cond;
+}
+
+static int kmsg_create_extra(int minor, void *extra)
+{
+   struct kmsg_reader *r = extra;
+
+   r->seq = kmsg_get_first_seq();
+   atomic_fetch_add_explicit(&kmsg_readers, 1, mo_relaxed);
+   return 0;
+}
+
+static int kmsg_on_dup_extra(int minor, void *extra)
+{
+   atomic_fetch_add_explicit(&kmsg_readers, 1, mo_relaxed);
+   return 0;
+}
+
+static void kmsg_destroy_extra(int minor, void *extra)
+{
+   atomic_fetch_sub_explicit(&kmsg_readers, 1, mo_relaxed);
+}
+
+static int
+kmsg_create_device_file(int minor,
+                        enum vfs_entry_type *type,
+                        struct devfs_file_info *nfo)
+{
+   static const struct file_ops static_ops_kmsg = {
+
+      .read = kmsg_dev_read,
+      .seek = kmsg_dev_seek,
+      .read_ready = kmsg_dev_read_ready,
+      .get_rready_cond = kmsg_dev_get_rready_cond,
+   };
+
+   *type = VFS_CHAR_DEV;
+   nfo->fops = &static_ops_kmsg;
+   nfo->create_extra = &kmsg_create_extra;
+   nfo->on_dup_extra = &kmsg_on_dup_extra;
+   nfo->destroy_extra = &kmsg_destroy_extra;
+   return 0;
+}
+
+/*
+ * Creates /dev/kmsg, which allows user space programs to read the kernel log
+ * record by record, without the console and its formatting.
+ */
+void init_kmsg_device(void)
+{
+   struct driver_info *di = kzalloc_obj(struct driver_info);
+   int rc;
+
+   if (!di)
+      panic("kmsg: no enough memory for struct driver_info");
+
+   di->name = "kmsg";
+   di->create_dev_file = kmsg_create_device_file;
+   register_driver(di, MEM_MAJOR);
+
+   if ((rc = create_dev_file("kmsg", MEM_MAJOR, KMSG_MINOR, NULL)))
+      panic("kmsg: unable to create /dev/kmsg (error: %d)", rc);
+}
@@ -6,6 +6,7 @@
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/irq.h>
+#include <tilck/kernel/lockstat.h>
 
 bool kmutex_is_curr_task_holding_lock(struct kmutex *m)
 {
@@ -22,6 +23,7 @@ void kmutex_init(struct kmutex *m, u32 flags)
 
 void kmutex_destroy(struct kmutex *m)
 {
+   lockstat_unregister(lockstat_ref(m));
    bzero(m, sizeof(struct kmutex));
 }
 
@@ -36,21 +38,85 @@ kmutex_lock_enable_preemption_wrapper(struct kmutex *m)
 #endif
 }
 
+static ALWAYS_INLINE void
+kmutex_take_ownership(struct kmutex *m)
+{
+   m->owner_task = get_curr_task();
+
+   if (m->flags & KMUTEX_FL_RECURSIVE) {
+      ASSERT(m->lock_count == 0);
+      m->lock_count++;
+   }
+}
+
+/*
+ * Optimistic waiting, the UP version of adaptive spinning.
+ *
+ * Most of the critical sections are just a few hundred cycles long, while going
+ * to sleep with the wait-obj machinery and being woken up later costs much
+ * more than that. Therefore, if the owner is runnable (it got preempted or it
+ * yielded while holding the mutex), just yield a few times letting it complete
+ * its critical section instead of sleeping. Spinning on UP makes no sense, but
+ * yielding does: it's the only way for the owner to run.
+ *
+ * We stop as soon as the owner goes to sleep (its critical section is clearly
+ * long) or someone else is already sleeping on the mutex: in that case, the
+ * mutex will be handed off directly to the first waiter by kmutex_unlock()
+ * and we have to queue up behind it, in order to avoid lock stealing and the
+ * starvation of the sleeping waiters.
+ *
+ * Called and returns with preemption disabled exactly once. Returns true if
+ * the mutex has been acquired.
+ */
+static bool kmutex_wait_for_runnable_owner(struct kmutex *m)
+{
+   struct task *owner;
+
+   if (m->flags & KMUTEX_FL_NO_SPIN)
+      return false;
+
+   if (get_preempt_disable_count() != 1)
+      return false; /* We cannot yield here */
+
+   for (int i = 0; i < KMUTEX_SPIN_MAX_YIELDS; i++) {
+
+      if (!list_is_empty(&m->wait_list))
+         return false;
+
+      owner = m->owner_task;
+
+      if (!owner) {
+         kmutex_take_ownership(m);
+         return true;
+      }
+
+      if (get_task_state(owner) != TASK_STATE_RUNNABLE)
+         return false; /* The owner is sleeping: its critical section is long */
+
+      kernel_yield_preempt_disabled();
+      disable_preemption();
+   }
+
+   if (!m->owner_task && list_is_empty(&m->wait_list)) {
+      kmutex_take_ownership(m);
+      return true;
+   }
+
+   return false;
+}
+
 void kmutex_lock(struct kmutex *m)
 {
+   u64 wait_start;
+
    disable_preemption();
    DEBUG_ONLY(check_not_in_irq_handler());
 
    if (!m->owner_task) {
 
       /* Nobody owns this mutex, just make this task own it */
-      m->owner_task = get_curr_task();
-
-      if (m->flags & KMUTEX_FL_RECURSIVE) {
-         ASSERT(m->lock_count == 0);
-         m->lock_count++;
-      }
-
+      kmutex_take_ownership(m);
+      lockstat_acquired(lockstat_of(m), 0);
       kmutex_lock_enable_preemption_wrapper(m);
       enable_preemption();
       return;
@@ -70,6 +136,19 @@ void kmutex_lock(struct kmutex *m)
       ASSERT(!kmutex_is_curr_task_holding_lock(m));
    }
 
+   wait_start = lockstat_wait_begin(lockstat_of(m));
+
+   if (kmutex_wait_for_runnable_owner(m)) {
+
+#if KMUTEX_STATS_ENABLED
+      m->num_spin_acquired++;
+#endif
+
+      lockstat_acquired(lockstat_of(m), wait_start);
+      enable_preemption();
+      return;
+   }
+
 #if KMUTEX_STATS_ENABLED
    m->num_waiters++;
    m->max_num_waiters = MAX(m->num_waiters, m->max_num_waiters);
@@ -92,6 +171,7 @@ void kmutex_lock(struct kmutex *m)
 
    /* Now for sure this task should hold the mutex */
    ASSERT(kmutex_is_curr_task_holding_lock(m));
+   lockstat_acquired(lockstat_of(m), wait_start);
 
    /*
     * DEBUG check: in case we went to sleep with a recursive mutex, then the
@@ -118,6 +198,8 @@ bool kmutex_trylock(struct kmutex *m)
       if (m->flags & KMUTEX_FL_RECURSIVE)
          m->lock_count++;
 
+      lockstat_acquired(lockstat_of(m), 0);
+
    } else {
 
       /*
@@ -158,8 +240,13 @@ void kmutex_unlock(struct kmutex *m)
    }
 
    m->owner_task = NULL;
+   lockstat_released(lockstat_of(m));
 
-   /* Unlock one task waiting to acquire the mutex 'm' (if any) */
+   /*
+    * Unlock one task waiting to acquire the mutex 'm' (if any), handing off the
+    * mutex directly to it. Leaving the mutex free would allow the tasks in
+    * kmutex_wait_for_runnable_owner() to steal it, starving the sleepers.
+    */
    if (!list_is_empty(&m->wait_list)) {
 
       struct wait_obj *task_wo =
@@ -0,0 +1,163 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+
+#include <tilck/kernel/lockstat.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/sort.h>
+#include <tilck/kernel/hal.h>
+
+/*
+ * The list and all the counters are protected by disabling the preemption,
+ * which is enough on UP. The lock primitives cannot be used in IRQ context.
+ */
+static struct list lockstat_list = STATIC_LIST_INIT(lockstat_list);
+static int lockstat_count;
+
+void
+lockstat_register(struct lockstat **ls_ref,
+                  enum lockstat_type type,
+                  const char *name,
+                  long id)
+{
+   struct lockstat *ls;
+
+   if (!KRN_LOCKSTAT || !ls_ref)
+      return;
+
+   ASSERT(*ls_ref == NULL);
+
+   /* Best effort: in case of OOM, the lock just won't be tracked */
+   if (!(ls = kzalloc_obj(struct lockstat)))
+      return;
+
+   list_node_init(&ls->node);
+   ls->type = type;
+   ls->name = name;
+   ls->id = id;
+
+   disable_preemption();
+   {
+      list_add_tail(&lockstat_list, &ls->node);
+      lockstat_count++;
+      *ls_ref = ls;
+   }
+   enable_preemption();
+}
+
+void
+lockstat_unregister(struct lockstat **ls_ref)
+{
+   struct lockstat *ls;
+
+   if (!KRN_LOCKSTAT || !ls_ref || !*ls_ref)
+      return;
+
+   disable_preemption();
+   {
+      ls = *ls_ref;
+      list_remove(&ls->node);
+      lockstat_count--;
+      *ls_ref = NULL;
+   }
+   enable_preemption();
+
+   kfree_obj(ls, struct lockstat);
+}
+
+u64 __lockstat_wait_begin(void)
+{
+   return RDTSC();
+}
+
+void __lockstat_acquired(struct lockstat *ls, u64 wait_start, bool ex)
+{
+   const u64 wait = wait_start ? RDTSC() - wait_start : 0;
+
+   disable_preemption();
+   {
+      ls->acquisitions++;
+
+      if (wait_start) {
+         ls->contentions++;
+         ls->wait_tot += wait;
+         ls->wait_max = MAX(ls->wait_max, wait);
+      }
+
+      if (ex)
+         ls->holder_tid = get_curr_tid();
+   }
+   enable_preemption();
+}
+
+void __lockstat_released(struct lockstat *ls)
+{
+   disable_preemption();
+   {
+      ls->holder_tid = 0;
+   }
+   enable_preemption();
+}
+
+void lockstat_reset(void)
+{
+   struct lockstat *pos;
+
+   disable_preemption();
+   {
+      list_for_each_ro(pos, &lockstat_list, node) {
+         pos->acquisitions = 0;
+         pos->contentions = 0;
+         pos->wait_tot = 0;
+         pos->wait_max = 0;
+      }
+   }
+   enable_preemption();
+}
+
+int lockstat_get_count(void)
+{
+   return lockstat_count;
+}
+
+static long lockstat_cmpf(const void *a, const void *b)
+{
+   const struct lockstat *x = a;
+   const struct lockstat *y = b;
+
+   if (x->contentions != y->contentions)
+      return x->contentions < y->contentions ? 1 : -1;
+
+   if (x->wait_tot != y->wait_tot)
+      return x->wait_tot < y->wait_tot ? 1 : -1;
+
+   return (long)y->acquisitions - (long)x->acquisitions;
+}
+
+/*
+ * Copy the stats of up to `max_count` tracked locks in `arr`, sorted by
+ * contentions and total wait time, in descending order. Returns the number
+ * of elements copied. The `node` field of the copies must be ignored.
+ */
+int lockstat_snapshot(struct lockstat *arr, int max_count)
+{
+   struct lockstat *pos;
+   int count = 0;
+
+   disable_preemption();
+   {
+      list_for_each_ro(pos, &lockstat_list, node) {
+
+         if (count == max_count)
+            break;
+
+         arr[count++] = *pos;
+      }
+   }
+   enable_preemption();
+
+   insertion_sort_generic(arr, sizeof(arr[0]), (u32)count, lockstat_cmpf);
+   return count;
+}
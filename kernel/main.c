@@ -21,6 +21,9 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/elf_loader.h>
 #include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/kmsg.h>
+#include <tilck/kernel/sys_stats.h>
+#include <tilck/kernel/smp.h>
 #include <tilck/kernel/fs/fat32.h>
 #include <tilck/kernel/fs/devfs.h>
 #include <tilck/kernel/timer.h>
@@ -34,6 +37,7 @@
 #include <tilck/kernel/fs/kernelfs.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/uefi.h>
+#include <tilck/kernel/boot_timeline.h>
 
 #include <tilck/mods/console.h>
 #include <tilck/mods/fb_console.h>
@@ -306,6 +310,8 @@ run_init_or_selftest(void)
    if (self_test_to_run) {
 
       if (KERNEL_SELFTESTS) {
+         wait_for_all_modules();
+         boot_tl_mark("run selftest");
          self_test_to_run();
          return;
       }
@@ -317,7 +323,11 @@ run_init_or_selftest(void)
       if (system_mmap_get_ramdisk(0, NULL, NULL) < 0)
          panic("No ramdisk and no selftest requested: nothing to do.");
 
-      /* Run init or whatever program was passed in the cmdline */
+      /*
+       * Run init or whatever program was passed in the cmdline. NOTE: the
+       * async modules might still be initializing: init doesn't need them.
+       */
+      boot_tl_mark("run init");
       long rc = first_execve(cmd_args[0], cmd_args);
 
       if (rc != 0)
@@ -330,10 +340,12 @@ static void do_async_init()
    /* declare the show_hello_message() function */
    void show_hello_message(void);
 
-   mount_initrd();
-   init_devfs();
-   init_modules();
-   init_extra_debug_features();
+   BOOT_STAGE(mount_initrd());
+   BOOT_STAGE(init_devfs());
+   BOOT_STAGE(init_kmsg_device());
+   BOOT_STAGE(init_smp());
+   BOOT_STAGE(init_modules());
+   BOOT_STAGE(init_extra_debug_features());
 
    show_hello_message();
    run_init_or_selftest();
@@ -349,35 +361,39 @@ async_init(void)
 void
 kmain(u32 multiboot_magic, u32 mbi_addr)
 {
-   call_kernel_global_ctors();
+   boot_tl_init();
+   BOOT_STAGE(call_kernel_global_ctors());
    save_multiboot_info(multiboot_magic, mbi_addr);
 
-   early_init_serial_ports();
-   init_cpu_exception_handling();
-   early_init_paging();
-   early_init_kmalloc();
-
-   read_multiboot_info();
-   enable_cpu_features();
-   kmain_early_checks();
-   init_segmentation();
-   init_fpu_memcpy();
-   init_kmalloc();
-   init_paging();
-
-   setup_uefi_runtime_services();
-   acpi_mod_init_tables();
-
-   init_console();
-   init_self_tests();
-   init_irq_handling();
-   init_sched();
-   init_syscall_interfaces();
-   init_worker_threads();
-   init_timer();
-   init_system_time();
-   init_kernelfs();
+   BOOT_STAGE(early_init_serial_ports());
+   BOOT_STAGE(init_cpu_exception_handling());
+   BOOT_STAGE(early_init_paging());
+   BOOT_STAGE(early_init_kmalloc());
+
+   BOOT_STAGE(read_multiboot_info());
+   BOOT_STAGE(enable_cpu_features());
+   BOOT_STAGE(kmain_early_checks());
+   BOOT_STAGE(init_segmentation());
+   BOOT_STAGE(init_fpu_memcpy());
+   BOOT_STAGE(init_kmalloc());
+   BOOT_STAGE(init_paging());
+
+   BOOT_STAGE(setup_uefi_runtime_services());
+   BOOT_STAGE(acpi_mod_init_tables());
+
+   BOOT_STAGE(init_console());
+   BOOT_STAGE(init_self_tests());
+   BOOT_STAGE(init_irq_handling());
+   BOOT_STAGE(init_sched());
+   BOOT_STAGE(init_syscall_interfaces());
+   BOOT_STAGE(init_sys_stats());
+   BOOT_STAGE(init_worker_threads());
+   BOOT_STAGE(init_printk_worker());
+   BOOT_STAGE(init_timer());
+   BOOT_STAGE(init_system_time());
+   BOOT_STAGE(init_kernelfs());
 
    async_init();
+   boot_tl_mark("kmain: start scheduling");
    do_schedule();
 }
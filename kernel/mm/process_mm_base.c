@@ -3,6 +3,7 @@
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/process.h>
 #include <tilck/kernel/paging_hw.h>
+#include <tilck/kernel/fs/fd_table.h>
 
 struct user_mapping *
 process_add_user_mapping(fs_handle h,
@@ -141,9 +142,9 @@ void remove_all_file_mappings(struct process *pi)
 {
    fs_handle *h;
 
-   for (u32 i = 0; i < MAX_HANDLES; i++) {
+   for (int i = 0; i < fdt_size(pi->fdt); i++) {
 
-      if (!(h = pi->handles[i]))
+      if (!(h = fdt_get(pi->fdt, i)))
          continue;
 
       remove_all_mappings_of_handle(pi, h);
@@ -312,8 +313,7 @@ bool user_map_zero_page(ulong user_vaddr, size_t page_count)
 
 int generic_fs_munmap(struct user_mapping *um, void *vaddrp, size_t len)
 {
-   struct fs_handle_base *hb = um->h;
-   struct process *pi = hb->pi;
+   struct process *pi = um->pi;
    ulong vaddr = (ulong)vaddrp;
    ulong vend = vaddr + len;
    ASSERT(IS_PAGE_ALIGNED(len));
@@ -1,14 +1,24 @@
 /* SPDX-License-Identifier: BSD-2-Clause */
 
 #include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
 #include <tilck/common/printk.h>
 
 #include <tilck/kernel/modules.h>
 #include <tilck/kernel/sort.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/cmdline.h>
+#include <tilck/kernel/boot_timeline.h>
 
 static int mods_count;
 static struct module *modules[32];
 
+/* Protects the `initialized` field of the modules and `async_pending` */
+static struct kmutex mods_lock = STATIC_KMUTEX_INIT(mods_lock, 0);
+static struct kcond mods_cond = STATIC_KCOND_INIT(mods_cond);
+static int async_pending;
+
 void register_module(struct module *m)
 {
    ASSERT(mods_count < ARRAY_SIZE(modules) - 1);
@@ -22,13 +32,115 @@ static long mod_cmp_func(const void *a, const void *b)
    return (*ma)->priority - (*mb)->priority;
 }
 
+static struct module *find_module(const char *name)
+{
+   for (int i = 0; i < mods_count; i++)
+      if (!strcmp(modules[i]->name, name))
+         return modules[i];
+
+   return NULL;
+}
+
+static inline bool is_async_module(struct module *m)
+{
+   return m->async && !kopt_sync_mods;
+}
+
+static void check_module_deps(struct module *m)
+{
+   struct module *dep;
+
+   for (const char *const *n = m->deps; n && *n; n++) {
+
+      if (!(dep = find_module(*n)))
+         continue; /* Not built-in: hard deps are checked at build time */
+
+      if (dep->priority >= m->priority)
+         panic("Module %s depends on %s, initialized after it", m->name, *n);
+   }
+}
+
+static void wait_for_module_deps(struct module *m)
+{
+   struct module *dep;
+
+   kmutex_lock(&mods_lock);
+
+   for (const char *const *n = m->deps; n && *n; n++) {
+
+      if (!(dep = find_module(*n)))
+         continue;
+
+      while (!dep->initialized)
+         kcond_wait(&mods_cond, &mods_lock, KCOND_WAIT_FOREVER);
+   }
+
+   kmutex_unlock(&mods_lock);
+}
+
+static void do_init_module(struct module *m)
+{
+   const bool async = is_async_module(m);
+   int idx;
+
+   wait_for_module_deps(m);
+
+   printk("*** Init kernel module: %s%s\n", m->name, async ? " (async)" : "");
+   idx = boot_tl_begin(m->name);
+   m->init();
+   boot_tl_end(idx);
+
+   kmutex_lock(&mods_lock);
+   {
+      m->initialized = true;
+
+      if (async && !--async_pending)
+         boot_tl_mark("all async modules initialized");
+
+      kcond_signal_all(&mods_cond);
+   }
+   kmutex_unlock(&mods_lock);
+}
+
+static void async_init_module(void *arg)
+{
+   do_init_module(arg);
+}
+
+void wait_for_all_modules(void)
+{
+   kmutex_lock(&mods_lock);
+   {
+      while (async_pending > 0)
+         kcond_wait(&mods_cond, &mods_lock, KCOND_WAIT_FOREVER);
+   }
+   kmutex_unlock(&mods_lock);
+}
+
 void init_modules(void)
 {
    insertion_sort_ptr(modules, (u32)mods_count, &mod_cmp_func);
 
    for (int i = 0; i < mods_count; i++) {
+
+      check_module_deps(modules[i]);
+
+      if (is_async_module(modules[i]))
+         async_pending++;
+   }
+
+   for (int i = 0; i < mods_count; i++) {
+
       struct module *m = modules[i];
-      printk("*** Init kernel module: %s\n", m->name);
-      m->init();
+
+      if (is_async_module(m)) {
+
+         if (kthread_create2(&async_init_module, m->name, 0, m) >= 0)
+            continue;
+
+         printk("WARNING: no kthread for module %s: init it now\n", m->name);
+      }
+
+      do_init_module(m);
    }
 }
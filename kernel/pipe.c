@@ -2,22 +2,38 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/atomics.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
 
 #include <tilck/kernel/kmalloc.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/pipe.h>
 #include <tilck/kernel/fs/kernelfs.h>
-#include <tilck/kernel/ringbuf.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/paging_hw.h>
+#include <tilck/kernel/user.h>
+
+struct pipe_buf {
+
+   char *page;          /* linear address of the page holding the data */
+   u16 off;             /* offset of the first unread byte in `page` */
+   u16 len;             /* number of unread bytes */
+   bool gifted;         /* page shared with user space: never write on it */
+};
 
 struct pipe {
 
    KOBJ_BASE_FIELDS
 
-   char *buf;
-   struct ringbuf rb;
+   struct pipe_buf *bufs;     /* ring of `nr_bufs` page buffers */
+   u32 nr_bufs;
+   u32 head;                  /* index of the first buffer with data */
+   u32 used;                  /* number of buffers with data */
+   char *spare_page;          /* free page, kept to avoid kmalloc churn */
+
    struct kmutex mutex;
    struct kcond not_full_cond;
    struct kcond not_empty_cond;
@@ -27,6 +43,147 @@ struct pipe {
    ATOMIC(int) write_handles;
 };
 
+static ALWAYS_INLINE struct pipe_buf *pipe_buf_at(struct pipe *p, u32 i)
+{
+   ASSERT(i < p->nr_bufs);
+   return &p->bufs[(p->head + i) % p->nr_bufs];
+}
+
+static ALWAYS_INLINE bool pipe_is_empty(struct pipe *p)
+{
+   return p->used == 0;
+}
+
+static ALWAYS_INLINE bool pipe_buf_has_room(struct pipe_buf *b)
+{
+   return !b->gifted && b->off + b->len < PAGE_SIZE;
+}
+
+static bool pipe_is_full(struct pipe *p)
+{
+   if (p->used < p->nr_bufs)
+      return false;
+
+   return !pipe_buf_has_room(pipe_buf_at(p, p->used - 1));
+}
+
+static char *pipe_alloc_page(struct pipe *p)
+{
+   char *page = p->spare_page;
+
+   if (page) {
+      p->spare_page = NULL;
+      return page;
+   }
+
+   return kmalloc(PAGE_SIZE);
+}
+
+static void pipe_release_page(struct pipe *p, struct pipe_buf *b)
+{
+   if (b->gifted)
+      release_shared_page(b->page);
+   else if (!p->spare_page)
+      p->spare_page = b->page;
+   else
+      kfree2(b->page, PAGE_SIZE);
+
+   bzero(b, sizeof(*b));
+}
+
+/* Copy up to `size` bytes out of the pipe. Returns the number of bytes read */
+static size_t pipe_copy_out(struct pipe *p, char *buf, size_t size)
+{
+   size_t tot = 0;
+
+   while (tot < size && !pipe_is_empty(p)) {
+
+      struct pipe_buf *b = pipe_buf_at(p, 0);
+      const size_t n = MIN(size - tot, (size_t)b->len);
+
+      memcpy(buf + tot, b->page + b->off, n);
+      b->off += (u16)n;
+      b->len -= (u16)n;
+      tot += n;
+
+      if (!b->len) {
+         pipe_release_page(p, b);
+         p->head = (p->head + 1) % p->nr_bufs;
+         p->used--;
+      }
+   }
+
+   return tot;
+}
+
+/*
+ * Copy up to `size` bytes into the pipe, filling first the room left in the
+ * last buffer. Returns the number of bytes written or -ENOMEM, if it was not
+ * possible to write anything because of a failed page allocation.
+ */
+static ssize_t pipe_copy_in(struct pipe *p, const char *buf, size_t size)
+{
+   struct pipe_buf *b;
+   size_t tot = 0;
+
+   if (p->used && pipe_buf_has_room((b = pipe_buf_at(p, p->used - 1)))) {
+
+      const size_t n = MIN(size, PAGE_SIZE - b->off - b->len);
+
+      memcpy(b->page + b->off + b->len, buf, n);
+      b->len += (u16)n;
+      tot += n;
+   }
+
+   while (tot < size && p->used < p->nr_bufs) {
+
+      const size_t n = MIN(size - tot, PAGE_SIZE);
+      char *page;
+
+      if (!(page = pipe_alloc_page(p)))
+         return tot ? (ssize_t)tot : -ENOMEM;
+
+      memcpy(page, buf + tot, n);
+
+      b = pipe_buf_at(p, p->used++);
+      *b = (struct pipe_buf) {
+         .page = page,
+         .off = 0,
+         .len = (u16)n,
+         .gifted = false,
+      };
+
+      tot += n;
+   }
+
+   return (ssize_t)tot;
+}
+
+/*
+ * Try to add the user page at `u_page` to the pipe, without copying it.
+ * Returns true in case of success.
+ */
+static bool pipe_gift_user_page(struct pipe *p, void *u_page)
+{
+   struct pipe_buf *b;
+   char *page;
+
+   ASSERT(p->used < p->nr_bufs);
+
+   if (!(page = share_user_page_cow(get_curr_pdir(), u_page)))
+      return false;
+
+   b = pipe_buf_at(p, p->used++);
+   *b = (struct pipe_buf) {
+      .page = page,
+      .off = 0,
+      .len = PAGE_SIZE,
+      .gifted = true,
+   };
+
+   return true;
+}
+
 static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
 {
    struct kfs_handle *kh = h;
@@ -42,7 +199,7 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
 
    while (true) {
 
-      rc = (ssize_t)ringbuf_read_bytes(&p->rb, (u8 *)buf, size);
+      rc = (ssize_t)pipe_copy_out(p, buf, size);
 
       if (rc)
          break; /* Everything is alright, we read something */
@@ -81,7 +238,7 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
     */
    kcond_signal_one(&p->not_full_cond);
 
-   if (!ringbuf_is_empty(&p->rb)) {
+   if (!pipe_is_empty(p)) {
       /* The buffer is not empty: wake up one more reader, if any */
       kcond_signal_one(&p->not_empty_cond);
    }
@@ -91,11 +248,57 @@ static ssize_t pipe_read(fs_handle h, char *buf, size_t size, offt *pos)
    return !sig_pending ? rc : -EINTR;
 }
 
+/*
+ * Wait for some room in the pipe. Returns 0 when the caller should retry or
+ * a negative error code: -EPIPE when there are no more readers, -EAGAIN in the
+ * non-blocking case and -EINTR if we've been interrupted by a signal.
+ */
+static int pipe_wait_for_room(struct pipe *p, bool nonblock)
+{
+   if (nonblock)
+      return -EAGAIN;
+
+   /* Wait for readers to empty the buffer */
+   kcond_wait(&p->not_full_cond, &p->mutex, KCOND_WAIT_FOREVER);
+
+   /* After wake up */
+   if (pending_signals())
+      return -EINTR;
+
+   return 0;
+}
+
+static int pipe_check_readers(struct pipe *p)
+{
+   if (atomic_load_explicit(&p->read_handles, mo_relaxed) == 0) {
+
+      /* Broken pipe */
+      send_signal(get_curr_pid(), SIGPIPE, true);
+      return -EPIPE;
+   }
+
+   return 0;
+}
+
+static void pipe_wakeup_after_write(struct pipe *p)
+{
+   /*
+    * Wake up one blocked reader, instead of all of them.
+    * See the comments in pipe_read() above.
+    */
+   kcond_signal_one(&p->not_empty_cond);
+
+   if (!pipe_is_full(p)) {
+      /* The buffer is not full: wake up one more writer, if any */
+      kcond_signal_one(&p->not_full_cond);
+   }
+}
+
 static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
 {
    struct kfs_handle *kh = h;
    struct pipe *p = (void *)kh->kobj;
-   bool sig_pending = false;
+   const bool nonblock = !!(kh->fl_flags & O_NONBLOCK);
    ssize_t rc = 0;
    ASSERT(*pos == 0);
 
@@ -106,48 +309,166 @@ static ssize_t pipe_write(fs_handle h, char *buf, size_t size, offt *pos)
 
    while (true) {
 
-      if (atomic_load_explicit(&p->read_handles, mo_relaxed) == 0) {
-
-         /* Broken pipe */
-         send_signal(get_curr_pid(), SIGPIPE, true);
-         rc = -EPIPE;
+      if ((rc = pipe_check_readers(p)))
          break;
-      }
 
-      rc = (ssize_t)ringbuf_write_bytes(&p->rb, (u8 *)buf, size);
+      rc = pipe_copy_in(p, buf, size);
 
       if (rc)
-         break; /* Everything is alright, we wrote something */
+         break; /* We wrote something or we're out of memory */
 
-      if (kh->fl_flags & O_NONBLOCK) {
-         rc = -EAGAIN;
+      if ((rc = pipe_wait_for_room(p, nonblock)))
          break;
-      }
+   }
 
-      /* Wait for readers to empty the buffer */
-      kcond_wait(&p->not_full_cond, &p->mutex, KCOND_WAIT_FOREVER);
+   pipe_wakeup_after_write(p);
 
-      /* After wake up */
-      if (pending_signals()) {
-         sig_pending = true;
-         break;
+   /* Unlock the pipe's state lock and return */
+   kmutex_unlock(&p->mutex);
+   return rc;
+}
+
+/*
+ * Move up to `len` bytes from the user buffer at `u_buf` into the pipe. Whole
+ * and page-aligned user pages are added to the pipe by reference, as
+ * copy-on-write pages. Everything else is just copied. Returns the number of
+ * bytes moved or a negative error code.
+ */
+static ssize_t pipe_vmsplice_chunk(struct pipe *p, char *u_buf, size_t len)
+{
+   struct task *curr = get_curr_task();
+
+   if (IS_PAGE_ALIGNED(u_buf) && len >= PAGE_SIZE) {
+
+      if (p->used == p->nr_bufs)
+         return 0; /* No free buffers */
+
+      if (pipe_gift_user_page(p, u_buf))
+         return PAGE_SIZE;
+   }
+
+   /* Copy the data up to the next page boundary */
+   len = MIN(len, PAGE_SIZE - ((ulong)u_buf & OFFSET_IN_PAGE_MASK));
+
+   if (copy_from_user(curr->io_copybuf, u_buf, len))
+      return -EFAULT;
+
+   return pipe_copy_in(p, curr->io_copybuf, len);
+}
+
+ssize_t
+pipe_vmsplice(fs_handle h, const struct iovec *iov, int iovcnt, u32 flags)
+{
+   struct kfs_handle *kh = h;
+   struct pipe *p = (void *)kh->kobj;
+   bool nonblock = !!(kh->fl_flags & O_NONBLOCK);
+   ssize_t tot = 0, rc = 0;
+
+   if (kh->fops->read) {
+
+      /*
+       * vmsplice() on the read side of a pipe is just a readv(), as we don't
+       * support mapping pipe's pages in the user space.
+       */
+      return vfs_readv(h, iov, iovcnt);
+   }
+
+   if (flags & SPLICE_F_NONBLOCK)
+      nonblock = true;
+
+   kmutex_lock(&p->mutex);
+
+   for (int i = 0; i < iovcnt; i++) {
+
+      size_t off = 0;
+
+      while (off < iov[i].iov_len) {
+
+         if ((rc = pipe_check_readers(p)))
+            goto out;
+
+         rc = pipe_vmsplice_chunk(p,
+                                  (char *)iov[i].iov_base + off,
+                                  iov[i].iov_len - off);
+         if (rc < 0)
+            goto out;
+
+         if (rc > 0) {
+            off += (size_t)rc;
+            tot += rc;
+            continue;
+         }
+
+         /* The pipe is full */
+         if (tot > 0)
+            goto out;
+
+         if ((rc = pipe_wait_for_room(p, nonblock)))
+            goto out;
       }
    }
 
-   /*
-    * Wake up one blocked reader, instead of all of them.
-    * See the comments in pipe_read() above.
-    */
-   kcond_signal_one(&p->not_empty_cond);
+out:
+   pipe_wakeup_after_write(p);
+   kmutex_unlock(&p->mutex);
+   return tot > 0 ? tot : rc;
+}
 
-   if (!ringbuf_is_full(&p->rb)) {
-      /* The buffer is not full: wake up one more writer, if any */
-      kcond_signal_one(&p->not_full_cond);
+static int pipe_set_size(struct pipe *p, int size)
+{
+   struct pipe_buf *new_bufs;
+   u32 nr_bufs;
+
+   if (size <= 0)
+      return -EINVAL;
+
+   nr_bufs = (u32)round_up_at((ulong)size, PAGE_SIZE) >> PAGE_SHIFT;
+
+   if (nr_bufs > PIPE_MAX_BUFS)
+      return -EPERM; /* Like Linux does for unprivileged users */
+
+   kmutex_lock(&p->mutex);
+
+   if (p->used > nr_bufs) {
+      kmutex_unlock(&p->mutex);
+      return -EBUSY;
    }
 
-   /* Unlock the pipe's state lock and return */
+   if (!(new_bufs = kzalloc_array_obj(struct pipe_buf, nr_bufs))) {
+      kmutex_unlock(&p->mutex);
+      return -ENOMEM;
+   }
+
+   for (u32 i = 0; i < p->used; i++)
+      new_bufs[i] = *pipe_buf_at(p, i);
+
+   kfree_array_obj(p->bufs, struct pipe_buf, p->nr_bufs);
+   p->bufs = new_bufs;
+   p->nr_bufs = nr_bufs;
+   p->head = 0;
+
+   /* The pipe might have more room now */
+   kcond_signal_all(&p->not_full_cond);
    kmutex_unlock(&p->mutex);
-   return !sig_pending ? rc : -EINTR;
+   return (int)(nr_bufs << PAGE_SHIFT);
+}
+
+static int pipe_fcntl(fs_handle h, int cmd, int arg)
+{
+   struct kfs_handle *kh = h;
+   struct pipe *p = (void *)kh->kobj;
+
+   switch (cmd) {
+
+      case F_SETPIPE_SZ:
+         return pipe_set_size(p, arg);
+
+      case F_GETPIPE_SZ:
+         return (int)(p->nr_bufs << PAGE_SHIFT);
+
+      default:
+         return -EINVAL;
+   }
 }
 
 static int pipe_read_ready(fs_handle h)
@@ -158,7 +479,7 @@ static int pipe_read_ready(fs_handle h)
 
    kmutex_lock(&p->mutex);
    {
-      ret = !ringbuf_is_empty(&p->rb) ||
+      ret = !pipe_is_empty(p) ||
             atomic_load_explicit(&p->write_handles, mo_relaxed) == 0;
    }
    kmutex_unlock(&p->mutex);
@@ -180,7 +501,7 @@ static int pipe_write_ready(fs_handle h)
 
    kmutex_lock(&p->mutex);
    {
-      ret = !ringbuf_is_full(&p->rb) ||
+      ret = !pipe_is_full(p) ||
             atomic_load_explicit(&p->read_handles, mo_relaxed) == 0;
    }
    kmutex_unlock(&p->mutex);
@@ -222,6 +543,7 @@ static struct kcond *pipe_get_except_cond(fs_handle h)
 static const struct file_ops static_ops_pipe_read_end =
 {
    .read = pipe_read,
+   .fcntl = pipe_fcntl,
    .read_ready = pipe_read_ready,
    .except_ready = pipe_except_ready,
    .get_rready_cond = pipe_get_rready_cond,
@@ -231,6 +553,7 @@ static const struct file_ops static_ops_pipe_read_end =
 static const struct file_ops static_ops_pipe_write_end =
 {
    .write = pipe_write,
+   .fcntl = pipe_fcntl,
    .except_ready = pipe_except_ready,
    .write_ready = pipe_write_ready,
    .get_wready_cond = pipe_get_wready_cond,
@@ -243,8 +566,17 @@ void destroy_pipe(struct pipe *p)
    kcond_destory(&p->not_empty_cond);
    kcond_destory(&p->not_full_cond);
    kmutex_destroy(&p->mutex);
-   ringbuf_destory(&p->rb);
-   kfree2(p->buf, PIPE_BUF_SIZE);
+
+   while (!pipe_is_empty(p)) {
+      pipe_release_page(p, pipe_buf_at(p, 0));
+      p->head = (p->head + 1) % p->nr_bufs;
+      p->used--;
+   }
+
+   if (p->spare_page)
+      kfree2(p->spare_page, PAGE_SIZE);
+
+   kfree_array_obj(p->bufs, struct pipe_buf, p->nr_bufs);
    kfree_obj(p, struct pipe);
 }
 
@@ -288,15 +620,16 @@ struct pipe *create_pipe(void)
    if (!(p = (void *)kzalloc_obj(struct pipe)))
       return NULL;
 
-   if (!(p->buf = kmalloc(PIPE_BUF_SIZE))) {
+   if (!(p->bufs = kzalloc_array_obj(struct pipe_buf, PIPE_DEF_BUFS))) {
       kfree_obj(p, struct pipe);
       return NULL;
    }
 
+   p->nr_bufs = PIPE_DEF_BUFS;
+
    p->on_handle_close = &pipe_on_handle_close;
    p->on_handle_dup = &pipe_on_handle_dup;
    p->destory_obj = (void *)&destroy_pipe;
-   ringbuf_init(&p->rb, PIPE_BUF_SIZE, 1, p->buf);
    kmutex_init(&p->mutex, 0);
    kcond_init(&p->not_full_cond);
    kcond_init(&p->not_empty_cond);
@@ -327,3 +660,11 @@ fs_handle pipe_create_write_handle(struct pipe *p)
 
    return res;
 }
+
+bool is_pipe_handle(fs_handle h)
+{
+   struct fs_handle_base *hb = h;
+
+   return hb->fops == &static_ops_pipe_read_end ||
+          hb->fops == &static_ops_pipe_write_end;
+}
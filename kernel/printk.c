@@ -13,6 +13,8 @@
 #include <tilck/kernel/term.h>
 #include <tilck/kernel/tty.h>
 #include <tilck/kernel/datetime.h>
+#include <tilck/kernel/kmsg.h>
+#include <tilck/kernel/worker_thread.h>
 
 #include <tilck/mods/tracing.h>
 
@@ -32,42 +34,22 @@
 #define PRINTK_NOSPACE_IN_RBUF_FLUSH_COLOR    COLOR_MAGENTA
 #define PRINTK_PANIC_COLOR                    COLOR_RED
 
-struct ringbuf_stat {
-
-   union {
-
-      struct {
-         u32 read_pos              : 14;
-         u32 write_pos             : 14;
-         u32 full                  :  1;
-         u32 first_printk          :  1;
-         u32 newline               :  1;
-         u32 unused0               :  1;
-      };
+bool __in_printk;
 
-      ATOMIC(u32) raw;
-      u32 __raw;
-   };
-};
+/* Next record to print on the console */
+static u32 console_seq;
 
-#if TINY_KERNEL
-   static char printk_rbuf[2 * KB];
-#else
-   static char printk_rbuf[8 * KB];
-#endif
+/* True while a context is printing records on the console */
+static ATOMIC(bool) console_busy;
 
-static volatile struct ringbuf_stat printk_rbuf_stat =
-{
-   .newline = 1
-};
+/* True if the last record ended with a newline */
+static ATOMIC(bool) last_newline = true;
 
-bool __in_printk;
+/* Low-priority worker thread printing on the console the records from IRQs */
+static struct worker_thread *printk_wth;
+static ATOMIC(bool) printk_wth_job_pending;
 
-/*
- * NOTE: the ring buf cannot be larger than 16K elems because of the size of the
- * read_pos and write_pos bit-fields.
- */
-STATIC_ASSERT(sizeof(printk_rbuf) <= 16 * KB);
+STATIC_ASSERT(KMSG_TEXT_SZ >= PRINTK_BUF_SZ);
 
 static void
 printk_direct_flush_no_tty(const char *buf, size_t size, u8 color)
@@ -86,81 +68,27 @@ printk_direct_flush_no_tty(const char *buf, size_t size, u8 color)
    }
 }
 
-static ALWAYS_INLINE u32
-printk_calc_used(const struct ringbuf_stat *cs)
-{
-   u32 used = (cs->write_pos - cs->read_pos) % sizeof(printk_rbuf);
-
-   if (!used)
-      used = cs->full ? sizeof(printk_rbuf) : 0;
-
-   return used;
-}
-
 static void
-printk_write_early_ringbuf_to_trace_printk(void)
+printk_write_early_records_to_trace_printk(void)
 {
    char buf[sizeof(((struct printk_event_data *)0)->buf)];
-   u32 rpos, buf_pos, used, to_read;
-   char val;
-
-   ASSERT(!are_interrupts_enabled());
-   used = printk_calc_used((struct ringbuf_stat *)&printk_rbuf_stat);
-   rpos = printk_rbuf_stat.read_pos;
-
-   while (used) {
-
-      /* Determine how many bytes we can read */
-      to_read = MIN(used, (u32)sizeof(buf) - 1);
-
-      /* Read the first char and check if it's the printk prefix */
-      val = printk_rbuf[rpos % sizeof(printk_rbuf)];
-
-      if (val == '[') {
+   const u32 next = kmsg_get_next_seq();
+   struct kmsg_hdr hdr;
+   int rc;
 
-         /*
-          * Yes, it looks like the printk prefix '[    0.000] '. So, check if
-          * the char ']' is exactly where we expect it to be and skip the whole
-          * prefix.
-          */
-         if (printk_rbuf[(rpos + 10) % sizeof(printk_rbuf)] == ']') {
-            ASSERT(printk_rbuf[(rpos + 11) % sizeof(printk_rbuf)] == ' ');
-            rpos += 12;
-         }
-      }
+   for (u32 seq = kmsg_get_first_seq(); seq != next; seq++) {
 
-      /* OK, now we can read the actual message on that line */
-      for (buf_pos = 0; buf_pos < to_read && val != '\n';) {
-         val = printk_rbuf[rpos++ % sizeof(printk_rbuf)];
-         buf[buf_pos++] = val;
-      }
+      if ((rc = kmsg_read(seq, 0, buf, sizeof(buf), &hdr)) < 0)
+         continue;
 
-      /* Account all the chars that we put into our buffer */
-      used -= buf_pos;
-      buf[buf_pos] = 0;
+      if (hdr.len >= sizeof(buf)) {
 
-      if (val != '\n' && buf_pos == sizeof(buf) - 1) {
-         /*
-          * The trace buffer line is full but we didn't hit a newline delimiter:
-          * this means that we're dealing with a too long line that must be
-          * truncated.
-          */
+         /* The record has been truncated */
          char trunc[] = TRACE_PRINTK_TRUNC_STR;
          memcpy(buf + sizeof(buf) - sizeof(trunc), trunc, sizeof(trunc));
-
-         /*
-          * Now skip the rest of the text line from the ring buffer, so that
-          * we don't see it as a different trace event on the next iteration.
-          */
-         while (used > 0) {
-            if (printk_rbuf[rpos++ % sizeof(printk_rbuf)] == '\n') {
-               used--;
-               break;
-            }
-            used--;
-         }
       }
-      trace_printk_raw(1, buf, buf_pos + 1);
+
+      trace_printk_raw(1, buf, (size_t)rc);
    }
 }
 
@@ -193,149 +121,192 @@ printk_direct_flush(const char *buf, size_t size, u8 color)
 }
 
 static void
-__printk_flush_ringbuf(char *tmpbuf, u32 buf_size)
+printk_flush_record_prefix(struct kmsg_hdr *h, u8 color)
 {
-   struct ringbuf_stat cs, ns;
-   u32 used, to_read = 0;
+   char prefixbuf[PRINTK_PREFIXBUF_SZ];
+   int prefix_sz;
 
-   if (MOD_tracing_actual) {
-      static bool printk_flush_ringbuf_done_once;
-      if (UNLIKELY(!printk_flush_ringbuf_done_once)) {
-         printk_flush_ringbuf_done_once = true;
-         if (trace_printk_is_enabled() && !in_panic()) {
-            init_trace_printk();
-            printk_write_early_ringbuf_to_trace_printk();
-         }
-      }
-   }
+   prefix_sz = snprintk(
+      prefixbuf, sizeof(prefixbuf), "[%5u.%03u] %s",
+      (u32)(h->ts / TS_SCALE),
+      (u32)((h->ts % TS_SCALE) / (TS_SCALE / 1000)),
+      (h->flags & KMSG_FL_LOWSS) ? "[LOWSS] " : ""
+   );
+
+   printk_direct_flush(prefixbuf, (size_t)prefix_sz, color);
+}
 
-   while (true) {
+/*
+ * Print on the console all the published records, starting from console_seq,
+ * using `tmpbuf` to copy their text. Our own record (`own_seq`) gets printed
+ * with `own_color`.
+ *
+ * Returns false if it stopped at a record not published yet: that happens when
+ * we interrupted a printk() call between the reservation of its record and its
+ * publication. Once done, that printk() will print our records too.
+ */
+static bool
+__printk_flush_records(char *tmpbuf, u32 buf_size, u32 own_seq, u8 own_color)
+{
+   struct kmsg_hdr hdr;
+   u8 color;
+   u32 off;
+   int rc;
 
-      do {
-         cs = printk_rbuf_stat;
-         ns = printk_rbuf_stat;
-         used = printk_calc_used(&cs);
+   while (console_seq != kmsg_get_next_seq()) {
 
-         /* We can read at most 'buf_size' bytes at a time */
-         to_read = UNSAFE_MIN(buf_size, used);
+      rc = kmsg_read(console_seq, 0, tmpbuf, buf_size, &hdr);
 
-         /* And copy them to our minibuf */
-         for (u32 i = 0; i < to_read; i++)
-            tmpbuf[i] = printk_rbuf[(cs.read_pos + i) % sizeof(printk_rbuf)];
+      if (rc == -EAGAIN) {
 
-         /* Increase read_pos and decrease used */
-         ns.read_pos = (ns.read_pos + to_read) % sizeof(printk_rbuf);
+         if (!in_panic())
+            return false;
 
-         if (!to_read)
-            ns.first_printk = 0;
+         /* In panic, the interrupted printk() won't ever complete: skip it */
+         console_seq++;
+         continue;
+      }
 
-         /* Repeat that until we were able to do that atomically */
+      if (rc == -EPIPE) {
 
-      } while (!atomic_cas_weak(&printk_rbuf_stat.raw,
-                                &cs.__raw,
-                                ns.__raw,
-                                mo_relaxed,
-                                mo_relaxed));
+         /* The console was too slow and lost some records */
+         static const char err_msg[] = "{_DROPPED_}\n";
+         printk_direct_flush(err_msg, sizeof(err_msg) - 1,
+                             PRINTK_NOSPACE_IN_RBUF_FLUSH_COLOR);
 
-      /* Note: we checked that `first_printk` in `cs` was unset! */
-      if (!to_read)
-         break;
+         console_seq = kmsg_get_first_seq();
+         continue;
+      }
 
-      printk_direct_flush(tmpbuf, to_read, PRINTK_RINGBUF_FLUSH_COLOR);
+      color = console_seq == own_seq ? own_color : PRINTK_RINGBUF_FLUSH_COLOR;
+
+      if (hdr.flags & KMSG_FL_PREFIX)
+         printk_flush_record_prefix(&hdr, color);
+
+      for (off = 0; rc > 0; ) {
+
+         printk_direct_flush(tmpbuf, (size_t)rc, color);
+         off += (u32)rc;
+         rc = kmsg_read(console_seq, off, tmpbuf, buf_size, &hdr);
+      }
+
+      console_seq++;
    }
-}
 
-void
-printk_flush_ringbuf(void)
-{
-   char minibuf[80];
-   __printk_flush_ringbuf(minibuf, sizeof(minibuf));
+   return true;
 }
 
-static void printk_append_to_ringbuf(const char *buf, size_t size)
+static void
+printk_flush_records(char *tmpbuf, u32 buf_size, u32 own_seq, u8 own_color)
 {
-   static const char err_msg[] = "{_DROPPED_}\n";
-   struct ringbuf_stat cs, ns;
-   u32 used;
+   bool expected, done;
 
-   if (!size)
-      return;
+   ASSERT(!is_preemption_enabled());
 
    do {
-      cs = printk_rbuf_stat;
-      ns = printk_rbuf_stat;
-      used = printk_calc_used(&cs);
-
-      if (used + size >= sizeof(printk_rbuf)) {
 
-         /* Corner case: the ring buffer is full */
+      expected = false;
 
-         if (term_is_initialized()) {
-            printk_direct_flush(buf, size, PRINTK_NOSPACE_IN_RBUF_FLUSH_COLOR);
+      if (!atomic_cas_strong(&console_busy, &expected, true,
+                             mo_acquire, mo_relaxed))
+      {
+         /*
+          * We interrupted a context which is flushing the records: it will
+          * flush ours too. Exception: in panic that context won't ever resume.
+          */
+         if (!in_panic())
             return;
-         }
+      }
 
-         if (buf != err_msg && used < sizeof(printk_rbuf) - 1) {
-            size = MIN(sizeof(printk_rbuf) - used - 1, sizeof(err_msg));
-            printk_append_to_ringbuf(err_msg, size);
-         }
+      done = __printk_flush_records(tmpbuf, buf_size, own_seq, own_color);
+      atomic_store_explicit(&console_busy, false, mo_release);
 
-         return;
-      }
+      /*
+       * Check again, after releasing `console_busy`, for records appended by
+       * IRQ handlers which found the console busy: if we don't flush them now,
+       * they will remain pending until the next printk().
+       */
 
-      ns.write_pos = (ns.write_pos + size) % sizeof(printk_rbuf);
+   } while (done && console_seq != kmsg_get_next_seq());
+}
 
-      if (ns.write_pos == ns.read_pos)
-         ns.full = 1;
+static void
+printk_worker_job(void *arg)
+{
+   char tmpbuf[PRINTK_BUF_SZ];
 
-   } while (!atomic_cas_weak(&printk_rbuf_stat.raw,
-                             &cs.__raw,
-                             ns.__raw,
-                             mo_relaxed,
-                             mo_relaxed));
+   /* Clear the flag *before* flushing, in order to not lose any records */
+   atomic_store_explicit(&printk_wth_job_pending, false, mo_relaxed);
 
-   // Now we have some allocated space in the ringbuf
+   disable_preemption();
+   {
+      printk_flush_records(tmpbuf, sizeof(tmpbuf), ~0u, PRINTK_COLOR);
+   }
+   enable_preemption();
 
-   for (u32 i = 0; i < size; i++)
-      printk_rbuf[(cs.write_pos + i) % sizeof(printk_rbuf)] = buf[i];
+   kmsg_wakeup_readers();
 }
 
 /*
- * Sets atomically first_printk=1 and returns the old ringbuf_stat.
+ * Enqueue a job on the printk worker thread, unless there's already one
+ * pending. It's safe to call it from any context, IRQ handlers included.
  */
-static struct ringbuf_stat
-try_set_first_printk_on_stack(bool newline)
+static bool
+printk_wth_enqueue_job(void)
 {
-   struct ringbuf_stat cs, ns;
+   bool expected = false;
 
-   do {
-      cs = printk_rbuf_stat;
-      ns = printk_rbuf_stat;
-      ns.first_printk = 1;
-      ns.newline = newline;
-   } while (!atomic_cas_weak(&printk_rbuf_stat.raw,
-                             &cs.__raw,
-                             ns.__raw,
-                             mo_relaxed,
-                             mo_relaxed));
-
-   return cs;
+   if (!printk_wth)
+      return false;
+
+   if (!atomic_cas_strong(&printk_wth_job_pending, &expected, true,
+                          mo_relaxed, mo_relaxed))
+   {
+      return true; /* there's already a pending job */
+   }
+
+   if (!wth_enqueue_on(printk_wth, &printk_worker_job, NULL)) {
+      atomic_store_explicit(&printk_wth_job_pending, false, mo_relaxed);
+      return false;
+   }
+
+   return true;
 }
 
-static void
-restore_first_printk_value(void)
+void
+printk_flush_ringbuf(void)
 {
-   struct ringbuf_stat cs, ns;
+   char minibuf[80];
 
-   do {
-      cs = printk_rbuf_stat;
-      ns = printk_rbuf_stat;
-      ns.first_printk = 0;
-   } while (!atomic_cas_weak(&printk_rbuf_stat.raw,
-                             &cs.__raw,
-                             ns.__raw,
-                             mo_relaxed,
-                             mo_relaxed));
+   if (MOD_tracing_actual) {
+      static bool printk_flush_ringbuf_done_once;
+      if (UNLIKELY(!printk_flush_ringbuf_done_once)) {
+         printk_flush_ringbuf_done_once = true;
+         if (trace_printk_is_enabled() && !in_panic()) {
+            init_trace_printk();
+            printk_write_early_records_to_trace_printk();
+         }
+      }
+   }
+
+   disable_preemption();
+   {
+      printk_flush_records(minibuf, sizeof(minibuf), ~0u, PRINTK_COLOR);
+   }
+   enable_preemption();
+}
+
+void
+init_printk_worker(void)
+{
+   disable_preemption();
+   {
+      printk_wth = wth_create_thread("printk", WTH_PRIO_LOWEST, 4);
+
+      if (!printk_wth)
+         panic("printk: unable to create the worker thread");
+   }
+   enable_preemption();
 }
 
 STATIC int
@@ -363,18 +334,13 @@ vsnprintk_with_truc_suffix(char *buf, u32 bufsz, const char *fmt, va_list args)
 }
 
 static void
-__tilck_vprintk(char *prefixbuf,
-                char *buf,
-                u32 bufsz,
-                u32 flags,
-                const char *fmt,
-                va_list args)
+__tilck_vprintk(char *buf, u32 bufsz, u32 flags, const char *fmt, va_list args)
 {
    const bool panic = in_panic();
    bool prefix = !panic;
-   bool has_newline = false;
-   struct ringbuf_stat old;
-   int written, prefix_sz = 0;
+   u8 rec_flags = 0;
+   int written;
+   u32 seq;
 
    if (fmt[0] == PRINTK_CTRL_CHAR) {
 
@@ -395,108 +361,85 @@ __tilck_vprintk(char *prefixbuf,
 
    written = vsnprintk_with_truc_suffix(buf, bufsz, fmt, args);
 
-   for (int i = 0; i < written; i++) {
-      if (buf[i] == '\n') {
-         has_newline = true;
-         break;
-      }
+   /*
+    * A record gets the "[time] " prefix only when it starts a new line, which
+    * means when the previous one ended with a newline.
+    */
+   if (atomic_exchange_explicit(&last_newline,
+                                written > 0 && buf[written - 1] == '\n',
+                                mo_relaxed) && prefix)
+   {
+      rec_flags |= KMSG_FL_PREFIX;
    }
 
-   old = try_set_first_printk_on_stack(has_newline);
-
-   if (prefix && old.newline) {
-
-      const u64 systime = get_sys_time();
-
-      prefix_sz = snprintk(
-         prefixbuf, PRINTK_PREFIXBUF_SZ, "[%5u.%03u] %s",
-         (u32)(systime / TS_SCALE),
-         (u32)((systime % TS_SCALE) / (TS_SCALE / 1000)),
-         bufsz < PRINTK_BUF_SZ ? "[LOWSS] " : ""
-      );
-
-   } else {
-
-      prefix = false;
-   }
+   if (bufsz < PRINTK_BUF_SZ)
+      rec_flags |= KMSG_FL_LOWSS;
 
+   seq = kmsg_append(buf, (u32)written, rec_flags, get_sys_time());
 
    if (!term_is_initialized()) {
-      printk_append_to_ringbuf(prefixbuf, (size_t) prefix_sz);
-      printk_append_to_ringbuf(buf, (size_t) written);
-      restore_first_printk_value();
+      /* The records will be printed later by printk_flush_ringbuf() */
       return;
    }
 
    if (panic) {
       u8 color = in_panic_debugger() ? DEFAULT_FG_COLOR : PRINTK_PANIC_COLOR;
-      printk_direct_flush(buf, (size_t) written, color);
-      restore_first_printk_value();
+      disable_preemption();
+      {
+         printk_flush_records(buf, bufsz, seq, color);
+      }
+      enable_preemption();
       return;
    }
 
    trace_printk_raw(1, buf, (size_t) written);
-   disable_preemption();
-   {
-      if (!old.first_printk) {
 
-         /*
-          * OK, we were the first. Now, flush our buffer directly and loop
-          * flushing anything that, in the meanwhile, printk() calls from IRQs
-          * generated.
-          */
+   if (in_irq() && printk_wth_enqueue_job()) {
 
-         printk_direct_flush(prefixbuf, (size_t) prefix_sz, PRINTK_COLOR);
-         printk_direct_flush(buf, (size_t) written, PRINTK_COLOR);
-         __printk_flush_ringbuf(buf, bufsz);
-
-         /*
-          * No need to call restore_first_printk_value(): printk_flush_ringbuf
-          * clears the `first_printk` bit for us.
-          */
+      /*
+       * Don't make the interrupted task to wait for the terminal rendering
+       * of our message: the printk worker thread will take care of it.
+       */
+      return;
+   }
 
-      } else {
+   disable_preemption();
+   {
+      printk_flush_records(buf, bufsz, seq, PRINTK_COLOR);
+   }
+   enable_preemption();
 
-         /*
-          * We were NOT the first printk on the stack: we're in an IRQ handler
-          * and can only append our data to the ringbuf. On return, at some
-          * point, the first printk(), in printk_flush_ringbuf() [case above]
-          * will flush our data.
-          */
+   if (atomic_load_explicit(&kmsg_readers, mo_relaxed)) {
 
-         printk_append_to_ringbuf(prefixbuf, (size_t) prefix_sz);
-         printk_append_to_ringbuf(buf, (size_t) written);
-      }
+      /*
+       * Let the worker thread wake up the /dev/kmsg readers, since we might
+       * be in a context where signaling a condition is not safe.
+       */
+      printk_wth_enqueue_job();
    }
-   enable_preemption();
 }
 
 static void
 __regular_tilck_vprintk(u32 flags, const char *fmt, va_list args)
 {
-   char prefixbuf[PRINTK_PREFIXBUF_SZ];
    char buf[PRINTK_BUF_SZ];
-
-   __tilck_vprintk(prefixbuf, buf, sizeof(buf), flags, fmt, args);
+   __tilck_vprintk(buf, sizeof(buf), flags, fmt, args);
 }
 
 static void
 __low_ssp_tilck_vprintk(u32 flags, const char *fmt, va_list args)
 {
-   char prefixbuf[PRINTK_PREFIXBUF_SZ];
    char buf[64];
-
-   __tilck_vprintk(prefixbuf, buf, sizeof(buf), flags, fmt, args);
+   __tilck_vprintk(buf, sizeof(buf), flags, fmt, args);
 }
 
 void
 tilck_vprintk(u32 flags, const char *fmt, va_list args)
 {
-   static char p_prefixbuf[PRINTK_PREFIXBUF_SZ];
    static char p_buf[PRINTK_BUF_SZ];
 
    if (in_panic())
-      __tilck_vprintk(p_prefixbuf, p_buf, sizeof(p_buf), flags, fmt, args);
+      __tilck_vprintk(p_buf, sizeof(p_buf), flags, fmt, args);
    else if (get_rem_stack() < PRINTK_SAFE_STACK_SPACE)
       panic("No stack space for vprintk(\"%s\")", fmt);
    else if (get_rem_stack() < PRINTK_SAFE_STACK_SPACE + 512)
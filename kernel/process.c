@@ -15,6 +15,7 @@
 #include <tilck/kernel/errno.h>
 #include <tilck/kernel/user.h>
 #include <tilck/kernel/debug_utils.h>
+#include <tilck/kernel/lockstat.h>
 #include <tilck/kernel/fs/vfs.h>
 
 #include <sys/prctl.h>        // system header
@@ -181,18 +182,19 @@ void init_task_lists(struct task *ti)
 {
    bintree_node_init(&ti->tree_by_tid_node);
    list_node_init(&ti->runnable_node);
-   list_node_init(&ti->wakeup_timer_node);
    list_node_init(&ti->siblings_node);
 
    list_init(&ti->tasks_waiting_list);
    list_init(&ti->on_exit);
    bzero(&ti->wobj, sizeof(struct wait_obj));
+   init_task_wakeup_timer(ti);
 }
 
 void init_process_lists(struct process *pi)
 {
    list_init(&pi->children);
    kmutex_init(&pi->fslock, KMUTEX_FL_RECURSIVE);
+   lockstat_register_kmutex(&pi->fslock, "fslock", pi->pid);
 }
 
 struct task *
@@ -353,6 +355,7 @@ static void free_process_int(struct process *pi)
 
    if (release_obj(pi) == 0) {
 
+      kmutex_destroy(&pi->fslock);
       arch_specific_free_proc(pi);
       kfree2(get_process_task(pi), TOT_PROC_AND_TASK_SIZE);
 
@@ -2,6 +2,7 @@
 
 #include <tilck/kernel/rwlock.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/lockstat.h>
 
 void rwlock_rp_init(struct rwlock_rp *r)
 {
@@ -65,10 +66,15 @@ void rwlock_wp_init(struct rwlock_wp *rw, bool recursive)
    rw->r = 0;
    rw->w = false;
    rw->rec = recursive;
+
+#if KRN_LOCKSTAT
+   rw->ls = NULL;
+#endif
 }
 
 void rwlock_wp_destroy(struct rwlock_wp *rw)
 {
+   lockstat_unregister(lockstat_ref(rw));
    rw->ex_owner = NULL;
    rw->w = false;
    rw->r = 0;
@@ -80,11 +86,15 @@ void rwlock_wp_shlock(struct rwlock_wp *rw)
 {
    kmutex_lock(&rw->m);
    {
+      const u64 wait_start = rw->w ? lockstat_wait_begin(lockstat_of(rw)) : 0;
+
       /* Wait until there's at least one writer waiting (they have priority) */
       while (rw->w) {
          kcond_wait(&rw->c, &rw->m, KCOND_WAIT_FOREVER);
       }
 
+      lockstat_shacquired(lockstat_of(rw), wait_start);
+
       /*
        * OK, no writer is waiting and we're holding the mutex: we can safely
        * increment the readers count and claim that the acquired a shared
@@ -111,6 +121,8 @@ void rwlock_wp_shunlock(struct rwlock_wp *rw)
 
 static void rwlock_wp_exlock_int(struct rwlock_wp *rw)
 {
+   u64 wait_start;
+
    if (rw->rec) {
       if (rw->ex_owner == get_curr_task()) {
          ASSERT(rw->w);
@@ -120,6 +132,9 @@ static void rwlock_wp_exlock_int(struct rwlock_wp *rw)
       }
    }
 
+   wait_start = (rw->w || rw->r > 0)
+      ? lockstat_wait_begin(lockstat_of(rw))
+      : 0;
 
    /* Wait our turn until other writers are waiting to write */
    while (rw->w) {
@@ -145,6 +160,7 @@ static void rwlock_wp_exlock_int(struct rwlock_wp *rw)
 
    ASSERT(rw->ex_owner == NULL);
    rw->ex_owner = get_curr_task();
+   lockstat_acquired(lockstat_of(rw), wait_start);
 
    if (rw->rec) {
       /* recursive locking count */
@@ -178,6 +194,7 @@ static void rwlock_wp_exunlock_int(struct rwlock_wp *rw)
    }
 
    rw->ex_owner = NULL;
+   lockstat_released(lockstat_of(rw));
 
    /* The `w` flag must be set */
    ASSERT(rw->w);
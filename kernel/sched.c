@@ -12,21 +12,25 @@
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/errno.h>
 
-/* Shared global variables */
+#if !KRN_SMP
+
+/* Shared global variables (per-CPU with KRN_SMP: see struct cpu_info) */
 struct task *__current;
 ATOMIC(int) __disable_preempt = 1;        /* see docs/atomics.md */
 ATOMIC(int) __need_resched;               /* see docs/atomics.md */
 
-struct task *kernel_process;
-struct process *kernel_process_pi;
-
 /* Task lists */
 struct list runnable_tasks_list;
+static volatile int runnable_tasks_count;
+
+#endif
+
+struct task *kernel_process;
+struct process *kernel_process_pi;
 
 /* Static variables */
 static struct task *tree_by_tid_root;
 static u64 idle_ticks;
-static volatile int runnable_tasks_count;
 static int current_max_pid = -1;
 static int current_max_kernel_tid = -1;
 struct task *idle_task;
@@ -39,10 +43,192 @@ const char *const task_state_str[5] = {
    [TASK_STATE_ZOMBIE]   = "zombie",
 };
 
+#if KRN_SMP
+
+static ALWAYS_INLINE void rq_add(struct task *ti)
+{
+   struct cpu_info *c = &cpus[ti->cpu];
+   list_add_tail(&c->runnable_list, &ti->runnable_node);
+   c->runnable_count++;
+}
+
+static ALWAYS_INLINE void rq_remove(struct task *ti)
+{
+   struct cpu_info *c = &cpus[ti->cpu];
+   list_remove(&ti->runnable_node);
+   c->runnable_count--;
+   ASSERT(c->runnable_count >= 0);
+}
+
+/* Runnable tasks on this CPU. Preemption must be disabled or we're idle */
+static ALWAYS_INLINE int get_local_runnable_count(void)
+{
+   return get_this_cpu()->runnable_count;
+}
+
+/*
+ * Number of runnable tasks in the whole system, counting the idle tasks as if
+ * they were a single one, like without SMP.
+ */
+static int get_runnable_tasks_count(void)
+{
+   int count = 1;
+
+   for (u32 i = 0; i < cpus_count; i++) {
+
+      if (!cpus[i].online)
+         continue;
+
+      count += cpus[i].runnable_count;
+
+      if (get_task_state(cpus[i].idle_task) == TASK_STATE_RUNNABLE)
+         count--;
+   }
+
+   return count;
+}
+
+static ALWAYS_INLINE struct task *get_local_idle_task(void)
+{
+   return get_this_cpu()->idle_task;
+}
+
+static ALWAYS_INLINE bool is_cpu_idle(u32 cpu)
+{
+   struct cpu_info *c = &cpus[cpu];
+   return c->online && c->current == c->idle_task && !c->runnable_count;
+}
+
+/*
+ * Choose the runqueue for a task which is becoming runnable, without having
+ * been preempted. Prefer its last CPU, if it's idle, otherwise any idle CPU,
+ * so that the task can run immediately. When no CPU is idle, keep the task on
+ * its last CPU: the CPUs becoming idle will steal it, if necessary.
+ */
+static u32 sched_select_cpu(struct task *ti)
+{
+   const u32 last = ti->cpu;
+
+   if (is_cpu_idle(last))
+      return last;
+
+   for (u32 i = 0; i < cpus_count; i++)
+      if (is_cpu_idle(i))
+         return i;
+
+   return cpus[last].online ? last : get_this_cpu_idx();
+}
+
+/* Wake up the CPU which just got a runnable task in its runqueue, if idle */
+static void sched_notify_cpu(u32 cpu)
+{
+   struct cpu_info *c = &cpus[cpu];
+
+   if (cpu != get_this_cpu_idx() && c->current == c->idle_task)
+      smp_send_resched(cpu);
+}
+
+/*
+ * Make a task running on another CPU enter the kernel as soon as possible, in
+ * order to handle its pending signals or to get stopped. Otherwise, that would
+ * happen only at its next syscall or at the end of its time slice.
+ */
+void sched_kick_task(struct task *ti)
+{
+   const u32 cpu = ti->cpu;
+   ASSERT(!is_preemption_enabled());
+
+   if (cpu != get_this_cpu_idx() && cpus[cpu].current == ti)
+      smp_send_resched(cpu);
+}
+
+/*
+ * Work stealing, used when there's nothing to run in the local runqueue: move
+ * into it the runnable task with the lowest vruntime among the ones queued on
+ * the other CPUs. The idle tasks are never stolen.
+ *
+ * NOTE: a task in a runqueue might still be running on its CPU (e.g. it got
+ * woken up before calling schedule()), but only while that CPU owns the BKL,
+ * which is released only after switching to another stack: see
+ * smp_on_context_switch(). Therefore, we can never steal a running task.
+ */
+static struct task *sched_steal_task(void)
+{
+   const u32 me = get_this_cpu_idx();
+   struct task *selected = NULL;
+   struct task *pos;
+   ulong var;
+
+   for (u32 i = 0; i < cpus_count; i++) {
+
+      if (i == me || !cpus[i].online)
+         continue;
+
+      list_for_each_ro(pos, &cpus[i].runnable_list, runnable_node) {
+
+         if (pos->stopped || is_idle_task(pos))
+            continue;
+
+         if (!selected || pos->ticks.vruntime < selected->ticks.vruntime)
+            selected = pos;
+      }
+   }
+
+   if (selected) {
+
+      disable_interrupts(&var);
+      {
+         rq_remove(selected);
+         selected->cpu = me;
+         rq_add(selected);
+      }
+      enable_interrupts(&var);
+   }
+
+   return selected;
+}
+
+#else
+
+static ALWAYS_INLINE void rq_add(struct task *ti)
+{
+   list_add_tail(&runnable_tasks_list, &ti->runnable_node);
+   runnable_tasks_count++;
+}
+
+static ALWAYS_INLINE void rq_remove(struct task *ti)
+{
+   list_remove(&ti->runnable_node);
+   runnable_tasks_count--;
+   ASSERT(runnable_tasks_count >= 0);
+}
+
+static ALWAYS_INLINE int get_local_runnable_count(void)
+{
+   return runnable_tasks_count;
+}
+
+static ALWAYS_INLINE int get_runnable_tasks_count(void)
+{
+   return runnable_tasks_count;
+}
+
+static ALWAYS_INLINE struct task *get_local_idle_task(void)
+{
+   return idle_task;
+}
+
+#endif
+
 void enable_preemption(void)
 {
-   int oldval =
-      atomic_fetch_sub_explicit(&__disable_preempt, 1, mo_relaxed);
+   int oldval;
+
+#if KRN_SMP
+   DO_ON_THIS_CPU(c, oldval = c->disable_preempt--);
+#else
+   oldval = atomic_fetch_sub_explicit(&__disable_preempt, 1, mo_relaxed);
+#endif
 
    ASSERT(oldval > 0);
 
@@ -373,14 +559,25 @@ int iterate_over_tasks(bintree_visit_cb func, void *arg)
 
 static void idle(void)
 {
+#if KRN_SMP
+   /* An AP failed to start: see sched_drop_cpu_idle_task() */
+   if (!is_idle_task(get_curr_task()))
+      return;
+#endif
+
    while (true) {
 
       ASSERT(is_preemption_enabled());
 
       idle_ticks++;
+
+#if KRN_SMP
+      smp_idle_halt();
+#else
       halt();
+#endif
 
-      if (need_reschedule() || runnable_tasks_count > 1)
+      if (need_reschedule() || get_local_runnable_count() > 1)
          schedule();
    }
 }
@@ -389,7 +586,7 @@ void yield_until_last(void)
 {
    ASSERT(is_preemption_enabled());
 
-   do { kernel_yield(); } while (runnable_tasks_count > 2);
+   do { kernel_yield(); } while (get_runnable_tasks_count() > 2);
    kernel_yield();
 }
 
@@ -403,7 +600,13 @@ static void create_kernel_process(void)
    struct task *s_kernel_ti = (struct task *)kernel_proc_buf;
    struct process *s_kernel_pi = (struct process *)(s_kernel_ti + 1);
 
+#if KRN_SMP
+   for (u32 i = 0; i < MAX_CPUS; i++)
+      list_init(&cpus[i].runnable_list);
+#else
    list_init(&runnable_tasks_list);
+#endif
+
    s_kernel_pi->pid = create_new_pid();
    s_kernel_ti->tid = create_new_kernel_tid();
    s_kernel_pi->ref_count = 1;
@@ -458,8 +661,87 @@ void init_sched(void)
       panic("Unable to create the idle_task!");
 
    idle_task = get_task(tid);
+
+#if KRN_SMP
+   cpus[0].idle_task = idle_task;
+#endif
 }
 
+#if KRN_SMP
+
+/*
+ * Create the idle task of an AP: it's created like the BSP's one, but then it
+ * gets moved (pinned, actually) to the runqueue of its CPU. Preemption is kept
+ * disabled meanwhile, in order to prevent anybody from running it elsewhere.
+ */
+struct task *sched_create_cpu_idle_task(u32 cpu)
+{
+   struct task *ti = NULL;
+   ulong var;
+   int tid;
+
+   disable_preemption();
+   {
+      tid = kthread_create(&idle, 0, NULL);
+
+      if (tid >= 0) {
+
+         ti = get_task(tid);
+
+         disable_interrupts(&var);
+         {
+            rq_remove(ti);
+            ti->cpu = cpu;
+            rq_add(ti);
+            cpus[cpu].idle_task = ti;
+         }
+         enable_interrupts(&var);
+      }
+   }
+   enable_preemption();
+   return ti;
+}
+
+/*
+ * Undo sched_create_cpu_idle_task() for an AP which didn't come online: move
+ * the task to our runqueue. Not being an idle task anymore, it will just exit
+ * as soon as it runs.
+ */
+void sched_drop_cpu_idle_task(u32 cpu)
+{
+   struct task *ti = cpus[cpu].idle_task;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      cpus[cpu].idle_task = NULL;
+      cpus[cpu].current = NULL;
+      rq_remove(ti);
+      ti->cpu = get_this_cpu_idx();
+      rq_add(ti);
+   }
+   enable_interrupts(&var);
+}
+
+/* Helpers for the assembly code, which can't use the inline accessors */
+
+struct task *asm_get_curr_task(void)
+{
+   return get_curr_task();
+}
+
+int asm_get_preempt_count(void)
+{
+   return get_preempt_disable_count();
+}
+
+void asm_set_preempt_count(int count)
+{
+   DO_ON_THIS_CPU(c, c->disable_preempt = count);
+}
+
+#endif
+
 void set_current_task_in_kernel(void)
 {
    ASSERT(!is_preemption_enabled());
@@ -474,8 +756,7 @@ static void task_add_to_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_add_tail(&runnable_tasks_list, &ti->runnable_node);
-         runnable_tasks_count++;
+         rq_add(ti);
          break;
 
       case TASK_STATE_SLEEPING:
@@ -503,9 +784,7 @@ static void task_remove_from_state_list(struct task *ti)
    switch (atomic_load_explicit(&ti->state, mo_relaxed)) {
 
       case TASK_STATE_RUNNABLE:
-         list_remove(&ti->runnable_node);
-         runnable_tasks_count--;
-         ASSERT(runnable_tasks_count >= 0);
+         rq_remove(ti);
          break;
 
       case TASK_STATE_SLEEPING:
@@ -533,9 +812,26 @@ void task_change_state(struct task *ti, enum task_state new_state)
 
    disable_interrupts(&var);
    {
+#if KRN_SMP
+      const bool woken = new_state == TASK_STATE_RUNNABLE &&
+                         ti->state != TASK_STATE_RUNNING &&
+                         !is_worker_thread(ti);
+#endif
+
       task_remove_from_state_list(ti);
       atomic_store_explicit(&ti->state, new_state, mo_relaxed);
+
+#if KRN_SMP
+      if (woken)
+         ti->cpu = sched_select_cpu(ti);
+#endif
+
       task_add_to_state_list(ti);
+
+#if KRN_SMP
+      if (woken)
+         sched_notify_cpu(ti->cpu);
+#endif
    }
    enable_interrupts(&var);
 }
@@ -556,6 +852,11 @@ void add_task(struct task *ti)
 {
    disable_preemption();
    {
+#if KRN_SMP
+      if (ti->state == TASK_STATE_RUNNABLE && !is_worker_thread(ti))
+         ti->cpu = sched_select_cpu(ti);
+#endif
+
       task_add_to_state_list(ti);
 
       bintree_insert_ptr(&tree_by_tid_root,
@@ -603,7 +904,7 @@ void sched_account_ticks(void)
    if (curr->running_in_kernel)
       t->total_kernel++;
 
-   if (curr != idle_task) {
+   if (!is_idle_task(curr)) {
 
       /*
        * The more currently runnable tasks are, the higher vruntime has to
@@ -620,7 +921,7 @@ void sched_account_ticks(void)
        * tasks that that consumed 100% of the CPU when no other task was
        * runnable won't be so much penalized.
        */
-      t->vruntime += (u64)(runnable_tasks_count - 1);
+      t->vruntime += (u64)(get_local_runnable_count() - 1);
    }
 
    /*
@@ -673,11 +974,17 @@ sched_do_select_runnable_task(enum task_state curr_state, bool resched)
    struct task *selected = NULL;
    struct task *pos;
 
-   list_for_each_ro(pos, &runnable_tasks_list, runnable_node) {
+#if KRN_SMP
+   struct list *runqueue = &get_this_cpu()->runnable_list;
+#else
+   struct list *runqueue = &runnable_tasks_list;
+#endif
+
+   list_for_each_ro(pos, runqueue, runnable_node) {
 
       ASSERT_TASK_STATE(pos->state, TASK_STATE_RUNNABLE);
 
-      if (pos->stopped || pos == idle_task)
+      if (pos->stopped || is_idle_task(pos))
          continue;
 
       if (pos->timer_ready) {
@@ -732,13 +1039,24 @@ void do_schedule(void)
    /* Check for worker threads ready to run */
    selected = wth_get_runnable_thread();
 
+#if KRN_SMP
+   /* Worker threads are not in any runqueue: they can run on any CPU */
+   if (selected)
+      selected->cpu = get_this_cpu_idx();
+#endif
+
    /* Check for regular runnable tasks */
    if (!selected) {
 
       selected = sched_do_select_runnable_task(curr_state, resched);
 
+#if KRN_SMP
+      if (!selected)
+         selected = sched_steal_task();
+#endif
+
       if (!selected)
-         selected = idle_task; /* fall-back to the idle task */
+         selected = get_local_idle_task(); /* fall-back to the idle task */
    }
 
    if (selected != curr) {
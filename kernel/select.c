@@ -8,6 +8,7 @@
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/fs/vfs.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
 
 struct select_ctx {
    int nfds;
@@ -16,7 +17,7 @@ struct select_ctx {
    struct k_timeval *tv;
    struct k_timeval *user_tv;
    int cond_cnt;
-   u32 timeout_ticks;
+   u64 timeout_ns;
 };
 
 static const func_get_rwe_cond gcf[3] = {
@@ -164,8 +165,8 @@ select_wait_on_cond(struct select_ctx *c)
    }
 
    if (c->tv) {
-      ASSERT(c->timeout_ticks > 0);
-      task_set_wakeup_timer(curr, c->timeout_ticks);
+      ASSERT(c->timeout_ns > 0);
+      task_set_wakeup_timer_ns(curr, c->timeout_ns);
    }
 
    while (true) {
@@ -197,9 +198,9 @@ select_wait_on_cond(struct select_ctx *c)
             if (!count_ready_streams(c->nfds, c->sets))
                continue; /* No ready streams, we have to wait again. */
 
-            u32 rem = task_cancel_wakeup_timer(curr);
-            c->tv->tv_sec = rem / TIMER_HZ;
-            c->tv->tv_usec = (rem % TIMER_HZ) * (1000000 / TIMER_HZ);
+            u64 rem = task_cancel_wakeup_timer(curr);
+            c->tv->tv_sec = (long)(rem / BILLION);
+            c->tv->tv_usec = (long)((rem % BILLION) / 1000);
          }
 
       } else {
@@ -245,7 +246,7 @@ select_read_user_sets(fd_set *sets[3], fd_set *u_sets[3])
 static int
 select_read_user_tv(struct k_timeval *user_tv,
                     struct k_timeval **tv_ref,
-                    u32 *timeout)
+                    u64 *timeout)
 {
    struct task *curr = get_curr_task();
    struct k_timeval *tv = NULL;
@@ -258,11 +259,10 @@ select_read_user_tv(struct k_timeval *user_tv,
          return -EFAULT;
 
       u64 tmp = 0;
-      tmp += (u64)tv->tv_sec * TIMER_HZ;
-      tmp += (u64)tv->tv_usec / (1000000 / TIMER_HZ);
+      tmp += MIN((u64)tv->tv_sec, UINT64_MAX / BILLION - 1) * BILLION;
+      tmp += (u64)tv->tv_usec * 1000;
 
-      /* NOTE: select() can't sleep for more than UINT32_MAX ticks */
-      *timeout = (u32) CLAMP(tmp, 1u, UINT32_MAX);
+      *timeout = MAX(tmp, 1u);
    }
 
    *tv_ref = tv;
@@ -274,7 +274,7 @@ select_compute_cond_cnt(struct select_ctx *c)
 {
    int rc;
 
-   if (!c->tv || c->timeout_ticks > 0) {
+   if (!c->tv || c->timeout_ns > 0) {
       for (int i = 0; i < 3; i++) {
          if ((rc = select_count_cond_per_set(c, c->sets[i], gcf[i])))
             return rc;
@@ -319,18 +319,18 @@ int sys_select(int user_nfds,
       .tv = NULL,
       .user_tv = user_tv,
       .cond_cnt = 0,
-      .timeout_ticks = 0,
+      .timeout_ns = 0,
    };
 
    int rc;
 
-   if (user_nfds < 0 || user_nfds > MAX_HANDLES)
+   if (user_nfds < 0 || user_nfds > MIN(MAX_HANDLES, FD_SETSIZE))
       return -EINVAL;
 
    if ((rc = select_read_user_sets(ctx.sets, ctx.u_sets)))
       return rc;
 
-   if ((rc = select_read_user_tv(user_tv, &ctx.tv, &ctx.timeout_ticks)))
+   if ((rc = select_read_user_tv(user_tv, &ctx.tv, &ctx.timeout_ns)))
       return rc;
 
    if ((rc = count_ready_streams(ctx.nfds, ctx.sets)) > 0)
@@ -339,7 +339,7 @@ int sys_select(int user_nfds,
    if ((rc = select_compute_cond_cnt(&ctx)))
       return rc;
 
-   if (ctx.cond_cnt > 0 && (!user_tv || ctx.timeout_ticks > 0)) {
+   if (ctx.cond_cnt > 0 && (!user_tv || ctx.timeout_ns > 0)) {
 
       /*
        * The count of condition variables for all the file descriptors is
@@ -357,7 +357,7 @@ int sys_select(int user_nfds,
        * be NULL (see the comment below).
        */
 
-      if (ctx.timeout_ticks > 0) {
+      if (ctx.timeout_ns > 0) {
 
          /*
           * Corner case: no conditions on which to wait, but timeout is > 0:
@@ -366,7 +366,7 @@ int sys_select(int user_nfds,
           * was even used as a portable implementation of nanosleep().
           */
 
-         kernel_sleep(ctx.timeout_ticks);
+         kernel_sleep_ns(ctx.timeout_ns);
 
          if (pending_signals())
             return -EINTR;
@@ -231,8 +231,12 @@ static void signal_wakeup_task(struct task *ti)
 
          if (ti->wobj.type != WOBJ_KMUTEX && ti->wobj.type != WOBJ_SEM)
             wake_up(ti);
-      }
 
+      } else {
+
+         /* It might be running on another CPU: make it handle the signal */
+         sched_kick_task(ti);
+      }
 
       ti->stopped = false;
 
@@ -283,6 +287,8 @@ static void action_stop(struct task *ti, int signum, int fl)
 
    if (ti == get_curr_task())
       schedule_preempt_disabled();
+   else
+      sched_kick_task(ti);
 }
 
 static void action_continue(struct task *ti, int signum, int fl)
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/utils.h>
+
+#include <tilck/kernel/sys_stats.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/elf_utils.h>
+#include <tilck/kernel/debug_utils.h>
+
+struct sys_stats *sys_stats;
+long sys_stats_pid_filter;
+
+void __sys_stats_account(u32 sn, u64 cycles)
+{
+   struct sys_stats *s;
+   u32 bucket;
+
+   ASSERT(!is_preemption_enabled());
+
+   if (sys_stats_pid_filter > 0) {
+      if (get_curr_proc()->pid != sys_stats_pid_filter)
+         return;
+   }
+
+   s = &sys_stats[sn];
+   bucket = cycles >> 32
+      ? SYS_STATS_HIST_BUCKETS - 1
+      : get_last_set_bit_index32((u32)cycles | 1);
+
+   s->count++;
+   s->hist[bucket]++;
+   s->tot_cycles += cycles;
+   s->max_cycles = MAX(s->max_cycles, cycles);
+}
+
+void sys_stats_reset(void)
+{
+   if (!sys_stats)
+      return;
+
+   disable_preemption();
+   {
+      bzero(sys_stats, sizeof(struct sys_stats) * MAX_SYSCALLS);
+   }
+   enable_preemption();
+}
+
+/* Returns the name of the syscall without the "sys_" prefix, or NULL */
+const char *sys_stats_get_name(u32 sn)
+{
+   void *func = get_syscall_func_ptr(sn);
+   const char *name;
+
+   if (!func)
+      return NULL;
+
+   if (!(name = find_sym_at_addr((ulong)func, NULL, NULL)))
+      return NULL;
+
+   return !strncmp(name, "sys_", 4) ? name + 4 : name;
+}
+
+void init_sys_stats(void)
+{
+   if (!KRN_SYS_STATS)
+      return;
+
+   if (!(sys_stats = kzalloc_array_obj(struct sys_stats, MAX_SYSCALLS)))
+      panic("Unable to allocate the syscall stats");
+}
@@ -14,6 +14,9 @@
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/modules.h>
+
+#include <linux/sched.h> // system header
 
 #define LINUX_REBOOT_MAGIC1         0xfee1dead
 #define LINUX_REBOOT_MAGIC2          672274793
@@ -35,12 +38,14 @@ int sys_madvise(void *addr, size_t len, int advice)
 int
 do_nanosleep(const struct k_timespec64 *req, struct k_timespec64 *rem)
 {
-   u64 ticks_to_sleep;
-   u64 exp_wake_up_ticks;
+   u64 ns_to_sleep;
+   u64 exp_wake_up_time;
+   u64 now;
 
-   ticks_to_sleep = timespec_to_ticks(req);
-   exp_wake_up_ticks = get_ticks() + ticks_to_sleep;
-   kernel_sleep(ticks_to_sleep);
+   ns_to_sleep = timespec_to_ns(req);
+   now = get_sys_time();
+   exp_wake_up_time = now + MIN(ns_to_sleep, UINT64_MAX - now);
+   kernel_sleep_ns(ns_to_sleep);
 
    /* After wake-up */
    rem->tv_sec = 0;
@@ -48,10 +53,10 @@ do_nanosleep(const struct k_timespec64 *req, struct k_timespec64 *rem)
 
    if (pending_signals()) {
 
-      u64 ticks = get_ticks();
+      now = get_sys_time();
 
-      if (ticks < exp_wake_up_ticks)
-         ticks_to_timespec(exp_wake_up_ticks - ticks, rem);
+      if (now < exp_wake_up_time)
+         ns_to_timespec(exp_wake_up_time - now, rem);
 
       return -EINTR;
    }
@@ -222,12 +227,36 @@ int sys_getrusage(int who, struct k_rusage *user_buf)
 
 int sys_fork(void)
 {
-   return do_fork(false);
+   return do_fork(false, NULL);
 }
 
 int sys_vfork(void)
 {
-   return do_fork(true);
+   return do_fork(true, NULL);
+}
+
+int sys_clone(ulong flags, void *newsp, int *ptid, ulong tls, int *ctid)
+{
+   /*
+    * Tilck does not support threads. The only flavors of clone() supported
+    * are the ones equivalent to fork() and vfork(), optionally running the
+    * child on a different stack. The latter is what posix_spawn() in libmusl
+    * uses: with CLONE_VM | CLONE_VFORK, the child shares parent's address
+    * space (no pdir_clone() at all) until it calls execve() or exits.
+    */
+
+   if ((flags & CSIGNAL) != SIGCHLD)
+      return -EINVAL;
+
+   flags &= ~(ulong)CSIGNAL;
+
+   if (flags == 0)
+      return do_fork(false, newsp);
+
+   if (flags == (CLONE_VM | CLONE_VFORK))
+      return do_fork(true, newsp);
+
+   return -EINVAL;
 }
 
 static int
@@ -252,6 +281,9 @@ kernel_shutdown(void)
 
    printk("The system is shutting down.\n");
 
+   /* Reboot and poweroff might need ACPI, which is initialized async */
+   wait_for_all_modules();
+
    disable_preemption();
    {
       iterate_over_tasks(&stop_all_user_tasks, NULL);
@@ -13,6 +13,8 @@
 #include <tilck/kernel/elf_utils.h>
 #include <tilck/kernel/worker_thread.h>
 #include <tilck/kernel/datetime.h>
+#include <tilck/kernel/hrtimer.h>
+#include <tilck/kernel/vdso.h>
 
 FASTCALL void asm_nop_loop(u32 iters);
 
@@ -31,8 +33,10 @@ u32 slow_timer_irq_handler_count;
 /* Temporary global used by asm_do_bogomips_loop() */
 volatile ATOMIC(u32) __bogo_loops;
 
+/* TSC clocksource: its state is in the vvar page, shared with the vdso */
+union vvar_page vvar_page ALIGNED_AT(PAGE_SIZE);
+
 /* Static variables */
-static struct list timer_wakeup_list = STATIC_LIST_INIT(timer_wakeup_list);
 static u32 loops_per_tick;         /* Tilck bogoMips as loops/tick    */
 static u32 loops_per_ms = 5000000; /* loops/millisecond (initial val)  */
 static u32 loops_per_us = 5000;    /* loops/microsecond (initial val) */
@@ -50,142 +54,142 @@ u64 get_ticks(void)
    return curr_ticks;
 }
 
-void task_set_wakeup_timer(struct task *ti, u32 ticks)
+/*
+ * Nanoseconds elapsed since the last tick, measured with the TSC. Used by
+ * get_sys_time() to have a better resolution than a tick. Returns 0 until the
+ * TSC has been calibrated. Must be called with the interrupts disabled.
+ */
+u32 get_ns_since_last_tick(void)
 {
-   ulong var;
-   ASSERT(ticks > 0);
+   const struct vdso_time_data *td = &vvar_page.time;
+   u64 cycles, ns;
+   ASSERT(!are_interrupts_enabled());
 
-   disable_interrupts(&var);
-   {
-      if (ti->ticks_before_wake_up == 0) {
-         ASSERT(!list_is_node_in_list(&ti->wakeup_timer_node));
-         list_add_tail(&timer_wakeup_list, &ti->wakeup_timer_node);
-      } else {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-      }
+   if (!td->tsc_ok)
+      return 0;
 
-      ti->ticks_before_wake_up = ticks;
-   }
-   enable_interrupts(&var);
+   /*
+    * Clamp to a tick in case of delayed timer IRQs: also avoids overflows.
+    * A "negative" delta means that RDTSC got executed out-of-order, before
+    * reading `tsc_base`. NOTE: the vdso does exactly the same calculation.
+    */
+   cycles = RDTSC() - td->tsc_base;
+   cycles = (s64)cycles < 0 ? 0 : MIN(cycles, (u64)td->max_delta_tsc);
+   ns = (cycles * td->tsc_mult) >> td->tsc_shift;
+   return (u32)MIN(ns, (u64)td->max_delta_ns);
 }
 
-void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
+bool has_tsc_clocksource(void)
 {
-   ulong var;
-   ASSERT(new_ticks > 0);
+   return vvar_page.time.tsc_ok != 0;
+}
 
-   disable_interrupts(&var);
+/*
+ * Convert a (possibly large) number of TSC cycles to nanoseconds, without the
+ * overflow risk of the mult/shift method. Returns 0 if the TSC has not been
+ * calibrated (yet).
+ */
+u64 tsc_to_ns(u64 cycles)
+{
+   const struct vdso_time_data *td = &vvar_page.time;
+   const u64 per_tick = td->max_delta_tsc;
+
+   if (!td->tsc_ok)
+      return 0;
+
+   return (cycles / per_tick) * __tick_duration +
+          (cycles % per_tick) * __tick_duration / per_tick;
+}
+
+static u32 get_curr_tick_duration(void)
+{
+   if (__tick_adj_ticks_rem)
+      return (u32)((s32)__tick_duration + __tick_adj_val);
+
+   return __tick_duration;
+}
+
+/*
+ * Called with the interrupts disabled by datetime.c after changing the tick
+ * adjustment, because that changes the duration of the current tick as well.
+ */
+void timer_tick_adj_changed(void)
+{
+   ASSERT(!are_interrupts_enabled());
+
+   vdso_time_write_begin();
    {
-      if (ti->ticks_before_wake_up > 0) {
-         ASSERT(list_is_node_in_list(&ti->wakeup_timer_node));
-         ti->ticks_before_wake_up = new_ticks;
-      }
+      vvar_page.time.max_delta_ns = get_curr_tick_duration() - 1;
    }
-   enable_interrupts(&var);
+   vdso_time_write_end();
 }
 
-u32 task_cancel_wakeup_timer(struct task *ti)
+static void task_wakeup_timer_func(struct hrtimer *t)
 {
-   ulong var;
-   u32 old;
-   disable_interrupts(&var);
-   {
-      old = ti->ticks_before_wake_up;
+   struct task *ti = CONTAINER_OF(t, struct task, wakeup_timer);
+   ASSERT(!are_interrupts_enabled());
 
-      if (old > 0) {
-         ti->timer_ready = false;
-         ti->ticks_before_wake_up = 0;
-         list_remove(&ti->wakeup_timer_node);
-      }
+   ti->timer_ready = true;
+
+   if (ti->state == TASK_STATE_SLEEPING) {
+      task_change_state(ti, TASK_STATE_RUNNABLE);
+      sched_set_need_resched();
    }
-   enable_interrupts(&var);
-   return old;
 }
 
-static void tick_all_timers(void)
+void init_task_wakeup_timer(struct task *ti)
 {
-   struct task *pos, *temp;
-   bool any_woken_up_task = false;
-   ulong var;
-
-   /*
-    * This is *NOT* the best we can do. In particular, it's terrible to keep
-    * the interrupts disabled while iterating the _whole_ timer_wakeup_list.
-    *
-    * Possible better solutions
-    * -----------------------------
-    * 1. Keep the tasks to wake-up in a sort of ordered list and then use
-    * relative timers. This way, at each tick we'll have to decrement just one
-    * single counter. We'll start decrement the next counter only when the first
-    * counter reaches 0 and its list node is removed. Of course, if we cannot
-    * use kmalloc() in case of sleep, it gets much harder to create such an
-    * ordered list and make it live inside a member of struct task. Maybe a BST
-    * will do the job, but that would require paying O(logN) per tick for
-    * finding the earliest timer. Not sure how better would be now for N < 50
-    * (typical), given the huge added constant for the BST functions. Also, the
-    * cancellation of a timer would require some extra effort in order to
-    * re-calculate the relative timer values, while we want the cancellation to
-    * be light-fast because it's run by IRQ handlers.
-    *
-    * 2. Use a fixed number of wakeup lists like: short-term, mid-term and
-    * long-term. Current task's wakeup list node will be placed in one those
-    * lists, depending on far in the future the task is supposted to be woke up.
-    * On every tick, here in tick_all_timers(), ONLY the short-term list will be
-    * iterated. That's a considerable improvement. In a system, there might be
-    * even 1,000 active timers, but how many of them will expire in the next
-    * second? Only a small percentage of them. To further improve the
-    * scalability, it's possible to have even more than 3 lists, or to further
-    * reduce the time-horizon of the short-term list. Periodically, but NOT on
-    * every tick, the `ticks_before_wake_up` field belonging to tasks in the
-    * other wakeup lists will adjusted with bigger decrements and tasks will be
-    * moved from one list to another. That will also happen in case the wakeup
-    * timer is changed for task with an already active timer. This solution
-    * looks much better than solution 1.
-    *
-    * Conclusion
-    * ---------------------
-    * For the moment, given the very limited scale of Tilck (tens of tasks at
-    * most running on the whole system), the current solution is safe and
-    * good-enough but, at some point, a smarter ad-hoc solution should be
-    * devised. Probably solution 2 is the right candidate.
-    */
-   disable_interrupts(&var);
+   hrtimer_init(&ti->wakeup_timer, &task_wakeup_timer_func);
+}
 
-   list_for_each(pos, temp, &timer_wakeup_list, wakeup_timer_node) {
+void task_set_wakeup_timer_ns(struct task *ti, u64 ns)
+{
+   const u64 now = get_sys_time();
+   ASSERT(ns > 0);
 
-      /* If task is part of this list, it's counter must be > 0 */
-      ASSERT(pos->ticks_before_wake_up > 0);
+   hrtimer_start(&ti->wakeup_timer, now + MIN(ns, UINT64_MAX - now));
+}
 
-      if (UNLIKELY(--pos->ticks_before_wake_up == 0)) {
+void task_set_wakeup_timer(struct task *ti, u32 ticks)
+{
+   ASSERT(ticks > 0);
+   task_set_wakeup_timer_ns(ti, (u64)ticks * __tick_duration);
+}
 
-         pos->timer_ready = true;
-         list_remove(&pos->wakeup_timer_node);
+void task_update_wakeup_timer_if_any(struct task *ti, u32 new_ticks)
+{
+   ulong var;
+   ASSERT(new_ticks > 0);
 
-         if (pos->state == TASK_STATE_SLEEPING) {
-            task_change_state(pos, TASK_STATE_RUNNABLE);
-            any_woken_up_task = true;
-         }
-      }
+   disable_interrupts(&var);
+   {
+      if (hrtimer_is_pending(&ti->wakeup_timer))
+         task_set_wakeup_timer(ti, new_ticks);
    }
-
    enable_interrupts(&var);
-
-   if (any_woken_up_task)
-      sched_set_need_resched();
 }
 
-static void do_sleep_internal(u32 ticks)
+/*
+ * Cancel the wake-up timer of the task, if any. Returns the nanoseconds left
+ * before it would have fired or 0, if there was no active timer.
+ */
+u64 task_cancel_wakeup_timer(struct task *ti)
 {
-   ASSERT(are_interrupts_enabled());
-
-   disable_preemption();
-   task_change_state(get_curr_task(), TASK_STATE_SLEEPING);
-   task_set_wakeup_timer(get_curr_task(), ticks);
-   kernel_yield_preempt_disabled();
+   ulong var;
+   u64 rem;
+   disable_interrupts(&var);
+   {
+      if ((rem = hrtimer_cancel(&ti->wakeup_timer)))
+         ti->timer_ready = false;
+   }
+   enable_interrupts(&var);
+   return rem;
 }
 
-void kernel_sleep(u64 ticks)
+void kernel_sleep_ns(u64 ns)
 {
+   struct task *curr = get_curr_task();
+
    if (in_panic()) {
 
       /*
@@ -200,78 +204,31 @@ void kernel_sleep(u64 ticks)
    }
 
    DEBUG_ONLY(check_not_in_irq_handler());
+   ASSERT(are_interrupts_enabled());
 
-   /*
-    * Implementation: why
-    * ---------------------
-    *
-    * In theory, the function could be implemented just as:
-    *
-    *    if (ticks) {
-    *       task_set_wakeup_timer(get_curr_task(), ticks);
-    *       task_change_state(get_curr_task(), TASK_STATE_SLEEPING);
-    *    }
-    *    kernel_yield();
-    *
-    * But that would require task->ticks_before_wake_up to be actually 64-bit,
-    * wide and that's bad on 32-bit systems because:
-    *
-    *    - it would require using the soft 64-bit integers (slow)
-    *    - it would make impossible, in the case we wanted that, the counter
-    *      to be atomic.
-    *
-    * Therefore, in order to use a 32-bit value for 'ticks_before_wake_up' and,
-    * at the same time being able to sleep for more than 2^32-1 ticks, we need
-    * a more tricky implementation (below), and the little extra runtime price
-    * for it is totally fine, since we're going to sleep anyways!
-    *
-    * Implementation: how
-    * ----------------------
-    *
-    * The simpler way to explain the algorithm is to just assume everything
-    * is in base 10 and that ticks_before_wake_up has 2 digits, while we want
-    * to support 4 digits sleep time. For example, we want to sleep for 234
-    * ticks. The algorithm first computes 534 % 100 = 34 and then 534 / 100 = 5.
-    * After that, it sleeps q (= 5) times for 99 ticks (max allowed). Clearly,
-    * we missed 5 ticks (5 * 99 < 500) this way, but we'll going to fix that
-    * buy just sleeping 'q' ticks. Thus, by now, we've slept for 500 ticks.
-    * Now we have to sleep for 34 ticks more are we're done.
-    *
-    * The same logic applies to base-2 case with 32-bit and 64-bit integers,
-    * just the numbers are much bigger. The remainder can be computed using
-    * a bitmask, while the division by using just a right shift.
-    */
-
-   const u32 rem = ticks & 0xffffffff;
-   const u32 q = ticks >> 32;
-
-   if (q) {
-
-      for (u32 i = 0; i < q; i++) {
-
-         do_sleep_internal(0xffffffff);
-
-         if (pending_signals())
-            return;
-      }
-
-      do_sleep_internal(q);
-
-      if (pending_signals())
-         return;
+   if (!ns) {
+      kernel_yield();
+      return;
    }
 
-   if (rem) {
-      do_sleep_internal(rem);
-   }
+   disable_preemption();
+   task_change_state(curr, TASK_STATE_SLEEPING);
+   task_set_wakeup_timer_ns(curr, ns);
+   kernel_yield_preempt_disabled();
 
-   if (!q && !rem)
-      kernel_yield();
+   /* We might have been woken up by a signal, before the timer fired */
+   task_cancel_wakeup_timer(curr);
+}
+
+void kernel_sleep(u64 ticks)
+{
+   const u64 max_ticks = UINT64_MAX / __tick_duration;
+   kernel_sleep_ns(MIN(ticks, max_ticks) * __tick_duration);
 }
 
 void kernel_sleep_ms(u64 ms)
 {
-   kernel_sleep(MAX(1u, ms_to_ticks(ms)));
+   kernel_sleep_ns(MIN(ms, UINT64_MAX / MILLION) * MILLION);
 }
 
 static ALWAYS_INLINE bool timer_nested_irq(void)
@@ -314,12 +271,10 @@ static enum irq_action timer_irq_handler(void *ctx)
     *       will be ignored (see above). No other IRQ handler should read it.
     */
 
-   if (__tick_adj_ticks_rem) {
-      ns_delta = (u32)((s32)__tick_duration + __tick_adj_val);
+   ns_delta = get_curr_tick_duration();
+
+   if (__tick_adj_ticks_rem)
       __tick_adj_ticks_rem--;
-   } else {
-      ns_delta = __tick_duration;
-   }
 
    disable_interrupts_forced();
    {
@@ -331,16 +286,60 @@ static enum irq_action timer_irq_handler(void *ctx)
        */
       __ticks++;
       __time_ns += ns_delta;
+
+      vdso_time_write_begin();
+      {
+         vvar_page.time.tsc_base = RDTSC();
+         vvar_page.time.ns_base = __time_ns;
+         vvar_page.time.max_delta_ns = get_curr_tick_duration() - 1;
+      }
+      vdso_time_write_end();
    }
    enable_interrupts_forced();
 
    sched_account_ticks();
-   tick_all_timers();
+   smp_broadcast_tick();
+
+   /*
+    * Without a one-shot timer backend, the hrtimers (and the sleeping tasks'
+    * wake-up timers) expire here. Otherwise, this is just a safety net.
+    */
+   hrtimer_run_expired();
    return IRQ_HANDLED;
 }
 
 static enum irq_action measure_bogomips_irq_handler(void *ctx);
 
+/*
+ * Compute the multiplier and the shift used to convert TSC cycles to ns, as
+ * `(cycles * mult) >> shift`, with the max shift allowing `mult` to fit in 32
+ * bits. That's what the vdso can do cheaply, with a single 32x32 `mul`.
+ */
+static void init_tsc_clocksource(u64 tsc_per_tick)
+{
+   struct vdso_time_data *td = &vvar_page.time;
+   u32 shift = 31;
+   ASSERT(!are_interrupts_enabled());
+
+   if (!tsc_per_tick || tsc_per_tick > UINT32_MAX)
+      return;
+
+   while (shift && ((u64)__tick_duration << shift) / tsc_per_tick > UINT32_MAX)
+      shift--;
+
+   vdso_time_write_begin();
+   {
+      td->tsc_mult = (u32)(((u64)__tick_duration << shift) / tsc_per_tick);
+      td->tsc_shift = shift;
+      td->max_delta_tsc = (u32)tsc_per_tick;
+      td->tsc_base = RDTSC();
+      td->ns_base = __time_ns;
+      td->max_delta_ns = get_curr_tick_duration() - 1;
+      td->tsc_ok = 1;
+   }
+   vdso_time_write_end();
+}
+
 DEFINE_IRQ_HANDLER_NODE(timer, timer_irq_handler, NULL);
 DEFINE_IRQ_HANDLER_NODE(measure_bogomips, measure_bogomips_irq_handler, NULL);
 
@@ -348,6 +347,7 @@ struct bogo_measure_ctx {
    bool started;
    bool pass_start;
    u32 ticks;
+   u64 tsc_start;
 };
 
 static enum irq_action measure_bogomips_irq_handler(void *arg)
@@ -370,6 +370,10 @@ static enum irq_action measure_bogomips_irq_handler(void *arg)
        */
       __bogo_loops = 0;
       ctx->pass_start = true;
+
+      /* Use the same window to calibrate the TSC and the one-shot timer */
+      ctx->tsc_start = RDTSC();
+      hw_hrtimer_calib_begin();
       return IRQ_NOT_HANDLED;
    }
 
@@ -385,6 +389,12 @@ static enum irq_action measure_bogomips_irq_handler(void *arg)
          loops_per_ms = loops_per_tick / (1000 / TIMER_HZ);
          loops_per_us = loops_per_ms / 1000;
          __bogo_loops = -1;
+
+         init_tsc_clocksource(
+            (RDTSC() - ctx->tsc_start) / MEASURE_BOGOMIPS_TICKS
+         );
+
+         hw_hrtimer_calib_end(MEASURE_BOGOMIPS_TICKS);
       }
       enable_interrupts_forced();
    }
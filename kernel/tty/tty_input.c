@@ -193,6 +193,39 @@ tty_inbuf_write_elem(struct tty *t, u8 c, bool block)
    }
 }
 
+static void
+tty_inbuf_write_buf(struct tty *t, const u8 *buf, size_t len, bool block)
+{
+   ASSERT(in_panic() || !block || is_preemption_enabled());
+   size_t written;
+
+   while (true) {
+
+      disable_preemption();
+      {
+         written = ringbuf_write_bytes(&t->input_ringbuf, (u8 *)buf, len);
+      }
+      enable_preemption();
+
+      for (size_t i = 0; i < written; i++)
+         tty_keypress_echo(t, (char)buf[i]);
+
+      buf += written;
+      len -= written;
+
+      if (!len)
+         break;
+
+      /* Our buffer is full: same logic as in tty_inbuf_write_elem() */
+
+      if (!block)
+         break;
+
+      kcond_signal_all(&t->input_cond);
+      kcond_wait(&t->output_cond, NULL, TIME_SLICE_TICKS);
+   }
+}
+
 static int
 tty_handle_non_printable_key(struct kb_dev *kb,
                              struct tty *t,
@@ -278,6 +311,58 @@ void tty_send_keyevent(struct tty *t, struct key_event ke, bool block)
    return;
 }
 
+/*
+ * Returns true if `c` doesn't need any special handling by the line discipline
+ * and can be just copied in the input buffer, along with its neighbours.
+ */
+static bool tty_is_plain_input_char(struct tty *t, u8 c)
+{
+   const struct termios *const c_term = &t->c_term;
+
+   if (t->ctrl_handlers[c])
+      return false;
+
+   if (c == '\r' && (c_term->c_iflag & (IGNCR | ICRNL)))
+      return false;
+
+   if (c == '\n' && (c_term->c_iflag & INLCR))
+      return false;
+
+   if (c_term->c_lflag & ICANON)
+      return c != c_term->c_cc[VERASE] && !tty_is_line_delim_char(t, c);
+
+   return true;
+}
+
+/*
+ * Bulk version of tty_send_keyevent(), for devices like the serial ports that
+ * receive data in chunks. The line discipline is applied per buffer: runs of
+ * plain characters are copied in the input buffer in one shot and, in raw
+ * mode, the readers are woken up once per buffer, not once per character.
+ */
+void tty_send_buf(struct tty *t, const char *buf, size_t len, bool block)
+{
+   const u8 *p = (const u8 *)buf;
+   const u8 *const end = p + len;
+   const u8 *run;
+
+   while (p < end) {
+
+      for (run = p; p < end && tty_is_plain_input_char(t, *p); p++) { }
+
+      if (p > run)
+         tty_inbuf_write_buf(t, run, (size_t)(p - run), block);
+
+      if (p < end) {
+         tty_send_keyevent(t, make_key_event(0, (char)*p, true), block);
+         p++;
+      }
+   }
+
+   if (len && !(t->c_term.c_lflag & ICANON))
+      kcond_signal_one(&t->input_cond);
+}
+
 static int
 tty_keypress_handler_int(struct tty *t,
                          struct kb_dev *kb,
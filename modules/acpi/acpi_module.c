@@ -11,6 +11,9 @@
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/cmdline.h>
 #include <tilck/kernel/uefi.h>
+#include <tilck/kernel/smp.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+#include <tilck/kernel/arch/generic_x86/ioapic.h>
 
 #include <tilck/mods/pci.h>
 #include <tilck/mods/acpi.h>
@@ -151,6 +154,80 @@ acpi_read_acpi_hw_flags(void)
    AcpiPutTable((struct acpi_table_header *)fadt);
 }
 
+static u32
+madt_inti_to_ioapic_flags(u16 inti)
+{
+   u32 flags = 0;
+
+   if ((inti & ACPI_MADT_POLARITY_MASK) == ACPI_MADT_POLARITY_ACTIVE_LOW)
+      flags |= IOAPIC_FL_ACTIVE_LOW;
+
+   if ((inti & ACPI_MADT_TRIGGER_MASK) == ACPI_MADT_TRIGGER_LEVEL)
+      flags |= IOAPIC_FL_LEVEL;
+
+   return flags;
+}
+
+/*
+ * Walk the MADT table in order to find the physical address of the LAPIC, all
+ * the usable CPUs, the IOAPICs and the ISA IRQ overrides in the system.
+ */
+static void
+acpi_read_madt(void)
+{
+   ACPI_STATUS rc;
+   struct acpi_table_madt *madt;
+   struct acpi_subtable_header *h;
+   char *p, *end;
+
+   rc = AcpiGetTable(ACPI_SIG_MADT, 1, (struct acpi_table_header **)&madt);
+
+   if (rc == AE_NOT_FOUND)
+      return;
+
+   if (ACPI_FAILURE(rc)) {
+      print_acpi_failure("AcpiGetTable", "MADT", rc);
+      return;
+   }
+
+   lapic_set_paddr(madt->Address);
+   p = (char *)madt + sizeof(*madt);
+   end = (char *)madt + madt->Header.Length;
+
+   for (; p + sizeof(*h) <= end; p += h->Length) {
+
+      h = (void *)p;
+
+      if (!h->Length)
+         break; /* Broken table: avoid looping forever */
+
+      if (h->Type == ACPI_MADT_TYPE_LOCAL_APIC) {
+
+         struct acpi_madt_local_apic *la = (void *)h;
+
+         if (la->LapicFlags & ACPI_MADT_ENABLED)
+            smp_add_cpu(la->Id);
+
+      } else if (h->Type == ACPI_MADT_TYPE_IO_APIC) {
+
+         struct acpi_madt_io_apic *io = (void *)h;
+         ioapic_add(io->Id, io->Address, io->GlobalIrqBase);
+
+      } else if (h->Type == ACPI_MADT_TYPE_INTERRUPT_OVERRIDE) {
+
+         struct acpi_madt_interrupt_override *ov = (void *)h;
+
+         if (ov->Bus == 0) {
+            ioapic_add_isa_override(ov->SourceIrq,
+                                    ov->GlobalIrq,
+                                    madt_inti_to_ioapic_flags(ov->IntiFlags));
+         }
+      }
+   }
+
+   AcpiPutTable((struct acpi_table_header *)madt);
+}
+
 void
 acpi_reboot(void)
 {
@@ -280,6 +357,7 @@ acpi_mod_init_tables(void)
 
    acpi_init_status = ais_tables_initialized;
    acpi_read_acpi_hw_flags();
+   acpi_read_madt();
 }
 
 void
@@ -579,6 +657,8 @@ static struct module acpi_module = {
    .name = "acpi",
    .priority = MOD_acpi_prio,
    .init = &acpi_module_init,
+   .deps = MOD_DEPS("pci", "sysfs"),
+   .async = true,
 };
 
 REGISTER_MODULE(&acpi_module);
@@ -0,0 +1,388 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/modules.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/blkdev.h>
+
+/*
+ * Minimal PIO driver for the ATA disks on the legacy IDE channels (e.g. QEMU's
+ * `ide-hd` devices). The interrupts of the drives are disabled (nIEN) and the
+ * driver just polls the status register, yielding the CPU while the drive is
+ * busy for a while.
+ */
+
+/* Registers, relative to the command block base */
+#define ATA_REG_DATA                                 0
+#define ATA_REG_ERROR                                1
+#define ATA_REG_SECCOUNT                             2
+#define ATA_REG_LBA_LO                               3
+#define ATA_REG_LBA_MID                              4
+#define ATA_REG_LBA_HI                               5
+#define ATA_REG_DRIVE                                6
+#define ATA_REG_STATUS                               7
+#define ATA_REG_CMD                                  7
+
+/* Status register bits */
+#define ATA_ST_ERR                              (1 << 0)
+#define ATA_ST_DRQ                              (1 << 3)
+#define ATA_ST_DF                               (1 << 5)
+#define ATA_ST_DRDY                             (1 << 6)
+#define ATA_ST_BSY                              (1 << 7)
+
+/* Device control register bits */
+#define ATA_CTRL_NIEN                           (1 << 1)
+
+/* Commands */
+#define ATA_CMD_READ_PIO                          0x20
+#define ATA_CMD_READ_PIO_EXT                      0x24
+#define ATA_CMD_WRITE_PIO                         0x30
+#define ATA_CMD_WRITE_PIO_EXT                     0x34
+#define ATA_CMD_FLUSH_CACHE                       0xe7
+#define ATA_CMD_FLUSH_CACHE_EXT                   0xea
+#define ATA_CMD_IDENTIFY                          0xec
+
+#define ATA_LBA28_MAX                     (1u << 28)
+#define ATA_MAX_SECTORS                            256   /* per command */
+#define ATA_TIMEOUT_MS                            5000
+#define ATA_SPIN_ITERS                            1000
+
+struct ata_channel {
+
+   u16 io;                 /* command block base port */
+   u16 ctrl;               /* control block port (alt status / dev control) */
+   struct kmutex lock;
+};
+
+struct ata_drive {
+
+   struct blkdev bdev;
+   struct ata_channel *ch;
+   bool slave;
+   bool lba48;
+   char model[41];
+};
+
+static struct ata_channel ata_channels[2] = {
+   { .io = 0x1f0, .ctrl = 0x3f6 },
+   { .io = 0x170, .ctrl = 0x376 },
+};
+
+static inline u8 ata_status(struct ata_channel *ch)
+{
+   return inb(ch->io + ATA_REG_STATUS);
+}
+
+/* Reading the alternate status register 4 times takes at least 400 ns */
+static inline void ata_delay_400ns(struct ata_channel *ch)
+{
+   for (int i = 0; i < 4; i++)
+      inb(ch->ctrl);
+}
+
+/*
+ * Wait for BSY to be clear and for (status & mask) == val. Spin for a while,
+ * then start yielding the CPU, up to ATA_TIMEOUT_MS.
+ */
+static int ata_wait(struct ata_channel *ch, u8 mask, u8 val)
+{
+   const u64 deadline = get_ticks() + ms_to_ticks(ATA_TIMEOUT_MS);
+   u32 iters = 0;
+   u8 st;
+
+   while (true) {
+
+      st = ata_status(ch);
+
+      if (!(st & ATA_ST_BSY)) {
+
+         if (st & (ATA_ST_ERR | ATA_ST_DF))
+            return -EIO;
+
+         if ((st & mask) == val)
+            return 0;
+      }
+
+      if (++iters < ATA_SPIN_ITERS) {
+         cpu_relax();
+         continue;
+      }
+
+      if (get_ticks() > deadline)
+         return -EIO;
+
+      kernel_yield();
+   }
+}
+
+static void ata_select(struct ata_drive *d, u8 flags)
+{
+   outb(d->ch->io + ATA_REG_DRIVE, flags | (d->slave ? 0x10 : 0) | 0xa0);
+   ata_delay_400ns(d->ch);
+}
+
+/* Must be called after selecting the drive with ata_select() */
+static void
+ata_setup_lba(struct ata_drive *d, u64 lba, u32 count, bool lba48)
+{
+   const u16 io = d->ch->io;
+
+   if (lba48) {
+      outb(io + ATA_REG_SECCOUNT, (u8)(count >> 8));
+      outb(io + ATA_REG_LBA_LO, (u8)(lba >> 24));
+      outb(io + ATA_REG_LBA_MID, (u8)(lba >> 32));
+      outb(io + ATA_REG_LBA_HI, (u8)(lba >> 40));
+   }
+
+   outb(io + ATA_REG_SECCOUNT, (u8)count);
+   outb(io + ATA_REG_LBA_LO, (u8)lba);
+   outb(io + ATA_REG_LBA_MID, (u8)(lba >> 8));
+   outb(io + ATA_REG_LBA_HI, (u8)(lba >> 16));
+}
+
+static int ata_xfer_bio(struct ata_drive *d, struct blk_bio *bio)
+{
+   const u16 data_port = d->ch->io + ATA_REG_DATA;
+   u16 *buf = bio->buf;
+   int rc;
+
+   for (u32 s = 0; s < bio->count; s++) {
+
+      if ((rc = ata_wait(d->ch, ATA_ST_DRQ, ATA_ST_DRQ)))
+         return rc;
+
+      if (bio->write) {
+
+         for (u32 i = 0; i < BLK_SECTOR_SIZE / 2; i++)
+            outw(data_port, *buf++);
+
+      } else {
+
+         for (u32 i = 0; i < BLK_SECTOR_SIZE / 2; i++)
+            *buf++ = inw(data_port);
+      }
+   }
+
+   return 0;
+}
+
+static int ata_do_xfer(struct ata_drive *d, struct blk_req *req)
+{
+   const bool lba48 = req->sector + req->count > ATA_LBA28_MAX;
+   struct blk_bio *bio;
+   u8 cmd;
+   int rc;
+
+   ASSERT(req->count <= ATA_MAX_SECTORS);
+
+   if (lba48 && !d->lba48)
+      return -EIO;
+
+   /* LBA mode. For LBA28, the drive register contains the bits 24-27 */
+   ata_select(d, 0x40 | (lba48 ? 0 : (u8)((req->sector >> 24) & 0x0f)));
+
+   if ((rc = ata_wait(d->ch, ATA_ST_DRQ | ATA_ST_DRDY, ATA_ST_DRDY)))
+      return rc;
+
+   ata_setup_lba(d, req->sector, req->count, lba48);
+
+   if (req->write)
+      cmd = lba48 ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO;
+   else
+      cmd = lba48 ? ATA_CMD_READ_PIO_EXT : ATA_CMD_READ_PIO;
+
+   outb(d->ch->io + ATA_REG_CMD, cmd);
+   ata_delay_400ns(d->ch);
+
+   /* The bios are sorted by sector and contiguous: just follow them */
+   list_for_each_ro(bio, &req->bios, node) {
+      if ((rc = ata_xfer_bio(d, bio)))
+         return rc;
+   }
+
+   if (req->write) {
+
+      if ((rc = ata_wait(d->ch, ATA_ST_DRQ, 0)))
+         return rc;
+
+      cmd = d->lba48 ? ATA_CMD_FLUSH_CACHE_EXT : ATA_CMD_FLUSH_CACHE;
+      outb(d->ch->io + ATA_REG_CMD, cmd);
+      ata_delay_400ns(d->ch);
+
+      if ((rc = ata_wait(d->ch, 0, 0)))
+         return rc;
+   }
+
+   return 0;
+}
+
+static int ata_xfer(struct blkdev *bdev, struct blk_req *req)
+{
+   struct ata_drive *d = bdev->priv;
+   int rc;
+
+   kmutex_lock(&d->ch->lock);
+   {
+      rc = ata_do_xfer(d, req);
+   }
+   kmutex_unlock(&d->ch->lock);
+   return rc;
+}
+
+static const struct blkdev_ops ata_blkdev_ops = {
+   .xfer = &ata_xfer,
+};
+
+static void ata_get_model(u16 *id, char *model)
+{
+   int len = 40;
+
+   /* Words 27-46: the model number, with the two bytes of each word swapped */
+   for (int i = 0; i < 20; i++) {
+      model[i * 2] = (char)(id[27 + i] >> 8);
+      model[i * 2 + 1] = (char)(id[27 + i] & 0xff);
+   }
+
+   while (len > 0 && model[len - 1] == ' ')
+      len--;
+
+   model[len] = 0;
+}
+
+/*
+ * Send the IDENTIFY DEVICE command and read its result in `id`.
+ * Returns -ENODEV in case there's no ATA drive (ATAPI drives are ignored).
+ */
+static int ata_identify(struct ata_drive *d, u16 *id)
+{
+   struct ata_channel *ch = d->ch;
+   int rc;
+
+   ata_select(d, 0);
+   outb(ch->io + ATA_REG_SECCOUNT, 0);
+   outb(ch->io + ATA_REG_LBA_LO, 0);
+   outb(ch->io + ATA_REG_LBA_MID, 0);
+   outb(ch->io + ATA_REG_LBA_HI, 0);
+   outb(ch->io + ATA_REG_CMD, ATA_CMD_IDENTIFY);
+   ata_delay_400ns(ch);
+
+   if (!ata_status(ch))
+      return -ENODEV;
+
+   if ((rc = ata_wait(ch, 0, 0)))
+      return -ENODEV;
+
+   /* ATAPI and SATA devices set these registers to a signature */
+   if (inb(ch->io + ATA_REG_LBA_MID) || inb(ch->io + ATA_REG_LBA_HI))
+      return -ENODEV;
+
+   if ((rc = ata_wait(ch, ATA_ST_DRQ, ATA_ST_DRQ)))
+      return -ENODEV;
+
+   for (u32 i = 0; i < 256; i++)
+      id[i] = inw(ch->io + ATA_REG_DATA);
+
+   return 0;
+}
+
+static void ata_probe_drive(struct ata_channel *ch, u32 ch_idx, bool slave)
+{
+   struct ata_drive *d;
+   u16 *id;
+   int rc;
+
+   if (!(id = kmalloc(BLK_SECTOR_SIZE)))
+      panic("ATA: out of memory");
+
+   if (!(d = kzalloc_obj(struct ata_drive)))
+      panic("ATA: out of memory");
+
+   d->ch = ch;
+   d->slave = slave;
+
+   kmutex_lock(&ch->lock);
+   {
+      rc = ata_identify(d, id);
+   }
+   kmutex_unlock(&ch->lock);
+
+   if (rc)
+      goto out;
+
+   d->lba48 = !!(id[83] & (1 << 10));
+
+   if (d->lba48) {
+      d->bdev.nr_sectors = (u64)id[100]       |
+                           (u64)id[101] << 16 |
+                           (u64)id[102] << 32 |
+                           (u64)id[103] << 48;
+   } else {
+      d->bdev.nr_sectors = (u32)id[60] | (u32)id[61] << 16;
+   }
+
+   if (!d->bdev.nr_sectors)
+      goto out; /* No LBA support (CHS-only drive) */
+
+   ata_get_model(id, d->model);
+   snprintk(d->bdev.name,
+            sizeof(d->bdev.name),
+            "hd%c", 'a' + ch_idx * 2 + slave);
+   d->bdev.max_sectors = ATA_MAX_SECTORS;
+   d->bdev.ops = &ata_blkdev_ops;
+   d->bdev.priv = d;
+
+   printk("ATA: %s: %s, LBA%s\n",
+          d->bdev.name, d->model, d->lba48 ? "48" : "28");
+
+   if ((rc = register_blkdev(&d->bdev))) {
+      printk("ATA: failed to register %s: %d\n", d->bdev.name, rc);
+      goto out;
+   }
+
+   if ((rc = blkdev_scan_partitions(&d->bdev)))
+      printk("ATA: %s: can't read the partitions: %d\n", d->bdev.name, rc);
+
+   d = NULL; /* registered: don't free it */
+
+out:
+   if (d)
+      kfree_obj(d, struct ata_drive);
+
+   kfree2(id, BLK_SECTOR_SIZE);
+}
+
+static void init_ata(void)
+{
+   for (u32 i = 0; i < ARRAY_SIZE(ata_channels); i++) {
+
+      struct ata_channel *ch = &ata_channels[i];
+
+      /* Floating bus: no controller or no drives on this channel */
+      if (ata_status(ch) == 0xff)
+         continue;
+
+      kmutex_init(&ch->lock, 0);
+      outb(ch->ctrl, ATA_CTRL_NIEN);
+
+      ata_probe_drive(ch, i, false);
+      ata_probe_drive(ch, i, true);
+   }
+}
+
+static struct module ata_module = {
+
+   .name = "ata",
+   .priority = MOD_ata_prio,
+   .init = &init_ata,
+   .async = true,
+};
+
+REGISTER_MODULE(&ata_module);
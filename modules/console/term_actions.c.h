@@ -98,6 +98,7 @@ static void
 term_action_write(struct vterm *const t, const char *buf, u32 len, u8 color)
 {
    const struct video_interface *const vi = t->vi;
+   const bool deferred = term_defer_rendering(t);
 
    ts_scroll_to_bottom(t);
    vi->enable_cursor();
@@ -126,6 +127,9 @@ term_action_write(struct vterm *const t, const char *buf, u32 len, u8 color)
       term_execute_action(t, &a);
    }
 
+   if (deferred)
+      term_flush_damage(t);
+
    if (t->cursor_enabled)
       vi->move_cursor(t->r, t->c, get_curr_cell_fg_color(t));
 }
@@ -136,8 +140,13 @@ DEFINE_TERM_ACTION_3(write, const char *, u32, u8)
 static void
 term_action_direct_write(struct vterm *const t, char *buf, u32 len, u8 color)
 {
+   const bool deferred = term_defer_rendering(t);
+
    for (u32 i = 0; i < len; i++)
       term_internal_write_char2(t, buf[i], color);
+
+   if (deferred)
+      term_flush_damage(t);
 }
 
 DEFINE_TERM_ACTION_3(direct_write, char *, u32, u8)
@@ -191,10 +200,10 @@ term_action_erase_in_display(struct vterm *const t, int mode)
 
          /* Clear the screen from the cursor position up to the end */
 
-         for (u16 col = t->c; col < t->cols; col++) {
+         for (u16 col = t->c; col < t->cols; col++)
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
-         }
+
+         term_draw_cells(t, t->r, t->c, t->cols);
 
          for (u16 i = t->r + 1; i < t->rows; i++)
             ts_clear_row(t, i, DEFAULT_COLOR16);
@@ -208,10 +217,10 @@ term_action_erase_in_display(struct vterm *const t, int mode)
          for (u16 i = 0; i < t->r; i++)
             ts_clear_row(t, i, DEFAULT_COLOR16);
 
-         for (u16 col = 0; col < t->c; col++) {
+         for (u16 col = 0; col < t->c; col++)
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
-         }
+
+         term_draw_cells(t, t->r, 0, t->c);
 
          break;
 
@@ -251,17 +260,17 @@ term_action_erase_in_line(struct vterm *const t, int mode)
    switch (mode) {
 
       case 0:
-         for (u16 col = t->c; col < t->cols; col++) {
+         for (u16 col = t->c; col < t->cols; col++)
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
-         }
+
+         term_draw_cells(t, t->r, t->c, t->cols);
          break;
 
       case 1:
-         for (u16 col = 0; col < t->c; col++) {
+         for (u16 col = 0; col < t->c; col++)
             buf_set_entry(t, t->r, col, entry);
-            t->vi->set_char_at(t->r, col, entry);
-         }
+
+         term_draw_cells(t, t->r, 0, t->c);
          break;
 
       case 2:
@@ -317,8 +326,7 @@ term_action_ins_blank_chars(struct vterm *const t, u16 n)
    for (u16 c = t->c; c < t->c + n; c++)
       buf_row[c] = make_vgaentry(' ', vgaentry_get_color(buf_row[c]));
 
-   for (u16 c = t->c; c < t->cols; c++)
-      t->vi->set_char_at(row, c, buf_row[c]);
+   term_draw_cells(t, row, t->c, t->cols);
 }
 
 DEFINE_TERM_ACTION_1(ins_blank_chars, u16)
@@ -336,8 +344,7 @@ term_action_del_chars_in_line(struct vterm *const t, u16 n)
    for (u16 c = t->c + cN; c < MIN(t->c + cN + n - maxN, t->cols); c++)
       buf_row[c] = make_vgaentry(' ', vgaentry_get_color(buf_row[c]));
 
-   for (u16 c = t->c; c < t->cols; c++)
-      t->vi->set_char_at(row, c, buf_row[c]);
+   term_draw_cells(t, row, t->c, t->cols);
 }
 
 DEFINE_TERM_ACTION_1(del_chars_in_line, u16)
@@ -351,8 +358,7 @@ term_action_erase_chars_in_line(struct vterm *const t, u16 n)
    for (u16 c = t->c; c < MIN(t->cols, t->c + n); c++)
       buf_row[c] = make_vgaentry(' ', vgaentry_get_color(buf_row[c]));
 
-   for (u16 c = t->c; c < t->cols; c++)
-      t->vi->set_char_at(row, c, buf_row[c]);
+   term_draw_cells(t, row, t->c, t->cols);
 }
 
 DEFINE_TERM_ACTION_1(erase_chars_in_line, u16)
@@ -66,6 +66,18 @@ struct vterm {
 
    term_filter filter;
    void *filter_ctx;
+
+   /*
+    * Damage tracking. While `defer_rendering` is true, the changes are made
+    * only in `buffer` and the touched cells are just marked as dirty: the
+    * video interface is used only later, by term_flush_damage(). For each
+    * row, the dirty cells are the ones in [dirty_start[row], dirty_end[row]).
+    * Rows having dirty_end[row] == 0 are clean.
+    */
+   bool defer_rendering;
+   u16 dirty_rows;            /* number of rows having dirty cells */
+   u16 *dirty_start;
+   u16 *dirty_end;
 };
 
 static struct vterm first_instance;
@@ -185,6 +197,98 @@ static void term_int_enable_cursor(struct vterm *t, bool val)
    }
 }
 
+static void
+term_mark_dirty(struct vterm *t, u16 row, u16 start_col, u16 end_col)
+{
+   ASSERT(t->defer_rendering);
+
+   if (start_col >= end_col)
+      return;
+
+   if (!t->dirty_end[row]) {
+      t->dirty_start[row] = start_col;
+      t->dirty_end[row] = end_col;
+      t->dirty_rows++;
+      return;
+   }
+
+   t->dirty_start[row] = MIN(t->dirty_start[row], start_col);
+   t->dirty_end[row] = MAX(t->dirty_end[row], end_col);
+}
+
+/* Render the cells [start_col, end_col) of `row`, reading them from `buffer` */
+static void
+term_draw_cells(struct vterm *t, u16 row, u16 start_col, u16 end_col)
+{
+   if (t->defer_rendering) {
+      term_mark_dirty(t, row, start_col, end_col);
+      return;
+   }
+
+   for (u16 col = start_col; col < end_col; col++)
+      t->vi->set_char_at(row, col, buf_get_entry(t, row, col));
+}
+
+static ALWAYS_INLINE void
+term_draw_cell(struct vterm *t, u16 row, u16 col)
+{
+   term_draw_cells(t, row, col, col + 1);
+}
+
+/*
+ * Start deferring the rendering. Returns false if that's not possible or if
+ * we're already deferring it (nested call): in both cases, the caller must
+ * not call term_flush_damage().
+ */
+static bool term_defer_rendering(struct vterm *t)
+{
+   if (t->defer_rendering || !t->dirty_end || in_panic())
+      return false;
+
+   t->defer_rendering = true;
+   return true;
+}
+
+/*
+ * Render all the dirty cells and stop deferring the rendering. Rows having
+ * a large number of dirty cells are redrawn with set_row(), which is much
+ * faster per cell than set_char_at().
+ */
+static void term_flush_damage(struct vterm *t)
+{
+   const bool fpu_allowed = !in_irq() && !in_panic();
+
+   ASSERT(t->defer_rendering);
+   t->defer_rendering = false;
+
+   if (!t->dirty_rows)
+      return;
+
+   if (fpu_allowed)
+      fpu_context_begin();
+
+   for (u16 row = 0; row < t->rows; row++) {
+
+      const u16 s = t->dirty_start[row];
+      const u16 e = t->dirty_end[row];
+
+      if (!e)
+         continue;
+
+      if (e - s >= t->cols / 4)
+         t->vi->set_row(row, get_buf_row(t, row), fpu_allowed);
+      else
+         term_draw_cells(t, row, s, e);
+
+      t->dirty_end[row] = 0;
+   }
+
+   if (fpu_allowed)
+      fpu_context_end();
+
+   t->dirty_rows = 0;
+}
+
 static void term_redraw2(struct vterm *t, u16 s, u16 e)
 {
    const bool fpu_allowed = !in_irq() && !in_panic();
@@ -192,6 +296,14 @@ static void term_redraw2(struct vterm *t, u16 s, u16 e)
    if (!t->buffer)
       return;
 
+   if (t->defer_rendering) {
+
+      for (u16 row = s; row < e; row++)
+         term_mark_dirty(t, row, 0, t->cols);
+
+      return;
+   }
+
    if (fpu_allowed)
       fpu_context_begin();
 
@@ -268,7 +380,11 @@ static void ts_buf_clear_row(struct vterm *t, u16 row, u8 color)
 static void ts_clear_row(struct vterm *t, u16 row, u8 color)
 {
    ts_buf_clear_row(t, row, color);
-   t->vi->clear_row(row, color);
+
+   if (t->defer_rendering)
+      term_mark_dirty(t, row, 0, t->cols);
+   else
+      t->vi->clear_row(row, color);
 }
 
 static void term_int_scroll_up(struct vterm *t, u32 lines)
@@ -377,7 +493,12 @@ static void term_internal_incr_row(struct vterm *t)
 
    t->max_scroll++;
 
-   if (t->vi->scroll_one_line_up) {
+   /*
+    * When the rendering is deferred, scrolling costs just an increment of
+    * `scroll` (the buffer is a ring) and the screen will be redrawn only
+    * once, by term_flush_damage(), no matter how many lines we scrolled.
+    */
+   if (t->vi->scroll_one_line_up && !t->defer_rendering) {
       t->scroll++;
       t->vi->scroll_one_line_up();
    } else {
@@ -391,7 +512,12 @@ static void term_internal_write_printable_char(struct vterm *t, u8 c, u8 color)
 {
    const u16 entry = make_vgaentry(c, color);
    buf_set_entry(t, t->r, t->c, entry);
-   t->vi->set_char_at(t->r, t->c, entry);
+
+   if (t->defer_rendering)
+      term_mark_dirty(t, t->r, t->c, t->c + 1);
+   else
+      t->vi->set_char_at(t->r, t->c, entry);
+
    t->c++;
 }
 
@@ -422,7 +548,7 @@ static void term_internal_write_backspace(struct vterm *t, u8 color)
 
    if (!t->tabs_buf || !t->tabs_buf[t->r * t->cols + t->c]) {
       buf_set_entry(t, t->r, t->c, space_entry);
-      t->vi->set_char_at(t->r, t->c, space_entry);
+      term_draw_cell(t, t->r, t->c);
       return;
    }
 
@@ -615,6 +741,11 @@ dispose_term(term *_t)
       kfree_array_obj(t->screen_buf_copy, u16, t->rows * t->cols);
       t->screen_buf_copy = NULL;
    }
+
+   if (t->dirty_start) {
+      kfree_array_obj(t->dirty_start, u16, 2 * t->rows);
+      t->dirty_start = t->dirty_end = NULL;
+   }
 }
 
 static void
@@ -726,6 +857,12 @@ init_vterm(term *_t,
          printk("WARNING: unable to allocate main_tabs_buf\n");
       }
 
+      /* Not fatal: without these, the rendering won't be deferred */
+      t->dirty_start = kzalloc_array_obj(u16, 2 * t->rows);
+
+      if (t->dirty_start)
+         t->dirty_end = t->dirty_start + t->rows;
+
    } else {
 
       /* We're in panic or we were unable to allocate the buffer */
@@ -6,13 +6,18 @@
 #include <tilck/common/string_util.h>
 #include <tilck/kernel/debug_utils.h>
 #include <tilck/kernel/irq.h>
+#include <tilck/kernel/irq_bh.h>
 #include <tilck/kernel/timer.h>
 #include <tilck/kernel/kb.h>
 #include <tilck/kernel/sched.h>
 
 #include "termutil.h"
+#include "dp_int.h"
+
+#define DP_MAX_BHS   16
 
 static int row;
+static struct irq_bh_info bh_arr[DP_MAX_BHS];
 
 static void debug_dump_slow_irq_handler_count(void)
 {
@@ -72,6 +77,67 @@ static void debug_dump_masked_irqs(void)
    dp_writeln("");
 }
 
+/* Latency in microseconds when the TSC is calibrated, in Kcycles otherwise */
+static u64 dp_bh_lat(u64 cycles)
+{
+   return has_tsc_clocksource() ? tsc_to_ns(cycles) / 1000 : cycles / 1000;
+}
+
+static void debug_dump_bottom_halves(void)
+{
+   const int count = irq_bh_snapshot(bh_arr, ARRAY_SIZE(bh_arr));
+   const char *unit = has_tsc_clocksource() ? "us" : "Kc";
+
+   dp_writeln("");
+   dp_writeln("IRQ bottom halves (" E_COLOR_BR_WHITE "z" RESET_ATTRS
+              "ero counters, latency in %s)", unit);
+
+   dp_writeln(
+                 " Name    "
+      TERM_VLINE " IRQ "
+      TERM_VLINE " Pr "
+      TERM_VLINE " Schedule "
+      TERM_VLINE " Coalesce "
+      TERM_VLINE "   Runs   "
+      TERM_VLINE " Ovf "
+      TERM_VLINE " AvgLat "
+      TERM_VLINE " MaxLat"
+   );
+
+   dp_writeln(
+      GFX_ON
+      "qqqqqqqqqnqqqqqnqqqqnqqqqqqqqqqnqqqqqqqqqqnqqqqqqqqqqnqqqqqnqqqqqqqqn"
+      "qqqqqqq"
+      GFX_OFF
+   );
+
+   for (int i = 0; i < count; i++) {
+
+      const struct irq_bh_info *bh = &bh_arr[i];
+      const struct irq_bh_stats *s = &bh->stats;
+
+      dp_writeln(" %-7s%c"
+                 TERM_VLINE " %3d "
+                 TERM_VLINE " %2d "
+                 TERM_VLINE " %8u "
+                 TERM_VLINE " %8u "
+                 TERM_VLINE " %8u "
+                 TERM_VLINE " %3u "
+                 TERM_VLINE " %6llu "
+                 TERM_VLINE " %6llu",
+                 bh->name,
+                 bh->pending ? '*' : ' ',
+                 bh->irq,
+                 bh->priority,
+                 s->scheduled,
+                 s->coalesced,
+                 s->runs,
+                 s->overflows,
+                 s->runs ? dp_bh_lat(s->lat_tot / s->runs) : 0,
+                 dp_bh_lat(s->lat_max));
+   }
+}
+
 static void dp_show_irq_stats(void)
 {
    row = dp_screen_start_row;
@@ -81,6 +147,21 @@ static void dp_show_irq_stats(void)
    debug_dump_spur_irq_count();
    debug_dump_unhandled_irq_count();
    debug_dump_masked_irqs();
+   debug_dump_bottom_halves();
+}
+
+static int dp_irqs_keypress(struct key_event ke)
+{
+   switch (ke.print_char) {
+
+      case 'z':
+         irq_bh_reset_stats();
+         ui_need_update = true;
+         return kb_handler_ok_and_continue;
+
+      default:
+         return kb_handler_nak;
+   }
 }
 
 static struct dp_screen dp_irqs_screen =
@@ -88,7 +169,7 @@ static struct dp_screen dp_irqs_screen =
    .index = 4,
    .label = "IRQs",
    .draw_func = dp_show_irq_stats,
-   .on_keypress_func = NULL,
+   .on_keypress_func = dp_irqs_keypress,
 };
 
 __attribute__((constructor))
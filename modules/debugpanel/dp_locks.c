@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_kernel.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/lockstat.h>
+
+#include "termutil.h"
+#include "dp_int.h"
+
+static struct lockstat *locks_arr;
+static int locks_arr_size;
+static int locks_count;
+
+static void dp_locks_load_stats(void)
+{
+   const int count = lockstat_get_count();
+
+   if (count > locks_arr_size) {
+
+      if (locks_arr)
+         kfree_array_obj(locks_arr, struct lockstat, (size_t)locks_arr_size);
+
+      /* Leave some room for the locks registered later */
+      locks_arr_size = count + 16;
+      locks_arr = kalloc_array_obj(struct lockstat, (size_t)locks_arr_size);
+
+      if (!locks_arr)
+         panic("Unable to alloc memory for locks_arr");
+   }
+
+   locks_count = lockstat_snapshot(locks_arr, locks_arr_size);
+}
+
+static void dp_locks_enter(void)
+{
+   if (!KRN_LOCKSTAT)
+      return;
+
+   dp_locks_load_stats();
+}
+
+static int dp_locks_keypress(struct key_event ke)
+{
+   if (!KRN_LOCKSTAT)
+      return kb_handler_nak;
+
+   switch (ke.print_char) {
+
+      case 'r':
+         dp_locks_load_stats();
+         ui_need_update = true;
+         return kb_handler_ok_and_continue;
+
+      case 'z':
+         lockstat_reset();
+         dp_locks_load_stats();
+         ui_need_update = true;
+         return kb_handler_ok_and_continue;
+
+      default:
+         return kb_handler_nak;
+   }
+}
+
+static void dp_show_locks(void)
+{
+   int row = dp_screen_start_row;
+
+   if (!KRN_LOCKSTAT) {
+      dp_writeln("Not available: recompile with KRN_LOCKSTAT=1");
+      return;
+   }
+
+   dp_writeln("Tracked locks: %d, sorted by contentions and total wait",
+              locks_count);
+
+   dp_writeln(
+      E_COLOR_BR_WHITE "r" RESET_ATTRS "efresh, "
+      E_COLOR_BR_WHITE "z" RESET_ATTRS "ero counters"
+   );
+
+   dp_writeln("");
+
+   dp_writeln(
+                 " Lock         "
+      TERM_VLINE "  ID   "
+      TERM_VLINE " Type   "
+      TERM_VLINE "  Acquired  "
+      TERM_VLINE " Contended "
+      TERM_VLINE " Wait (Kc)  "
+      TERM_VLINE " Max (Kc) "
+      TERM_VLINE " Holder"
+   );
+
+   dp_writeln(
+      GFX_ON
+      "qqqqqqqqqqqqqqnqqqqqqqnqqqqqqqqnqqqqqqqqqqqqnqqqqqqqqqqqnqqqqqqqqqqqq"
+      "nqqqqqqqqqqnqqqqqqq"
+      GFX_OFF
+   );
+
+   for (int i = 0; i < locks_count; i++) {
+
+      const struct lockstat *ls = &locks_arr[i];
+      char id_buf[8] = "-";
+      char holder_buf[8] = "-";
+
+      if (ls->id >= 0)
+         snprintk(id_buf, sizeof(id_buf), "%ld", ls->id);
+
+      if (ls->holder_tid)
+         snprintk(holder_buf, sizeof(holder_buf), "%d", ls->holder_tid);
+
+      dp_writeln(" %-12.12s "
+                 TERM_VLINE " %5s "
+                 TERM_VLINE " %-6s "
+                 TERM_VLINE " %10u "
+                 TERM_VLINE " %9u "
+                 TERM_VLINE " %10llu "
+                 TERM_VLINE " %8llu "
+                 TERM_VLINE " %6s",
+                 ls->name,
+                 id_buf,
+                 lockstat_type_str(ls->type),
+                 ls->acquisitions,
+                 ls->contentions,
+                 ls->wait_tot / 1000,
+                 ls->wait_max / 1000,
+                 holder_buf);
+   }
+
+   dp_writeln("");
+}
+
+static struct dp_screen dp_locks_screen =
+{
+   .index = 7,
+   .label = "Locks",
+   .draw_func = dp_show_locks,
+   .on_dp_enter = dp_locks_enter,
+   .on_keypress_func = dp_locks_keypress,
+};
+
+__attribute__((constructor))
+static void dp_locks_init(void)
+{
+   dp_register_screen(&dp_locks_screen);
+}
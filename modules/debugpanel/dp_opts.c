@@ -15,6 +15,7 @@
 #include <tilck_gen_headers/mod_acpi.h>
 #include <tilck_gen_headers/mod_pci.h>
 #include <tilck_gen_headers/mod_sb16.h>
+#include <tilck_gen_headers/mod_ata.h>
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/string_util.h>
@@ -66,6 +67,7 @@ static void dp_show_opts(void)
    DUMP_BOOL_OPT(MOD_tracing);
    DUMP_BOOL_OPT(MOD_sysfs);
    DUMP_BOOL_OPT(MOD_sb16);
+   DUMP_BOOL_OPT(MOD_ata);
 
    DUMP_LABEL("Modules config");
    DUMP_INT_OPT(FBCON_BIGFONT_THR);
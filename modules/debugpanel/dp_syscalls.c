@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/config_kernel.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/sys_stats.h>
+#include <tilck/kernel/sort.h>
+
+#include "termutil.h"
+#include "dp_int.h"
+
+struct sys_info {
+
+   u32 sn;
+   u32 count;
+   u64 tot_cycles;
+   u64 max_cycles;
+   u8 p50;           /* log2 of the median latency, in cycles */
+   u8 p99;           /* log2 of the 99th percentile latency, in cycles */
+};
+
+static struct sys_info *sys_arr;
+static u32 sys_count;
+static u64 tot_calls;
+static char sys_order_by;
+
+static long dp_sys_cmpf_count(const void *a, const void *b)
+{
+   const struct sys_info *x = a;
+   const struct sys_info *y = b;
+   return (long)y->count - (long)x->count;
+}
+
+static long dp_sys_cmpf_tot(const void *a, const void *b)
+{
+   const struct sys_info *x = a;
+   const struct sys_info *y = b;
+   return y->tot_cycles > x->tot_cycles ? 1 : -1;
+}
+
+static long dp_sys_cmpf_avg(const void *a, const void *b)
+{
+   const struct sys_info *x = a;
+   const struct sys_info *y = b;
+   return y->tot_cycles / y->count > x->tot_cycles / x->count ? 1 : -1;
+}
+
+static long dp_sys_cmpf_max(const void *a, const void *b)
+{
+   const struct sys_info *x = a;
+   const struct sys_info *y = b;
+   return y->max_cycles > x->max_cycles ? 1 : -1;
+}
+
+static u8 hist_percentile(const struct sys_stats *s, u32 p)
+{
+   const u64 target = ((u64)s->count * p + 99) / 100;
+   u64 sum = 0;
+
+   for (int i = 0; i < SYS_STATS_HIST_BUCKETS; i++) {
+
+      sum += s->hist[i];
+
+      if (sum >= target)
+         return (u8)i;
+   }
+
+   return SYS_STATS_HIST_BUCKETS - 1;
+}
+
+static void dp_sys_sort(void)
+{
+   long (*cmpf)(const void *, const void *);
+
+   switch (sys_order_by) {
+      case 'c': cmpf = dp_sys_cmpf_count; break;
+      case 'a': cmpf = dp_sys_cmpf_avg;   break;
+      case 'm': cmpf = dp_sys_cmpf_max;   break;
+      default:  cmpf = dp_sys_cmpf_tot;   break;
+   }
+
+   insertion_sort_generic(sys_arr, sizeof(sys_arr[0]), sys_count, cmpf);
+}
+
+static void dp_sys_load_stats(void)
+{
+   struct sys_stats s;
+
+   sys_count = 0;
+   tot_calls = 0;
+
+   for (u32 i = 0; i < MAX_SYSCALLS; i++) {
+
+      disable_preemption();
+      {
+         s = sys_stats[i];
+      }
+      enable_preemption();
+
+      if (!s.count)
+         continue;
+
+      sys_arr[sys_count++] = (struct sys_info) {
+         .sn = i,
+         .count = s.count,
+         .tot_cycles = s.tot_cycles,
+         .max_cycles = s.max_cycles,
+         .p50 = hist_percentile(&s, 50),
+         .p99 = hist_percentile(&s, 99),
+      };
+
+      tot_calls += s.count;
+   }
+
+   dp_sys_sort();
+}
+
+static void dp_sys_enter(void)
+{
+   if (!sys_stats)
+      return;
+
+   if (!sys_arr) {
+
+      if (!(sys_arr = kzalloc_array_obj(struct sys_info, MAX_SYSCALLS)))
+         panic("Unable to alloc memory for sys_arr");
+
+      sys_order_by = 't';
+   }
+
+   dp_sys_load_stats();
+}
+
+static int dp_sys_keypress(struct key_event ke)
+{
+   const char c = ke.print_char;
+
+   if (!sys_stats)
+      return kb_handler_nak;
+
+   switch (c) {
+
+      case 'c':
+      case 't':
+      case 'a':
+      case 'm':
+         sys_order_by = c;
+         dp_sys_sort();
+         ui_need_update = true;
+         return kb_handler_ok_and_continue;
+
+      case 'r':
+         dp_sys_load_stats();
+         ui_need_update = true;
+         return kb_handler_ok_and_continue;
+
+      case 'z':
+         sys_stats_reset();
+         dp_sys_load_stats();
+         ui_need_update = true;
+         return kb_handler_ok_and_continue;
+
+      default:
+         return kb_handler_nak;
+   }
+}
+
+static void dp_show_syscalls(void)
+{
+   int row = dp_screen_start_row;
+
+   if (!sys_stats) {
+      dp_writeln("Not available: recompile with KRN_SYS_STATS=1");
+      return;
+   }
+
+   dp_writeln("Syscalls called: %u, total calls: %llu, pid filter: %ld",
+              sys_count, tot_calls, sys_stats_pid_filter);
+
+   dp_writeln(
+      "Order by: "
+      E_COLOR_BR_WHITE "c" RESET_ATTRS "alls, "
+      E_COLOR_BR_WHITE "t" RESET_ATTRS "otal, "
+      E_COLOR_BR_WHITE "a" RESET_ATTRS "vg, "
+      E_COLOR_BR_WHITE "m" RESET_ATTRS "ax. "
+      E_COLOR_BR_WHITE "r" RESET_ATTRS "efresh, "
+      E_COLOR_BR_WHITE "z" RESET_ATTRS "ero counters"
+   );
+
+   dp_writeln("p50, p99: log2 of the latency percentiles, in cycles");
+
+   dp_writeln("");
+
+   dp_writeln(
+                 " Syscall        "                RESET_ATTRS
+      TERM_VLINE "%s" "  Calls   "                 RESET_ATTRS
+      TERM_VLINE "%s" " Total (Kc) "               RESET_ATTRS
+      TERM_VLINE "%s" " Avg (cyc) "                RESET_ATTRS
+      TERM_VLINE "%s" " Max (cyc)  "               RESET_ATTRS
+      TERM_VLINE " p50 p99",
+      sys_order_by == 'c' ? E_COLOR_BR_WHITE REVERSE_VIDEO : "",
+      sys_order_by == 't' ? E_COLOR_BR_WHITE REVERSE_VIDEO : "",
+      sys_order_by == 'a' ? E_COLOR_BR_WHITE REVERSE_VIDEO : "",
+      sys_order_by == 'm' ? E_COLOR_BR_WHITE REVERSE_VIDEO : ""
+   );
+
+   dp_writeln(
+      GFX_ON
+      "qqqqqqqqqqqqqqqqnqqqqqqqqqqnqqqqqqqqqqqqnqqqqqqqqqqqnqqqqqqqqqqqq"
+      "nqqqqqqqq"
+      GFX_OFF
+   );
+
+   for (u32 i = 0; i < sys_count; i++) {
+
+      const struct sys_info *si = &sys_arr[i];
+      const char *name = sys_stats_get_name(si->sn);
+      char num_buf[16];
+
+      if (!name) {
+         snprintk(num_buf, sizeof(num_buf), "#%u", si->sn);
+         name = num_buf;
+      }
+
+      dp_writeln(" %-14.14s "
+                 TERM_VLINE " %8u "
+                 TERM_VLINE " %10llu "
+                 TERM_VLINE " %9llu "
+                 TERM_VLINE " %10llu "
+                 TERM_VLINE "  %2u  %2u",
+                 name,
+                 si->count,
+                 si->tot_cycles / 1000,
+                 si->tot_cycles / si->count,
+                 si->max_cycles,
+                 si->p50,
+                 si->p99);
+   }
+
+   dp_writeln("");
+}
+
+static struct dp_screen dp_syscalls_screen =
+{
+   .index = 6,
+   .label = "Syscalls",
+   .draw_func = dp_show_syscalls,
+   .on_dp_enter = dp_sys_enter,
+   .on_keypress_func = dp_sys_keypress,
+};
+
+__attribute__((constructor))
+static void dp_syscalls_init(void)
+{
+   dp_register_screen(&dp_syscalls_screen);
+}
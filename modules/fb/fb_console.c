@@ -198,6 +198,10 @@ static void fb_set_row_optimized(u16 row, u16 *data, bool fpu_allowed)
                          fb_term_cols,
                          fpu_allowed);
 
+   /* Like in fb_set_char_at_optimized(): the cursor has been overwritten */
+   if (row == cursor_row)
+      fb_save_under_cursor_buf();
+
    fb_reset_blink_timer();
 }
 
@@ -7,6 +7,13 @@ extern u32 font_h;
 extern u32 vga_rgb_colors[16];
 extern bool __use_framebuffer;
 
+/* Variants of the 8-pixel scanline kernels, for the perf self-tests */
+enum fb_glyph_variant {
+   FB_GLYPH_TABLE,         /* copy of the pre-rendered scanlines */
+   FB_GLYPH_SSE2,          /* expansion in the SIMD registers, with SSE2 */
+   FB_GLYPH_AVX2,          /* expansion in the SIMD registers, with AVX2 */
+};
+
 u32 fb_get_width(void);
 u32 fb_get_height(void);
 u32 fb_get_bpp(void);
@@ -23,6 +30,7 @@ void fb_lines_shift_up(u32 src_y, u32 dst_y, u32 lines_count);
 bool fb_pre_render_char_scanlines(void);
 bool fb_alloc_shadow_buffer(void);
 void fb_raw_perf_screen_redraw(u32 color, bool use_fpu);
+void fb_raw_perf_glyphs_redraw(enum fb_glyph_variant v);
 void fb_set_font(void *font);
 void fb_draw_banner(void);
 
@@ -24,6 +24,7 @@
 #include <tilck/kernel/system_mmap.h>
 #include <tilck/kernel/system_mmap_int.h>
 #include <tilck/kernel/errno.h>
+#include <tilck/kernel/interrupts.h>
 
 #include "fb_int.h"
 
@@ -186,11 +187,37 @@ void set_framebuffer_info_from_mbi(multiboot_info_t *mbi)
    });
 }
 
+/*
+ * The SIMD kernels need a FPU context, which we cannot have in IRQ context or
+ * in panic, and 32-byte aligned scanlines.
+ */
+static ALWAYS_INLINE bool fb_can_use_simd_kernels(void)
+{
+   return fpu_glyph_kernels &&
+          !(fb_vaddr % 32) &&
+          !(fb_pitch % 32) &&
+          !in_irq() &&
+          !in_panic();
+}
+
 void fb_lines_shift_up(u32 src_y, u32 dst_y, u32 lines_count)
 {
-   memcpy32((void *)(fb_vaddr + fb_pitch * dst_y),
-            (void *)(fb_vaddr + fb_pitch * src_y),
-            (fb_pitch * lines_count) >> 2);
+   void *dest = (void *)(fb_vaddr + fb_pitch * dst_y);
+   void *src = (void *)(fb_vaddr + fb_pitch * src_y);
+   const u32 len = fb_pitch * lines_count;
+
+   if (fb_can_use_simd_kernels() && !(len % 32)) {
+
+      /* Reading from the framebuffer is slow: use non-temporal loads */
+      fpu_context_begin();
+      {
+         fpu_memcpy256_nt_read(dest, src, len >> 5);
+      }
+      fpu_context_end();
+      return;
+   }
+
+   memcpy32(dest, src, len >> 2);
 }
 
 u32 fb_get_width(void)
@@ -254,7 +281,20 @@ void fb_raw_color_lines(u32 iy, u32 h, u32 color)
 
       if (LIKELY(fb_pitch == fb_line_length)) {
 
-         memset32((void *)v, color, (fb_pitch * h) >> 2);
+         const u32 len = fb_pitch * h;
+
+         if (fb_can_use_simd_kernels() && !(len % 32)) {
+
+            fpu_context_begin();
+            {
+               fpu_memset256((void *)v, color, len >> 5);
+            }
+            fpu_context_end();
+
+         } else {
+
+            memset32((void *)v, color, len >> 2);
+         }
 
       } else {
 
@@ -450,6 +490,22 @@ void fb_draw_char_failsafe(u32 x, u32 y, u16 e)
 
 #define TOT_CHAR_SCANLINES_SIZE (PSZ*SL_COUNT*FG_COLORS*BG_COLORS*SL_SIZE)
 
+/*
+ * State of the glyph kernels: the masks never change, while the colors are
+ * updated (and re-loaded in the SIMD registers) only when they change between
+ * two consecutive glyphs. Used only in FPU context, therefore with preemption
+ * disabled and never in IRQ context.
+ */
+static struct fpu_glyph_colors fb_glyph_colors = {
+   .masks = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 },
+};
+
+static ALWAYS_INLINE void fb_set_glyph_colors(u16 e)
+{
+   memset32(fb_glyph_colors.fg, vga_rgb_colors[vgaentry_get_fg(e)], SL_SIZE);
+   memset32(fb_glyph_colors.bg, vga_rgb_colors[vgaentry_get_bg(e)], SL_SIZE);
+}
+
 bool fb_pre_render_char_scanlines(void)
 {
    fb_w8_char_scanlines = kmalloc(TOT_CHAR_SCANLINES_SIZE);
@@ -522,18 +578,27 @@ void fb_draw_char_optimized(u32 x, u32 y, u16 e)
       return;
 }
 
+/*
+ * Draw a whole row of glyphs. When `fpu` is true, we're in a FPU context and
+ * we can either copy the pre-rendered scanlines with SIMD instructions or,
+ * when the glyph kernels are available, expand the font's scanlines directly
+ * in the SIMD registers, without touching the 512 KB of pre-rendered ones.
+ */
 void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
 {
    static const void *ops[] = {
-      &&width_1_nofpu, &&width_1_fpu, &&width_2_nofpu, &&width_2_fpu
+      &&width_1_nofpu, &&width_1_fpu, &&width_1_simd,
+      &&width_2_nofpu, &&width_2_fpu, &&width_2_simd,
    };
 
    const u32 bpg_shift = 4 + (font_bytes_per_glyph == 64) * 2; // 4 or 6
    const u32 w4_shift  = 5 + (font_w == 16);                   // 5 or 6
-   const void *const op = ops[(font_w == 16) * 2 + fpu];       // ops[0..3]
+   const u32 mode      = fpu ? 1 + !!fpu_glyph_kernels : 0;    // 0, 1 or 2
+   const void *const op = ops[(font_w == 16) * 3 + mode];      // ops[0..5]
 
    /* -------------- Regular variables --------------- */
    const ulong vaddr_base = fb_vaddr + (fb_pitch * y);
+   int loaded_color = -1;
 
    ASSUME_WITHOUT_CHECK(font_w == 8 || font_w == 16);
    ASSUME_WITHOUT_CHECK(font_h == 16 || font_h == 32);
@@ -550,6 +615,19 @@ void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
       u32 *scanlines = &fb_w8_char_scanlines[c_off];
       goto *op;
 
+      width_1_simd:
+
+         if (vgaentry_get_color(e) != loaded_color) {
+            loaded_color = vgaentry_get_color(e);
+            fb_set_glyph_colors(e);
+            fpu_glyph_load_colors(&fb_glyph_colors);
+         }
+
+         for (u32 r = 0; r < font_h; r++, d++, vaddr += fb_pitch)
+            fpu_glyph_expand_8px_nt(vaddr, d[0]);
+
+         continue;
+
       width_1_fpu:
 
          for (u32 r = 0; r < font_h; r++, d++, vaddr += fb_pitch)
@@ -564,6 +642,21 @@ void fb_draw_row_optimized(u32 y, u16 *entries, u32 count, bool fpu)
 
          continue;
 
+      width_2_simd:
+
+         if (vgaentry_get_color(e) != loaded_color) {
+            loaded_color = vgaentry_get_color(e);
+            fb_set_glyph_colors(e);
+            fpu_glyph_load_colors(&fb_glyph_colors);
+         }
+
+         for (u32 r = 0; r < font_h; r++, d+=2, vaddr += fb_pitch) {
+            fpu_glyph_expand_8px_nt(vaddr,      d[0]);
+            fpu_glyph_expand_8px_nt(vaddr + 32, d[1]);
+         }
+
+         continue;
+
       width_2_fpu:
 
          for (u32 r = 0; r < font_h; r++, d+=2, vaddr += fb_pitch) {
@@ -630,4 +723,47 @@ void fb_raw_perf_screen_redraw(u32 color, bool use_fpu)
    else
       memset32((void *)fb_vaddr, color, (fb_pitch * fb_height) >> 2);
 }
+
+/*
+ * Fill the whole screen with 8-pixel glyph scanlines (white on black), using
+ * the given variant of the scanline kernel. Must be called in FPU context.
+ */
+void fb_raw_perf_glyphs_redraw(enum fb_glyph_variant v)
+{
+   const u32 *scanlines = &fb_w8_char_scanlines[COLOR_WHITE << 15];
+
+   VERIFY(fb_bpp == 32);
+   VERIFY(!(fb_vaddr % 32) && !(fb_pitch % 32));
+
+   fb_set_glyph_colors(make_vgaentry(0, make_color(COLOR_WHITE, COLOR_BLACK)));
+
+   if (v == FB_GLYPH_SSE2)
+      fpu_glyph_load_colors_sse2(&fb_glyph_colors);
+   else if (v == FB_GLYPH_AVX2)
+      fpu_glyph_load_colors_avx2(&fb_glyph_colors);
+   else
+      VERIFY(fb_w8_char_scanlines != NULL);
+
+   for (u32 y = 0; y < fb_height; y++) {
+
+      void *vaddr = (void *)(fb_vaddr + fb_pitch * y);
+
+      for (u32 x = 0; x < fb_width / SL_SIZE; x++, vaddr += 32) {
+
+         const u8 sl = (u8)(x + y);
+
+         switch (v) {
+            case FB_GLYPH_TABLE:
+               fpu_cpy_single_256_nt(vaddr, &scanlines[sl << 3]);
+               break;
+            case FB_GLYPH_SSE2:
+               fpu_glyph_expand_8px_nt_sse2(vaddr, sl);
+               break;
+            case FB_GLYPH_AVX2:
+               fpu_glyph_expand_8px_nt_avx2(vaddr, sl);
+               break;
+         }
+      }
+   }
+}
 #endif
@@ -140,18 +140,18 @@ register_mapping:
 
 static int fbdev_munmap(struct user_mapping *um, void *vaddr, size_t len)
 {
-   struct fs_handle_base *hb = um->h;
+   struct process *pi = um->pi;
    size_t unmapped_count;
    bool dying_task = false;
 
    ASSERT(IS_PAGE_ALIGNED(len));
-   ASSERT(hb->pi == get_curr_proc());
+   ASSERT(pi == get_curr_proc());
 
-   if (get_process_task(hb->pi)->state == TASK_STATE_ZOMBIE)
+   if (get_process_task(pi)->state == TASK_STATE_ZOMBIE)
       dying_task = true;
 
    unmapped_count = unmap_pages_permissive(
-      hb->pi->pdir,
+      pi->pdir,
       vaddr,
       len >> PAGE_SHIFT,
       false
@@ -173,7 +173,7 @@ static int fbdev_munmap(struct user_mapping *um, void *vaddr, size_t len)
     * shortcuts to reboot the machine or connect to it remotely to do that.
     */
    if (total_fb_pages_mapped == 0 && dying_task) {
-      tty_restore_kd_text_mode(hb->pi->proc_tty);
+      tty_restore_kd_text_mode(pi->proc_tty);
    }
 
    return 0;
@@ -11,6 +11,9 @@
 #include <tilck/mods/fb_console.h>
 #include <tilck/kernel/self_tests.h>
 #include <tilck/kernel/hal.h>
+#include <tilck/kernel/term.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/datetime.h>
 
 #include "fb_int.h"
 
@@ -58,7 +61,134 @@ void selftest_fbperf_fpu(void)
    internal_selftest_fb_perf(true);
 }
 
+static u64 fb_perf_glyphs_cycles(enum fb_glyph_variant v)
+{
+   const int iters = 30;
+   u64 start, duration;
+
+   fpu_context_begin();
+   {
+      start = RDTSC();
+
+      for (int i = 0; i < iters; i++)
+         fb_raw_perf_glyphs_redraw(v);
+
+      duration = RDTSC() - start;
+   }
+   fpu_context_end();
+   return duration / iters;
+}
+
+/*
+ * Compare the variants of the kernel drawing the 8-pixel scanlines of the
+ * glyphs: the copy of the pre-rendered scanlines and their expansion on the
+ * fly in the SIMD registers.
+ */
+void selftest_fbperf_glyphs(void)
+{
+   static const char *names[] = {
+      [FB_GLYPH_TABLE] = "table",
+      [FB_GLYPH_SSE2] = "sse2",
+      [FB_GLYPH_AVX2] = "avx2",
+   };
+
+   const bool supported[] = {
+      [FB_GLYPH_TABLE] = fb_is_using_opt_funcs(),
+      [FB_GLYPH_SSE2] = x86_cpu_features.can_use_sse2,
+      [FB_GLYPH_AVX2] = x86_cpu_features.can_use_avx2,
+   };
+
+   const u32 pixels = fb_get_width() * fb_get_height();
+
+   if (!use_framebuffer())
+      panic("Unable to test framebuffer's performance: we're in text-mode");
+
+   printk("fb size (pixels): %u\n", pixels);
+
+   for (u32 v = 0; v < ARRAY_SIZE(names); v++) {
+
+      u64 cycles;
+
+      if (!supported[v]) {
+         printk("%-5s: not supported\n", names[v]);
+         continue;
+      }
+
+      cycles = fb_perf_glyphs_cycles((enum fb_glyph_variant)v);
+
+      printk("%-5s: cycles per redraw: %" PRIu64 ", per 32 pixels: %" PRIu64
+             "\n", names[v], cycles, 32 * cycles / pixels);
+   }
+
+   printk("glyph kernels in use: %s\n",
+          fpu_glyph_kernels ? fpu_glyph_kernels : "none");
+
+   fb_draw_banner();
+}
+
+/*
+ * Measure the throughput of the whole video term + fb console stack, in
+ * chars/sec, writing `tot_lines` lines of text in chunks of `lines_per_write`
+ * lines. That's what matters for heavy output like build logs: small writes
+ * stress the per-write overhead, while big ones show the benefit of batching
+ * the rendering and the scrolling.
+ */
+static u64
+fb_term_perf_chars_per_sec(char *buf, u32 lines_per_write, u32 tot_lines)
+{
+   const u32 line_len = fb_get_width() / font_w;    /* including '\n' */
+   const u32 write_len = line_len * lines_per_write;
+   u64 start, duration;
+
+   for (u32 i = 0; i < write_len; i++)
+      buf[i] = (i % line_len == line_len - 1) ? '\n' : (char)('a' + i % 26);
+
+   start = get_sys_time();
+
+   for (u32 i = 0; i < tot_lines; i += lines_per_write)
+      term_write(buf, write_len, DEFAULT_COLOR16);
+
+   duration = get_sys_time() - start;
+   return (u64)tot_lines * line_len * TS_SCALE / MAX(duration, 1ull);
+}
+
+void selftest_fbperf_term(void)
+{
+   static const u32 lines_per_write[] = { 1, 8, 64 };
+   const u32 tot_lines = 1024;
+   u64 results[ARRAY_SIZE(lines_per_write)];
+   u32 max_lines_per_write = 0;
+   char *buf;
+
+   if (!use_framebuffer())
+      panic("Unable to test framebuffer's performance: we're in text-mode");
+
+   for (u32 i = 0; i < ARRAY_SIZE(lines_per_write); i++)
+      max_lines_per_write = MAX(max_lines_per_write, lines_per_write[i]);
+
+   buf = kmalloc(max_lines_per_write * (fb_get_width() / font_w));
+
+   if (!buf)
+      panic("Unable to allocate the buffer for the fb term perf test");
+
+   for (u32 i = 0; i < ARRAY_SIZE(lines_per_write); i++) {
+      results[i] =
+         fb_term_perf_chars_per_sec(buf, lines_per_write[i], tot_lines);
+   }
+
+   kfree2(buf, max_lines_per_write * (fb_get_width() / font_w));
+
+   for (u32 i = 0; i < ARRAY_SIZE(lines_per_write); i++) {
+      printk("lines per write: %3u -> chars/sec: %" PRIu64 "\n",
+             lines_per_write[i], results[i]);
+   }
+
+   printk("use_opt_funcs: %d\n", fb_is_using_opt_funcs());
+}
+
 REGISTER_SELF_TEST(fbperf_nofpu, se_manual, &selftest_fbperf_nofpu)
 REGISTER_SELF_TEST(fbperf_fpu, se_manual, &selftest_fbperf_fpu)
+REGISTER_SELF_TEST(fbperf_term, se_manual, &selftest_fbperf_term)
+REGISTER_SELF_TEST(fbperf_glyphs, se_manual, &selftest_fbperf_glyphs)
 
 #endif // #if KERNEL_SELFTESTS
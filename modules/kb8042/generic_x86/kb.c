@@ -6,7 +6,7 @@
 #include <tilck/common/printk.h>
 
 #include <tilck/kernel/modules.h>
-#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/irq_bh.h>
 #include <tilck/kernel/list.h>
 #include <tilck/kernel/kb.h>
 #include <tilck/kernel/errno.h>
@@ -30,7 +30,7 @@ enum kb_state {
    KB_READ_FIRST_SCANCODE_AFTER_E1_STATE,
 };
 
-static struct worker_thread *kb_worker_thread;
+static struct irq_bh kb_bh;
 static enum kb_state kb_curr_state;
 static bool key_pressed_state[2][128];
 static bool numLock;
@@ -292,29 +292,18 @@ static enum irq_action keyboard_irq_handler(void *ctx)
       ulong val;
       disable_interrupts(&val);
       {
-         kb_irq_bottom_half(NULL);
+         irq_bh_run_now(&kb_bh);
       }
       enable_interrupts(&val);
       return IRQ_HANDLED;
    }
 
-   /* Everything is fine: we read at least one scancode */
-   if (!wth_enqueue_on(kb_worker_thread, &kb_irq_bottom_half, NULL)) {
-
-      /*
-       * While on real hardware this should NEVER happen, on some slow emulators
-       * that's totally possible. For example, on this pure browser emulator:
-       * https://copy.sh/v86/
-       *
-       * If we scroll fast up and down immediately after boot while the
-       * fb_pre_render_char_scanlines() function has not completed yet,
-       * the scroll will be so slow that sometimes the queue of tasks for this
-       * bottom half will fill up.
-       */
-
-      printk("WARNING: KB: unable to enqueue job\n");
-   }
-
+   /*
+    * Everything is fine: we read at least one scancode. If the bottom half is
+    * already pending, it will process also the new scancodes. In the unlikely
+    * case of an overflow, the scancodes stay in the ring until the next IRQ.
+    */
+   irq_bh_schedule(&kb_bh);
    return IRQ_HANDLED;
 }
 
@@ -328,20 +317,25 @@ static u8 kb_translate_to_mediumraw(struct key_event ke)
    return mediumraw_e0_keys[key & 0xff] | (u8)(!ke.pressed << 7);
 }
 
-static void create_kb_worker_thread(void)
+static void create_kb_bottom_half(void)
 {
    u8 *kb_input_buf = kmalloc(512);
+   int rc;
 
    if (!kb_input_buf)
       panic("KB: unable to alloc kb_input_buf");
 
    safe_ringbuf_init(&kb_input_rb, 512, 1, kb_input_buf);
 
-   kb_worker_thread =
-      wth_create_thread("kb", 1 /* priority */, WTH_KB_QUEUE_SIZE);
+   rc = irq_bh_init(&kb_bh,
+                    "kb",
+                    X86_PC_KEYBOARD_IRQ,
+                    1, /* priority */
+                    &kb_irq_bottom_half,
+                    NULL);
 
-   if (!kb_worker_thread)
-      panic("KB: Unable to create a worker thread for IRQs");
+   if (rc)
+      panic("KB: Unable to create the IRQ bottom half");
 }
 
 static struct kb_dev ps2_keyboard = {
@@ -466,7 +460,7 @@ init_kb_internal(void)
    kb_led_update();
    kb_set_typematic_byte(0);
 
-   create_kb_worker_thread();
+   create_kb_bottom_half();
    irq_install_handler(X86_PC_KEYBOARD_IRQ, &keyboard);
    register_keyboard_device(&ps2_keyboard);
 }
@@ -489,6 +483,7 @@ static struct module kb_ps2_module = {
    .name = "kb8042",
    .priority = MOD_kb_prio,
    .init = &init_kb,
+   .deps = MOD_DEPS("acpi"),   /* for get_acpi_init_status(), when built-in */
 };
 
 REGISTER_MODULE(&kb_ps2_module);
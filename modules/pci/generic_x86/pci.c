@@ -35,8 +35,13 @@
 #define PCI_CONFIG_DATA                 0xcfc
 
 #define PCI_DEV_BASE_INFO                0x00
+#define PCI_STATUS_OFF                   0x06
 #define PCI_CLASS_INFO_OFF               0x08
 #define PCI_HDR_TYPE_OFF                 0x0e
+#define PCI_CAP_PTR_OFF                  0x34
+
+#define PCI_STATUS_CAP_LIST          (1 << 4)
+#define PCI_MAX_CAPS                       48
 
 #define PCI_HDR1_SECOND_BUS              0x19
 #define PCI_HDR1_SUBORD_BUS              0x1a
@@ -267,6 +272,49 @@ pci_get_object(struct pci_device_loc loc)
    return NULL;
 }
 
+struct pci_device *
+pci_find_device(u16 vendor_id, u16 device_id)
+{
+   struct pci_device *pos;
+
+   list_for_each_ro(pos, &pci_device_list, node) {
+      if (pos->nfo.vendor_id == vendor_id && pos->nfo.device_id == device_id)
+         return pos;
+   }
+
+   return NULL;
+}
+
+/* Get the physical address of the memory BAR number `bar` (0-5) */
+int
+pci_get_mem_bar(struct pci_device_loc loc, u32 bar, u64 *paddr)
+{
+   const u32 off = PCI_BAR0_OFF + 4 * bar;
+   u32 lo, hi = 0;
+   int rc;
+
+   if (bar > 5)
+      return -EINVAL;
+
+   if ((rc = pci_config_read(loc, off, 32, &lo)))
+      return rc;
+
+   if (lo & PCI_BAR_IO)
+      return -EINVAL;
+
+   if ((lo & PCI_BAR_TYPE_MASK) == PCI_BAR_TYPE_64BIT) {
+
+      if (bar == 5)
+         return -EINVAL;
+
+      if ((rc = pci_config_read(loc, off + 4, 32, &hi)))
+         return rc;
+   }
+
+   *paddr = ((u64)hi << 32) | (lo & PCI_BAR_MEM_ADDR_MASK);
+   return 0;
+}
+
 static ulong
 discovery_pcie_get_conf_vaddr(struct pci_device_loc loc)
 {
@@ -379,6 +427,41 @@ int pci_device_get_info(struct pci_device_loc loc,
    return 0;
 }
 
+/*
+ * Walk the capabilities list of the device looking for `cap_id`. Return the
+ * offset of the capability in the config space or 0, if not found.
+ */
+u8
+pci_find_cap(struct pci_device_loc loc, u8 cap_id)
+{
+   u32 status, ptr, hdr;
+
+   if (pci_config_read(loc, PCI_STATUS_OFF, 16, &status))
+      return 0;
+
+   if (!(status & PCI_STATUS_CAP_LIST))
+      return 0;
+
+   if (pci_config_read(loc, PCI_CAP_PTR_OFF, 8, &ptr))
+      return 0;
+
+   /* Limit the iterations, in case of a (broken) circular list */
+   for (int i = 0; i < PCI_MAX_CAPS && ptr >= 0x40; i++) {
+
+      ptr &= ~3u;
+
+      if (pci_config_read(loc, ptr, 16, &hdr))
+         return 0;
+
+      if ((hdr & 0xff) == cap_id)
+         return (u8)ptr;
+
+      ptr = hdr >> 8;
+   }
+
+   return 0;
+}
+
 /*
  * Initialize the support for the Enhanced Configuration Access Mechanism,
  * used by PCI Express.
@@ -535,6 +618,8 @@ pci_discover_leaf_node(struct pci_device_loc loc,
    list_node_init(&dev->node);
    dev->loc = loc;
    dev->nfo = *nfo;
+   dev->msi_cap = pci_find_cap(loc, PCI_CAP_ID_MSI);
+   dev->msix_cap = pci_find_cap(loc, PCI_CAP_ID_MSIX);
 
    list_add_tail(&pci_device_list, &dev->node);
 
@@ -854,6 +939,8 @@ static struct module pci_module = {
    .name = "pci",
    .priority = MOD_pci_prio,
    .init = &init_pci,
+   .deps = MOD_DEPS("sysfs"),
+   .async = true,
 };
 
 REGISTER_MODULE(&pci_module);
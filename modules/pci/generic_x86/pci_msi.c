@@ -0,0 +1,296 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/irq.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+
+#include <tilck/mods/pci.h>
+
+/*
+ * MSI and MSI-X support.
+ *
+ * A device using message signaled interrupts gets a dedicated vector, instead
+ * of sharing a legacy PIC line (and its handlers list) with other devices. The
+ * message is just a memory write to the LAPIC address range, carrying the
+ * vector in its data. For the moment, we use a single vector per device:
+ * multi-message MSI and the other entries of the MSI-X table are left off.
+ */
+
+/* MSI capability: registers (offsets from the cap) and control flags */
+#define PCI_MSI_CTL                         2
+#define PCI_MSI_ADDR_LO                     4
+#define PCI_MSI_ADDR_HI                     8
+#define PCI_MSI_DATA_32                     8
+#define PCI_MSI_DATA_64                    12
+#define PCI_MSI_MASK_32                    12
+#define PCI_MSI_MASK_64                    16
+
+#define PCI_MSI_CTL_ENABLE           (1 << 0)
+#define PCI_MSI_CTL_MME_MASK         (7 << 4)
+#define PCI_MSI_CTL_64BIT            (1 << 7)
+#define PCI_MSI_CTL_PER_VEC_MASK     (1 << 8)
+
+/* MSI-X capability: registers (offsets from the cap) and control flags */
+#define PCI_MSIX_CTL                        2
+#define PCI_MSIX_TABLE                      4
+
+#define PCI_MSIX_CTL_FUNC_MASK      (1 << 14)
+#define PCI_MSIX_CTL_ENABLE         (1 << 15)
+#define PCI_MSIX_TABLE_BIR_MASK             7
+
+/* Fields of an MSI-X table entry (16 bytes), as u32 indexes */
+#define PCI_MSIX_ENTRY_ADDR_LO              0
+#define PCI_MSIX_ENTRY_ADDR_HI              1
+#define PCI_MSIX_ENTRY_DATA                 2
+#define PCI_MSIX_ENTRY_VEC_CTL              3
+#define PCI_MSIX_ENTRY_SIZE                16
+
+#define PCI_MSIX_VEC_CTL_MASKED      (1 << 0)
+
+/* Messages target the LAPIC of the current CPU (the BSP), physical mode */
+#define PCI_MSI_ADDR_BASE          0xfee00000
+
+static inline u32 pci_msi_addr(void)
+{
+   return PCI_MSI_ADDR_BASE | (lapic_get_id() << 12);
+}
+
+static int
+pci_set_intx_disabled(struct pci_device *dev, bool disabled)
+{
+   u32 cmd;
+   int rc;
+
+   if ((rc = pci_config_read(dev->loc, PCI_COMMAND_OFF, 16, &cmd)))
+      return rc;
+
+   if (disabled)
+      cmd |= PCI_COMMAND_INTX_DISABLE;
+   else
+      cmd &= ~PCI_COMMAND_INTX_DISABLE;
+
+   return pci_config_write(dev->loc, PCI_COMMAND_OFF, 16, cmd);
+}
+
+static int
+pci_msi_setup(struct pci_device *dev, int vec)
+{
+   const struct pci_device_loc loc = dev->loc;
+   const u32 cap = dev->msi_cap;
+   u32 ctl, data_off, mask_off;
+   int rc;
+
+   if ((rc = pci_config_read(loc, cap + PCI_MSI_CTL, 16, &ctl)))
+      return rc;
+
+   if (ctl & PCI_MSI_CTL_64BIT) {
+
+      data_off = cap + PCI_MSI_DATA_64;
+      mask_off = cap + PCI_MSI_MASK_64;
+
+      if ((rc = pci_config_write(loc, cap + PCI_MSI_ADDR_HI, 32, 0)))
+         return rc;
+
+   } else {
+
+      data_off = cap + PCI_MSI_DATA_32;
+      mask_off = cap + PCI_MSI_MASK_32;
+   }
+
+   if ((rc = pci_config_write(loc, cap + PCI_MSI_ADDR_LO, 32, pci_msi_addr())))
+      return rc;
+
+   /* Fixed delivery mode, edge triggered */
+   if ((rc = pci_config_write(loc, data_off, 16, (u32)vec)))
+      return rc;
+
+   if (ctl & PCI_MSI_CTL_PER_VEC_MASK)
+      if ((rc = pci_config_write(loc, mask_off, 32, 0)))
+         return rc;
+
+   /* Request a single message (MME = 0) and enable MSI */
+   ctl &= ~PCI_MSI_CTL_MME_MASK;
+   ctl |= PCI_MSI_CTL_ENABLE;
+   return pci_config_write(loc, cap + PCI_MSI_CTL, 16, ctl);
+}
+
+static int
+pci_msix_map_entry(struct pci_device *dev)
+{
+   const struct pci_device_loc loc = dev->loc;
+   u32 table;
+   u64 paddr64;
+   ulong paddr;
+   void *va;
+   int rc;
+
+   if ((rc = pci_config_read(loc, dev->msix_cap + PCI_MSIX_TABLE, 32, &table)))
+      return rc;
+
+   rc = pci_get_mem_bar(loc, table & PCI_MSIX_TABLE_BIR_MASK, &paddr64);
+
+   if (rc)
+      return rc;
+
+   paddr64 += table & ~PCI_MSIX_TABLE_BIR_MASK;
+
+   if (NBITS == 32 && paddr64 > (0xffffffff - PAGE_SIZE))
+      return -E2BIG;
+
+   paddr = (ulong)paddr64;
+
+   if ((paddr & OFFSET_IN_PAGE_MASK) + PCI_MSIX_ENTRY_SIZE > PAGE_SIZE)
+      return -EINVAL;
+
+   if (!(va = hi_vmem_reserve(PAGE_SIZE)))
+      return -ENOMEM;
+
+   rc = map_kernel_page(va, paddr & PAGE_MASK, PAGING_FL_RW|PAGING_FL_SHARED);
+
+   if (rc) {
+      hi_vmem_release(va, PAGE_SIZE);
+      return rc;
+   }
+
+   dev->msix_entry = (void *)((ulong)va + (paddr & OFFSET_IN_PAGE_MASK));
+   return 0;
+}
+
+static void
+pci_msix_unmap_entry(struct pci_device *dev)
+{
+   void *va = (void *)((ulong)dev->msix_entry & PAGE_MASK);
+
+   unmap_kernel_page(va, false);
+   hi_vmem_release(va, PAGE_SIZE);
+   dev->msix_entry = NULL;
+}
+
+static int
+pci_msix_setup(struct pci_device *dev, int vec)
+{
+   const struct pci_device_loc loc = dev->loc;
+   const u32 ctl_off = dev->msix_cap + PCI_MSIX_CTL;
+   volatile u32 *e;
+   u32 ctl, cmd;
+   int rc;
+
+   if ((rc = pci_config_read(loc, PCI_COMMAND_OFF, 16, &cmd)))
+      return rc;
+
+   /* The MSI-X table is in a memory BAR: we cannot touch it otherwise */
+   if (!(cmd & PCI_COMMAND_MEM_SPACE))
+      return -EIO;
+
+   if ((rc = pci_config_read(loc, ctl_off, 16, &ctl)))
+      return rc;
+
+   if ((rc = pci_msix_map_entry(dev)))
+      return rc;
+
+   /* Enable MSI-X with the whole function masked, while programming it */
+   ctl |= PCI_MSIX_CTL_ENABLE | PCI_MSIX_CTL_FUNC_MASK;
+
+   if ((rc = pci_config_write(loc, ctl_off, 16, ctl))) {
+      pci_msix_unmap_entry(dev);
+      return rc;
+   }
+
+   e = dev->msix_entry;
+   e[PCI_MSIX_ENTRY_ADDR_LO] = pci_msi_addr();
+   e[PCI_MSIX_ENTRY_ADDR_HI] = 0;
+   e[PCI_MSIX_ENTRY_DATA] = (u32)vec;
+   e[PCI_MSIX_ENTRY_VEC_CTL] &= ~PCI_MSIX_VEC_CTL_MASKED;
+
+   ctl &= ~PCI_MSIX_CTL_FUNC_MASK;
+
+   if ((rc = pci_config_write(loc, ctl_off, 16, ctl))) {
+      e[PCI_MSIX_ENTRY_VEC_CTL] |= PCI_MSIX_VEC_CTL_MASKED;
+      pci_config_write(loc, ctl_off, 16, ctl & ~PCI_MSIX_CTL_ENABLE);
+      pci_msix_unmap_entry(dev);
+      return rc;
+   }
+
+   return 0;
+}
+
+/*
+ * Allocate a dedicated vector for the device, handled by `n`, and enable the
+ * delivery of its interrupts through MSI-X (preferred) or MSI. The legacy INTx
+ * interrupt gets disabled. Return the vector or a negative errno value.
+ */
+int
+pci_enable_msi(struct pci_device *dev, struct irq_handler_node *n)
+{
+   int vec, rc;
+
+   if (!dev->msix_cap && !dev->msi_cap)
+      return -ENODEV;
+
+   if (dev->msi_vector)
+      return -EBUSY;
+
+   if ((vec = irq_alloc_vector(n)) < 0)
+      return vec;
+
+   if ((rc = pci_set_intx_disabled(dev, true)))
+      goto err_end;
+
+   if (dev->msix_cap)
+      rc = pci_msix_setup(dev, vec);
+   else
+      rc = pci_msi_setup(dev, vec);
+
+   if (rc) {
+      pci_set_intx_disabled(dev, false);
+      goto err_end;
+   }
+
+   printk("PCI: %04x:%02x:%02x.%x: using %s, vector: %#x\n",
+          dev->loc.seg, dev->loc.bus, dev->loc.dev, dev->loc.func,
+          dev->msix_cap ? "MSI-X" : "MSI", vec);
+
+   dev->msi_vector = vec;
+   return vec;
+
+err_end:
+   irq_free_vector(vec);
+   return rc;
+}
+
+void
+pci_disable_msi(struct pci_device *dev)
+{
+   const struct pci_device_loc loc = dev->loc;
+   u32 off, ctl;
+
+   if (!dev->msi_vector)
+      return;
+
+   if (dev->msix_entry) {
+
+      off = dev->msix_cap + PCI_MSIX_CTL;
+      dev->msix_entry[PCI_MSIX_ENTRY_VEC_CTL] |= PCI_MSIX_VEC_CTL_MASKED;
+
+      if (!pci_config_read(loc, off, 16, &ctl))
+         pci_config_write(loc, off, 16, ctl & ~PCI_MSIX_CTL_ENABLE);
+
+      pci_msix_unmap_entry(dev);
+
+   } else {
+
+      off = dev->msi_cap + PCI_MSI_CTL;
+
+      if (!pci_config_read(loc, off, 16, &ctl))
+         pci_config_write(loc, off, 16, ctl & ~PCI_MSI_CTL_ENABLE);
+   }
+
+   pci_set_intx_disabled(dev, false);
+   irq_free_vector(dev->msi_vector);
+   dev->msi_vector = 0;
+}
@@ -21,6 +21,8 @@ DEF_STATIC_SYSOBJ_PROP(class_name, &sysobj_ptype_ro_string_literal);
 DEF_STATIC_SYSOBJ_PROP(subclass_name, &sysobj_ptype_ro_string_literal);
 DEF_STATIC_SYSOBJ_PROP(progif_name, &sysobj_ptype_ro_string_literal);
 DEF_STATIC_SYSOBJ_PROP(vendor_name, &sysobj_ptype_ro_string_literal);
+DEF_STATIC_SYSOBJ_PROP(msi_cap, &sysobj_ptype_ro_ulong_hex_literal);
+DEF_STATIC_SYSOBJ_PROP(msix_cap, &sysobj_ptype_ro_ulong_hex_literal);
 
 /* Sysfs obj types */
 DEF_STATIC_SYSOBJ_TYPE(pci_device_sysobj_type,
@@ -35,6 +37,8 @@ DEF_STATIC_SYSOBJ_TYPE(pci_device_sysobj_type,
                        &prop_subclass_name,
                        &prop_progif_name,
                        &prop_vendor_name,
+                       &prop_msi_cap,
+                       &prop_msix_cap,
                        NULL);
 
 static int
@@ -69,7 +73,9 @@ pci_create_obj_for_device(struct pci_device *dev)
                           dc.class_name,
                           dc.subclass_name,
                           dc.progif_name,
-                          vendor);
+                          vendor,
+                          TO_PTR(dev->msi_cap),
+                          TO_PTR(dev->msix_cap));
 
    if (!obj)
       return -ENOMEM;
@@ -0,0 +1,316 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/tilck_prof.h>
+
+#include <tilck/kernel/modules.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/process.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/elf_utils.h>
+#include <tilck/kernel/fs/devfs.h>
+#include <tilck/kernel/fs/vfs.h>
+
+#include <tilck/mods/profiler.h>
+
+#define PROF_RING_SAMPLES                   1024
+
+STATIC_ASSERT((PROF_RING_SAMPLES & (PROF_RING_SAMPLES - 1)) == 0);
+
+/*
+ * The ring is written only by prof_take_sample(), in the timer IRQ context
+ * with interrupts disabled, and read by prof_read() with interrupts disabled
+ * as well. Therefore, on Tilck (UP), no other synchronization is needed.
+ */
+static struct tilck_prof_sample *prof_ring;
+static u32 prof_head;
+static u32 prof_tail;
+static u32 prof_period;
+static u32 prof_ticks;
+static u32 prof_samples;
+static u32 prof_dropped;
+static int prof_handles;
+
+bool __prof_running;
+
+/*
+ * Follow the chain of saved frame pointers on the kernel stack of the current
+ * task. Every frame must be inside the stack and above the previous one: the
+ * interrupted code might be using EBP as a general purpose register.
+ */
+static u32
+prof_walk_kernel_stack(struct task *curr, void *fp, ulong *frames, u32 max)
+{
+   const ulong stack_lo = (ulong)curr->kernel_stack;
+   const ulong stack_hi = stack_lo + KERNEL_STACK_SIZE - 2 * sizeof(ulong);
+   ulong prev_fp = 0;
+   u32 i;
+
+   if (!stack_lo)
+      return 0;
+
+   for (i = 0; i < max; i++) {
+
+      const ulong f = (ulong)fp;
+
+      if (f < stack_lo || f > stack_hi || f <= prev_fp)
+         break;
+
+      if (!(frames[i] = ((ulong *)f)[1]))
+         break;
+
+      prev_fp = f;
+      fp = ((void **)f)[0];
+   }
+
+   return i;
+}
+
+void prof_take_sample(regs_t *r)
+{
+   struct task *curr = get_curr_task();
+   struct tilck_prof_sample *s;
+
+   ASSERT(!are_interrupts_enabled());
+
+   if (++prof_ticks < prof_period)
+      return;
+
+   prof_ticks = 0;
+
+   if (prof_head - prof_tail == PROF_RING_SAMPLES) {
+      prof_dropped++;
+      return;
+   }
+
+   s = &prof_ring[prof_head % PROF_RING_SAMPLES];
+   s->pid = curr->pi->pid;
+   s->tid = curr->tid;
+   s->frames[0] = (ulong)regs_get_ip(r);
+
+   if (regs_is_user_mode(r)) {
+
+      s->flags = TILCK_PROF_FL_USER;
+      s->frames_count = 1;
+
+   } else {
+
+      s->flags = 0;
+      s->frames_count = 1 + prof_walk_kernel_stack(curr,
+                                                   regs_get_frame_ptr(r),
+                                                   s->frames + 1,
+                                                   TILCK_PROF_MAX_FRAMES - 1);
+   }
+
+   prof_head++;
+   prof_samples++;
+}
+
+static ssize_t prof_read(fs_handle h, char *buf, size_t size, offt *pos)
+{
+   const size_t max = size / sizeof(struct tilck_prof_sample);
+   struct tilck_prof_sample *dest = (void *)buf;
+   size_t count = 0;
+   ulong var;
+
+   if (!max)
+      return -EINVAL;
+
+   while (count < max) {
+
+      disable_interrupts(&var);
+
+      if (prof_tail == prof_head) {
+         enable_interrupts(&var);
+         break;
+      }
+
+      dest[count++] = prof_ring[prof_tail++ % PROF_RING_SAMPLES];
+      enable_interrupts(&var);
+   }
+
+   return (ssize_t)(count * sizeof(struct tilck_prof_sample));
+}
+
+static void prof_set_running(bool running, u32 period)
+{
+   ulong var;
+   disable_interrupts(&var);
+   {
+      if (running) {
+         prof_period = period ? period : 1;
+         prof_ticks = 0;
+      }
+
+      __prof_running = running;
+   }
+   enable_interrupts(&var);
+}
+
+static int prof_ioctl_get_stats(void *user_argp)
+{
+   struct tilck_prof_stats st;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      st = (struct tilck_prof_stats) {
+         .timer_hz = TIMER_HZ,
+         .period = prof_period,
+         .samples = prof_samples,
+         .dropped = prof_dropped,
+      };
+   }
+   enable_interrupts(&var);
+
+   if (copy_to_user(user_argp, &st, sizeof(st)))
+      return -EFAULT;
+
+   return 0;
+}
+
+static int prof_ioctl_get_sym(void *user_argp)
+{
+   struct tilck_prof_sym ps;
+   const char *name;
+   long off;
+
+   if (copy_from_user(&ps, user_argp, sizeof(ps)))
+      return -EFAULT;
+
+   if (!(name = find_sym_at_addr(ps.addr, &off, NULL)))
+      return -ENOENT;
+
+   ps.off = (ulong)off;
+   strncpy(ps.name, name, sizeof(ps.name) - 1);
+   ps.name[sizeof(ps.name) - 1] = 0;
+
+   if (copy_to_user(user_argp, &ps, sizeof(ps)))
+      return -EFAULT;
+
+   return 0;
+}
+
+static int prof_ioctl(fs_handle h, ulong request, void *user_argp)
+{
+   switch (request) {
+
+      case TILCK_IOCTL_PROF_START:
+         prof_set_running(true, (u32)(ulong)user_argp);
+         return 0;
+
+      case TILCK_IOCTL_PROF_STOP:
+         prof_set_running(false, 0);
+         return 0;
+
+      case TILCK_IOCTL_PROF_GET_STATS:
+         return prof_ioctl_get_stats(user_argp);
+
+      case TILCK_IOCTL_PROF_GET_SYM:
+         return prof_ioctl_get_sym(user_argp);
+
+      default:
+         return -EINVAL;
+   }
+}
+
+static int prof_create_extra(int minor, void *extra)
+{
+   int rc = 0;
+
+   disable_preemption();
+   {
+      if (prof_handles)
+         rc = -EBUSY; /* Only one consumer at a time is supported */
+      else
+         prof_handles = 1;
+   }
+   enable_preemption();
+
+   if (rc)
+      return rc;
+
+   /* Allocate the ring on the first use and keep it: it's an opt-in feature */
+   if (!prof_ring) {
+
+      prof_ring = kzalloc_array_obj(struct tilck_prof_sample,
+                                    PROF_RING_SAMPLES);
+
+      if (!prof_ring) {
+         prof_handles = 0;
+         return -ENOMEM;
+      }
+   }
+
+   prof_head = prof_tail = 0;
+   prof_samples = prof_dropped = 0;
+   return 0;
+}
+
+static int prof_on_dup_extra(int minor, void *extra)
+{
+   disable_preemption();
+   {
+      prof_handles++;
+   }
+   enable_preemption();
+   return 0;
+}
+
+static void prof_destroy_extra(int minor, void *extra)
+{
+   disable_preemption();
+   {
+      ASSERT(prof_handles > 0);
+
+      if (!--prof_handles)
+         prof_set_running(false, 0);
+   }
+   enable_preemption();
+}
+
+static int
+create_prof_device(int minor,
+                   enum vfs_entry_type *type,
+                   struct devfs_file_info *nfo)
+{
+   static const struct file_ops static_ops_prof = {
+      .read = prof_read,
+      .ioctl = prof_ioctl,
+   };
+
+   *type = VFS_CHAR_DEV;
+   nfo->fops = &static_ops_prof;
+   nfo->create_extra = &prof_create_extra;
+   nfo->on_dup_extra = &prof_on_dup_extra;
+   nfo->destroy_extra = &prof_destroy_extra;
+   return 0;
+}
+
+static void init_profiler(void)
+{
+   struct driver_info *di = kzalloc_obj(struct driver_info);
+   int major, rc;
+
+   if (!di)
+      panic("Unable to allocate the profiler's driver info");
+
+   di->name = "prof";
+   di->create_dev_file = create_prof_device;
+   major = register_driver(di, -1);
+
+   if ((rc = create_dev_file("prof", major, 0 /* minor */, NULL)))
+      panic("Unable to create /dev/prof (error: %d)", rc);
+}
+
+static struct module prof_module = {
+
+   .name = "profiler",
+   .priority = MOD_profiler_prio,
+   .init = &init_profiler,
+};
+
+REGISTER_MODULE(&prof_module);
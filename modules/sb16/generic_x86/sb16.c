@@ -66,6 +66,9 @@ sb16_alloc_buf(void)
 static enum irq_action
 sb16_handle_irq(void *ctx)
 {
+   if (sb16_dsp_is_running())
+      return sb16_dsp_handle_irq();
+
    SB16_DBG("sb16, irq, completed slot: %u\n", sb16_slot);
 
    /* Mark the current slot as "used" */
@@ -118,12 +121,7 @@ sb16_read(fs_handle h, char *user_buf, size_t size, offt *pos)
 static void
 sb16_fill_buf_with_mute(void *buf, size_t len)
 {
-   u16 mute = (u16)(dsp_params.sign ? 0 : (1 << ((u32)dsp_params.bits-1)) - 1);
-
-   if (dsp_params.bits == 8)
-      memset(buf, mute, len);
-   else
-      memset16(buf, mute, len / 2);
+   sb16_fill_with_mute(&dsp_params, buf, len);
 }
 
 static void
@@ -161,8 +159,11 @@ do_start_play(u8 next_slot, u32 sz)
       curr_buf_sz = MAX(sz, played_anything ? 4 * KB : 8 * KB);
       played_anything = true;
 
-      sb16_program_dma(dsp_params.bits, sz < 32 * KB ? sz : 64 * KB);
-      sb16_program(&dsp_params, curr_buf_sz);
+      sb16_program_dma(dsp_params.bits,
+                       sz < 32 * KB ? sz : 64 * KB,
+                       sz >= 32 * KB);
+
+      sb16_program(&dsp_params, curr_buf_sz, curr_buf_sz == 32 * KB);
 
    } else {
 
@@ -295,6 +296,14 @@ sb16_release_on_exit(struct task *ti)
    SB16_DBG("sb16: release ownership from TID: %d\n", ti->tid);
 }
 
+/* Called with preemption disabled */
+bool
+sb16_is_busy(void)
+{
+   ASSERT(!is_preemption_enabled());
+   return owner || sb16_playing;
+}
+
 static int
 sb16_ioctl_acquire(void)
 {
@@ -306,6 +315,11 @@ sb16_ioctl_acquire(void)
          /* The current task, does not own the resource */
          rc = -EPERM;
 
+      } else if (sb16_dsp_is_busy()) {
+
+         /* The hardware is in use through /dev/dsp */
+         rc = -EBUSY;
+
       } else {
 
          rc = register_on_task_exit_cb(&sb16_release_on_exit);
@@ -339,7 +353,7 @@ sb16_ioctl_release(void)
    return rc;
 }
 
-static int
+int
 sb16_ioctl_get_info(struct tilck_sound_card_info *user_info)
 {
    static const struct tilck_sound_card_info info = {
@@ -414,6 +428,9 @@ create_sb16_device(int minor,
       .ioctl = sb16_ioctl,
    };
 
+   if (minor == SB16_DSP_MINOR)
+      return sb16_create_dsp_device(minor, type, nfo);
+
    *type = VFS_CHAR_DEV;
    nfo->fops = &static_ops_sb16;
    nfo->spec_flags = VFS_SPFL_NO_USER_COPY;
@@ -442,6 +459,11 @@ init_sb16(void)
       return;
    }
 
+   if (sb16_dsp_init() < 0) {
+      printk("sb16: failed to init /dev/dsp\n");
+      return;
+   }
+
    outb(DSP_WRITE, DSP_ENABLE_SPKR);
 
    struct driver_info *di = kalloc_obj(struct driver_info);
@@ -465,6 +487,11 @@ init_sb16(void)
 
    if (rc != 0)
       panic("sb16: unable to create /dev/sb16 (error: %d)", rc);
+
+   rc = create_dev_file("dsp", sb16_major, SB16_DSP_MINOR, NULL);
+
+   if (rc != 0)
+      panic("sb16: unable to create /dev/dsp (error: %d)", rc);
 }
 
 static struct module sb16_module = {
@@ -472,6 +499,8 @@ static struct module sb16_module = {
    .name = "sb16",
    .priority = MOD_sb16_prio,
    .init = &init_sb16,
+   .deps = MOD_DEPS("sysfs"),
+   .async = true,
 };
 
 REGISTER_MODULE(&sb16_module);
@@ -2,6 +2,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/kernel/hal.h>
+#include <tilck/kernel/fs/devfs.h>
 
 #define SB16_DBG_ENABLED       0
 
@@ -42,15 +43,39 @@ struct sb16_info {
    u8 ver_minor;
 };
 
+/*
+ * /dev/dsp: the kernel ring buffer and the DMA half-buffers (periods) are
+ * sized in milliseconds of audio, according to the current sound params.
+ */
+#define SB16_DSP_MINOR             1
+#define SB16_DSP_BUF_MS          500
+#define SB16_DSP_PERIOD_MS        20
+#define SB16_DSP_MAX_RATE      44100
+#define SB16_DSP_MIN_RATE       5000
+#define SB16_DSP_BH_PRIO           1
+
 extern struct sb16_info sb16_info;
 
 u8 sb16_get_irq(void);
 int sb16_detect_dsp_hw_and_reset(void);
 int sb16_check_version(void);
-void sb16_program_dma(u8 bits, u32 buf_sz);
-void sb16_program(struct tilck_sound_params *params, u32 buf_sz);
+void sb16_program_dma(u8 bits, u32 buf_sz, bool auto_init);
+void sb16_program(struct tilck_sound_params *p, u32 buf_sz, bool auto_init);
+void sb16_fill_with_mute(struct tilck_sound_params *p, void *buf, size_t len);
 void sb16_generate_test_sound(void);
 
+/* Exclusive access to the hardware, shared by /dev/sb16 and /dev/dsp */
+bool sb16_is_busy(void);
+bool sb16_dsp_is_busy(void);
+int sb16_ioctl_get_info(struct tilck_sound_card_info *user_info);
+
+int sb16_dsp_init(void);
+bool sb16_dsp_is_running(void);
+enum irq_action sb16_dsp_handle_irq(void);
+int sb16_create_dsp_device(int minor,
+                           enum vfs_entry_type *type,
+                           struct devfs_file_info *nfo);
+
 static inline void sb16_irq_ack(void)
 {
    extern u16 sb16_curr_ack_cmd;
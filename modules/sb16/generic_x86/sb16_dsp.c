@@ -0,0 +1,492 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/tilck_sound.h>
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/irq_bh.h>
+#include <tilck/kernel/ringbuf.h>
+#include <tilck/kernel/fs/devfs.h>
+#include <tilck/kernel/fs/vfs.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/process.h>
+
+#include "sb16.h"
+
+/*
+ * /dev/dsp: streaming PCM interface, in the style of OSS.
+ *
+ * Writers fill a kernel ring buffer holding SB16_DSP_BUF_MS of audio. The DMA
+ * buffer is split in two halves (periods) of SB16_DSP_PERIOD_MS each, played
+ * in loop with both the DMA controller and the DSP in auto-init mode. At the
+ * end of each period, the IRQ handler refills the half just played from the
+ * ring buffer, while the DSP plays the other one. Therefore, a writer can be
+ * preempted for up to the duration of the ring buffer without glitches.
+ *
+ * When the ring buffer doesn't contain a whole period, the rest of the half is
+ * filled with silence and, unless we're draining, that counts as an underrun.
+ * The playback stops when both the halves contain just silence.
+ *
+ * Writers get woken up by an IRQ bottom half, since kcond_signal_all() cannot
+ * be called by IRQ handlers. Only one process at a time can open the device,
+ * which is mutually exclusive with /dev/sb16. Opening it resets the params
+ * to the OSS defaults (8 kHz, 8 bit unsigned, mono): TILCK_IOCTL_SOUND_SETUP
+ * changes them.
+ */
+
+#define DSP_RB_MAX_SIZE   (SB16_DSP_MAX_RATE * 4 * SB16_DSP_BUF_MS / 1000)
+#define DSP_BOUNCE_SIZE                                              (4 * KB)
+
+struct sb16_dsp_stats {
+   ulong underruns;              /* periods not fully filled with data */
+   ulong played_bytes;
+   ulong started;                /* how many times the playback started */
+};
+
+static const struct tilck_sound_params dsp_default_params = {
+   .sample_rate = 8000,
+   .bits = 8,
+   .channels = 1,
+   .sign = 0,
+};
+
+static struct sb16_dsp_stats dsp_stats;
+static struct irq_bh dsp_bh;
+static u8 *dsp_rb_buf;
+static u8 *dsp_bounce_buf;
+
+/* Open handles (including dups): changed with preemption disabled */
+static int dsp_handles;
+
+/* Protected by dsp_mutex */
+static struct kmutex dsp_mutex = STATIC_KMUTEX_INIT(dsp_mutex, 0);
+static struct kcond dsp_cond = STATIC_KCOND_INIT(dsp_cond);
+static struct tilck_sound_params dsp_params;
+static u32 dsp_period;           /* size in bytes of each DMA half */
+static u32 dsp_frame;            /* size in bytes of a frame: 1, 2 or 4 */
+
+/* Shared with the IRQ handler: changed with the interrupts disabled */
+static struct ringbuf dsp_rb;
+static volatile bool dsp_running;
+static volatile bool dsp_draining;
+static u8 dsp_half;              /* the half currently played */
+static u32 dsp_half_data[2];     /* bytes of actual data in each half */
+
+#include "sb16_sysfs.c.h"
+
+bool
+sb16_dsp_is_running(void)
+{
+   return dsp_running;
+}
+
+/* Called with preemption disabled */
+bool
+sb16_dsp_is_busy(void)
+{
+   ASSERT(!is_preemption_enabled());
+   return dsp_handles > 0 || dsp_running;
+}
+
+static bool
+dsp_set_params(const struct tilck_sound_params *p)
+{
+   u32 bps, rb_size;
+
+   if (!IN_RANGE_INC(p->sample_rate, SB16_DSP_MIN_RATE, SB16_DSP_MAX_RATE))
+      return false;
+
+   if ((p->bits != 8 && p->bits != 16) || p->sign > 1)
+      return false;
+
+   if (p->channels != 1 && p->channels != 2)
+      return false;
+
+   dsp_params = *p;
+   dsp_frame = (u32)p->bits / 8 * p->channels;
+   bps = p->sample_rate * dsp_frame;
+
+   dsp_period = bps * SB16_DSP_PERIOD_MS / 1000;
+   dsp_period = CLAMP(dsp_period, 256u, 32 * KB) & ~3u;
+
+   rb_size = MIN(bps * SB16_DSP_BUF_MS / 1000, (u32)DSP_RB_MAX_SIZE) & ~3u;
+   rb_size = MAX(rb_size, 2 * dsp_period);
+
+   ringbuf_init(&dsp_rb, rb_size, 1, dsp_rb_buf);
+   return true;
+}
+
+/* True if the ring buffer contains at least a whole frame to play */
+static bool
+dsp_has_frames(void)
+{
+   return ringbuf_get_elems(&dsp_rb) >= dsp_frame;
+}
+
+/* Called by the IRQ handler or with the interrupts disabled */
+static void
+dsp_fill_half(u8 i)
+{
+   u8 *half = sb16_info.buf + i * dsp_period;
+   u32 avail = (u32)ringbuf_get_elems(&dsp_rb) & ~(dsp_frame - 1);
+   u32 n = (u32)ringbuf_read_bytes(&dsp_rb, half, MIN(avail, dsp_period));
+
+   if (n < dsp_period)
+      sb16_fill_with_mute(&dsp_params, half + n, dsp_period - n);
+
+   dsp_half_data[i] = n;
+}
+
+/* Called with dsp_mutex held */
+static void
+dsp_start(void)
+{
+   ulong var;
+   ASSERT(!dsp_running);
+
+   disable_interrupts(&var);
+   {
+      dsp_fill_half(0);
+      dsp_fill_half(1);
+      dsp_half = 0;
+      dsp_running = true;
+      dsp_stats.started++;
+   }
+   enable_interrupts(&var);
+
+   SB16_DBG("dsp: start, period: %u, rb: %u\n", dsp_period, dsp_rb.max_elems);
+   sb16_program_dma(dsp_params.bits, 2 * dsp_period, true);
+   sb16_program(&dsp_params, dsp_period, true);
+}
+
+enum irq_action
+sb16_dsp_handle_irq(void)
+{
+   const u8 done = dsp_half;
+
+   sb16_irq_ack();
+   dsp_stats.played_bytes += dsp_half_data[done];
+
+   /* The DSP is already playing the other half: refill the one just played */
+   dsp_half = !done;
+   dsp_fill_half(done);
+
+   if (dsp_half_data[done] < dsp_period && !dsp_draining)
+      dsp_stats.underruns++;
+
+   if (!dsp_half_data[0] && !dsp_half_data[1]) {
+
+      /* Both the halves contain just silence: stop */
+      SB16_DBG("dsp: irq, no more data: STOP\n");
+      sb16_pause();
+      dsp_running = false;
+
+      /* Drop the incomplete frame (if any) left by the writer: see below */
+      if (dsp_draining)
+         ringbuf_reset(&dsp_rb);
+   }
+
+   irq_bh_schedule(&dsp_bh);
+   return IRQ_HANDLED;
+}
+
+static void
+dsp_bh_func(void *ctx)
+{
+   kmutex_lock(&dsp_mutex);
+   {
+      kcond_signal_all(&dsp_cond);
+   }
+   kmutex_unlock(&dsp_mutex);
+}
+
+static u32
+dsp_get_free_space(void)
+{
+   ulong var;
+   u32 ret;
+
+   disable_interrupts(&var);
+   {
+      ret = dsp_rb.max_elems - dsp_rb.elems;
+   }
+   enable_interrupts(&var);
+   return ret;
+}
+
+static ssize_t
+dsp_write(fs_handle h, char *user_buf, size_t size, offt *pos)
+{
+   struct fs_handle_base *hb = h;
+   const bool nonblock = !!(hb->fl_flags & O_NONBLOCK);
+   size_t written = 0;
+   ulong var;
+   u32 chunk;
+   int rc = 0;
+
+   kmutex_lock(&dsp_mutex);
+
+   while (written < size) {
+
+      if (!(chunk = dsp_get_free_space())) {
+
+         if (!dsp_running)
+            dsp_start();
+
+         if (nonblock) {
+            rc = -EAGAIN;
+            break;
+         }
+
+         kcond_wait(&dsp_cond, &dsp_mutex, KCOND_WAIT_FOREVER);
+
+         if (pending_signals()) {
+            rc = -EINTR;
+            break;
+         }
+
+         continue;
+      }
+
+      chunk = MIN(chunk, (u32)DSP_BOUNCE_SIZE);
+      chunk = (u32)MIN((size_t)chunk, size - written);
+
+      if (copy_from_user(dsp_bounce_buf, user_buf + written, chunk)) {
+         rc = -EFAULT;
+         break;
+      }
+
+      disable_interrupts(&var);
+      {
+         ringbuf_write_bytes(&dsp_rb, dsp_bounce_buf, chunk);
+      }
+      enable_interrupts(&var);
+      written += chunk;
+
+      /* Start playing once both the halves can be filled with data */
+      if (!dsp_running && ringbuf_get_elems(&dsp_rb) >= 2 * dsp_period)
+         dsp_start();
+   }
+
+   kmutex_unlock(&dsp_mutex);
+   return written > 0 ? (ssize_t)written : rc;
+}
+
+/*
+ * Called with dsp_mutex held: play all the buffered data and wait for it.
+ *
+ * Only whole frames are played: when the writer wrote a byte count that is
+ * not a multiple of the frame size, the remaining bytes are dropped here.
+ * Otherwise, they would stay in the ring buffer forever, making every later
+ * TILCK_IOCTL_SOUND_SETUP fail with -EBUSY.
+ */
+static int
+dsp_drain(void)
+{
+   ulong var;
+   int rc = 0;
+   dsp_draining = true;
+
+   if (!dsp_running && dsp_has_frames())
+      dsp_start();
+
+   while (dsp_running) {
+
+      kcond_wait(&dsp_cond, &dsp_mutex, KCOND_WAIT_FOREVER);
+
+      if (pending_signals()) {
+         rc = -EINTR;
+         break;
+      }
+   }
+
+   if (!rc) {
+
+      disable_interrupts(&var);
+      {
+         ringbuf_reset(&dsp_rb);
+      }
+      enable_interrupts(&var);
+   }
+
+   dsp_draining = false;
+   return rc;
+}
+
+static int
+dsp_ioctl_setup(struct tilck_sound_params *user_params)
+{
+   struct tilck_sound_params p;
+   int rc = 0;
+
+   if (copy_from_user(&p, user_params, sizeof(p)))
+      return -EFAULT;
+
+   kmutex_lock(&dsp_mutex);
+   {
+      if (dsp_running || !ringbuf_is_empty(&dsp_rb))
+         rc = -EBUSY;
+      else if (!dsp_set_params(&p))
+         rc = -EINVAL;
+   }
+   kmutex_unlock(&dsp_mutex);
+   return rc;
+}
+
+static int
+dsp_ioctl(fs_handle h, ulong request, void *user_argp)
+{
+   int rc;
+
+   switch (request) {
+
+      case TILCK_IOCTL_SOUND_SETUP:
+         return dsp_ioctl_setup(user_argp);
+
+      case TILCK_IOCTL_SOUND_GET_INFO:
+         return sb16_ioctl_get_info(user_argp);
+
+      case TILCK_IOCTL_SOUND_WAIT_COMPLETION:
+         kmutex_lock(&dsp_mutex);
+         {
+            rc = dsp_drain();
+         }
+         kmutex_unlock(&dsp_mutex);
+         return rc;
+
+      default:
+         return -EINVAL;
+   }
+}
+
+static int
+dsp_write_ready(fs_handle h)
+{
+   return dsp_get_free_space() > 0;
+}
+
+static struct kcond *
+dsp_get_wready_cond(fs_handle h)
+{
+   return &dsp_cond;
+}
+
+static int
+dsp_create_extra(int minor, void *extra)
+{
+   int rc = 0;
+
+   disable_preemption();
+   {
+      if (sb16_dsp_is_busy() || sb16_is_busy())
+         rc = -EBUSY;
+      else
+         dsp_handles++;
+   }
+   enable_preemption();
+
+   if (rc)
+      return rc;
+
+   kmutex_lock(&dsp_mutex);
+   {
+      dsp_draining = false;
+      dsp_set_params(&dsp_default_params);
+   }
+   kmutex_unlock(&dsp_mutex);
+   return 0;
+}
+
+static int
+dsp_on_dup_extra(int minor, void *extra)
+{
+   disable_preemption();
+   {
+      dsp_handles++;
+   }
+   enable_preemption();
+   return 0;
+}
+
+static void
+dsp_destroy_extra(int minor, void *extra)
+{
+   bool last;
+
+   disable_preemption();
+   {
+      last = !--dsp_handles;
+   }
+   enable_preemption();
+
+   if (!last)
+      return;
+
+   /* Let the buffered data play in background, without waiting for it */
+   kmutex_lock(&dsp_mutex);
+   {
+      dsp_draining = true;
+
+      if (!dsp_running && dsp_has_frames())
+         dsp_start();
+   }
+   kmutex_unlock(&dsp_mutex);
+}
+
+int
+sb16_create_dsp_device(int minor,
+                       enum vfs_entry_type *type,
+                       struct devfs_file_info *nfo)
+{
+   static const struct file_ops static_ops_dsp = {
+      .write = dsp_write,
+      .ioctl = dsp_ioctl,
+      .write_ready = dsp_write_ready,
+      .get_wready_cond = dsp_get_wready_cond,
+   };
+
+   *type = VFS_CHAR_DEV;
+   nfo->fops = &static_ops_dsp;
+   nfo->spec_flags = VFS_SPFL_NO_USER_COPY;
+   nfo->create_extra = &dsp_create_extra;
+   nfo->on_dup_extra = &dsp_on_dup_extra;
+   nfo->destroy_extra = &dsp_destroy_extra;
+   return 0;
+}
+
+int
+sb16_dsp_init(void)
+{
+   int rc;
+
+   if (!(dsp_rb_buf = kmalloc(DSP_RB_MAX_SIZE)))
+      return -ENOMEM;
+
+   if (!(dsp_bounce_buf = kmalloc(DSP_BOUNCE_SIZE))) {
+      kfree2(dsp_rb_buf, DSP_RB_MAX_SIZE);
+      return -ENOMEM;
+   }
+
+   rc = irq_bh_init(&dsp_bh,
+                    "sb16dsp",
+                    sb16_info.irq,
+                    SB16_DSP_BH_PRIO,
+                    &dsp_bh_func,
+                    NULL);
+
+   if (rc) {
+      kfree2(dsp_bounce_buf, DSP_BOUNCE_SIZE);
+      kfree2(dsp_rb_buf, DSP_RB_MAX_SIZE);
+      return rc;
+   }
+
+   dsp_set_params(&dsp_default_params);
+   sb16_dsp_create_sysfs_view();
+   return 0;
+}
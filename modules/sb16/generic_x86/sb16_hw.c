@@ -109,7 +109,7 @@ sb16_check_version(void)
 }
 
 void
-sb16_program_dma(u8 bits, u32 buf_sz)
+sb16_program_dma(u8 bits, u32 buf_sz, bool auto_init)
 {
    u32 cnt;
    u16 mask_reg_cmd;
@@ -148,7 +148,7 @@ sb16_program_dma(u8 bits, u32 buf_sz)
 
    dma_mode = DMA_SINGLE_MODE | DMA_READ_TX | channel;
 
-   if (buf_sz == 64 * KB) {
+   if (auto_init) {
       SB16_DBG("prog DMA in AUTO INIT mode\n");
       dma_mode |= DMA_AUTO_INIT;
    } else {
@@ -180,7 +180,7 @@ sb16_set_sample_rate(u16 sample_rate)
 }
 
 void
-sb16_program(struct tilck_sound_params *p, u32 buf_sz)
+sb16_program(struct tilck_sound_params *p, u32 buf_sz, bool auto_init)
 {
    u8 prog_mode = 0;
    u8 sound_fmt = 0;
@@ -188,7 +188,7 @@ sb16_program(struct tilck_sound_params *p, u32 buf_sz)
 
    prog_mode |= DSP_PLAY;
 
-   if (buf_sz == 32 * KB) {
+   if (auto_init) {
       SB16_DBG("prog DSP in AUTO_INIT mode\n");
       prog_mode |= DSP_AUTO_INIT;
    } else {
@@ -224,3 +224,14 @@ sb16_program(struct tilck_sound_params *p, u32 buf_sz)
    outb(DSP_WRITE, ((samples_cnt-1)     ) & 0xff); // count low
    outb(DSP_WRITE, ((samples_cnt-1) >> 8) & 0xff); // count high
 }
+
+void
+sb16_fill_with_mute(struct tilck_sound_params *p, void *buf, size_t len)
+{
+   u16 mute = (u16)(p->sign ? 0 : (1 << ((u32)p->bits - 1)) - 1);
+
+   if (p->bits == 8)
+      memset(buf, mute, len);
+   else
+      memset16(buf, mute, len / 2);
+}
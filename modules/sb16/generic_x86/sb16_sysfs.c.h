@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/mod_sysfs.h>
+
+#if MOD_sysfs
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+/* Properties */
+DEF_STATIC_SYSOBJ_PROP(dsp_underruns, &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(dsp_played_bytes, &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(dsp_started, &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(dsp_buf_ms, &sysobj_ptype_ro_ulong_literal);
+DEF_STATIC_SYSOBJ_PROP(dsp_period_ms, &sysobj_ptype_ro_ulong_literal);
+
+/* Sysfs obj types */
+DEF_STATIC_SYSOBJ_TYPE(sb16_sysobj_type,
+                       &prop_dsp_underruns,
+                       &prop_dsp_played_bytes,
+                       &prop_dsp_started,
+                       &prop_dsp_buf_ms,
+                       &prop_dsp_period_ms,
+                       NULL);
+
+/* Create /syst/hw/media/sb16 */
+static void
+sb16_dsp_create_sysfs_view(void)
+{
+   struct sysobj *obj;
+
+   obj = sysfs_create_obj(&sb16_sysobj_type,
+                          NULL,                    /* hooks */
+                          &dsp_stats.underruns,
+                          &dsp_stats.played_bytes,
+                          &dsp_stats.started,
+                          TO_PTR(SB16_DSP_BUF_MS),
+                          TO_PTR(SB16_DSP_PERIOD_MS));
+
+   if (!obj)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, &sysfs_media_obj, "sb16", obj) < 0) {
+      sysfs_destroy_unregistered_obj(obj);
+      goto fail;
+   }
+
+   return;
+
+fail:
+   printk("sb16: unable to create view in sysfs\n");
+}
+
+#else
+
+static void
+sb16_dsp_create_sysfs_view(void)
+{
+   /* do nothing */
+}
+
+#endif
@@ -145,6 +145,32 @@ char serial_read(u16 port)
    return (char) inb(port);
 }
 
+/*
+ * Read all the available data from the UART's RX FIFO, up to `len` bytes.
+ * Returns the number of bytes read and sets `*overrun` if the UART reported
+ * that some data has been lost because its FIFO was full.
+ */
+size_t serial_read_fifo(u16 port, char *buf, size_t len, bool *overrun)
+{
+   size_t n = 0;
+   u8 lsr;
+
+   while (n < len) {
+
+      lsr = inb(port + UART_LSR);
+
+      if (lsr & LSR_OVERRUN_ERROR)
+         *overrun = true;
+
+      if (!(lsr & LSR_DATA_READY))
+         break;
+
+      buf[n++] = (char) inb(port + UART_RBR);
+   }
+
+   return n;
+}
+
 bool serial_write_ready(u16 port)
 {
    return !!(inb(port + UART_LSR) & LSR_EMPTY_TR_REG);
@@ -160,3 +186,28 @@ void serial_write(u16 port, char c)
    serial_wait_for_write(port);
    outb(port, (u8)c);
 }
+
+void serial_write_fifo(u16 port, const char *buf, size_t len)
+{
+   /*
+    * The caller is supposed to have checked that the transmitter is empty:
+    * in that case, the whole FIFO is available and we can fill it without
+    * polling LSR after each byte.
+    */
+   ASSERT(len <= SERIAL_TX_FIFO_SIZE);
+
+   for (size_t i = 0; i < len; i++)
+      outb(port + UART_THR, (u8)buf[i]);
+}
+
+void serial_set_tx_intr(u16 port, bool enabled)
+{
+   u8 ier = inb(port + UART_IER);
+
+   if (enabled)
+      ier |= IER_TR_EMPTY_INTR;
+   else
+      ier &= (u8)~IER_TR_EMPTY_INTR;
+
+   outb(port + UART_IER, ier);
+}
@@ -7,69 +7,319 @@
 #include <tilck/kernel/modules.h>
 #include <tilck/kernel/hal.h>
 #include <tilck/kernel/irq.h>
-#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/irq_bh.h>
 #include <tilck/kernel/cmdline.h>
 #include <tilck/kernel/tty.h>
 #include <tilck/kernel/sched.h>
+#include <tilck/kernel/sync.h>
+#include <tilck/kernel/ringbuf.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/interrupts.h>
 
 #include <tilck/mods/serial.h>
 
 /* NOTE: hw-specific stuff in generic code. TODO: fix that. */
 
+#define SERIAL_RX_RB_SIZE                 4096
+#define SERIAL_TX_RB_SIZE                 4096
+#define SERIAL_TX_LOW_WATERMARK           (SERIAL_TX_RB_SIZE / 4)
+#define SERIAL_BH_PRIO                    2
+
 struct serial_device {
 
    const char *name;
+   const char *rx_bh_name;
+   const char *tx_bh_name;
    u16 ioport;
    struct tty *tty;
-   ATOMIC(int) jobs_cnt;
-   struct worker_thread *wth;
+
+   /*
+    * RX side. The IRQ handler drains the UART's FIFO into `rx_rb` and schedules
+    * `rx_bh`, which passes everything it finds in the ring to the TTY layer,
+    * in one batch. Like `tx_rb`, the ring is always accessed with the
+    * interrupts disabled.
+    */
+   struct ringbuf rx_rb;
+   struct irq_bh rx_bh;
+
+   /* Stats, exposed in sysfs */
+   ulong rx_bytes;
+   ulong rx_hw_overruns;      /* Times the UART's RX FIFO overflowed */
+   ulong rx_dropped;          /* Bytes dropped because `rx_rb` was full */
+   ulong tx_bytes;
+
+   /*
+    * TX side. The ring is accessed both by the writers and by the IRQ handler,
+    * therefore always with the interrupts disabled. When `tx_active` is true,
+    * the THRE interrupt is enabled and the IRQ handler moves the data from the
+    * ring to the UART's FIFO.
+    */
+   struct ringbuf tx_rb;
+   struct kcond tx_cond;      /* Signalled when there's room in `tx_rb` */
+   struct irq_bh tx_bh;       /* Wakes up the writers */
+   bool tx_ready;             /* IRQ-driven TX is possible */
+   bool tx_active;
+   bool tx_waiters;
 };
 
 struct serial_device legacy_serial_ports[] =
 {
    {
       .name = "COM1",
+      .rx_bh_name = "com1_rx",
+      .tx_bh_name = "com1_tx",
       .ioport = COM1,
    },
    {
       .name = "COM2",
+      .rx_bh_name = "com2_rx",
+      .tx_bh_name = "com2_tx",
       .ioport = COM2,
    },
    {
       .name = "COM3",
+      .rx_bh_name = "com3_rx",
+      .tx_bh_name = "com3_tx",
       .ioport = COM3,
    },
    {
       .name = "COM4",
+      .rx_bh_name = "com4_rx",
+      .tx_bh_name = "com4_tx",
       .ioport = COM4,
    },
 };
 
-static void ser_bh_handler(void *ctx)
+static void ser_rx_bh_handler(void *ctx)
 {
    struct serial_device *const dev = ctx;
-   struct tty *const t = dev->tty;
-   const u16 p = dev->ioport;
-   char c;
+   char buf[256];
+   size_t n;
+   ulong var;
+
+   do {
+
+      disable_interrupts(&var);
+      {
+         n = ringbuf_read_bytes(&dev->rx_rb, (u8 *)buf, sizeof(buf));
+      }
+      enable_interrupts(&var);
+
+      if (n)
+         tty_send_buf(dev->tty, buf, n, true);
+
+   } while (n);
+}
+
+/*
+ * Called by the IRQ handler: drain the UART's RX FIFO into the RX ring.
+ * Returns true if there's data to process in the ring.
+ */
+static bool ser_rx_handle_irq(struct serial_device *dev)
+{
+   char buf[SERIAL_RX_FIFO_SIZE];
+   bool overrun = false;
+   bool has_data;
+   size_t n, written;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      while ((n = serial_read_fifo(dev->ioport, buf, sizeof(buf), &overrun))) {
+
+         written = ringbuf_write_bytes(&dev->rx_rb, (u8 *)buf, n);
+         dev->rx_bytes += n;
+         dev->rx_dropped += n - written;
+      }
+
+      if (overrun)
+         dev->rx_hw_overruns++;
+
+      has_data = !ringbuf_is_empty(&dev->rx_rb);
+   }
+   enable_interrupts(&var);
+   return has_data;
+}
+
+static struct serial_device *get_serial_device(u16 ioport)
+{
+   for (int i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++)
+      if (legacy_serial_ports[i].ioport == ioport)
+         return &legacy_serial_ports[i];
+
+   return NULL;
+}
+
+static void ser_tx_bh_handler(void *ctx)
+{
+   struct serial_device *const dev = ctx;
+   kcond_signal_all(&dev->tx_cond);
+}
+
+static void ser_tx_stop(struct serial_device *dev)
+{
+   ASSERT(!are_interrupts_enabled());
+   serial_set_tx_intr(dev->ioport, false);
+   dev->tx_active = false;
+}
+
+/*
+ * Called by the IRQ handler: move up to SERIAL_TX_FIFO_SIZE bytes from the TX
+ * ring to the UART. Returns true if the IRQ was for us.
+ */
+static bool ser_tx_handle_irq(struct serial_device *dev)
+{
+   char buf[SERIAL_TX_FIFO_SIZE];
+   bool wakeup_writers = false;
+   size_t n;
+   ulong var;
+
+   if (!serial_write_ready(dev->ioport))
+      return false;
+
+   disable_interrupts(&var);
+
+   if (!dev->tx_active) {
+      /* The TX has been stopped by ser_tx_flush_polling() in the meanwhile */
+      enable_interrupts(&var);
+      return false;
+   }
+
+   {
+      n = ringbuf_read_bytes(&dev->tx_rb, (u8 *)buf, sizeof(buf));
+      serial_write_fifo(dev->ioport, buf, n);
+
+      if (ringbuf_is_empty(&dev->tx_rb))
+         ser_tx_stop(dev);
+
+      if (dev->tx_waiters &&
+          ringbuf_get_elems(&dev->tx_rb) <= SERIAL_TX_LOW_WATERMARK)
+      {
+         dev->tx_waiters = false;
+         wakeup_writers = true;
+      }
+   }
+   enable_interrupts(&var);
+
+   /*
+    * kcond_signal_all() cannot be called from IRQ context. In case of overflow,
+    * it's not a big deal: the writers wait with a timeout.
+    */
+   if (wakeup_writers)
+      irq_bh_schedule(&dev->tx_bh);
+
+   return true;
+}
+
+/*
+ * Synchronously flush the TX ring, by polling. Used when we cannot sleep
+ * waiting for the IRQ handler to make room in the ring.
+ */
+static void ser_tx_flush_polling(struct serial_device *dev)
+{
+   ulong var;
+   u8 c;
 
-   while (serial_read_ready(p)) {
+   disable_interrupts(&var);
+   {
+      while (ringbuf_read_elem1(&dev->tx_rb, &c))
+         serial_write(dev->ioport, (char)c);
 
-      c = serial_read(p);
-      tty_send_keyevent(t, make_key_event(0, c, true), true);
+      if (dev->tx_active)
+         ser_tx_stop(dev);
    }
+   enable_interrupts(&var);
+}
+
+static size_t
+ser_tx_enqueue(struct serial_device *dev, const char *buf, size_t len)
+{
+   size_t written;
+   ulong var;
+
+   disable_interrupts(&var);
+   {
+      written = ringbuf_write_bytes(&dev->tx_rb, (u8 *)buf, len);
 
-   dev->jobs_cnt--;
+      if (written && !dev->tx_active) {
+
+         /*
+          * Enabling the THRE interrupt while the transmitter is empty triggers
+          * an IRQ immediately: the IRQ handler will start the transmission.
+          */
+         dev->tx_active = true;
+         serial_set_tx_intr(dev->ioport, true);
+      }
+
+      if (written < len)
+         dev->tx_waiters = true;
+   }
+   enable_interrupts(&var);
+   return written;
+}
+
+void serial_write_buf(u16 port, const char *buf, size_t len)
+{
+   struct serial_device *dev = get_serial_device(port);
+   size_t written;
+
+   if (dev)
+      dev->tx_bytes += len;
+
+   if (UNLIKELY(!dev || !dev->tx_ready || in_panic())) {
+
+      /* Early boot or panic: just poll, after flushing the ring (if any) */
+      if (dev && dev->tx_ready)
+         ser_tx_flush_polling(dev);
+
+      for (size_t i = 0; i < len; i++)
+         serial_write(port, buf[i]);
+
+      return;
+   }
+
+   while (len > 0) {
+
+      written = ser_tx_enqueue(dev, buf, len);
+      buf += written;
+      len -= written;
+
+      if (!len)
+         break;
+
+      if (!is_preemption_enabled()) {
+
+         /* We cannot sleep: make room in the ring by ourselves */
+         ser_tx_flush_polling(dev);
+         continue;
+      }
+
+      /*
+       * Wait for the IRQ handler to drain the ring. The timeout protects us
+       * from the (unlikely) case where the wake-up job could not be enqueued.
+       */
+      kcond_wait(&dev->tx_cond, NULL, TIME_SLICE_TICKS);
+   }
 }
 
 static enum irq_action serial_con_irq_handler(void *ctx)
 {
    struct serial_device *const dev = ctx;
+   bool tx_handled = false;
+
+   if (dev->tx_active)
+      tx_handled = ser_tx_handle_irq(dev);
+
+   if (!serial_read_ready(dev->ioport)) {
+
+      if (tx_handled)
+         return IRQ_HANDLED;
 
-   if (!serial_read_ready(dev->ioport))
       return IRQ_NOT_HANDLED; /* Not an IRQ from this "device" [irq sharing] */
+   }
 
-   if (dev->jobs_cnt >= 2)
-      return IRQ_HANDLED;
+   if (!ser_rx_handle_irq(dev))
+      return IRQ_HANDLED; /* Nothing to process */
 
    if (UNLIKELY(in_panic())) {
 
@@ -77,22 +327,19 @@ static enum irq_action serial_con_irq_handler(void *ctx)
       ulong val;
       disable_interrupts(&val);
       {
-         dev->jobs_cnt++;
-         ser_bh_handler(dev);
+         irq_bh_run_now(&dev->rx_bh);
       }
       enable_interrupts(&val);
       return IRQ_HANDLED;
    }
 
-   if (!wth_enqueue_on(dev->wth, &ser_bh_handler, dev)) {
-      printk("Serial: WARNING: hit job queue limit\n");
-      return IRQ_HANDLED;
-   }
-
-   dev->jobs_cnt++;
+   /* On overflow, the data stays in the ring: the next IRQ will retry */
+   irq_bh_schedule(&dev->rx_bh);
    return IRQ_HANDLED;
 }
 
+#include "serial_sysfs.c.h"
+
 void early_init_serial_ports(void)
 {
    init_serial_port(COM1);
@@ -108,29 +355,41 @@ DEFINE_IRQ_HANDLER_NODE(com4, serial_con_irq_handler, &legacy_serial_ports[3]);
 
 static void init_serial_comm(void)
 {
-   struct worker_thread *wth;
-
-   disable_preemption();
-   {
-      wth = wth_create_thread("serial", 1, WTH_SERIAL_QUEUE_SIZE);
-
-      if (!wth)
-         panic("Serial: Unable to create a worker thread for IRQs");
-   }
-   enable_preemption();
-
    for (int i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++) {
 
       struct serial_device *dev = &legacy_serial_ports[i];
+      void *rx_buf = kmalloc(SERIAL_RX_RB_SIZE);
+      void *tx_buf = kmalloc(SERIAL_TX_RB_SIZE);
+      const int irq = (i & 1) ? X86_PC_COM2_COM4_IRQ : X86_PC_COM1_COM3_IRQ;
+
+      if (!rx_buf || !tx_buf)
+         panic("Serial: Unable to allocate the buffers for %s", dev->name);
+
+      if (irq_bh_init(&dev->rx_bh, dev->rx_bh_name, irq,
+                      SERIAL_BH_PRIO, &ser_rx_bh_handler, dev) ||
+          irq_bh_init(&dev->tx_bh, dev->tx_bh_name, irq,
+                      SERIAL_BH_PRIO, &ser_tx_bh_handler, dev))
+      {
+         panic("Serial: Unable to create the IRQ bottom halves");
+      }
 
       dev->tty = get_serial_tty((int)i);
-      dev->wth = wth;
+
+      ringbuf_init(&dev->rx_rb, SERIAL_RX_RB_SIZE, 1, rx_buf);
+      ringbuf_init(&dev->tx_rb, SERIAL_TX_RB_SIZE, 1, tx_buf);
+      kcond_init(&dev->tx_cond);
    }
 
    irq_install_handler(X86_PC_COM1_COM3_IRQ, &com1);
    irq_install_handler(X86_PC_COM1_COM3_IRQ, &com3);
    irq_install_handler(X86_PC_COM2_COM4_IRQ, &com2);
    irq_install_handler(X86_PC_COM2_COM4_IRQ, &com4);
+
+   /* From now on, serial_write_buf() can rely on the THRE interrupt */
+   for (int i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++)
+      legacy_serial_ports[i].tx_ready = true;
+
+   serial_create_sysfs_view();
 }
 
 static struct module serial_module = {
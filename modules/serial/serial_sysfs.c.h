@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/mod_sysfs.h>
+
+#if MOD_sysfs
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+/* Properties */
+DEF_STATIC_SYSOBJ_PROP(rx_bytes, &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(rx_hw_overruns, &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(rx_dropped, &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(tx_bytes, &sysobj_ptype_ro_ulong);
+
+/* Sysfs obj types */
+DEF_STATIC_SYSOBJ_TYPE(serial_device_sysobj_type,
+                       &prop_rx_bytes,
+                       &prop_rx_hw_overruns,
+                       &prop_rx_dropped,
+                       &prop_tx_bytes,
+                       NULL);
+
+/* Create /syst/hw/comm/COMx for each serial device */
+static void
+serial_create_sysfs_view(void)
+{
+   for (int i = 0; i < ARRAY_SIZE(legacy_serial_ports); i++) {
+
+      struct serial_device *dev = &legacy_serial_ports[i];
+      struct sysobj *obj;
+
+      obj = sysfs_create_obj(&serial_device_sysobj_type,
+                             NULL,                    /* hooks */
+                             &dev->rx_bytes,
+                             &dev->rx_hw_overruns,
+                             &dev->rx_dropped,
+                             &dev->tx_bytes);
+
+      if (!obj)
+         goto fail;
+
+      if (sysfs_register_obj(NULL, &sysfs_comm_obj, dev->name, obj) < 0) {
+         sysfs_destroy_unregistered_obj(obj);
+         goto fail;
+      }
+   }
+
+   return;
+
+fail:
+   printk("Serial: unable to create view in sysfs\n");
+}
+
+#else
+
+static void
+serial_create_sysfs_view(void)
+{
+   /* do nothing */
+}
+
+#endif
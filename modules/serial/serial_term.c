@@ -56,13 +56,21 @@ static void
 sterm_action_write(term *_t, const char *buf, size_t len)
 {
    struct sterm *const t = _t;
+   const char *end = buf + len;
+   const char *p;
 
-   for (u32 i = 0; i < len; i++) {
+   /* Write the data in chunks, translating each '\n' into "\r\n" */
+   while (buf < end) {
 
-      if (buf[i] == '\n')
-         serial_write(t->serial_port_fwd, '\r');
+      for (p = buf; p < end && *p != '\n'; p++) { }
 
-      serial_write(t->serial_port_fwd, buf[i]);
+      serial_write_buf(t->serial_port_fwd, buf, (size_t)(p - buf));
+
+      if (p == end)
+         break;
+
+      serial_write_buf(t->serial_port_fwd, "\r\n", 2);
+      buf = p + 1;
    }
 }
 
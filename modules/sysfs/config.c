@@ -16,6 +16,7 @@
 #include <tilck_gen_headers/mod_acpi.h>
 #include <tilck_gen_headers/mod_pci.h>
 #include <tilck_gen_headers/mod_sb16.h>
+#include <tilck_gen_headers/mod_ata.h>
 
 #include <tilck/common/build_info.h>
 
@@ -49,6 +50,9 @@ DEF_STATIC_CONF_RO(BOOL,  mmap_no_cow,             MMAP_NO_COW);
 DEF_STATIC_CONF_RO(BOOL,  ubsan,                   KERNEL_UBSAN);
 DEF_STATIC_CONF_RO(BOOL,  kernel_64bit_offt,       KERNEL_64BIT_OFFT);
 DEF_STATIC_CONF_RO(BOOL,  clock_drift_comp,        KRN_CLOCK_DRIFT_COMP);
+DEF_STATIC_CONF_RO(BOOL,  lockstat,                KRN_LOCKSTAT);
+DEF_STATIC_CONF_RO(BOOL,  smp,                     KRN_SMP);
+DEF_STATIC_CONF_RO(BOOL,  lapic_timer,             KRN_LAPIC_TIMER);
 
 /* config/console */
 DEF_STATIC_CONF_RO(ULONG, big_font_threshold,      FBCON_BIGFONT_THR);
@@ -69,6 +73,7 @@ DEF_STATIC_CONF_RO(BOOL,  console,                 MOD_console);
 DEF_STATIC_CONF_RO(BOOL,  fb,                      MOD_fb);
 DEF_STATIC_CONF_RO(BOOL,  serial,                  MOD_serial);
 DEF_STATIC_CONF_RO(BOOL,  sb16,                    MOD_sb16);
+DEF_STATIC_CONF_RO(BOOL,  ata,                     MOD_ata);
 DEF_STATIC_CONF_RO(BOOL,  debugpanel,              MOD_debugpanel);
 
 void sysfs_create_config_obj(void)
@@ -113,6 +118,9 @@ void sysfs_create_config_obj(void)
       SYSOBJ_CONF_PROP_PAIR(ubsan),
       SYSOBJ_CONF_PROP_PAIR(kernel_64bit_offt),
       SYSOBJ_CONF_PROP_PAIR(clock_drift_comp),
+      SYSOBJ_CONF_PROP_PAIR(lockstat),
+      SYSOBJ_CONF_PROP_PAIR(smp),
+      SYSOBJ_CONF_PROP_PAIR(lapic_timer),
       NULL
    );
 
@@ -153,6 +161,7 @@ void sysfs_create_config_obj(void)
       SYSOBJ_CONF_PROP_PAIR(fb),
       SYSOBJ_CONF_PROP_PAIR(serial),
       SYSOBJ_CONF_PROP_PAIR(sb16),
+      SYSOBJ_CONF_PROP_PAIR(ata),
       SYSOBJ_CONF_PROP_PAIR(debugpanel),
       NULL
    );
@@ -0,0 +1,363 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/exec_cache.h>
+#include <tilck/kernel/sys_stats.h>
+#include <tilck/kernel/lockstat.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/boot_timeline.h>
+
+#include <tilck/mods/sysfs.h>
+#include <tilck/mods/sysfs_utils.h>
+
+/* stats/exec_cache */
+DEF_STATIC_SYSOBJ_PROP(hits,              &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(misses,            &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(invalidations,     &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(evictions,         &sysobj_ptype_ro_ulong);
+DEF_STATIC_SYSOBJ_PROP(entries,           &sysobj_ptype_ro_ulong);
+
+/* Max size of a line of the stats/syscalls/table file */
+#define SYS_STATS_LINE_MAX   (64 + SYS_STATS_HIST_BUCKETS * 16)
+
+static u32 sys_stats_count_active(void)
+{
+   u32 count = 0;
+
+   for (u32 i = 0; i < MAX_SYSCALLS; i++)
+      if (sys_stats[i].count)
+         count++;
+
+   return count;
+}
+
+static offt
+sys_stats_table_get_buf_sz(struct sysobj *obj, void *data)
+{
+   /* Leave room for syscalls called for the first time after open() */
+   return (offt)((sys_stats_count_active() + 8) * SYS_STATS_LINE_MAX);
+}
+
+static int
+sys_stats_dump_line(char *buf, int buf_sz, u32 sn, struct sys_stats *s)
+{
+   const char *name = sys_stats_get_name(sn);
+   char num_buf[16];
+   int w;
+
+   if (!name) {
+      snprintk(num_buf, sizeof(num_buf), "#%u", sn);
+      name = num_buf;
+   }
+
+   w = snprintk(buf, (size_t)buf_sz, "%-16s %8u %10" PRIu64 " %12" PRIu64,
+                name, s->count, s->tot_cycles / s->count, s->max_cycles);
+
+   for (int i = 0; i < SYS_STATS_HIST_BUCKETS && w < buf_sz; i++) {
+      if (s->hist[i])
+         w += snprintk(buf + w, (size_t)(buf_sz - w), " %d:%u", i, s->hist[i]);
+   }
+
+   if (w < buf_sz)
+      w += snprintk(buf + w, (size_t)(buf_sz - w), "\n");
+
+   return MIN(w, buf_sz);
+}
+
+static offt
+sys_stats_table_load(struct sysobj *obj,
+                     void *data,
+                     void *buf,
+                     offt buf_sz,
+                     offt off)
+{
+   struct sys_stats s;
+   int w, sz = (int)buf_sz;
+
+   ASSERT(off == 0);
+
+   w = snprintk(buf, (size_t)sz,
+                "# syscall           calls   avg_cyc      max_cyc"
+                " log2(cycles):calls\n");
+
+   for (u32 i = 0; i < MAX_SYSCALLS && w < sz; i++) {
+
+      disable_preemption();
+      {
+         s = sys_stats[i];
+      }
+      enable_preemption();
+
+      if (s.count)
+         w += sys_stats_dump_line((char *)buf + w, sz - w, i, &s);
+   }
+
+   return MIN(w, sz);
+}
+
+static offt
+sys_stats_reset_store(struct sysobj *obj, void *data, void *buf, offt buf_sz)
+{
+   sys_stats_reset();
+   return buf_sz;
+}
+
+static const struct sysobj_prop_type sysobj_ptype_sys_stats_table = {
+   .get_buf_sz = &sys_stats_table_get_buf_sz,
+   .load = &sys_stats_table_load,
+};
+
+static const struct sysobj_prop_type sysobj_ptype_sys_stats_reset = {
+   .store = &sys_stats_reset_store,
+};
+
+/* stats/syscalls */
+DEF_STATIC_SYSOBJ_PROP(table,             &sysobj_ptype_sys_stats_table);
+DEF_STATIC_SYSOBJ_PROP(reset,             &sysobj_ptype_sys_stats_reset);
+DEF_STATIC_SYSOBJ_PROP(pid_filter,        &sysobj_ptype_long);
+
+static void sysfs_create_sys_stats_obj(struct sysobj *stats)
+{
+   struct sysobj *syscalls;
+
+   syscalls = sysfs_create_custom_obj(
+      "syscalls",
+      NULL,       /* hooks */
+      &prop_table,            NULL,
+      &prop_reset,            NULL,
+      &prop_pid_filter,       &sys_stats_pid_filter,
+      NULL
+   );
+
+   if (!syscalls)
+      panic("Unable to create the sysfs stats/syscalls obj");
+
+   if (sysfs_register_obj(NULL, stats, "syscalls", syscalls))
+      panic("Unable to register the sysfs stats/syscalls obj");
+}
+
+/* Max size of a line of the stats/locks/table file */
+#define LOCKSTAT_LINE_MAX    128
+
+static offt
+lockstat_table_get_buf_sz(struct sysobj *obj, void *data)
+{
+   /* Leave room for locks registered after open() */
+   return (offt)((lockstat_get_count() + 8) * LOCKSTAT_LINE_MAX);
+}
+
+static offt
+lockstat_table_load(struct sysobj *obj,
+                    void *data,
+                    void *buf,
+                    offt buf_sz,
+                    offt off)
+{
+   const int max_count = (int)buf_sz / LOCKSTAT_LINE_MAX;
+   struct lockstat *arr;
+   int w, count, sz = (int)buf_sz;
+
+   ASSERT(off == 0);
+
+   if (!(arr = kalloc_array_obj(struct lockstat, (size_t)max_count)))
+      return -ENOMEM;
+
+   count = lockstat_snapshot(arr, max_count);
+
+   w = snprintk(buf, (size_t)sz,
+                "# lock           id type        acq   contended"
+                "   wait_tot_cyc   wait_max_cyc holder\n");
+
+   for (int i = 0; i < count && w < sz; i++) {
+
+      const struct lockstat *ls = &arr[i];
+
+      w += snprintk((char *)buf + w, (size_t)(sz - w),
+                    "%-12s %5ld %-6s %10u %10u %14llu %14llu %6d\n",
+                    ls->name, ls->id, lockstat_type_str(ls->type),
+                    ls->acquisitions, ls->contentions,
+                    ls->wait_tot, ls->wait_max, ls->holder_tid);
+   }
+
+   kfree_array_obj(arr, struct lockstat, (size_t)max_count);
+   return MIN(w, sz);
+}
+
+static offt
+lockstat_reset_store(struct sysobj *obj, void *data, void *buf, offt buf_sz)
+{
+   lockstat_reset();
+   return buf_sz;
+}
+
+static const struct sysobj_prop_type sysobj_ptype_lockstat_table = {
+   .get_buf_sz = &lockstat_table_get_buf_sz,
+   .load = &lockstat_table_load,
+};
+
+static const struct sysobj_prop_type sysobj_ptype_lockstat_reset = {
+   .store = &lockstat_reset_store,
+};
+
+/* stats/locks */
+DEF_STATIC_SYSOBJ_PROP2(prop_locks_table, table, &sysobj_ptype_lockstat_table);
+DEF_STATIC_SYSOBJ_PROP2(prop_locks_reset, reset, &sysobj_ptype_lockstat_reset);
+
+static void sysfs_create_lockstat_obj(struct sysobj *stats)
+{
+   struct sysobj *locks;
+
+   locks = sysfs_create_custom_obj(
+      "locks",
+      NULL,       /* hooks */
+      &prop_locks_table,      NULL,
+      &prop_locks_reset,      NULL,
+      NULL
+   );
+
+   if (!locks)
+      panic("Unable to create the sysfs stats/locks obj");
+
+   if (sysfs_register_obj(NULL, stats, "locks", locks))
+      panic("Unable to register the sysfs stats/locks obj");
+}
+
+/* Max size of a line of the stats/boot/timeline file */
+#define BOOT_TL_LINE_MAX     96
+
+static offt
+boot_tl_table_get_buf_sz(struct sysobj *obj, void *data)
+{
+   return (offt)((BOOT_TL_MAX_EVENTS + 1) * BOOT_TL_LINE_MAX);
+}
+
+/* Microseconds since `base` if the TSC is calibrated, cycles otherwise */
+static u64 boot_tl_time(u64 tsc, u64 base, bool us)
+{
+   return us ? tsc_to_ns(tsc - base) / 1000 : tsc - base;
+}
+
+static offt
+boot_tl_table_load(struct sysobj *obj,
+                   void *data,
+                   void *buf,
+                   offt buf_sz,
+                   offt off)
+{
+   const bool us = has_tsc_clocksource();
+   struct boot_tl_event *arr, *e;
+   int w, count, sz = (int)buf_sz;
+   u64 base;
+
+   ASSERT(off == 0);
+
+   if (!(arr = kalloc_array_obj(struct boot_tl_event, BOOT_TL_MAX_EVENTS)))
+      return -ENOMEM;
+
+   count = boot_tl_snapshot(arr, BOOT_TL_MAX_EVENTS, &base);
+
+   w = snprintk(buf, (size_t)sz,
+                "%-32s %5s %14s %14s\n", "# stage", "tid",
+                us ? "start_us" : "start_cyc", us ? "dur_us" : "dur_cyc");
+
+   for (int i = 0; i < count && w < sz; i++) {
+
+      e = &arr[i];
+
+      if (!e->name)
+         continue; /* Slot reserved, but not filled yet */
+
+      w += snprintk((char *)buf + w, (size_t)(sz - w),
+                    "%-32s %5d %14llu ",
+                    e->name, e->tid, boot_tl_time(e->start, base, us));
+
+      if (w >= sz)
+         break;
+
+      if (e->end)
+         w += snprintk((char *)buf + w, (size_t)(sz - w), "%14llu\n",
+                       boot_tl_time(e->end, e->start, us));
+      else
+         w += snprintk((char *)buf + w, (size_t)(sz - w), "%14s\n", "-");
+   }
+
+   kfree_array_obj(arr, struct boot_tl_event, BOOT_TL_MAX_EVENTS);
+   return MIN(w, sz);
+}
+
+static const struct sysobj_prop_type sysobj_ptype_boot_tl_table = {
+   .get_buf_sz = &boot_tl_table_get_buf_sz,
+   .load = &boot_tl_table_load,
+};
+
+/* stats/boot */
+DEF_STATIC_SYSOBJ_PROP2(prop_boot_timeline, timeline,
+                        &sysobj_ptype_boot_tl_table);
+
+static void sysfs_create_boot_tl_obj(struct sysobj *stats)
+{
+   struct sysobj *boot;
+
+   boot = sysfs_create_custom_obj(
+      "boot",
+      NULL,       /* hooks */
+      &prop_boot_timeline,    NULL,
+      NULL
+   );
+
+   if (!boot)
+      panic("Unable to create the sysfs stats/boot obj");
+
+   if (sysfs_register_obj(NULL, stats, "boot", boot))
+      panic("Unable to register the sysfs stats/boot obj");
+}
+
+void sysfs_create_stats_obj(void)
+{
+   struct sysobj *stats, *exec_cache;
+
+   stats = sysfs_create_empty_obj();
+
+   if (!stats)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, &sysfs_root_obj, "stats", stats))
+      goto fail;
+
+   exec_cache = sysfs_create_custom_obj(
+      "exec_cache",
+      NULL,       /* hooks */
+      &prop_hits,             &exec_cache_stats.hits,
+      &prop_misses,           &exec_cache_stats.misses,
+      &prop_invalidations,    &exec_cache_stats.invalidations,
+      &prop_evictions,        &exec_cache_stats.evictions,
+      &prop_entries,          &exec_cache_stats.entries,
+      NULL
+   );
+
+   if (!exec_cache)
+      goto fail;
+
+   if (sysfs_register_obj(NULL, stats, "exec_cache", exec_cache))
+      goto fail;
+
+   if (sys_stats)
+      sysfs_create_sys_stats_obj(stats);
+
+   if (KRN_LOCKSTAT)
+      sysfs_create_lockstat_obj(stats);
+
+   sysfs_create_boot_tl_obj(stats);
+
+   /* Success */
+   return;
+
+fail:
+   panic("Unable to create the sysfs stats obj");
+}
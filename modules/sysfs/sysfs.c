@@ -11,6 +11,7 @@
 #include <tilck/kernel/datetime.h>
 #include <tilck/kernel/sync.h>
 #include <tilck/kernel/rwlock.h>
+#include <tilck/kernel/lockstat.h>
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/process_mm.h>
 #include <tilck/kernel/modules.h>
@@ -25,6 +26,7 @@
 #include "lock_and_retain.c.h"
 
 void sysfs_create_config_obj(void);
+void sysfs_create_stats_obj(void);
 static struct mnt_fs *sysfs;
 
 static int
@@ -443,22 +445,16 @@ sysfs_destroy_unregistered_obj(struct sysobj *obj)
    kfree_obj(obj, struct sysobj);
 }
 
-int
-sysfs_register_obj(struct mnt_fs *fs,
-                   struct sysobj *parent,
-                   const char *name,
-                   struct sysobj *obj)
+static int
+__sysfs_register_obj(struct mnt_fs *fs,
+                     struct sysobj *parent,
+                     const char *name,
+                     struct sysobj *obj)
 {
+   struct sysfs_data *d = fs->device_data;
    struct sysfs_inode *iobj, *iparent;
-   struct sysfs_data *d;
    int rc;
 
-   if (!fs) {
-      ASSERT(sysfs != NULL);
-      fs = sysfs;
-   }
-
-   d = fs->device_data;
    ASSERT(obj != NULL);
 
    if (!parent) {
@@ -495,6 +491,28 @@ sysfs_register_obj(struct mnt_fs *fs,
    return sysfs_create_files_for_obj(fs, obj);
 }
 
+int
+sysfs_register_obj(struct mnt_fs *fs,
+                   struct sysobj *parent,
+                   const char *name,
+                   struct sysobj *obj)
+{
+   int rc;
+
+   if (!fs) {
+      ASSERT(sysfs != NULL);
+      fs = sysfs;
+   }
+
+   /* Modules can register objects concurrently: see init_modules() */
+   sysfs_exclusive_lock(fs);
+   {
+      rc = __sysfs_register_obj(fs, parent, name, obj);
+   }
+   sysfs_exclusive_unlock(fs);
+   return rc;
+}
+
 struct symlink_tmp {
 
    char path[MAX_PATH];
@@ -517,32 +535,20 @@ sysfs_get_path_to_root(struct sysobj *obj, struct sysobj **path, int pl)
    return i;
 }
 
-int
-sysfs_symlink_obj(struct mnt_fs *fs,
-                  struct sysobj *new_parent,
-                  const char *new_name,
-                  struct sysobj *obj)
+static int
+__sysfs_symlink_obj(struct mnt_fs *fs,
+                    struct sysobj *new_parent,
+                    const char *new_name,
+                    struct sysobj *obj)
 {
+   struct sysfs_data *sd = fs->device_data;
    struct symlink_tmp *tmp;
    struct sysfs_inode *link;
-   struct sysfs_data *sd;
    struct sysobj *n;
    int rc, np_nodes, obj_nodes, len;
    int i, past_lca; /* index of the lowest common ancestor + 1 */
    char *path, *path_end;
 
-   ASSERT(new_parent);
-   ASSERT(new_name);
-   ASSERT(obj);
-
-   if (!fs) {
-      /* The main sysfs must be initialized */
-      ASSERT(sysfs != NULL);
-      fs = sysfs;
-   }
-
-   sd = fs->device_data;
-
    if (!(tmp = kzalloc_obj(struct symlink_tmp)))
       goto oom;
 
@@ -635,6 +641,32 @@ oom:
    goto out;
 }
 
+int
+sysfs_symlink_obj(struct mnt_fs *fs,
+                  struct sysobj *new_parent,
+                  const char *new_name,
+                  struct sysobj *obj)
+{
+   int rc;
+
+   ASSERT(new_parent);
+   ASSERT(new_name);
+   ASSERT(obj);
+
+   if (!fs) {
+      /* The main sysfs must be initialized */
+      ASSERT(sysfs != NULL);
+      fs = sysfs;
+   }
+
+   sysfs_exclusive_lock(fs);
+   {
+      rc = __sysfs_symlink_obj(fs, new_parent, new_name, obj);
+   }
+   sysfs_exclusive_unlock(fs);
+   return rc;
+}
+
 struct mnt_fs *
 create_sysfs(void)
 {
@@ -654,6 +686,7 @@ create_sysfs(void)
    d->next_inode = 1;
    d->wrt_time = (time_t)get_timestamp();
    rwlock_wp_init(&d->rwlock, false);
+   lockstat_register_rwlock(&d->rwlock, "sysfs", -1);
    list_init(&d->dirty_handles);
    d->root = sysfs_create_inode_dir(d, NULL);
 
@@ -756,6 +789,7 @@ init_sysfs(void)
       panic("Unable to create default objects");
 
    sysfs_create_config_obj();
+   sysfs_create_stats_obj();
 }
 
 static struct module sysfs_module = {
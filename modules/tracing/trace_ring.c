@@ -0,0 +1,328 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/atomics.h>
+#include <tilck/common/tilck_trace.h>
+
+#include <tilck/kernel/sched.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/user.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/process_mm.h>
+#include <tilck/kernel/fs/devfs.h>
+#include <tilck/kernel/fs/vfs.h>
+
+#include <tilck/mods/tracing.h>
+
+#define TRACE_RING_DATA_SIZE                (128 * KB)
+#define TRACE_RING_SIZE                     (PAGE_SIZE + TRACE_RING_DATA_SIZE)
+#define TRACE_RING_RECS                                     \
+   (TRACE_RING_DATA_SIZE / sizeof(struct tilck_trace_rec))
+
+STATIC_ASSERT(sizeof(struct tilck_trace_ring_hdr) <= PAGE_SIZE);
+STATIC_ASSERT((TRACE_RING_RECS & (TRACE_RING_RECS - 1)) == 0);
+
+STATIC_ASSERT(TILCK_TRACE_SYS_ENTER == te_sys_enter);
+STATIC_ASSERT(TILCK_TRACE_SYS_EXIT == te_sys_exit);
+STATIC_ASSERT(TILCK_TRACE_SIGNAL_DELIVERED == te_signal_delivered);
+STATIC_ASSERT(TILCK_TRACE_KILLED == te_killed);
+
+/*
+ * NOTE: the header and the records are shared with the user space consumer,
+ * which can write anything there. The code below must never trust them:
+ * in the worst case, a buggy consumer can only get garbage trace records.
+ */
+static struct tilck_trace_ring_hdr *ring_hdr;
+static struct tilck_trace_rec *ring_recs;
+static int ring_handles;
+
+bool __trace_ring_on;
+
+static ALWAYS_INLINE ATOMIC(u32) *
+atomic_u32(u32 *ptr)
+{
+   return (ATOMIC(u32) *)ptr;
+}
+
+static struct tilck_trace_rec *
+trace_ring_reserve(u32 *seq)
+{
+   ATOMIC(u32) *head = atomic_u32(&ring_hdr->head);
+   u32 h, t;
+
+   h = atomic_load_explicit(head, mo_relaxed);
+
+   do {
+
+      t = atomic_load_explicit(atomic_u32(&ring_hdr->tail), mo_acquire);
+
+      if (h - t >= TRACE_RING_RECS) {
+
+         /* The ring is full: drop the record */
+         atomic_fetch_add_explicit(atomic_u32(&ring_hdr->dropped),
+                                   1, mo_relaxed);
+         return NULL;
+      }
+
+   } while (!atomic_cas_weak(head, &h, h + 1, mo_relaxed, mo_relaxed));
+
+   *seq = h;
+   return &ring_recs[h % TRACE_RING_RECS];
+}
+
+static ALWAYS_INLINE void
+trace_ring_commit(struct tilck_trace_rec *r, u32 seq)
+{
+   atomic_store_explicit(atomic_u32(&r->seq_plus_one), seq + 1, mo_release);
+}
+
+void
+trace_ring_sys_event(enum trace_event_type type,
+                     u32 sys,
+                     long retval,
+                     const ulong args[6])
+{
+   struct tilck_trace_rec *r;
+   u32 seq;
+
+   if (!(r = trace_ring_reserve(&seq)))
+      return;
+
+   r->type = (u16)type;
+   r->sys = (u16)sys;
+   r->tid = get_curr_tid();
+   r->signum = 0;
+   r->ts = get_sys_time();
+   r->retval = retval;
+   memcpy(r->args, args, sizeof(r->args));
+
+   trace_ring_commit(r, seq);
+}
+
+void
+trace_ring_signal_event(enum trace_event_type type, int tid, int signum)
+{
+   struct tilck_trace_rec *r;
+   u32 seq;
+
+   if (!(r = trace_ring_reserve(&seq)))
+      return;
+
+   r->type = (u16)type;
+   r->sys = 0;
+   r->tid = tid;
+   r->signum = signum;
+   r->ts = get_sys_time();
+   r->retval = 0;
+   bzero(r->args, sizeof(r->args));
+
+   trace_ring_commit(r, seq);
+}
+
+static int
+trace_ring_ioctl_trace_tid(int tid)
+{
+   struct task *ti;
+   int rc = 0;
+
+   disable_preemption();
+   {
+      ti = tid ? get_task(tid) : get_curr_task();
+
+      if (ti && !is_kernel_thread(ti))
+         ti->traced = true;
+      else
+         rc = -ESRCH;
+   }
+   enable_preemption();
+   return rc;
+}
+
+static int
+trace_ring_ioctl_get_sys_name(void *user_argp)
+{
+   struct tilck_trace_sys ts;
+   const char *name;
+
+   if (copy_from_user(&ts, user_argp, sizeof(ts)))
+      return -EFAULT;
+
+   if (!(name = tracing_get_syscall_name(ts.sys)))
+      return -ENOENT;
+
+   /* Skip the "sys_" prefix */
+   strncpy(ts.name, name + 4, sizeof(ts.name) - 1);
+   ts.name[sizeof(ts.name) - 1] = 0;
+
+   if (copy_to_user(user_argp, &ts, sizeof(ts)))
+      return -EFAULT;
+
+   return 0;
+}
+
+static int
+trace_ring_ioctl(fs_handle h, ulong request, void *user_argp)
+{
+   switch (request) {
+
+      case TILCK_IOCTL_TRACE_START:
+         tracing_set_enabled(true);
+         return 0;
+
+      case TILCK_IOCTL_TRACE_STOP:
+         tracing_set_enabled(false);
+         return 0;
+
+      case TILCK_IOCTL_TRACE_TID:
+         return trace_ring_ioctl_trace_tid((int)(ulong)user_argp);
+
+      case TILCK_IOCTL_TRACE_GET_SYS_NAME:
+         return trace_ring_ioctl_get_sys_name(user_argp);
+
+      default:
+         return -EINVAL;
+   }
+}
+
+static int
+trace_ring_mmap(struct user_mapping *um, pdir_t *pdir, int flags)
+{
+   const size_t pg_count = um->len >> PAGE_SHIFT;
+   size_t mapped_cnt;
+
+   ASSERT(IS_PAGE_ALIGNED(um->len));
+
+   if (flags & VFS_MM_DONT_MMAP)
+      return 0;
+
+   if (um->off != 0 || um->len > TRACE_RING_SIZE)
+      return -EINVAL;
+
+   /* The header page is writable: the consumer updates `tail` there */
+   if (map_page(pdir,
+                um->vaddrp,
+                LIN_VA_TO_PA(ring_hdr),
+                PAGING_FL_US | PAGING_FL_RW | PAGING_FL_SHARED) < 0)
+   {
+      return -ENOMEM;
+   }
+
+   mapped_cnt = map_pages(pdir,
+                          (char *)um->vaddrp + PAGE_SIZE,
+                          LIN_VA_TO_PA(ring_recs),
+                          pg_count - 1,
+                          PAGING_FL_US | PAGING_FL_SHARED);
+
+   if (mapped_cnt != pg_count - 1) {
+      unmap_pages_permissive(pdir, um->vaddrp, mapped_cnt + 1, false);
+      return -ENOMEM;
+   }
+
+   return 0;
+}
+
+static int
+trace_ring_create_extra(int minor, void *extra)
+{
+   int rc = 0;
+
+   disable_preemption();
+   {
+      if (!ring_handles) {
+
+         /* Start from a empty ring: skip everything not consumed so far */
+         atomic_store_explicit(atomic_u32(&ring_hdr->tail),
+                               atomic_load_explicit(
+                                  atomic_u32(&ring_hdr->head), mo_relaxed),
+                               mo_release);
+
+         atomic_store_explicit(atomic_u32(&ring_hdr->dropped), 0, mo_relaxed);
+         ring_handles = 1;
+         __trace_ring_on = true;
+
+      } else {
+
+         rc = -EBUSY; /* Only one consumer at a time is supported */
+      }
+   }
+   enable_preemption();
+   return rc;
+}
+
+static int
+trace_ring_on_dup_extra(int minor, void *extra)
+{
+   disable_preemption();
+   {
+      ring_handles++;
+   }
+   enable_preemption();
+   return 0;
+}
+
+static void
+trace_ring_destroy_extra(int minor, void *extra)
+{
+   disable_preemption();
+   {
+      ASSERT(ring_handles > 0);
+
+      if (!--ring_handles)
+         __trace_ring_on = false;
+   }
+   enable_preemption();
+}
+
+static int
+create_trace_ring_device(int minor,
+                         enum vfs_entry_type *type,
+                         struct devfs_file_info *nfo)
+{
+   static const struct file_ops static_ops_trace_ring = {
+      .ioctl = trace_ring_ioctl,
+      .mmap = trace_ring_mmap,
+      .munmap = generic_fs_munmap,
+   };
+
+   *type = VFS_CHAR_DEV;
+   nfo->fops = &static_ops_trace_ring;
+   nfo->spec_flags = VFS_SPFL_MMAP_SUPPORTED;
+   nfo->create_extra = &trace_ring_create_extra;
+   nfo->on_dup_extra = &trace_ring_on_dup_extra;
+   nfo->destroy_extra = &trace_ring_destroy_extra;
+   return 0;
+}
+
+void
+init_trace_ring(void)
+{
+   struct driver_info *di;
+   int major, rc;
+
+   ring_hdr = aligned_kmalloc(PAGE_SIZE, PAGE_SIZE);
+   ring_recs = aligned_kmalloc(TRACE_RING_DATA_SIZE, PAGE_SIZE);
+   di = kzalloc_obj(struct driver_info);
+
+   if (!ring_hdr || !ring_recs || !di)
+      panic("Unable to allocate the trace ring");
+
+   bzero(ring_hdr, PAGE_SIZE);
+   bzero(ring_recs, TRACE_RING_DATA_SIZE);
+
+   *ring_hdr = (struct tilck_trace_ring_hdr) {
+      .magic = TILCK_TRACE_RING_MAGIC,
+      .rec_size = sizeof(struct tilck_trace_rec),
+      .rec_count = TRACE_RING_RECS,
+      .data_off = PAGE_SIZE,
+   };
+
+   di->name = "trace";
+   di->create_dev_file = create_trace_ring_device;
+   major = register_driver(di, -1);
+
+   if ((rc = create_dev_file("trace", major, 0 /* minor */, NULL)))
+      panic("Unable to create /dev/trace (error: %d)", rc);
+}
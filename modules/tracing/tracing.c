@@ -288,6 +288,12 @@ trace_syscall_enter_int(u32 sys,
    if (si && !exp_block(si))
       return; /* don't trace the enter event */
 
+   if (trace_ring_is_active()) {
+      const ulong args[6] = {a1,a2,a3,a4,a5,a6};
+      trace_ring_sys_event(te_sys_enter, sys, 0, args);
+      return;
+   }
+
    struct trace_event e = {
 
       .type = te_sys_enter,
@@ -318,6 +324,12 @@ trace_syscall_exit_int(u32 sys,
    if (!get_curr_task()->traced)
       return; /* the current task is not traced */
 
+   if (trace_ring_is_active()) {
+      const ulong args[6] = {a1,a2,a3,a4,a5,a6};
+      trace_ring_sys_event(te_sys_exit, sys, retval, args);
+      return;
+   }
+
    struct trace_event e = {
       .type = te_sys_exit,
       .tid = get_curr_tid(),
@@ -421,6 +433,11 @@ trace_signal_delivered_int(int target_tid, int signum)
    if (!ti->traced)
       return; /* the task is not traced */
 
+   if (trace_ring_is_active()) {
+      trace_ring_signal_event(te_signal_delivered, target_tid, signum);
+      return;
+   }
+
    struct trace_event e = {
       .type = te_signal_delivered,
       .tid = target_tid,
@@ -439,6 +456,11 @@ trace_task_killed_int(int signum)
    if (!get_curr_task()->traced)
       return; /* the current task is not traced */
 
+   if (trace_ring_is_active()) {
+      trace_ring_signal_event(te_killed, get_curr_tid(), signum);
+      return;
+   }
+
    struct trace_event e = {
       .type = te_killed,
       .tid = get_curr_tid(),
@@ -907,6 +929,7 @@ init_tracing(void)
    tracing_allocate_slots_for_params();
 
    set_traced_syscalls("*");
+   init_trace_ring();
    __tracing_initialized = true;
 }
 
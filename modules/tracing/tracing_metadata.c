@@ -117,6 +117,18 @@ static const struct syscall_info __tracing_metadata[] =
       .params = { }
    },
 
+   {
+      .sys_n = SYS_clone,
+      .n_params = 3,
+      .exp_block = true,
+      .ret_type = &ptype_errno_or_val,
+      .params = {
+         SIMPLE_PARAM("flags", &ptype_voidp, sys_param_in),
+         SIMPLE_PARAM("newsp", &ptype_voidp, sys_param_in),
+         SIMPLE_PARAM("ptid", &ptype_voidp, sys_param_in),
+      }
+   },
+
    {
       .sys_n = SYS_getcwd,
       .n_params = 2,
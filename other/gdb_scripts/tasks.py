@@ -60,12 +60,21 @@ def get_proc(pid):
 
    return None
 
+def get_fdt_handles(proc):
+
+   fdt = proc['fdt']
+
+   if not fdt:
+      return None, 0
+
+   return fdt['handles'], int(fdt['size'])
+
 def get_handles(proc):
 
    handles_list = []
-   handles = proc['handles']
+   handles, size = get_fdt_handles(proc)
 
-   for i in range(bu.config.MAX_HANDLES):
+   for i in range(size):
       if handles[i]:
          handles_list.append(i)
 
@@ -73,16 +82,18 @@ def get_handles(proc):
 
 def get_handle(proc, n):
 
-   if n not in range(0, bu.config.MAX_HANDLES):
+   handles, size = get_fdt_handles(proc)
+
+   if n not in range(0, size):
       return None
 
-   return proc['handles'][n].cast(tt.fs_handle_base_p)
+   return handles[n].cast(tt.fs_handle_base_p)
 
 def get_handle_num(proc, handle_obj_ptr):
 
-   handles = proc['handles']
+   handles, size = get_fdt_handles(proc)
 
-   for i in range(bu.config.MAX_HANDLES):
+   for i in range(size):
 
       if handles[i] == handle_obj_ptr:
          return i
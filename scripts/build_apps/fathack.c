@@ -2,6 +2,7 @@
 
 #include <tilck/common/basic_defs.h>
 #include <tilck/common/fat32_base.h>
+#include <tilck/common/lz4.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,6 +40,7 @@ struct action {
 
 static u32 used_bytes;
 static u32 ff_clu_off;
+static const char *out_file;
 
 /* --- */
 
@@ -163,6 +165,200 @@ static int action_do_align(struct action_ctx *ctx)
    return 0;
 }
 
+/* --- LZ4 compressor (the decompressor is in common/lz4.c) --- */
+
+#define LZ4_HASH_BITS                          16
+#define LZ4_MFLIMIT                            12  /* last match start limit */
+#define LZ4_LAST_LITERALS                       5
+#define LZ4_MAX_OFFSET                      65535
+
+static u32 lz4_table[1 << LZ4_HASH_BITS];
+
+static inline u32 lz4_read32(const u8 *p)
+{
+   u32 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static inline u32 lz4_hash(u32 v)
+{
+   return (v * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static u8 *lz4_write_len(u8 *op, u32 len)
+{
+   for (; len >= 255; len -= 255)
+      *op++ = 255;
+
+   *op++ = (u8)len;
+   return op;
+}
+
+static u8 *
+lz4_write_seq(u8 *op, const u8 *lit, u32 lit_len, u32 off, u32 match_len)
+{
+   u8 *token = op++;
+   *token = (u8)(MIN(lit_len, 15u) << 4);
+
+   if (lit_len >= 15)
+      op = lz4_write_len(op, lit_len - 15);
+
+   memcpy(op, lit, lit_len);
+   op += lit_len;
+
+   if (!match_len)
+      return op;        /* The last sequence: only literals */
+
+   *op++ = (u8)off;
+   *op++ = (u8)(off >> 8);
+
+   match_len -= 4;
+   *token |= (u8)MIN(match_len, 15u);
+
+   if (match_len >= 15)
+      op = lz4_write_len(op, match_len - 15);
+
+   return op;
+}
+
+/*
+ * Greedy, single-probe LZ4 compressor: nothing fancy, but it's good enough for
+ * a FAT image and the output is a standard LZ4 block. Returns the compressed
+ * size, or 0 if the block is not compressible (`dst` must have `n` bytes).
+ */
+static u32 lz4_compress_block(const u8 *src, u32 n, u8 *dst)
+{
+   const u8 *ip = src, *anchor = src;
+   const u8 *const end = src + n;
+   u8 *op = dst;
+   u8 *const oend = dst + n;
+   const u8 *match;
+   u32 seq, h, len;
+
+   memset(lz4_table, 0, sizeof(lz4_table));
+
+   while (n > LZ4_MFLIMIT && ip <= end - LZ4_MFLIMIT) {
+
+      seq = lz4_read32(ip);
+      h = lz4_hash(seq);
+      match = lz4_table[h] ? src + lz4_table[h] - 1 : NULL;
+      lz4_table[h] = (u32)(ip - src) + 1;
+
+      if (!match || ip - match > LZ4_MAX_OFFSET || lz4_read32(match) != seq) {
+         ip++;
+         continue;
+      }
+
+      len = 4;
+
+      while (ip + len < end - LZ4_LAST_LITERALS && ip[len] == match[len])
+         len++;
+
+      /* Worst case for a sequence: token + lengths + literals + offset */
+      if (op + (ip - anchor) + (ip - anchor) / 255 + len / 255 + 8 > oend)
+         return 0;
+
+      op = lz4_write_seq(op, anchor, (u32)(ip - anchor), (u32)(ip - match),
+                         len);
+      ip += len;
+      anchor = ip;
+   }
+
+   len = (u32)(end - anchor);
+
+   if (op + len + len / 255 + 2 > oend)
+      return 0;
+
+   op = lz4_write_seq(op, anchor, len, 0, 0);
+   return (u32)(op - dst);
+}
+
+static int action_compress(struct action_ctx *ctx)
+{
+   const u32 bs = LZ4_RD_BLOCK_SIZE;
+   const u32 orig_size = (u32)ctx->statbuf.st_size;
+   struct lz4_rd_hdr hdr;
+   struct lz4_rd_stream stream;
+   u8 *out, *op, *check;
+   u32 n, csz, bhdr;
+   size_t out_sz;
+   FILE *fh;
+   int rc;
+
+   if (!out_file) {
+      fprintf(stderr, "ERROR: missing output file\n");
+      return 1;
+   }
+
+   out = malloc(sizeof(hdr) + orig_size + orig_size / bs * sizeof(u32) + 64);
+   check = malloc(orig_size);
+
+   if (!out || !check) {
+      fprintf(stderr, "ERROR: out of memory\n");
+      return 1;
+   }
+
+   op = out + sizeof(hdr);
+
+   for (u32 off = 0; off < orig_size; off += n) {
+
+      const u8 *src = (u8 *)ctx->vaddr + off;
+      n = MIN(bs, orig_size - off);
+      csz = lz4_compress_block(src, n, op + sizeof(u32));
+
+      if (csz) {
+         bhdr = csz;
+      } else {
+         memcpy(op + sizeof(u32), src, n);
+         bhdr = n | LZ4_RD_STORED;
+         csz = n;
+      }
+
+      memcpy(op, &bhdr, sizeof(u32));
+      op += sizeof(u32) + csz;
+   }
+
+   out_sz = (size_t)(op - out);
+   memcpy(hdr.magic, LZ4_RD_MAGIC, sizeof(hdr.magic));
+   hdr.hdr_size = sizeof(hdr);
+   hdr.block_size = bs;
+   hdr.orig_size = orig_size;
+   hdr.comp_size = (u32)(out_sz - sizeof(hdr));
+   memcpy(out, &hdr, sizeof(hdr));
+
+   /* Check the round trip with the same code used by the bootloaders */
+   ASSERT(lz4_rd_check_hdr(out));
+   lz4_rd_stream_init(&stream, out, check);
+   rc = lz4_rd_feed(&stream, out + sizeof(hdr), hdr.comp_size);
+
+   if (rc != (int)hdr.comp_size || !lz4_rd_done(&stream) ||
+       memcmp(check, ctx->vaddr, orig_size))
+   {
+      fprintf(stderr, "FATAL ERROR: LZ4 round trip failed\n");
+      return 1;
+   }
+
+   if (!(fh = fopen(out_file, "wb"))) {
+      perror("fopen() failed");
+      return 1;
+   }
+
+   if (fwrite(out, 1, out_sz, fh) != out_sz) {
+      perror("fwrite() failed");
+      fclose(fh);
+      return 1;
+   }
+
+   fclose(fh);
+   printf("INFO: compressed %u -> %zu bytes (%u%%)\n",
+          orig_size, out_sz, (u32)(100 * out_sz / orig_size));
+
+   free(check);
+   free(out);
+   return 0;
+}
+
 struct action actions[] = {
 
    {
@@ -185,6 +381,13 @@ struct action actions[] = {
       ACTIONS_2(action_calc_used_bytes, action_do_align),
       NO_ACTIONS(),
    },
+
+   {
+      {"-z", "--compress"},
+      NO_ACTIONS(),
+      ACTIONS_1(action_compress),
+      NO_ACTIONS(),
+   },
 };
 
 void show_help_and_exit(int argc, char **argv)
@@ -193,6 +396,7 @@ void show_help_and_exit(int argc, char **argv)
    printf("    %s -t, --truncate <fat part file>\n", argv[0]);
    printf("    %s -c, --calc_used_bytes <fat part file>\n", argv[0]);
    printf("    %s -a, --align_first_data_sector <fat part file>\n", argv[0]);
+   printf("    %s -z, --compress <fat part file> <lz4 out file>\n", argv[0]);
    exit(1);
 }
 
@@ -215,6 +419,7 @@ parse_opts(int argc, char **argv, struct action **a_ref, const char **file_ref)
 
    *a_ref = a;
    *file_ref = argv[2];
+   out_file = argc > 3 ? argv[3] : NULL;
    return 0;
 }
 
@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/string_util.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/self_tests.h>
+#include <tilck/kernel/kmalloc.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/blkdev.h>
+
+#define SE_BLK_SECTORS                            256   /* 128 KB */
+#define SE_BLK_SIZE             (SE_BLK_SECTORS * BLK_SECTOR_SIZE)
+#define SE_BLK_PAGES                    (SE_BLK_SIZE / PAGE_SIZE)
+
+static u8 *se_blk_data;
+static u32 se_blk_xfers;
+
+/* A fake RAM-backed block device */
+static int se_blk_xfer(struct blkdev *dev, struct blk_req *req)
+{
+   struct blk_bio *bio;
+   u64 sector = req->sector;
+
+   VERIFY(req->count <= dev->max_sectors);
+
+   list_for_each_ro(bio, &req->bios, node) {
+
+      void *disk = se_blk_data + sector * BLK_SECTOR_SIZE;
+      const size_t len = bio->count * BLK_SECTOR_SIZE;
+
+      VERIFY(bio->sector == sector);
+
+      if (bio->write)
+         memcpy(disk, bio->buf, len);
+      else
+         memcpy(bio->buf, disk, len);
+
+      sector += bio->count;
+   }
+
+   VERIFY(sector == req->sector + req->count);
+   se_blk_xfers++;
+   return 0;
+}
+
+static const struct blkdev_ops se_blk_ops = {
+   .xfer = &se_blk_xfer,
+};
+
+static void se_blk_check(struct blkdev *dev, u64 off, size_t len, u8 *buf)
+{
+   VERIFY(blkdev_read(dev, off, buf, len) == (ssize_t)len);
+   VERIFY(!memcmp(buf, se_blk_data + off, len));
+}
+
+void selftest_blkdev(void)
+{
+   static struct blkdev dev;
+   u8 *buf;
+
+   se_blk_data = kmalloc(SE_BLK_SIZE);
+   buf = kmalloc(SE_BLK_SIZE);
+   VERIFY(se_blk_data && buf);
+
+   for (u32 i = 0; i < SE_BLK_SIZE; i++)
+      se_blk_data[i] = (u8)(i * 7 + i / 512);
+
+   dev = (struct blkdev) {
+      .name = "se_blk",
+      .nr_sectors = SE_BLK_SECTORS,
+      .max_sectors = BLK_READAHEAD_PAGES * BLK_SECTORS_PER_PAGE,
+      .ops = &se_blk_ops,
+      .pc_max_pages = 2 * BLK_READAHEAD_PAGES,
+   };
+
+   blkdev_init(&dev);
+   se_blk_xfers = 0;
+
+   /* A miss reads-ahead BLK_READAHEAD_PAGES pages, in a single request */
+   se_blk_check(&dev, 100, 64, buf);
+   printk("[se_blkdev] bios: %llu, reqs: %llu, merges: %llu\n",
+          dev.stats.bios, dev.stats.reqs, dev.stats.merges);
+
+   VERIFY(se_blk_xfers == 1);
+   VERIFY(dev.stats.bios == BLK_READAHEAD_PAGES);
+   VERIFY(dev.stats.merges == BLK_READAHEAD_PAGES - 1);
+   VERIFY(dev.stats.pc_misses == 1);
+   VERIFY(dev.pc_pages == BLK_READAHEAD_PAGES);
+
+   /* The read-ahead pages are now hits: no more I/O */
+   se_blk_check(&dev, 0, BLK_READAHEAD_PAGES * PAGE_SIZE, buf);
+   VERIFY(se_blk_xfers == 1);
+   VERIFY(dev.stats.pc_hits == BLK_READAHEAD_PAGES);
+
+   /* Unaligned write-through, across two pages */
+   memset(buf, 0xaa, 1000);
+   VERIFY(blkdev_write(&dev, PAGE_SIZE - 300, buf, 1000) == 1000);
+   VERIFY(se_blk_data[PAGE_SIZE - 301] != 0xaa);
+   VERIFY(se_blk_data[PAGE_SIZE - 300] == 0xaa);
+   VERIFY(se_blk_data[PAGE_SIZE + 699] == 0xaa);
+   VERIFY(se_blk_data[PAGE_SIZE + 700] != 0xaa);
+   se_blk_check(&dev, PAGE_SIZE - 512, 2048, buf);
+
+   /* Read the whole device: the cache must evict the LRU pages */
+   se_blk_check(&dev, 0, SE_BLK_SIZE, buf);
+   printk("[se_blkdev] xfers: %u, evictions: %llu\n",
+          se_blk_xfers, dev.stats.pc_evictions);
+
+   VERIFY(dev.pc_pages == dev.pc_max_pages);
+   VERIFY(dev.stats.pc_evictions >= SE_BLK_PAGES - dev.pc_max_pages);
+
+   /* Full-page writes on evicted pages don't need to read them first */
+   se_blk_xfers = 0;
+   memset(buf, 0x55, 2 * PAGE_SIZE);
+   VERIFY(blkdev_write(&dev, 0, buf, 2 * PAGE_SIZE) == 2 * PAGE_SIZE);
+   VERIFY(se_blk_xfers == 1);
+   VERIFY(se_blk_data[0] == 0x55 && se_blk_data[2 * PAGE_SIZE - 1] == 0x55);
+   se_blk_check(&dev, 0, 3 * PAGE_SIZE, buf);
+
+   /* Out of range I/O */
+   VERIFY(blkdev_read(&dev, SE_BLK_SIZE, buf, 1) == 0);
+   VERIFY(blkdev_write(&dev, SE_BLK_SIZE, buf, 1) == -ENOSPC);
+   VERIFY(blkdev_read(&dev, SE_BLK_SIZE - 10, buf, 100) == 10);
+
+   blkdev_destroy(&dev);
+   VERIFY(dev.pc_pages == 0);
+
+   kfree2(buf, SE_BLK_SIZE);
+   kfree2(se_blk_data, SE_BLK_SIZE);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(blkdev, se_short, &selftest_blkdev)
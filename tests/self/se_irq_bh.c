@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/self_tests.h>
+#include <tilck/kernel/worker_thread.h>
+#include <tilck/kernel/irq_bh.h>
+#include <tilck/kernel/sched.h>
+
+static struct irq_bh se_bh;
+static u32 se_bh_runs;
+
+static void se_bh_func(void *ctx)
+{
+   se_bh_runs++;
+}
+
+void selftest_irq_bh(void)
+{
+   const u32 n = 10;
+   u32 runs_before;
+   int rc;
+
+   if (!se_bh.func) {
+
+      rc = irq_bh_init(&se_bh, "selftest", -1, IRQ_BH_MAX_PRIO, &se_bh_func,
+                       NULL);
+
+      VERIFY(rc == 0);
+   }
+
+   runs_before = se_bh.stats.runs;
+   se_bh_runs = 0;
+
+   /* The BH cannot run before we enable the preemption: it must coalesce */
+   disable_preemption();
+   {
+      for (u32 i = 0; i < n; i++)
+         VERIFY(irq_bh_schedule(&se_bh));
+
+      VERIFY(se_bh.pending);
+   }
+   enable_preemption();
+   wth_wait_for_completion(se_bh.wth);
+
+   printk("[se_irq_bh] runs: %u, coalesced: %u, max latency: %llu cycles\n",
+          se_bh_runs, se_bh.stats.coalesced, se_bh.stats.lat_max);
+
+   VERIFY(se_bh_runs == 1);
+   VERIFY(se_bh.stats.runs == runs_before + 1);
+   VERIFY(!se_bh.pending);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(irq_bh, se_short, &selftest_irq_bh)
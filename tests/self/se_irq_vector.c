@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <tilck_gen_headers/mod_pci.h>
+
+#include <tilck/common/basic_defs.h>
+#include <tilck/common/printk.h>
+
+#include <tilck/kernel/self_tests.h>
+#include <tilck/kernel/irq.h>
+#include <tilck/kernel/hal.h>
+#include <tilck/kernel/errno.h>
+#include <tilck/kernel/timer.h>
+#include <tilck/kernel/paging.h>
+#include <tilck/kernel/arch/generic_x86/lapic.h>
+#include <tilck/kernel/arch/generic_x86/ioapic.h>
+
+#include <tilck/mods/pci.h>
+
+static volatile u32 se_vector_hits;
+
+static enum irq_action se_vector_handler(void *ctx)
+{
+   se_vector_hits++;
+   return IRQ_HANDLED;
+}
+
+DEFINE_IRQ_HANDLER_NODE(se_vector_node, &se_vector_handler, NULL);
+
+/*
+ * Allocate a dedicated vector and raise it with self-IPIs: they're delivered
+ * through the LAPIC exactly like MSI interrupts.
+ */
+void selftest_irq_vector(void)
+{
+   const u32 n = 10;
+   int vec;
+
+   if (!lapic_is_available()) {
+      printk("[se_irq_vector] LAPIC not available: skip\n");
+      se_regular_end();
+      return;
+   }
+
+   vec = irq_alloc_vector(&se_vector_node);
+   VERIFY(vec >= IRQ_DYN_VECTOR_BASE);
+   se_vector_hits = 0;
+
+   for (u32 i = 0; i < n; i++) {
+      VERIFY(lapic_send_ipi(0, LAPIC_ICR_DEST_SELF | (u32)vec) == 0);
+   }
+
+   printk("[se_irq_vector] vector: %#x, hits: %u\n", vec, se_vector_hits);
+   irq_free_vector(vec);
+
+   VERIFY(se_vector_hits == n);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(irq_vector, se_short, &selftest_irq_vector)
+
+/*
+ * Route the PIT's IRQ through the IOAPIC to a dedicated vector. The PIC keeps
+ * delivering it as well, so the timer keeps working meanwhile. The IOAPICs are
+ * found in the MADT table: therefore, the test is skipped when booting with
+ * -noacpi.
+ */
+void selftest_ioapic(void)
+{
+   u32 gsi, flags;
+   int vec, rc;
+
+   if (!lapic_is_available()) {
+      printk("[se_ioapic] LAPIC not available: skip\n");
+      se_regular_end();
+      return;
+   }
+
+   vec = irq_alloc_vector(&se_vector_node);
+   VERIFY(vec >= IRQ_DYN_VECTOR_BASE);
+   se_vector_hits = 0;
+
+   gsi = ioapic_isa_irq_to_gsi(X86_PC_TIMER_IRQ, &flags);
+   rc = ioapic_route_gsi(gsi, vec, flags);
+
+   if (rc == -ENODEV) {
+      printk("[se_ioapic] IOAPIC not available: skip\n");
+      irq_free_vector(vec);
+      se_regular_end();
+      return;
+   }
+
+   VERIFY(rc == 0);
+   kernel_sleep(TIMER_HZ / 10);
+   VERIFY(ioapic_mask_gsi(gsi) == 0);
+
+   printk("[se_ioapic] GSI: %u, vector: %#x, hits: %u\n",
+          gsi, vec, se_vector_hits);
+
+   irq_free_vector(vec);
+   VERIFY(se_vector_hits > 0);
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(ioapic, se_short, &selftest_ioapic)
+
+#if MOD_pci
+
+/* QEMU's educational PCI device (-device edu), see docs/specs/edu.rst */
+#define EDU_VENDOR_ID                          0x1234
+#define EDU_DEVICE_ID                          0x11e8
+
+#define EDU_REG_IRQ_STATUS                  (0x24 / 4)
+#define EDU_REG_IRQ_RAISE                   (0x60 / 4)
+#define EDU_REG_IRQ_ACK                     (0x64 / 4)
+
+static volatile u32 *se_edu_regs;
+
+static enum irq_action se_edu_handler(void *ctx)
+{
+   se_edu_regs[EDU_REG_IRQ_ACK] = se_edu_regs[EDU_REG_IRQ_STATUS];
+   se_vector_hits++;
+   return IRQ_HANDLED;
+}
+
+DEFINE_IRQ_HANDLER_NODE(se_edu_node, &se_edu_handler, NULL);
+
+/*
+ * Enable MSI on the QEMU edu device, which raises an interrupt every time its
+ * IRQ_RAISE register is written, and check that all of them get delivered.
+ */
+void selftest_pci_msi(void)
+{
+   const u32 n = 10;
+   const u32 pg_flags = PAGING_FL_RW | PAGING_FL_SHARED;
+   struct pci_device *dev;
+   u64 paddr;
+   u32 cmd, i, t;
+   void *va;
+   int vec;
+
+   dev = pci_find_device(EDU_VENDOR_ID, EDU_DEVICE_ID);
+
+   if (!lapic_is_available() || !dev) {
+      printk("[se_pci_msi] LAPIC or QEMU edu device not available: skip\n");
+      se_regular_end();
+      return;
+   }
+
+   VERIFY(dev->msi_cap != 0);
+   VERIFY(pci_get_mem_bar(dev->loc, 0, &paddr) == 0);
+   VERIFY(pci_config_read(dev->loc, PCI_COMMAND_OFF, 16, &cmd) == 0);
+   VERIFY(cmd & PCI_COMMAND_MEM_SPACE);
+
+   /* The MSI messages are memory writes: the device must be a bus master */
+   VERIFY(pci_config_write(dev->loc, PCI_COMMAND_OFF, 16,
+                           cmd | PCI_COMMAND_BUS_MASTER) == 0);
+
+   VERIFY((va = hi_vmem_reserve(PAGE_SIZE)) != NULL);
+   VERIFY(paddr < 0xffffffff);
+   VERIFY(map_kernel_page(va, (ulong)paddr, pg_flags) == 0);
+   se_edu_regs = va;
+   se_vector_hits = 0;
+
+   vec = pci_enable_msi(dev, &se_edu_node);
+   VERIFY(vec >= IRQ_DYN_VECTOR_BASE);
+
+   for (i = 0; i < n; i++) {
+
+      se_edu_regs[EDU_REG_IRQ_RAISE] = 1;
+
+      /* Don't raise the next one before this one is handled: they'd merge */
+      for (t = 0; se_vector_hits == i && t < TIMER_HZ; t++)
+         kernel_sleep(1);
+   }
+
+   printk("[se_pci_msi] vector: %#x, hits: %u\n", vec, se_vector_hits);
+
+   pci_disable_msi(dev);
+   pci_config_write(dev->loc, PCI_COMMAND_OFF, 16, cmd);
+   unmap_kernel_page(va, false);
+   hi_vmem_release(va, PAGE_SIZE);
+   se_edu_regs = NULL;
+
+   VERIFY(se_vector_hits == n);
+   se_regular_end();
+}
+
+#else
+
+void selftest_pci_msi(void)
+{
+   printk("[se_pci_msi] PCI module not available: skip\n");
+   se_regular_end();
+}
+
+#endif
+
+REGISTER_SELF_TEST(pci_msi, se_short, &selftest_pci_msi)
@@ -428,3 +428,99 @@ end:
 }
 
 REGISTER_SELF_TEST(kmutex_ord, se_med, &selftest_kmutex_ord)
+
+/* -------------------------------------------------- */
+/*               Contention perf test                 */
+/* -------------------------------------------------- */
+
+/*
+ * Measure the throughput of kmutex under contention, with and without the
+ * optimistic waiting in kmutex_lock(). Each thread runs many short critical
+ * sections and, every few iterations, yields while holding the mutex in order
+ * to simulate a preemption in the middle of a critical section, which is what
+ * makes the other threads find the mutex owned.
+ */
+
+#define KMUTEX_PERF_TH_COUNT            4
+#define KMUTEX_PERF_ITERS           50000
+#define KMUTEX_PERF_YIELD_PERIOD       16
+#define KMUTEX_PERF_CS_LOOPS          100
+
+static volatile u32 kmutex_perf_counter;
+
+static void kmutex_perf_thread(void *unused)
+{
+   for (int iter = 0; iter < KMUTEX_PERF_ITERS; iter++) {
+
+      if (UNLIKELY(se_is_stop_requested()))
+         break;
+
+      kmutex_lock(&test_mutex);
+      {
+         for (int i = 0; i < KMUTEX_PERF_CS_LOOPS; i++)
+            asmVolatile("nop");
+
+         kmutex_perf_counter++;
+
+         if ((iter % KMUTEX_PERF_YIELD_PERIOD) == 0)
+            kernel_yield();
+      }
+      kmutex_unlock(&test_mutex);
+   }
+}
+
+static void kmutex_perf_run(const char *name, u32 flags)
+{
+   int local_tids[KMUTEX_PERF_TH_COUNT];
+   u64 start, duration, start_ticks, ticks;
+   const u32 expected = KMUTEX_PERF_TH_COUNT * KMUTEX_PERF_ITERS;
+
+   kmutex_init(&test_mutex, flags);
+   kmutex_perf_counter = 0;
+
+   start_ticks = get_ticks();
+   start = RDTSC();
+
+   for (int i = 0; i < KMUTEX_PERF_TH_COUNT; i++) {
+      local_tids[i] = kthread_create(kmutex_perf_thread, 0, NULL);
+      VERIFY(local_tids[i] > 0);
+   }
+
+   kthread_join_all(local_tids, ARRAY_SIZE(local_tids), true);
+
+   duration = RDTSC() - start;
+   ticks = get_ticks() - start_ticks;
+
+   if (!se_is_stop_requested()) {
+
+      VERIFY(kmutex_perf_counter == expected);
+
+      printk("[%-8s] %u lock/unlock pairs in %" PRIu64 " ticks, "
+             "cycles per pair: %" PRIu64 "\n",
+             name, expected, ticks, duration / expected);
+
+#if KMUTEX_STATS_ENABLED
+      printk("[%-8s] max waiters: %u, acquired after yielding: %u\n",
+             name, test_mutex.max_num_waiters, test_mutex.num_spin_acquired);
+#endif
+   }
+
+   kmutex_destroy(&test_mutex);
+}
+
+void selftest_kmutex_perf(void)
+{
+   printk("*** kmutex contention perf test ***\n");
+   printk("threads: %d, critical sections: ~%d nops, yield every %d iters\n",
+          KMUTEX_PERF_TH_COUNT, KMUTEX_PERF_CS_LOOPS, KMUTEX_PERF_YIELD_PERIOD);
+
+   kmutex_perf_run("sleep", KMUTEX_FL_NO_SPIN);
+   kmutex_perf_run("adaptive", 0);
+
+   if (se_is_stop_requested())
+      se_interrupted_end();
+   else
+      se_regular_end();
+}
+
+REGISTER_SELF_TEST(kmutex_perf, se_long, &selftest_kmutex_perf)
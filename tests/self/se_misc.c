@@ -8,6 +8,8 @@
 #include <tilck/kernel/paging.h>
 #include <tilck/kernel/sched.h>
 #include <tilck/kernel/timer.h>
+#include <tilck/kernel/datetime.h>
+#include <tilck/kernel/hrtimer.h>
 
 void simple_test_kthread(void *arg)
 {
@@ -86,6 +88,33 @@ void selftest_sleep()
 
 REGISTER_SELF_TEST(sleep, se_short, &selftest_sleep)
 
+void selftest_sleep_ns()
+{
+   static const u64 durations[] = {
+      50 * 1000, 300 * 1000, 1 * MILLION, 2500 * 1000, 10 * MILLION
+   };
+
+   printk("[sleep_ns] hrtimer backend: %s\n", hrtimer_get_backend_name());
+
+   for (int i = 0; i < ARRAY_SIZE(durations); i++) {
+
+      u64 before = get_sys_time();
+      kernel_sleep_ns(durations[i]);
+      u64 elapsed = get_sys_time() - before;
+
+      printk("[sleep_ns] requested: %7" PRIu64 " us, elapsed: %7" PRIu64
+             " us\n", durations[i] / 1000, elapsed / 1000);
+
+      /* Never wake up early; late at most by a tick (+ some slack) */
+      VERIFY(elapsed >= durations[i]);
+      VERIFY(elapsed - durations[i] <= 2 * BILLION / TIMER_HZ);
+   }
+
+   se_regular_end();
+}
+
+REGISTER_SELF_TEST(sleep_ns, se_short, &selftest_sleep_ns)
+
 void selftest_join()
 {
    int tid;
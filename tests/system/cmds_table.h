@@ -22,7 +22,10 @@ CMD_ENTRY(bad_read,     TT_SHORT,  true)
 CMD_ENTRY(bad_write,    TT_SHORT,  true)
 CMD_ENTRY(fork_perf,    TT_LONG,   true)
 CMD_ENTRY(vfork_perf,   TT_LONG,   true)
+CMD_ENTRY(exec_perf,    TT_LONG,   true)
+CMD_ENTRY(spawn_perf,   TT_LONG,   true)
 CMD_ENTRY(syscall_perf, TT_MED,    true)
+CMD_ENTRY(vdso_perf,    TT_MED,    true)
 CMD_ENTRY(fpu,          TT_SHORT,  true)
 CMD_ENTRY(brk,          TT_SHORT,  true)
 CMD_ENTRY(mmap,         TT_MED,    true)
@@ -43,6 +46,8 @@ CMD_ENTRY(sigabrt,      TT_SHORT,  true)
 CMD_ENTRY(sig_ignore,   TT_SHORT,  true)
 CMD_ENTRY(bigargv,      TT_SHORT,  true)
 CMD_ENTRY(cloexec,      TT_SHORT,  true)
+CMD_ENTRY(fdtable,      TT_SHORT,  true)
+CMD_ENTRY(fdoffsets,    TT_SHORT,  true)
 CMD_ENTRY(fs1,          TT_SHORT,  true)
 CMD_ENTRY(fs2,          TT_SHORT,  true)
 CMD_ENTRY(fs3,          TT_SHORT,  true)
@@ -64,6 +69,10 @@ CMD_ENTRY(pipe2,        TT_SHORT,  true)
 CMD_ENTRY(pipe3,        TT_SHORT,  true)
 CMD_ENTRY(pipe4,        TT_SHORT,  true)
 CMD_ENTRY(pipe5,        TT_SHORT,  true)
+CMD_ENTRY(pipe6,        TT_SHORT,  true)
+CMD_ENTRY(pipe_perf,    TT_MED,    true)
+CMD_ENTRY(uring1,       TT_SHORT,  true)
+CMD_ENTRY(uring_perf,   TT_MED,    true)
 CMD_ENTRY(pollerr,      TT_SHORT,  true)
 CMD_ENTRY(pollhup,      TT_SHORT,  true)
 CMD_ENTRY(poll1,        TT_SHORT,  true)
@@ -98,3 +107,4 @@ CMD_ENTRY(sigsegv5,     TT_SHORT,  true)
 CMD_ENTRY(getuids,      TT_SHORT,  true)
 CMD_ENTRY(getrusage,    TT_SHORT,  true)
 CMD_ENTRY(exit_cb,      TT_SHORT,  true)
+CMD_ENTRY(dsp,          TT_MED,    true)
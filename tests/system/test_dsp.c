@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "devshell.h"
+
+#define SB16_SYSFS_DIR                      "/syst/hw/media/sb16"
+#define PLAY_PATH                           "/initrd/usr/bin/play"
+
+struct dsp_stats {
+   unsigned long played_bytes;
+   unsigned long underruns;
+   unsigned long started;
+};
+
+static int read_dsp_stat(const char *name, unsigned long *val)
+{
+   char path[128];
+   char buf[32] = {0};
+   int fd, rc;
+
+   sprintf(path, SB16_SYSFS_DIR "/%s", name);
+
+   if ((fd = open(path, O_RDONLY)) < 0)
+      return -1;
+
+   rc = read(fd, buf, sizeof(buf) - 1);
+   close(fd);
+
+   if (rc <= 0)
+      return -1;
+
+   *val = strtoul(buf, NULL, 10);
+   return 0;
+}
+
+static int read_dsp_stats(struct dsp_stats *st)
+{
+   if (read_dsp_stat("dsp_played_bytes", &st->played_bytes) < 0)
+      return -1;
+
+   if (read_dsp_stat("dsp_underruns", &st->underruns) < 0)
+      return -1;
+
+   if (read_dsp_stat("dsp_started", &st->started) < 0)
+      return -1;
+
+   return 0;
+}
+
+/*
+ * Play the test sound through /dev/dsp with `play --dsp`, which already checks
+ * the stats by itself, and check them here as well. Requires QEMU's
+ * `-device sb16`, which the test runner passes.
+ */
+int cmd_dsp(int argc, char **argv)
+{
+   struct dsp_stats before, after;
+   int pid, wstatus;
+
+   if (access(SB16_SYSFS_DIR, F_OK) < 0) {
+      printf(PFX "[SKIP] because the sb16 device is not present\n");
+      return 0;
+   }
+
+   if (access(PLAY_PATH, X_OK) < 0) {
+      printf(PFX "[SKIP] because '%s' is not present\n", PLAY_PATH);
+      return 0;
+   }
+
+   DEVSHELL_CMD_ASSERT(read_dsp_stats(&before) == 0);
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid) {
+      execl(PLAY_PATH, "play", "--dsp", "--test", NULL);
+      _exit(127); // execl() failed
+   }
+
+   DEVSHELL_CMD_ASSERT(waitpid(pid, &wstatus, 0) == pid);
+   DEVSHELL_CMD_ASSERT(read_dsp_stats(&after) == 0);
+
+   printf(PFX "played: %lu bytes, underruns: %lu, started: %lu times\n",
+          after.played_bytes - before.played_bytes,
+          after.underruns - before.underruns,
+          after.started - before.started);
+
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+   DEVSHELL_CMD_ASSERT(after.played_bytes > before.played_bytes);
+   DEVSHELL_CMD_ASSERT(after.underruns == before.underruns);
+   DEVSHELL_CMD_ASSERT(after.started > before.started);
+   return 0;
+}
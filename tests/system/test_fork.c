@@ -13,10 +13,13 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <spawn.h>
 
 #include "devshell.h"
 #include "sysenter.h"
 
+extern char **environ;
+
 static int sysenter_fork(void)
 {
    return sysenter_call0(2 /* fork */);
@@ -136,6 +139,151 @@ int cmd_vfork_perf(int argc, char **argv)
    return do_fork_perf(&vfork);
 }
 
+typedef int (*spawn_func)(const char *path);
+
+static int spawn_with_fork(const char *path)
+{
+   int child_pid = fork();
+
+   if (!child_pid) {
+      execl(path, path, NULL);
+      _exit(127); // execl() failed
+   }
+
+   return child_pid;
+}
+
+static int spawn_with_vfork(const char *path)
+{
+   int child_pid = vfork();
+
+   if (!child_pid) {
+      execl(path, path, NULL);
+      _exit(127); // execl() failed
+   }
+
+   return child_pid;
+}
+
+static int spawn_with_posix_spawn(const char *path)
+{
+   char *const args[] = { (char *)path, NULL };
+   int rc, child_pid;
+
+   rc = posix_spawn(&child_pid, path, NULL, NULL, args, environ);
+
+   if (rc) {
+      errno = rc;
+      return -1;
+   }
+
+   return child_pid;
+}
+
+static int spawn_with_posix_spawn_fa(const char *path)
+{
+   char *const args[] = { (char *)path, NULL };
+   posix_spawn_file_actions_t fa;
+   int rc, child_pid;
+
+   posix_spawn_file_actions_init(&fa);
+   posix_spawn_file_actions_adddup2(&fa, 1, 2);
+   rc = posix_spawn(&child_pid, path, &fa, NULL, args, environ);
+   posix_spawn_file_actions_destroy(&fa);
+
+   if (rc) {
+      errno = rc;
+      return -1;
+   }
+
+   return child_pid;
+}
+
+static int
+do_exec_perf(const char *path, const char *name, spawn_func spawn)
+{
+   const int iters = 2000;
+   int rc, wstatus, child_pid;
+   ull_t start, duration;
+
+   start = RDTSC();
+
+   for (int i = 0; i < iters; i++) {
+
+      child_pid = spawn(path);
+
+      if (child_pid < 0) {
+         printf("%s failed: %s\n", name, strerror(errno));
+         return 1;
+      }
+
+      rc = waitpid(child_pid, &wstatus, 0);
+
+      if (rc != child_pid) {
+         printf("waitpid() returned %d [expected: %d]\n", rc, child_pid);
+         return 1;
+      }
+
+      if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+         printf("Unexpected exit status for '%s'\n", path);
+         print_waitpid_change(child_pid, wstatus);
+         return 1;
+      }
+   }
+
+   duration = RDTSC() - start;
+   printf("Avg. %-28s cost: %llu cycles\n", name, duration / iters);
+   return 0;
+}
+
+static bool check_exec_perf_path(const char *path)
+{
+   struct stat statbuf;
+
+   if (stat(path, &statbuf) < 0) {
+      printf(PFX "[SKIP] because '%s' is not present\n", path);
+      return false;
+   }
+
+   return true;
+}
+
+int cmd_exec_perf(int argc, char **argv)
+{
+   const char *path = argc > 0 ? argv[0] : "/bin/true";
+
+   if (!check_exec_perf_path(path))
+      return 0;
+
+   printf("Measuring vfork() + execve('%s') + waitpid() latency\n", path);
+   return do_exec_perf(path, "vfork() + execve()", &spawn_with_vfork);
+}
+
+int cmd_spawn_perf(int argc, char **argv)
+{
+   const char *path = argc > 0 ? argv[0] : "/bin/true";
+   int rc;
+
+   if (!check_exec_perf_path(path))
+      return 0;
+
+   printf("Comparing the ways to spawn '%s' (+ waitpid)\n", path);
+
+   if ((rc = do_exec_perf(path, "fork() + execve()", &spawn_with_fork)))
+      return rc;
+
+   if ((rc = do_exec_perf(path, "vfork() + execve()", &spawn_with_vfork)))
+      return rc;
+
+   if ((rc = do_exec_perf(path, "posix_spawn()", &spawn_with_posix_spawn)))
+      return rc;
+
+   rc = do_exec_perf(path,
+                     "posix_spawn() + file actions",
+                     &spawn_with_posix_spawn_fa);
+   return rc;
+}
+
 int cmd_execve0(int argc, char **argv)
 {
    int rc, pid, wstatus;
@@ -14,6 +14,7 @@
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/auxv.h>
 
 #include "devshell.h"
 #include "sysenter.h"
@@ -147,6 +148,94 @@ int cmd_syscall_perf(int argc, char **argv)
    return 0;
 }
 
+static void do_clock_gettime(bool use_syscall, struct timespec *ts)
+{
+   if (use_syscall)
+      syscall(SYS_clock_gettime, CLOCK_REALTIME, ts);
+   else
+      clock_gettime(CLOCK_REALTIME, ts); /* uses the vDSO, if available */
+}
+
+static ull_t ts_to_ns(const struct timespec *ts)
+{
+   return (ull_t)ts->tv_sec * 1000000000ull + (ull_t)ts->tv_nsec;
+}
+
+static ull_t clock_gettime_cycles(bool use_syscall)
+{
+   const int major_iters = 100;
+   const int iters = 1000;
+   struct timespec ts;
+   ull_t start, duration;
+   ull_t best = (ull_t) -1;
+
+   for (int j = 0; j < major_iters; j++) {
+
+      start = RDTSC();
+
+      for (int i = 0; i < iters; i++)
+         do_clock_gettime(use_syscall, &ts);
+
+      duration = RDTSC() - start;
+
+      if (duration < best)
+         best = duration;
+   }
+
+   return best / iters;
+}
+
+static ull_t clock_gettime_calls_per_sec(bool use_syscall)
+{
+   const ull_t window = 250 * 1000 * 1000; /* 250 ms */
+   struct timespec ts;
+   ull_t start, elapsed, calls = 0;
+
+   do_clock_gettime(use_syscall, &ts);
+   start = ts_to_ns(&ts);
+
+   do {
+
+      for (int i = 0; i < 100; i++)
+         do_clock_gettime(use_syscall, &ts);
+
+      calls += 100;
+      elapsed = ts_to_ns(&ts) - start;
+
+   } while (elapsed < window);
+
+   return calls * 1000000000ull / elapsed;
+}
+
+int cmd_vdso_perf(int argc, char **argv)
+{
+   struct timespec ts;
+   ull_t t, prev = 0;
+
+   printf("vDSO: %p\n", (void *)getauxval(AT_SYSINFO_EHDR));
+
+   /* The vDSO time must never go backwards and must match the syscall */
+   for (int i = 0; i < 100 * 1000; i++) {
+      do_clock_gettime(false, &ts);
+      t = ts_to_ns(&ts);
+      DEVSHELL_CMD_ASSERT(t >= prev);
+      prev = t;
+   }
+
+   do_clock_gettime(true, &ts);
+   t = ts_to_ns(&ts);
+   DEVSHELL_CMD_ASSERT(t + 10 * 1000 * 1000 >= prev);   /* 10 ms tolerance */
+   DEVSHELL_CMD_ASSERT(t < prev + 1000 * 1000 * 1000);
+
+   printf("syscall clock_gettime(): %llu cycles, %llu calls/sec\n",
+          clock_gettime_cycles(true), clock_gettime_calls_per_sec(true));
+
+   printf("vDSO    clock_gettime(): %llu cycles, %llu calls/sec\n",
+          clock_gettime_cycles(false), clock_gettime_calls_per_sec(false));
+
+   return 0;
+}
+
 int cmd_fpu(int argc, char **argv)
 {
    long double e = 1.0;
@@ -273,6 +362,192 @@ int cmd_cloexec(int argc, char **argv)
    return WEXITSTATUS(wstatus);
 }
 
+#ifndef SYS_close_range
+   #define SYS_close_range          436
+#endif
+
+#ifndef CLOSE_RANGE_CLOEXEC
+   #define CLOSE_RANGE_CLOEXEC      (1U << 2)
+#endif
+
+#define FDTABLE_TEST_FDS          1000
+
+static int fdtable_child(int first_fd)
+{
+   int rc;
+
+   /* The child must see all the parent's fds */
+   for (int fd = first_fd; fd < first_fd + FDTABLE_TEST_FDS; fd++) {
+      if (fcntl(fd, F_GETFD) < 0) {
+         printf("[child] fd %d is not valid\n", fd);
+         return 1;
+      }
+   }
+
+   /* Closing fds in the child must not affect the parent */
+   rc = syscall(SYS_close_range, first_fd, ~0U, 0);
+
+   if (rc < 0) {
+      perror("[child] close_range() failed");
+      return 1;
+   }
+
+   if (fcntl(first_fd, F_GETFD) >= 0 || errno != EBADF) {
+      printf("[child] fd %d still valid after close_range()\n", first_fd);
+      return 1;
+   }
+
+   return 0;
+}
+
+int cmd_fdtable(int argc, char **argv)
+{
+   int fd, first_fd, pid, wstatus, rc;
+
+   first_fd = dup(0);
+   DEVSHELL_CMD_ASSERT(first_fd >= 0);
+
+   /* Force the fd table to grow: dup() must always return the lowest fd */
+   for (int i = 1; i < FDTABLE_TEST_FDS; i++) {
+
+      fd = dup(0);
+
+      if (fd != first_fd + i) {
+         printf("dup() returned %d, expected: %d\n", fd, first_fd + i);
+         return 1;
+      }
+   }
+
+   /* Make a hole and check that it gets re-used */
+   close(first_fd + 500);
+   DEVSHELL_CMD_ASSERT(dup(0) == first_fd + 500);
+
+   pid = fork();
+   DEVSHELL_CMD_ASSERT(pid >= 0);
+
+   if (!pid)
+      exit(fdtable_child(first_fd));
+
+   waitpid(pid, &wstatus, 0);
+   DEVSHELL_CMD_ASSERT(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+
+   /* The parent's fds must still be there */
+   for (fd = first_fd; fd < first_fd + FDTABLE_TEST_FDS; fd++)
+      DEVSHELL_CMD_ASSERT(fcntl(fd, F_GETFD) == 0);
+
+   /* Mark the second half of the fds as FD_CLOEXEC */
+   rc = syscall(SYS_close_range,
+                first_fd + FDTABLE_TEST_FDS / 2,
+                first_fd + FDTABLE_TEST_FDS - 1,
+                CLOSE_RANGE_CLOEXEC);
+
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(fcntl(first_fd, F_GETFD) == 0);
+   DEVSHELL_CMD_ASSERT(fcntl(first_fd + FDTABLE_TEST_FDS - 1, F_GETFD) == 1);
+
+   /* Invalid arguments */
+   DEVSHELL_CMD_ASSERT(syscall(SYS_close_range, 10, 5, 0) < 0);
+   DEVSHELL_CMD_ASSERT(errno == EINVAL);
+
+   rc = syscall(SYS_close_range, first_fd, ~0U, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   DEVSHELL_CMD_ASSERT(dup(0) == first_fd);
+   close(first_fd);
+   return 0;
+}
+
+static int fdoffsets_child(int fd, int unrelated_fd)
+{
+   char buf[4];
+
+   if (unrelated_fd >= 0 && close(unrelated_fd) < 0) {
+      perror("[child] close() failed");
+      return 1;
+   }
+
+   /* The child starts from the parent's offset */
+   if (lseek(fd, 0, SEEK_CUR) != 3) {
+      printf("[child] wrong initial offset\n");
+      return 1;
+   }
+
+   if (read(fd, buf, 4) != 4 || memcmp(buf, "3456", 4)) {
+      printf("[child] read() failed or returned wrong data\n");
+      return 1;
+   }
+
+   return 0;
+}
+
+/*
+ * Returns the parent's offset after the child read 4 bytes. When
+ * `unrelated_fd` is >= 0, the child closes it before reading.
+ */
+static off_t fdoffsets_run_child(int fd, int unrelated_fd)
+{
+   int pid, wstatus;
+   off_t pos;
+
+   pid = fork();
+
+   if (pid < 0)
+      return -1;
+
+   if (!pid)
+      exit(fdoffsets_child(fd, unrelated_fd));
+
+   waitpid(pid, &wstatus, 0);
+
+   if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0)
+      return -1;
+
+   pos = lseek(fd, 0, SEEK_CUR);
+
+   /* Restore the offset for the next run */
+   if (lseek(fd, 3, SEEK_SET) != 3)
+      return -1;
+
+   return pos;
+}
+
+/*
+ * Check the file offsets after fork(). On Tilck, the child gets a copy of
+ * each handle: its offsets are independent from the parent's ones. On Linux,
+ * the offsets are shared, as POSIX requires. Either way, the semantics must
+ * not change when the child modifies its fd table (e.g. with close()).
+ */
+int cmd_fdoffsets(int argc, char **argv)
+{
+   const char *path = "/tmp/fdoffsets_test";
+   const off_t exp_pos = running_on_tilck() ? 3 : 7;
+   off_t pos1, pos2;
+   int fd, unrelated_fd;
+   char buf[3];
+
+   fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd >= 0);
+   DEVSHELL_CMD_ASSERT(write(fd, "0123456789abcdef", 16) == 16);
+   DEVSHELL_CMD_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+   DEVSHELL_CMD_ASSERT(read(fd, buf, 3) == 3);
+
+   unrelated_fd = dup(0);
+   DEVSHELL_CMD_ASSERT(unrelated_fd >= 0);
+
+   pos1 = fdoffsets_run_child(fd, -1);
+   pos2 = fdoffsets_run_child(fd, unrelated_fd);
+
+   printf("Parent's offset: %d, after a close() in the child: %d\n",
+          (int)pos1, (int)pos2);
+
+   DEVSHELL_CMD_ASSERT(pos1 == exp_pos);
+   DEVSHELL_CMD_ASSERT(pos2 == exp_pos);
+
+   close(unrelated_fd);
+   close(fd);
+   unlink(path);
+   return 0;
+}
+
 /* Test scripts testing EXTRA components running on Tilck */
 
 static const char *extra_test_scripts[] = {
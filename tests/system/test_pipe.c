@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/uio.h>
 
 #include "devshell.h"
 #include "test_common.h"
@@ -388,10 +389,9 @@ pipe_random_test(int readers, int writers)
       return 1;
    }
 
-   if (!getenv("TILCK")) {
-      fcntl(pipefd[0], F_SETPIPE_SZ, 4096);
-      fcntl(pipefd[1], F_SETPIPE_SZ, 4096);
-   }
+   /* Use a small buffer, in order to maximize the contention */
+   fcntl(pipefd[0], F_SETPIPE_SZ, 4096);
+   fcntl(pipefd[1], F_SETPIPE_SZ, 4096);
 
    for (int i = 0; i < writers; i++) {
 
@@ -469,3 +469,193 @@ int cmd_pipe5(int argc, char **argv)
 
    return 0;
 }
+
+static char vmsplice_buf[4 * 4096] __attribute__((aligned(4096)));
+
+/* Test F_SETPIPE_SZ, F_GETPIPE_SZ and vmsplice() */
+int cmd_pipe6(int argc, char **argv)
+{
+   char buf[4096];
+   struct iovec iov;
+   int pipefd[2];
+   int rc;
+
+   rc = pipe(pipefd);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = fcntl(pipefd[0], F_GETPIPE_SZ);
+   printf("Default pipe size: %d\n", rc);
+   DEVSHELL_CMD_ASSERT(rc >= 4096);
+
+   /* The size is rounded up to PAGE_SIZE */
+   rc = fcntl(pipefd[1], F_SETPIPE_SZ, 5000);
+   DEVSHELL_CMD_ASSERT(rc == 8192);
+   DEVSHELL_CMD_ASSERT(fcntl(pipefd[0], F_GETPIPE_SZ) == 8192);
+
+   /* Fill up the pipe */
+   memset(buf, 'a', sizeof(buf));
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], buf, sizeof(buf)) == sizeof(buf));
+   DEVSHELL_CMD_ASSERT(write(pipefd[1], buf, sizeof(buf)) == sizeof(buf));
+
+   /* Cannot shrink the pipe below the amount of data it contains */
+   rc = fcntl(pipefd[1], F_SETPIPE_SZ, 4096);
+   DEVSHELL_CMD_ASSERT(rc < 0 && errno == EBUSY);
+
+   /* Growing it is fine */
+   rc = fcntl(pipefd[1], F_SETPIPE_SZ, 4 * 4096);
+   DEVSHELL_CMD_ASSERT(rc == 4 * 4096);
+
+   DEVSHELL_CMD_ASSERT(read(pipefd[0], buf, sizeof(buf)) == sizeof(buf));
+   DEVSHELL_CMD_ASSERT(read(pipefd[0], buf, sizeof(buf)) == sizeof(buf));
+
+   /*
+    * Now test vmsplice(): after it returns, the pages belong to the pipe and
+    * modifying our buffer must NOT change the data in the pipe.
+    */
+   memset(vmsplice_buf, 'x', sizeof(vmsplice_buf));
+   iov = (struct iovec) { vmsplice_buf, sizeof(vmsplice_buf) };
+
+   rc = vmsplice(pipefd[1], &iov, 1, SPLICE_F_GIFT);
+   DEVSHELL_CMD_ASSERT(rc == sizeof(vmsplice_buf));
+
+   memset(vmsplice_buf, 'y', sizeof(vmsplice_buf));
+
+   for (int i = 0; i < 4; i++) {
+
+      rc = read(pipefd[0], buf, sizeof(buf));
+      DEVSHELL_CMD_ASSERT(rc == sizeof(buf));
+
+      for (int j = 0; j < rc; j++) {
+         if (buf[j] != 'x') {
+            printf("Unexpected byte at %d: '%c'\n", i * 4096 + j, buf[j]);
+            return 1;
+         }
+      }
+   }
+
+   /* Unaligned buffers get just copied */
+   iov = (struct iovec) { vmsplice_buf + 1, 100 };
+   rc = vmsplice(pipefd[1], &iov, 1, 0);
+   DEVSHELL_CMD_ASSERT(rc == 100);
+   DEVSHELL_CMD_ASSERT(read(pipefd[0], buf, sizeof(buf)) == 100);
+   DEVSHELL_CMD_ASSERT(buf[0] == 'y' && buf[99] == 'y');
+
+   close(pipefd[0]);
+   close(pipefd[1]);
+   return 0;
+}
+
+enum pipe_perf_mode {
+   PIPE_PERF_WRITE,
+   PIPE_PERF_VMSPLICE,
+};
+
+#define PIPE_PERF_TOT_SIZE          (32 * MB)
+#define PIPE_PERF_CHUNK             (64 * KB)
+
+static char pipe_perf_buf[PIPE_PERF_CHUNK] __attribute__((aligned(4096)));
+
+static void
+pipe_perf_writer(int wfd, size_t chunk, enum pipe_perf_mode mode)
+{
+   struct iovec iov;
+   size_t tot = 0;
+   ssize_t rc;
+
+   memset(pipe_perf_buf, 'a', sizeof(pipe_perf_buf));
+
+   while (tot < PIPE_PERF_TOT_SIZE) {
+
+      if (mode == PIPE_PERF_VMSPLICE) {
+         iov = (struct iovec) { pipe_perf_buf, chunk };
+         rc = vmsplice(wfd, &iov, 1, SPLICE_F_GIFT);
+      } else {
+         rc = write(wfd, pipe_perf_buf, chunk);
+      }
+
+      if (rc <= 0) {
+         perror("[pipe perf] write/vmsplice failed");
+         exit(1);
+      }
+
+      tot += (size_t)rc;
+   }
+
+   exit(0);
+}
+
+static int
+pipe_perf_run(const char *name,
+              int pipe_size,
+              size_t chunk,
+              enum pipe_perf_mode mode)
+{
+   static char rbuf[PIPE_PERF_CHUNK];
+   int pipefd[2], wstatus, child;
+   size_t tot = 0;
+   u64 start, duration;
+   ssize_t rc;
+
+   DEVSHELL_CMD_ASSERT(pipe(pipefd) == 0);
+
+   if (pipe_size > 0) {
+      rc = fcntl(pipefd[1], F_SETPIPE_SZ, pipe_size);
+      DEVSHELL_CMD_ASSERT(rc >= pipe_size);
+   }
+
+   start = RDTSC();
+   child = fork();
+   DEVSHELL_CMD_ASSERT(child >= 0);
+
+   if (!child) {
+      close(pipefd[0]);
+      pipe_perf_writer(pipefd[1], chunk, mode);
+   }
+
+   close(pipefd[1]);
+
+   while ((rc = read(pipefd[0], rbuf, sizeof(rbuf))) > 0)
+      tot += (size_t)rc;
+
+   duration = RDTSC() - start;
+   close(pipefd[0]);
+   waitpid(child, &wstatus, 0);
+
+   if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) || tot != PIPE_PERF_TOT_SIZE)
+   {
+      printf("[pipe perf] %s: FAILED (tot: %zu)\n", name, tot);
+      return 1;
+   }
+
+   printf("[pipe perf] %-28s %6" PRIu64 " cycles/KB\n",
+          name, duration / (PIPE_PERF_TOT_SIZE / KB));
+
+   return 0;
+}
+
+/* Measure the throughput of pipes with different sizes and write modes */
+int cmd_pipe_perf(int argc, char **argv)
+{
+   int rc;
+
+   printf("Transferring %d MB through a pipe\n", PIPE_PERF_TOT_SIZE / MB);
+
+   rc = pipe_perf_run("write 4K, pipe 4K:",
+                      4 * KB, 4 * KB, PIPE_PERF_WRITE);
+   if (rc)
+      return rc;
+
+   rc = pipe_perf_run("write 64K, pipe default:",
+                      0, 64 * KB, PIPE_PERF_WRITE);
+   if (rc)
+      return rc;
+
+   rc = pipe_perf_run("write 64K, pipe 1M:",
+                      1 * MB, 64 * KB, PIPE_PERF_WRITE);
+   if (rc)
+      return rc;
+
+   rc = pipe_perf_run("vmsplice 64K, pipe 1M:",
+                      1 * MB, 64 * KB, PIPE_PERF_VMSPLICE);
+   return rc;
+}
@@ -0,0 +1,372 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <tilck/common/tilck_uring.h>
+
+#include "devshell.h"
+#include "test_common.h"
+
+#ifndef SYS_io_uring_setup
+   #define SYS_io_uring_setup       425
+   #define SYS_io_uring_enter       426
+   #define SYS_io_uring_register    427
+#endif
+
+#define URING_TEST_FILE        "/tmp/uring_test"
+#define URING_PERF_READS       (100 * 1000)
+#define URING_PERF_BATCH       64
+#define URING_PERF_READ_SIZE   64
+
+struct uring {
+
+   int fd;
+   void *rings;
+   size_t rings_len;
+   struct io_uring_sqe *sqes;
+   size_t sqes_len;
+
+   u32 *sq_tail;
+   u32 *sq_array;
+   u32 sq_mask;
+
+   u32 *cq_head;
+   u32 *cq_tail;
+   u32 cq_mask;
+   struct io_uring_cqe *cqes;
+};
+
+static int io_uring_setup(u32 entries, struct io_uring_params *p)
+{
+   return (int)syscall(SYS_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, u32 to_submit, u32 min_complete, u32 flags)
+{
+   return (int)syscall(SYS_io_uring_enter,
+                       fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, u32 opcode, void *arg, u32 nr_args)
+{
+   return (int)syscall(SYS_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+#define RING_PTR(r, off)  ((u32 *)((char *)(r)->rings + (off)))
+
+static int uring_init(struct uring *r, u32 entries)
+{
+   struct io_uring_params p;
+
+   memset(&p, 0, sizeof(p));
+   r->fd = io_uring_setup(entries, &p);
+
+   if (r->fd < 0)
+      return -1;
+
+   r->rings_len = MAX(p.sq_off.array + p.sq_entries * sizeof(u32),
+                      p.cq_off.cqes + p.cq_entries * sizeof(*r->cqes));
+   r->sqes_len = p.sq_entries * sizeof(*r->sqes);
+
+   r->rings = mmap(NULL, r->rings_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, r->fd, IORING_OFF_SQ_RING);
+
+   if (r->rings == MAP_FAILED)
+      return -1;
+
+   r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED, r->fd, IORING_OFF_SQES);
+
+   if (r->sqes == MAP_FAILED)
+      return -1;
+
+   r->sq_tail = RING_PTR(r, p.sq_off.tail);
+   r->sq_array = RING_PTR(r, p.sq_off.array);
+   r->sq_mask = *RING_PTR(r, p.sq_off.ring_mask);
+   r->cq_head = RING_PTR(r, p.cq_off.head);
+   r->cq_tail = RING_PTR(r, p.cq_off.tail);
+   r->cq_mask = *RING_PTR(r, p.cq_off.ring_mask);
+   r->cqes = (void *)RING_PTR(r, p.cq_off.cqes);
+   return 0;
+}
+
+static void uring_destroy(struct uring *r)
+{
+   munmap(r->sqes, r->sqes_len);
+   munmap(r->rings, r->rings_len);
+   close(r->fd);
+}
+
+static struct io_uring_sqe *
+uring_get_sqe(struct uring *r, u8 opcode, int fd, u64 user_data)
+{
+   const u32 tail = *r->sq_tail;
+   const u32 idx = tail & r->sq_mask;
+   struct io_uring_sqe *sqe = &r->sqes[idx];
+
+   memset(sqe, 0, sizeof(*sqe));
+   sqe->opcode = opcode;
+   sqe->fd = fd;
+   sqe->off = (u64)-1;
+   sqe->user_data = user_data;
+
+   r->sq_array[idx] = idx;
+   __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+   return sqe;
+}
+
+static void
+uring_prep_rw(struct uring *r, u8 op, int fd, void *buf, u32 len, u64 off)
+{
+   struct io_uring_sqe *sqe = uring_get_sqe(r, op, fd, off);
+
+   sqe->addr = (u64)(ulong)buf;
+   sqe->len = len;
+   sqe->off = off;
+}
+
+static bool uring_peek_cqe(struct uring *r, struct io_uring_cqe *cqe)
+{
+   const u32 head = *r->cq_head;
+
+   if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+      return false;
+
+   *cqe = r->cqes[head & r->cq_mask];
+   __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+static void uring_wait_cqe(struct uring *r, struct io_uring_cqe *cqe)
+{
+   int rc;
+
+   while (!uring_peek_cqe(r, cqe)) {
+      rc = io_uring_enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS);
+      DEVSHELL_CMD_ASSERT(rc == 0);
+   }
+}
+
+static void uring_test_nop_batch(struct uring *r)
+{
+   struct io_uring_cqe cqe;
+   int rc;
+
+   for (u64 i = 0; i < 8; i++)
+      uring_get_sqe(r, IORING_OP_NOP, -1, 1000 + i);
+
+   /* The whole batch with a single syscall */
+   rc = io_uring_enter(r->fd, 8, 8, IORING_ENTER_GETEVENTS);
+   DEVSHELL_CMD_ASSERT(rc == 8);
+
+   for (u64 i = 0; i < 8; i++) {
+      DEVSHELL_CMD_ASSERT(uring_peek_cqe(r, &cqe));
+      DEVSHELL_CMD_ASSERT(cqe.user_data == 1000 + i);
+      DEVSHELL_CMD_ASSERT(cqe.res == 0);
+   }
+
+   DEVSHELL_CMD_ASSERT(!uring_peek_cqe(r, &cqe));
+}
+
+static void uring_test_file_rw(struct uring *r)
+{
+   struct io_uring_cqe cqe;
+   char buf[64] = {0};
+   int fd, rc;
+
+   fd = open(URING_TEST_FILE, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   uring_prep_rw(r, IORING_OP_WRITE, fd, "hello io_uring", 14, 0);
+   rc = io_uring_enter(r->fd, 1, 1, IORING_ENTER_GETEVENTS);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(uring_peek_cqe(r, &cqe));
+   DEVSHELL_CMD_ASSERT(cqe.res == 14);
+
+   /* Explicit offset, like pread() */
+   uring_prep_rw(r, IORING_OP_READ, fd, buf, sizeof(buf), 6);
+   rc = io_uring_enter(r->fd, 1, 1, IORING_ENTER_GETEVENTS);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(uring_peek_cqe(r, &cqe));
+   DEVSHELL_CMD_ASSERT(cqe.res == 8);
+   DEVSHELL_CMD_ASSERT(!strcmp(buf, "io_uring"));
+
+   /* Bad fd */
+   uring_prep_rw(r, IORING_OP_READ, 1234, buf, sizeof(buf), 0);
+   rc = io_uring_enter(r->fd, 1, 1, IORING_ENTER_GETEVENTS);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   DEVSHELL_CMD_ASSERT(uring_peek_cqe(r, &cqe));
+   DEVSHELL_CMD_ASSERT(cqe.res == -EBADF);
+
+   close(fd);
+   rc = unlink(URING_TEST_FILE);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+}
+
+static void uring_test_pipe(struct uring *r)
+{
+   struct io_uring_cqe cqe;
+   struct io_uring_sqe *sqe;
+   char buf[64] = {0};
+   int p[2], rc;
+
+   rc = pipe(p);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* Nothing to read: the request must go async, without blocking us */
+   uring_prep_rw(r, IORING_OP_READ, p[0], buf, sizeof(buf), (u64)-1);
+   sqe = uring_get_sqe(r, IORING_OP_POLL_ADD, p[0], 2);
+   sqe->poll_events = POLLIN;
+
+   rc = io_uring_enter(r->fd, 2, 0, 0);
+   DEVSHELL_CMD_ASSERT(rc == 2);
+   DEVSHELL_CMD_ASSERT(!uring_peek_cqe(r, &cqe));
+
+   rc = write(p[1], "async", 5);
+   DEVSHELL_CMD_ASSERT(rc == 5);
+
+   for (int n = 0; n < 2; n++) {
+
+      uring_wait_cqe(r, &cqe);
+
+      if (cqe.user_data == (u64)-1) {
+         DEVSHELL_CMD_ASSERT(cqe.res == 5);
+         DEVSHELL_CMD_ASSERT(!strcmp(buf, "async"));
+      } else {
+         DEVSHELL_CMD_ASSERT(cqe.user_data == 2);
+         DEVSHELL_CMD_ASSERT(cqe.res & POLLIN);
+      }
+   }
+
+   close(p[0]);
+   close(p[1]);
+}
+
+static void uring_test_fixed_files(struct uring *r)
+{
+   struct io_uring_cqe cqe;
+   struct io_uring_sqe *sqe;
+   char buf[64] = {0};
+   int p[2], rc;
+
+   rc = pipe(p);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   rc = io_uring_register(r->fd, IORING_REGISTER_FILES, p, 2);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* The registered files survive the close of the original fds */
+   close(p[1]);
+
+   uring_prep_rw(r, IORING_OP_WRITE, 1, "fixed", 5, (u64)-1);
+   sqe = &r->sqes[(*r->sq_tail - 1) & r->sq_mask];
+   sqe->flags = IOSQE_FIXED_FILE;
+
+   rc = io_uring_enter(r->fd, 1, 1, IORING_ENTER_GETEVENTS);
+   DEVSHELL_CMD_ASSERT(rc == 1);
+   uring_wait_cqe(r, &cqe);
+   DEVSHELL_CMD_ASSERT(cqe.res == 5);
+
+   rc = read(p[0], buf, sizeof(buf));
+   DEVSHELL_CMD_ASSERT(rc == 5);
+   DEVSHELL_CMD_ASSERT(!strcmp(buf, "fixed"));
+
+   rc = io_uring_register(r->fd, IORING_UNREGISTER_FILES, NULL, 0);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   /* After the unregister, the pipe has no writers anymore */
+   rc = read(p[0], buf, sizeof(buf));
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   close(p[0]);
+}
+
+int cmd_uring1(int argc, char **argv)
+{
+   struct uring r;
+   int rc;
+
+   rc = uring_init(&r, 8);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   uring_test_nop_batch(&r);
+   uring_test_file_rw(&r);
+   uring_test_pipe(&r);
+   uring_test_fixed_files(&r);
+
+   uring_destroy(&r);
+   return 0;
+}
+
+int cmd_uring_perf(int argc, char **argv)
+{
+   static char file_buf[4 * KB];
+   static char bufs[URING_PERF_BATCH][URING_PERF_READ_SIZE];
+   struct io_uring_cqe cqe;
+   struct uring r;
+   ull_t start, pread_cycles, uring_cycles;
+   u32 enters = 0;
+   int fd, rc;
+
+   fd = open(URING_TEST_FILE, O_CREAT | O_RDWR | O_TRUNC, 0644);
+   DEVSHELL_CMD_ASSERT(fd > 0);
+
+   memset(file_buf, 'x', sizeof(file_buf));
+   rc = write(fd, file_buf, sizeof(file_buf));
+   DEVSHELL_CMD_ASSERT(rc == sizeof(file_buf));
+
+   start = RDTSC();
+
+   for (u32 i = 0; i < URING_PERF_READS; i++) {
+      const off_t off = (i * URING_PERF_READ_SIZE) % sizeof(file_buf);
+      rc = pread(fd, bufs[i % URING_PERF_BATCH], URING_PERF_READ_SIZE, off);
+      DEVSHELL_CMD_ASSERT(rc == URING_PERF_READ_SIZE);
+   }
+
+   pread_cycles = RDTSC() - start;
+
+   rc = uring_init(&r, URING_PERF_BATCH);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+
+   start = RDTSC();
+
+   for (u32 i = 0; i < URING_PERF_READS; i += URING_PERF_BATCH) {
+
+      for (u32 j = 0; j < URING_PERF_BATCH; j++) {
+         const u64 off = ((i + j) * URING_PERF_READ_SIZE) % sizeof(file_buf);
+         uring_prep_rw(&r, IORING_OP_READ, fd,
+                       bufs[j], URING_PERF_READ_SIZE, off);
+      }
+
+      rc = io_uring_enter(r.fd, URING_PERF_BATCH,
+                          URING_PERF_BATCH, IORING_ENTER_GETEVENTS);
+      DEVSHELL_CMD_ASSERT(rc == URING_PERF_BATCH);
+      enters++;
+
+      for (u32 j = 0; j < URING_PERF_BATCH; j++) {
+         DEVSHELL_CMD_ASSERT(uring_peek_cqe(&r, &cqe));
+         DEVSHELL_CMD_ASSERT(cqe.res == URING_PERF_READ_SIZE);
+      }
+   }
+
+   uring_cycles = RDTSC() - start;
+
+   printf("pread():    %u syscalls, %llu cycles/read\n",
+          URING_PERF_READS, pread_cycles / URING_PERF_READS);
+   printf("io_uring:   %u syscalls, %llu cycles/read\n",
+          enters, uring_cycles / (enters * URING_PERF_BATCH));
+
+   uring_destroy(&r);
+   close(fd);
+   rc = unlink(URING_TEST_FILE);
+   DEVSHELL_CMD_ASSERT(rc == 0);
+   return 0;
+}
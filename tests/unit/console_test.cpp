@@ -32,6 +32,7 @@ static u16 test_video_framebuffer[TEST_TERM_ROWS][TEST_TERM_COLS];
 static u16 cursor_row;
 static u16 cursor_col;
 static bool cursor_enabled = true;
+static int set_row_calls;
 
 static void console_test_dump_char(int row, int col, bool safe)
 {
@@ -148,6 +149,7 @@ static void test_vi_set_char_at(u16 row, u16 col, u16 entry)
 static void test_vi_set_row(u16 row, u16 *data, bool fpu_allowed)
 {
    ASSERT_LT(row, TEST_TERM_ROWS);
+   set_row_calls++;
 
    memcpy(&test_video_framebuffer[row],
           data,
@@ -271,3 +273,39 @@ TEST_F(console_test, cursor_move)
       +--------------------+
    )");
 }
+
+TEST_F(console_test, scroll_in_one_write)
+{
+   set_row_calls = 0;
+   console_write("line 1\nline 2\nline 3\nline 4\nline 5\n"
+                 "line 6\nline 7\nline 8");
+
+   console_test_dump_screen(true);
+   check_screen_vs_expected(R"(
+      +--------------------+
+      |line 4              |
+      |line 5              |
+      |line 6              |
+      |line 7              |
+      |line 8$             |
+      +--------------------+
+   )");
+
+   /* The screen has been redrawn only once, not once per scrolled line */
+   ASSERT_LE(set_row_calls, TEST_TERM_ROWS);
+}
+
+TEST_F(console_test, erase_in_line_in_one_write)
+{
+   console_write("hello world\033[6D\033[K!");
+   console_test_dump_screen(true);
+   check_screen_vs_expected(R"(
+      +--------------------+
+      |hello!$             |
+      |                    |
+      |                    |
+      |                    |
+      |                    |
+      +--------------------+
+   )");
+}
@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include "mocking.h"
+#include "kernel_init_funcs.h"
+
+using namespace testing;
+
+extern "C" {
+   #include <tilck/kernel/process.h>
+   #include <tilck/kernel/fs/fd_table.h>
+   #include <tilck/kernel/test/fd_table.h>
+}
+
+class vfs_mock : public KernelSingleton {
+public:
+
+   MOCK_METHOD(int, vfs_dup, (fs_handle h, fs_handle *dup_h), (override));
+   MOCK_METHOD(void, vfs_close, (fs_handle h), (override));
+};
+
+class fdt_test : public Test {
+
+   void SetUp() override {
+      init_kmalloc_for_tests();
+   }
+};
+
+static void init_fdt(fd_table *fdt, fs_handle_base *handles, int count)
+{
+   *fdt = {};
+   fdt->size = FDT_INLINE_FDS;
+   fdt->handles = fdt->inline_handles;
+   fdt->open_fds = fdt->inline_open_fds;
+   fdt->cloexec_fds = fdt->inline_cloexec_fds;
+
+   for (int i = 0; i < count; i++) {
+      fdt->handles[i] = &handles[i];
+      fdt->open_fds[0] |= (1UL << i);
+   }
+
+   fdt->next_fd = count;
+}
+
+TEST_F(fdt_test, dup_oom_in_the_middle)
+{
+   vfs_mock mock;
+   process pi = {};
+   fd_table fdt;
+   fs_handle_base handles[3] = {}, dup_handles[2] = {};
+   init_fdt(&fdt, handles, 3);
+
+   EXPECT_CALL(mock, vfs_dup(&handles[0], _))
+      .WillOnce(
+         DoAll(
+            SetArgPointee<1>(&dup_handles[0]),
+            Return(0)
+         )
+      );
+   EXPECT_CALL(mock, vfs_dup(&handles[1], _))
+      .WillOnce(
+         DoAll(
+            SetArgPointee<1>(&dup_handles[1]),
+            Return(0)
+         )
+      );
+   EXPECT_CALL(mock, vfs_dup(&handles[2], _))
+      .WillOnce(Return(-1));
+
+   EXPECT_CALL(mock, vfs_close(&dup_handles[0]));
+   EXPECT_CALL(mock, vfs_close(&dup_handles[1]));
+   ASSERT_TRUE(fdt_dup(&fdt, &pi) == NULL);
+}
+
+TEST_F(fdt_test, dup_copies_cloexec_flags)
+{
+   vfs_mock mock;
+   process pi = {};
+   fd_table fdt, *new_fdt;
+   fs_handle_base handles[2] = {}, dup_handles[2] = {};
+   init_fdt(&fdt, handles, 2);
+
+   fdt.cloexec_fds[0] |= (1UL << 1);
+
+   EXPECT_CALL(mock, vfs_dup(&handles[0], _))
+      .WillOnce(
+         DoAll(
+            SetArgPointee<1>(&dup_handles[0]),
+            Return(0)
+         )
+      );
+   EXPECT_CALL(mock, vfs_dup(&handles[1], _))
+      .WillOnce(
+         DoAll(
+            SetArgPointee<1>(&dup_handles[1]),
+            Return(0)
+         )
+      );
+
+   new_fdt = fdt_dup(&fdt, &pi);
+   ASSERT_TRUE(new_fdt != NULL);
+
+   EXPECT_EQ(new_fdt->size, fdt.size);
+   EXPECT_EQ(new_fdt->next_fd, 2);
+   EXPECT_EQ(new_fdt->handles[0], &dup_handles[0]);
+   EXPECT_EQ(new_fdt->handles[1], &dup_handles[1]);
+   EXPECT_EQ(new_fdt->open_fds[0], 3ul);
+   EXPECT_EQ(dup_handles[0].pi, &pi);
+   EXPECT_EQ(dup_handles[1].pi, &pi);
+   EXPECT_FALSE(dup_handles[0].fd_flags & FD_CLOEXEC);
+   EXPECT_TRUE(dup_handles[1].fd_flags & FD_CLOEXEC);
+
+   EXPECT_CALL(mock, vfs_close(&dup_handles[0]));
+   EXPECT_CALL(mock, vfs_close(&dup_handles[1]));
+   fdt_release(new_fdt);
+}
@@ -51,6 +51,9 @@ void fpu_context_end() { }
 void map_zero_pages() { NOT_REACHED(); }
 void dump_var_mtrrs() { }
 void set_page_rw() { }
+void set_page_cow() { }
+void share_user_page_cow() { NOT_REACHED(); }
+void release_shared_page() { NOT_REACHED(); }
 void poweroff() { NOT_REACHED(); }
 int get_irq_num(void *ctx) { return -1; }
 int get_int_num(void *ctx) { return -1; }
@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+
+extern "C" {
+   #include <tilck/common/basic_defs.h>
+   #include <tilck/common/lz4.h>
+}
+
+static string lz4_dec(const vector<u8> &src, u32 cap = 256)
+{
+   vector<char> buf(cap);
+   int rc = lz4_decompress(src.data(), (u32)src.size(), buf.data(), cap);
+
+   if (rc < 0)
+      return "<error>";
+
+   return string(buf.data(), (size_t)rc);
+}
+
+TEST(lz4, literals_only)
+{
+   EXPECT_EQ(lz4_dec({ 0x50, 'h', 'e', 'l', 'l', 'o' }), "hello");
+   EXPECT_EQ(lz4_dec({ 0x00 }), "");
+}
+
+TEST(lz4, long_literals)
+{
+   vector<u8> src = { 0xf0, 20 - 15 };
+
+   for (int i = 0; i < 20; i++)
+      src.push_back((u8)('a' + i));
+
+   EXPECT_EQ(lz4_dec(src), "abcdefghijklmnopqrst");
+}
+
+TEST(lz4, overlapping_match)
+{
+   /* 'a', then a match at offset 1 of length 5 + 4, then the literal 'b' */
+   EXPECT_EQ(lz4_dec({ 0x15, 'a', 1, 0, 0x10, 'b' }), "aaaaaaaaaab");
+
+   /* 'x', 'y', then a match at offset 2 of length 15 + 3 + 4 */
+   string exp;
+
+   for (int i = 0; i < 12; i++)
+      exp += "xy";
+
+   EXPECT_EQ(lz4_dec({ 0x2f, 'x', 'y', 2, 0, 3, 0x00 }), exp);
+}
+
+TEST(lz4, corrupted)
+{
+   /* Offset 0 */
+   EXPECT_EQ(lz4_dec({ 0x10, 'a', 0, 0 }), "<error>");
+
+   /* Offset before the beginning of the output */
+   EXPECT_EQ(lz4_dec({ 0x10, 'a', 2, 0 }), "<error>");
+
+   /* Truncated literals and offset */
+   EXPECT_EQ(lz4_dec({ 0x50, 'h', 'e' }), "<error>");
+   EXPECT_EQ(lz4_dec({ 0x10, 'a', 1 }), "<error>");
+
+   /* Truncated literal length */
+   EXPECT_EQ(lz4_dec({ 0xf0, 255 }), "<error>");
+
+   /* Output buffer too small */
+   EXPECT_EQ(lz4_dec({ 0x15, 'a', 1, 0 }, 5), "<error>");
+   EXPECT_EQ(lz4_dec({ 0x50, 'h', 'e', 'l', 'l', 'o' }, 4), "<error>");
+}
+
+static void push_u32(vector<u8> &v, u32 val)
+{
+   u8 b[4];
+   memcpy(b, &val, 4);
+   v.insert(v.end(), b, b + 4);
+}
+
+TEST(lz4, rd_stream)
+{
+   const u32 bs = 8;
+   struct lz4_rd_hdr hdr;
+   struct lz4_rd_stream s;
+   vector<u8> img(sizeof(hdr));
+   char out[32] = {0};
+   u32 off = 0, pending = 0;
+
+   /* Block 0: stored, 8 bytes */
+   push_u32(img, 8 | LZ4_RD_STORED);
+   img.insert(img.end(), { 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H' });
+
+   /* Block 1: compressed, 8 x 'z' */
+   push_u32(img, 4);
+   img.insert(img.end(), { 0x13, 'z', 1, 0 });
+
+   /* Block 2 (the last one): compressed, 3 bytes */
+   push_u32(img, 4);
+   img.insert(img.end(), { 0x30, '1', '2', '3' });
+
+   memcpy(hdr.magic, LZ4_RD_MAGIC, sizeof(hdr.magic));
+   hdr.hdr_size = sizeof(hdr);
+   hdr.block_size = bs;
+   hdr.orig_size = 19;
+   hdr.comp_size = (u32)(img.size() - sizeof(hdr));
+   memcpy(img.data(), &hdr, sizeof(hdr));
+
+   ASSERT_TRUE(lz4_rd_check_hdr(img.data()));
+   lz4_rd_stream_init(&s, img.data(), out);
+
+   /* Feed the stream 3 bytes at a time, like reading small chunks */
+   for (u32 i = sizeof(hdr); i < img.size(); i += 3) {
+
+      pending = (u32)MIN(img.size(), (size_t)i + 3) - sizeof(hdr) - off;
+
+      int rc = lz4_rd_feed(&s, img.data() + sizeof(hdr) + off, pending);
+      ASSERT_GE(rc, 0);
+      off += (u32)rc;
+   }
+
+   EXPECT_TRUE(lz4_rd_done(&s));
+   EXPECT_EQ(off, hdr.comp_size);
+   EXPECT_EQ(string(out), "ABCDEFGHzzzzzzzz123");
+
+   /* A block decompressing to less than block_size is corrupted */
+   lz4_rd_stream_init(&s, img.data(), out);
+   img[sizeof(hdr) + 12 + 4] = 0x12;
+   EXPECT_EQ(lz4_rd_feed(&s, img.data() + sizeof(hdr), hdr.comp_size), -1);
+
+   /* Bad magic */
+   img[0] = 'X';
+   EXPECT_FALSE(lz4_rd_check_hdr(img.data()));
+}
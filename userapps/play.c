@@ -15,9 +15,12 @@
 
 #include <tilck/common/tilck_sound.h>
 
+#define DSP_STATS_DIR                          "/syst/hw/media/sb16"
+
 static char opt_device[64] = "/dev/sb16";
 static char opt_file[64];
 
+static bool opt_dsp;
 static bool opt_test;
 static bool opt_file_passed;
 static u8 opt_test_short;
@@ -28,8 +31,10 @@ static void
 show_help(void)
 {
    printf("syntax:\n");
-   printf("    play [-d device] --test [-b 8|16] [-ch 1|2] [-s]\n");
-   printf("    play [-d device] <WAVE FILE>\n");
+   printf("    play [-d device | --dsp] --test [-b 8|16] [-ch 1|2] [-s]\n");
+   printf("    play [-d device | --dsp] <WAVE FILE>\n");
+   printf("\n");
+   printf("    --dsp: stream through /dev/dsp and check its stats\n");
 }
 
 static void
@@ -54,6 +59,11 @@ parse_args(int argc, char **argv)
          argc--; argv++;
          strncpy(opt_device, argv[0], sizeof(opt_device)-1);
 
+      } else if (!strcmp(arg, "--dsp")) {
+
+         opt_dsp = true;
+         strcpy(opt_device, "/dev/dsp");
+
       } else if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
 
          show_help_and_exit();
@@ -465,6 +475,78 @@ out:
    return !!rc;
 }
 
+static int
+read_dsp_stat(const char *name, unsigned long *val)
+{
+   char path[128];
+   char buf[32] = {0};
+   int fd, rc;
+
+   sprintf(path, DSP_STATS_DIR "/%s", name);
+
+   if ((fd = open(path, O_RDONLY)) < 0) {
+      printf("Unable to open '%s': %s\n", path, strerror(errno));
+      return -1;
+   }
+
+   rc = read(fd, buf, sizeof(buf) - 1);
+   close(fd);
+
+   if (rc <= 0) {
+      printf("Unable to read '%s'\n", path);
+      return -1;
+   }
+
+   *val = strtoul(buf, NULL, 10);
+   return 0;
+}
+
+struct dsp_stats {
+   unsigned long played_bytes;
+   unsigned long underruns;
+};
+
+static int
+read_dsp_stats(struct dsp_stats *st)
+{
+   if (read_dsp_stat("dsp_played_bytes", &st->played_bytes) < 0)
+      return -1;
+
+   if (read_dsp_stat("dsp_underruns", &st->underruns) < 0)
+      return -1;
+
+   return 0;
+}
+
+/*
+ * Called after the playback through /dev/dsp completed: the kernel must have
+ * played some data and the ring buffer must have never run dry.
+ */
+static int
+check_dsp_stats(struct dsp_stats *before)
+{
+   struct dsp_stats after;
+
+   if (read_dsp_stats(&after) < 0)
+      return 1;
+
+   printf("DSP: played bytes: %lu, underruns: %lu\n",
+          after.played_bytes - before->played_bytes,
+          after.underruns - before->underruns);
+
+   if (after.played_bytes <= before->played_bytes) {
+      printf("DSP: FAIL: no data played\n");
+      return 1;
+   }
+
+   if (after.underruns != before->underruns) {
+      printf("DSP: FAIL: underruns occurred\n");
+      return 1;
+   }
+
+   return 0;
+}
+
 static int
 do_run_cmd(int devfd)
 {
@@ -514,6 +596,7 @@ int main(int argc, char **argv)
 {
    int rc, cmd_rc, devfd;
    struct tilck_sound_card_info nfo;
+   struct dsp_stats dsp_stats;
 
    parse_args(argc-1, argv+1);
 
@@ -525,11 +608,20 @@ int main(int argc, char **argv)
       return 1;
    }
 
-   rc = ioctl(devfd, TILCK_IOCTL_SOUND_ACQUIRE, NULL);
+   if (opt_dsp) {
 
-   if (rc < 0) {
-      printf("Failed to acquire the sound device\n");
-      return 1;
+      /* No acquire/release: /dev/dsp can be opened only once at a time */
+      if (read_dsp_stats(&dsp_stats) < 0)
+         return 1;
+
+   } else {
+
+      rc = ioctl(devfd, TILCK_IOCTL_SOUND_ACQUIRE, NULL);
+
+      if (rc < 0) {
+         printf("Failed to acquire the sound device\n");
+         return 1;
+      }
    }
 
    rc = ioctl(devfd, TILCK_IOCTL_SOUND_GET_INFO, &nfo);
@@ -559,11 +651,19 @@ int main(int argc, char **argv)
       return 1;
    }
 
-   rc = ioctl(devfd, TILCK_IOCTL_SOUND_RELEASE, NULL);
+   if (opt_dsp) {
 
-   if (rc < 0) {
-      printf("Failed to release the sound device\n");
-      return 1;
+      if (!cmd_rc)
+         cmd_rc = check_dsp_stats(&dsp_stats);
+
+   } else {
+
+      rc = ioctl(devfd, TILCK_IOCTL_SOUND_RELEASE, NULL);
+
+      if (rc < 0) {
+         printf("Failed to release the sound device\n");
+         return 1;
+      }
    }
 
    close(devfd);
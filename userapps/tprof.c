@@ -0,0 +1,538 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <elf.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+
+#include <tilck/common/tilck_prof.h>
+
+#if __SIZEOF_POINTER__ == 4
+   typedef Elf32_Ehdr Elf_Ehdr;
+   typedef Elf32_Shdr Elf_Shdr;
+   typedef Elf32_Sym Elf_Sym;
+   #define ELF_ST_TYPE(x) ELF32_ST_TYPE(x)
+#else
+   typedef Elf64_Ehdr Elf_Ehdr;
+   typedef Elf64_Shdr Elf_Shdr;
+   typedef Elf64_Sym Elf_Sym;
+   #define ELF_ST_TYPE(x) ELF64_ST_TYPE(x)
+#endif
+
+#define READ_BUF_SAMPLES                64
+
+struct sym {
+   ulong addr;
+   ulong size;
+   const char *name;
+   u32 self;                  /* Samples with this symbol as leaf */
+   u32 total;                 /* Samples with this symbol in the stack */
+};
+
+static const char *opt_device = "/dev/prof";
+static const char *opt_user_elf;
+static bool opt_folded;
+static u32 opt_period = 1;
+static int opt_secs;
+static int opt_top = 20;
+static char **opt_cmd;
+
+static int prof_fd;
+static struct tilck_prof_sample *samples;
+static size_t samples_count;
+static size_t samples_max;
+
+static struct sym *user_syms;
+static size_t user_syms_count;
+static char *user_strtab;
+
+static struct sym kernel_syms_cache[1024];
+static size_t kernel_syms_cache_count;
+
+static struct sym unknown_user_sym = { .name = "[user]" };
+static struct sym unknown_kernel_sym = { .name = "[kernel]" };
+static pid_t user_elf_pid;    /* When > 0, the pid using `opt_user_elf` */
+
+static volatile bool stop_requested;
+
+static void
+show_help_and_exit(void)
+{
+   printf("syntax:\n");
+   printf("    tprof [-f] [-n top] [-p period] [-t secs] [-e elf] "
+          "[-- <cmd> [args...]]\n");
+   printf("\n");
+   printf("Sample the running code every `period` timer ticks using %s\n",
+          opt_device);
+   printf("until <cmd> exits, `secs` seconds have passed or Ctrl+C is hit.\n");
+   printf("Then, print a flat top-N report or, with -f, the folded stacks\n");
+   printf("accepted by flamegraph.pl. User addresses are resolved using the\n");
+   printf("symbols of the given ELF file (default: <cmd>, if it's a path).\n");
+   exit(1);
+}
+
+static void
+parse_args(int argc, char **argv)
+{
+   while (argc) {
+
+      char *arg = argv[0];
+
+      if (!strcmp(arg, "-f")) {
+
+         opt_folded = true;
+
+      } else if (!strcmp(arg, "-n") && argc >= 2) {
+
+         argc--; argv++;
+         opt_top = atoi(argv[0]);
+
+      } else if (!strcmp(arg, "-p") && argc >= 2) {
+
+         argc--; argv++;
+         opt_period = (u32)atoi(argv[0]);
+
+      } else if (!strcmp(arg, "-t") && argc >= 2) {
+
+         argc--; argv++;
+         opt_secs = atoi(argv[0]);
+
+      } else if (!strcmp(arg, "-e") && argc >= 2) {
+
+         argc--; argv++;
+         opt_user_elf = argv[0];
+
+      } else if (!strcmp(arg, "--") && argc >= 2) {
+
+         opt_cmd = argv + 1;
+         break;
+
+      } else {
+
+         show_help_and_exit();
+      }
+
+      argc--; argv++;
+   }
+
+   if (!opt_user_elf && opt_cmd && strchr(opt_cmd[0], '/'))
+      opt_user_elf = opt_cmd[0];
+}
+
+static int
+sym_cmp(const void *a, const void *b)
+{
+   const struct sym *x = a;
+   const struct sym *y = b;
+
+   if (x->addr == y->addr)
+      return 0;
+
+   return x->addr < y->addr ? -1 : 1;
+}
+
+static void
+load_user_syms(const char *path)
+{
+   Elf_Ehdr *h;
+   Elf_Shdr *sh, *symtab = NULL;
+   Elf_Sym *syms;
+   struct stat st;
+   char *buf;
+   size_t n;
+   int fd;
+
+   if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+      fprintf(stderr, "tprof: unable to open %s: %s\n", path, strerror(errno));
+      return;
+   }
+
+   if (!(buf = malloc((size_t)st.st_size)))
+      goto out;
+
+   if (read(fd, buf, (size_t)st.st_size) != st.st_size)
+      goto out;
+
+   h = (void *)buf;
+
+   if (memcmp(h->e_ident, ELFMAG, SELFMAG)) {
+      fprintf(stderr, "tprof: %s is not an ELF file\n", path);
+      goto out;
+   }
+
+   sh = (void *)(buf + h->e_shoff);
+
+   for (int i = 0; i < h->e_shnum; i++) {
+      if (sh[i].sh_type == SHT_SYMTAB) {
+         symtab = &sh[i];
+         break;
+      }
+   }
+
+   if (!symtab) {
+      fprintf(stderr, "tprof: no symbols in %s\n", path);
+      goto out;
+   }
+
+   syms = (void *)(buf + symtab->sh_offset);
+   n = symtab->sh_size / sizeof(Elf_Sym);
+   user_strtab = buf + sh[symtab->sh_link].sh_offset;
+
+   if (!(user_syms = calloc(n, sizeof(struct sym))))
+      goto out;
+
+   for (size_t i = 0; i < n; i++) {
+
+      if (ELF_ST_TYPE(syms[i].st_info) != STT_FUNC || !syms[i].st_value)
+         continue;
+
+      user_syms[user_syms_count++] = (struct sym) {
+         .addr = syms[i].st_value,
+         .size = syms[i].st_size,
+         .name = user_strtab + syms[i].st_name,
+      };
+   }
+
+   qsort(user_syms, user_syms_count, sizeof(struct sym), sym_cmp);
+   buf = NULL; /* Keep it: the names point inside it */
+
+out:
+   free(buf);
+   close(fd);
+}
+
+static struct sym *
+resolve_user_addr(ulong addr)
+{
+   size_t lo = 0, hi = user_syms_count;
+
+   /* Find the last symbol with sym.addr <= addr */
+   while (lo < hi) {
+
+      size_t mid = (lo + hi) / 2;
+
+      if (user_syms[mid].addr <= addr)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   if (lo > 0) {
+
+      struct sym *s = &user_syms[lo - 1];
+
+      if (addr < s->addr + (s->size ? s->size : 1))
+         return s;
+   }
+
+   return &unknown_user_sym;
+}
+
+static struct sym *
+resolve_kernel_addr(ulong addr)
+{
+   struct tilck_prof_sym ps = { .addr = addr };
+   struct sym *s;
+
+   for (size_t i = 0; i < kernel_syms_cache_count; i++) {
+
+      s = &kernel_syms_cache[i];
+
+      if (s->addr <= addr && addr < s->addr + s->size)
+         return s;
+   }
+
+   if (ioctl(prof_fd, TILCK_IOCTL_PROF_GET_SYM, &ps) < 0)
+      return &unknown_kernel_sym;
+
+   /*
+    * We don't know the size of the symbol: just make its cache entry cover
+    * [sym_addr, addr]. That's enough to hit the cache for the hottest spots.
+    */
+   for (size_t i = 0; i < kernel_syms_cache_count; i++) {
+
+      s = &kernel_syms_cache[i];
+
+      if (s->addr == addr - ps.off) {
+         s->size = ps.off + 1;
+         return s;
+      }
+   }
+
+   if (kernel_syms_cache_count == ARRAY_SIZE(kernel_syms_cache))
+      return &unknown_kernel_sym; /* Very unlikely */
+
+   s = &kernel_syms_cache[kernel_syms_cache_count++];
+
+   *s = (struct sym) {
+      .addr = addr - ps.off,
+      .size = ps.off + 1,
+      .name = strdup(ps.name),
+   };
+
+   return s;
+}
+
+static struct sym *
+resolve_frame(const struct tilck_prof_sample *s, u32 i)
+{
+   if (!i && (s->flags & TILCK_PROF_FL_USER)) {
+
+      if (user_elf_pid > 0 && s->pid != user_elf_pid)
+         return &unknown_user_sym;
+
+      return resolve_user_addr(s->frames[0]);
+   }
+
+   /* Frames > 0 are return addresses: look for the call instruction */
+   return resolve_kernel_addr(i ? s->frames[i] - 1 : s->frames[i]);
+}
+
+static int
+consume_samples(void)
+{
+   struct tilck_prof_sample buf[READ_BUF_SAMPLES];
+   ssize_t rc;
+   size_t n;
+
+   rc = read(prof_fd, buf, sizeof(buf));
+
+   if (rc <= 0)
+      return (int)rc;
+
+   n = (size_t)rc / sizeof(buf[0]);
+
+   if (samples_count + n > samples_max) {
+
+      samples_max = samples_max ? samples_max * 2 : 1024;
+      samples = realloc(samples, samples_max * sizeof(samples[0]));
+
+      if (!samples) {
+         fprintf(stderr, "tprof: out of memory\n");
+         exit(1);
+      }
+   }
+
+   memcpy(samples + samples_count, buf, n * sizeof(buf[0]));
+   samples_count += n;
+   return (int)n;
+}
+
+static int
+sym_cmp_by_samples(const void *a, const void *b)
+{
+   const struct sym *x = *(const struct sym * const *)a;
+   const struct sym *y = *(const struct sym * const *)b;
+
+   if (x->self != y->self)
+      return x->self < y->self ? 1 : -1;
+
+   return x->total < y->total ? 1 : (x->total > y->total ? -1 : 0);
+}
+
+static void
+print_flat_report(void)
+{
+   struct sym **arr;
+   size_t count = 0;
+
+   for (size_t i = 0; i < samples_count; i++) {
+
+      const struct tilck_prof_sample *s = &samples[i];
+      struct sym *seen[TILCK_PROF_MAX_FRAMES];
+      u32 seen_count = 0;
+
+      resolve_frame(s, 0)->self++;
+
+      for (u32 j = 0; j < s->frames_count; j++) {
+
+         struct sym *sym = resolve_frame(s, j);
+         bool dup = false;
+
+         /* Count recursive functions just once per sample */
+         for (u32 k = 0; k < seen_count; k++)
+            dup = dup || seen[k] == sym;
+
+         if (!dup) {
+            seen[seen_count++] = sym;
+            sym->total++;
+         }
+      }
+   }
+
+   arr = calloc(kernel_syms_cache_count + user_syms_count + 2, sizeof(*arr));
+
+   if (!arr) {
+      fprintf(stderr, "tprof: out of memory\n");
+      return;
+   }
+
+   for (size_t i = 0; i < kernel_syms_cache_count; i++)
+      if (kernel_syms_cache[i].total)
+         arr[count++] = &kernel_syms_cache[i];
+
+   for (size_t i = 0; i < user_syms_count; i++)
+      if (user_syms[i].total)
+         arr[count++] = &user_syms[i];
+
+   if (unknown_kernel_sym.total)
+      arr[count++] = &unknown_kernel_sym;
+
+   if (unknown_user_sym.total)
+      arr[count++] = &unknown_user_sym;
+
+   qsort(arr, count, sizeof(*arr), sym_cmp_by_samples);
+
+   printf("%8s %7s %8s %7s  %s\n",
+          "self", "self%", "total", "total%", "symbol");
+
+   for (size_t i = 0; i < count && (int)i < opt_top; i++) {
+      printf("%8u %6.2f%% %8u %6.2f%%  %s\n",
+             arr[i]->self, 100.0 * arr[i]->self / samples_count,
+             arr[i]->total, 100.0 * arr[i]->total / samples_count,
+             arr[i]->name);
+   }
+
+   free(arr);
+}
+
+static int
+str_cmp(const void *a, const void *b)
+{
+   return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void
+print_folded_stacks(void)
+{
+   char **lines = calloc(samples_count, sizeof(char *));
+   char buf[1024];
+
+   if (!lines) {
+      fprintf(stderr, "tprof: out of memory\n");
+      return;
+   }
+
+   for (size_t i = 0; i < samples_count; i++) {
+
+      const struct tilck_prof_sample *s = &samples[i];
+      int w;
+
+      w = snprintf(buf, sizeof(buf), "%s-%d",
+                   s->pid ? "pid" : "kernel", s->pid ? s->pid : s->tid);
+
+      /* Folded stacks go from the root to the leaf */
+      for (u32 j = s->frames_count; j > 0 && w < (int)sizeof(buf); j--)
+         w += snprintf(buf + w, sizeof(buf) - (size_t)w,
+                       ";%s", resolve_frame(s, j - 1)->name);
+
+      lines[i] = strdup(buf);
+   }
+
+   qsort(lines, samples_count, sizeof(char *), str_cmp);
+
+   for (size_t i = 0, n = 1; i < samples_count; i++, n++) {
+
+      if (i + 1 < samples_count && !strcmp(lines[i], lines[i + 1]))
+         continue;
+
+      printf("%s %zu\n", lines[i], n);
+      n = 0;
+   }
+
+   for (size_t i = 0; i < samples_count; i++)
+      free(lines[i]);
+
+   free(lines);
+}
+
+static pid_t
+run_cmd(void)
+{
+   pid_t pid = fork();
+
+   if (pid < 0) {
+      perror("fork() failed");
+      return pid;
+   }
+
+   if (!pid) {
+      close(prof_fd);
+      execvp(opt_cmd[0], opt_cmd);
+      perror("execvp() failed");
+      exit(1);
+   }
+
+   return pid;
+}
+
+static void
+sigint_handler(int signum)
+{
+   stop_requested = true;
+}
+
+int main(int argc, char **argv)
+{
+   struct tilck_prof_stats stats;
+   pid_t child = -1;
+   int wstatus, elapsed_ms = 0;
+
+   parse_args(argc - 1, argv + 1);
+
+   if ((prof_fd = open(opt_device, O_RDONLY)) < 0) {
+      fprintf(stderr, "Unable to open %s: %s\n", opt_device, strerror(errno));
+      return 1;
+   }
+
+   signal(SIGINT, sigint_handler);
+   ioctl(prof_fd, TILCK_IOCTL_PROF_START, (void *)(long)opt_period);
+
+   if (opt_cmd && (child = run_cmd()) < 0)
+      return 1;
+
+   while (!stop_requested) {
+
+      if (consume_samples() > 0)
+         continue;
+
+      if (child > 0 && waitpid(child, &wstatus, WNOHANG) == child)
+         break;
+
+      if (opt_secs && elapsed_ms >= opt_secs * 1000)
+         break;
+
+      usleep(50 * 1000);
+      elapsed_ms += 50;
+   }
+
+   ioctl(prof_fd, TILCK_IOCTL_PROF_STOP);
+   while (consume_samples() > 0) { }
+
+   if (opt_user_elf) {
+      user_elf_pid = child;
+      load_user_syms(opt_user_elf);
+   }
+
+   if (opt_folded)
+      print_folded_stacks();
+   else
+      print_flat_report();
+
+   if (!ioctl(prof_fd, TILCK_IOCTL_PROF_GET_STATS, &stats)) {
+      fprintf(stderr, "tprof: %u samples (every %u ticks, %u Hz), %u dropped\n",
+              stats.samples, stats.period, stats.timer_hz, stats.dropped);
+   }
+
+   close(prof_fd);
+   return 0;
+}
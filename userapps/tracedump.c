@@ -0,0 +1,349 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <tilck/common/tilck_trace.h>
+
+#define MAX_SYS_NAMES                 512
+
+static const char *opt_device = "/dev/trace";
+static bool opt_json;
+static long opt_max_recs = -1;
+static char **opt_cmd;
+static int opt_tids[16];
+static int opt_tids_count;
+
+static int trace_fd;
+static struct tilck_trace_ring_hdr *hdr;
+static const struct tilck_trace_rec *recs;
+static size_t ring_size;
+
+static char sys_names[MAX_SYS_NAMES][32];
+static volatile bool stop_requested;
+
+static void
+show_help_and_exit(void)
+{
+   printf("syntax:\n");
+   printf("    tracedump [-j] [-n max] -p tid [-p tid...]\n");
+   printf("    tracedump [-j] [-n max] -- <cmd> [args...]\n");
+   printf("\n");
+   printf("Consume the binary records of %s and print them as text\n",
+          opt_device);
+   printf("or, with -j, as JSON (one object per line).\n");
+   exit(1);
+}
+
+static void
+parse_args(int argc, char **argv)
+{
+   while (argc) {
+
+      char *arg = argv[0];
+
+      if (!strcmp(arg, "-j")) {
+
+         opt_json = true;
+
+      } else if (!strcmp(arg, "-n")) {
+
+         if (argc < 2)
+            show_help_and_exit();
+
+         argc--; argv++;
+         opt_max_recs = atol(argv[0]);
+
+      } else if (!strcmp(arg, "-p")) {
+
+         if (argc < 2 || opt_tids_count == ARRAY_SIZE(opt_tids))
+            show_help_and_exit();
+
+         argc--; argv++;
+         opt_tids[opt_tids_count++] = atoi(argv[0]);
+
+      } else if (!strcmp(arg, "--")) {
+
+         if (argc < 2)
+            show_help_and_exit();
+
+         opt_cmd = argv + 1;
+         break;
+
+      } else {
+
+         show_help_and_exit();
+      }
+
+      argc--; argv++;
+   }
+
+   if (!opt_cmd && !opt_tids_count)
+      show_help_and_exit();
+}
+
+static const char *
+get_sys_name(u32 sys)
+{
+   struct tilck_trace_sys ts = { .sys = sys };
+
+   if (sys >= MAX_SYS_NAMES)
+      return "?";
+
+   if (!sys_names[sys][0]) {
+
+      if (ioctl(trace_fd, TILCK_IOCTL_TRACE_GET_SYS_NAME, &ts) < 0)
+         snprintf(ts.name, sizeof(ts.name), "sys_%u", sys);
+
+      memcpy(sys_names[sys], ts.name, sizeof(ts.name));
+   }
+
+   return sys_names[sys];
+}
+
+static void
+dump_rec_as_text(const struct tilck_trace_rec *r)
+{
+   printf("%5u.%06u [%d] ",
+          (u32)(r->ts / 1000000000),
+          (u32)((r->ts % 1000000000) / 1000),
+          r->tid);
+
+   switch (r->type) {
+
+      case TILCK_TRACE_SYS_ENTER:
+      case TILCK_TRACE_SYS_EXIT:
+
+         printf("%s %s(",
+                r->type == TILCK_TRACE_SYS_ENTER ? "ENTER" : "EXIT ",
+                get_sys_name(r->sys));
+
+         for (int i = 0; i < 6; i++)
+            printf("%s%#lx", i ? ", " : "", (unsigned long)r->args[i]);
+
+         if (r->type == TILCK_TRACE_SYS_EXIT)
+            printf(") -> %lld\n", (long long)r->retval);
+         else
+            printf(")\n");
+
+         break;
+
+      case TILCK_TRACE_SIGNAL_DELIVERED:
+         printf("GOT SIGNAL: %s\n", strsignal(r->signum));
+         break;
+
+      case TILCK_TRACE_KILLED:
+         printf("KILLED BY SIGNAL: %s\n", strsignal(r->signum));
+         break;
+
+      default:
+         printf("<unknown record type %u>\n", r->type);
+   }
+}
+
+static void
+dump_rec_as_json(const struct tilck_trace_rec *r)
+{
+   static const char *type_names[] = {
+      [TILCK_TRACE_SYS_ENTER] = "sys_enter",
+      [TILCK_TRACE_SYS_EXIT] = "sys_exit",
+      [TILCK_TRACE_SIGNAL_DELIVERED] = "signal_delivered",
+      [TILCK_TRACE_KILLED] = "killed",
+   };
+
+   const char *type = r->type < ARRAY_SIZE(type_names) && type_names[r->type]
+      ? type_names[r->type]
+      : "unknown";
+
+   printf("{\"ts\": %llu, \"tid\": %d, \"type\": \"%s\"",
+          (unsigned long long)r->ts, r->tid, type);
+
+   if (r->type == TILCK_TRACE_SYS_ENTER || r->type == TILCK_TRACE_SYS_EXIT) {
+
+      printf(", \"sys\": %u, \"name\": \"%s\", \"args\": [",
+             r->sys, get_sys_name(r->sys));
+
+      for (int i = 0; i < 6; i++)
+         printf("%s%lu", i ? ", " : "", (unsigned long)r->args[i]);
+
+      printf("]");
+
+      if (r->type == TILCK_TRACE_SYS_EXIT)
+         printf(", \"retval\": %lld", (long long)r->retval);
+
+   } else {
+
+      printf(", \"signum\": %d", r->signum);
+   }
+
+   printf("}\n");
+}
+
+/* Consume all the published records. Returns the number of records read. */
+static long
+consume_records(void)
+{
+   u32 tail = __atomic_load_n(&hdr->tail, __ATOMIC_RELAXED);
+   const u32 mask = hdr->rec_count - 1;
+   long count = 0;
+
+   while (opt_max_recs < 0 || opt_max_recs > 0) {
+
+      const struct tilck_trace_rec *r = &recs[tail & mask];
+
+      if (__atomic_load_n(&r->seq_plus_one, __ATOMIC_ACQUIRE) != tail + 1)
+         break; /* not published yet */
+
+      if (opt_json)
+         dump_rec_as_json(r);
+      else
+         dump_rec_as_text(r);
+
+      /* Free the slot */
+      tail++;
+      __atomic_store_n(&hdr->tail, tail, __ATOMIC_RELEASE);
+
+      if (opt_max_recs > 0)
+         opt_max_recs--;
+
+      count++;
+   }
+
+   return count;
+}
+
+static int
+map_trace_ring(void)
+{
+   struct tilck_trace_ring_hdr *h;
+
+   h = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, trace_fd, 0);
+
+   if (h == MAP_FAILED) {
+      perror("mmap() failed");
+      return -1;
+   }
+
+   if (h->magic != TILCK_TRACE_RING_MAGIC) {
+      fprintf(stderr, "Invalid trace ring magic: %#x\n", h->magic);
+      munmap(h, 4096);
+      return -1;
+   }
+
+   ring_size = h->data_off + h->rec_count * h->rec_size;
+   munmap(h, 4096);
+
+   hdr = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, trace_fd, 0);
+
+   if (hdr == MAP_FAILED) {
+      perror("mmap() failed");
+      return -1;
+   }
+
+   if (hdr->rec_size != sizeof(struct tilck_trace_rec)) {
+      fprintf(stderr, "Unsupported record size: %u\n", hdr->rec_size);
+      return -1;
+   }
+
+   recs = (void *)((char *)hdr + hdr->data_off);
+   return 0;
+}
+
+static pid_t
+run_cmd(void)
+{
+   pid_t pid = fork();
+
+   if (pid < 0) {
+      perror("fork() failed");
+      return pid;
+   }
+
+   if (!pid) {
+
+      /* Trace ourselves, then exec the command: the flag survives execve() */
+      if (ioctl(trace_fd, TILCK_IOCTL_TRACE_TID, 0) < 0) {
+         perror("ioctl(TILCK_IOCTL_TRACE_TID) failed");
+         exit(1);
+      }
+
+      close(trace_fd);
+      execvp(opt_cmd[0], opt_cmd);
+      perror("execvp() failed");
+      exit(1);
+   }
+
+   return pid;
+}
+
+static void
+sigint_handler(int signum)
+{
+   stop_requested = true;
+}
+
+int main(int argc, char **argv)
+{
+   pid_t child = -1;
+   int rc, wstatus;
+
+   parse_args(argc - 1, argv + 1);
+
+   if ((trace_fd = open(opt_device, O_RDWR)) < 0) {
+      fprintf(stderr, "Unable to open %s: %s\n", opt_device, strerror(errno));
+      return 1;
+   }
+
+   if (map_trace_ring() < 0)
+      return 1;
+
+   for (int i = 0; i < opt_tids_count; i++) {
+
+      rc = ioctl(trace_fd, TILCK_IOCTL_TRACE_TID, (void *)(long)opt_tids[i]);
+
+      if (rc < 0) {
+         fprintf(stderr, "Unable to trace tid %d: %s\n",
+                 opt_tids[i], strerror(errno));
+         return 1;
+      }
+   }
+
+   signal(SIGINT, sigint_handler);
+   ioctl(trace_fd, TILCK_IOCTL_TRACE_START);
+
+   if (opt_cmd && (child = run_cmd()) < 0)
+      return 1;
+
+   while (!stop_requested && opt_max_recs != 0) {
+
+      if (consume_records())
+         continue;
+
+      if (child > 0 && waitpid(child, &wstatus, WNOHANG) == child) {
+         consume_records(); /* the last ones */
+         break;
+      }
+
+      usleep(10 * 1000);
+   }
+
+   ioctl(trace_fd, TILCK_IOCTL_TRACE_STOP);
+
+   if (hdr->dropped)
+      fprintf(stderr, "tracedump: %u records dropped\n", hdr->dropped);
+
+   munmap(hdr, ring_size);
+   close(trace_fd);
+   return 0;
+}